@@ -6,6 +6,7 @@
 #include <stdbool.h>
 
 #include "pins_arduino.h"
+#include "ArduinoTasks.h"
 
 #ifdef __cplusplus
 #include "WString.h"
@@ -34,6 +35,7 @@ extern "C" {
 extern void delay(uint32_t ms);
 extern uint32_t millis();
 extern uint32_t micros();
+extern void yield();
 
 extern void pinMode(int, int);
 extern void digitalWrite(int, int);
@@ -0,0 +1,42 @@
+#ifndef _ARDUINO_TASKS_H
+#define _ARDUINO_TASKS_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+// Describes a task to be created by main() before the scheduler starts.
+// Instances are placed in the .arduino_tasks section by DEFINE_TASK() and
+// collected by the linker, so a sketch or library only has to define one.
+typedef struct {
+    const char *name;
+    void (*function)();
+    uint32_t stack;
+    UBaseType_t priority;
+    StackType_t *stackBuffer;       // Static allocation only, otherwise NULL
+    StaticTask_t *taskBuffer;       // Static allocation only, otherwise NULL
+    TaskHandle_t *handle;           // Receives the handle once created
+} ArduinoTaskDescriptor;
+
+// Define a task that runs fn() once at the given priority with the given
+// stack depth (in words). If fn() returns the task deletes itself. The task
+// handle is available afterwards as <name>_handle.
+//
+//     void blink() { for (;;) { ... } }
+//     DEFINE_TASK(blinker, 3, 256, blink);
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+#define DEFINE_TASK(name, prio, stack, fn) \
+    TaskHandle_t name##_handle = NULL; \
+    static StackType_t name##_stack[stack] portSTATIC_STORAGE; \
+    static StaticTask_t name##_tcb portSTATIC_STORAGE; \
+    static const ArduinoTaskDescriptor name##_descriptor __attribute__((section(".arduino_tasks"), used, aligned(4))) = \
+        { #name, fn, stack, prio, name##_stack, &name##_tcb, &name##_handle }
+#else
+#define DEFINE_TASK(name, prio, stack, fn) \
+    TaskHandle_t name##_handle = NULL; \
+    static const ArduinoTaskDescriptor name##_descriptor __attribute__((section(".arduino_tasks"), used, aligned(4))) = \
+        { #name, fn, stack, prio, NULL, NULL, &name##_handle }
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef _BUFFERED_PRINT_H
+#define _BUFFERED_PRINT_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "Print.h"
+
+// Collects output in a buffer of N bytes and passes it on to another Print
+// in one write() when the buffer fills or flush() is called, so a run of
+// print() calls, or a Printable that prints itself a piece at a time, costs
+// one write (and one UART mutex) rather than one per call. Whatever is left
+// is flushed when the BufferedPrint goes out of scope.
+//
+//     {
+//         BufferedPrint<128> out(Serial);
+//         out.print("t=");
+//         out.print(millis());
+//         out.print(" v=");
+//         out.println(volts, 3);
+//     }
+//
+template <size_t N = 64>
+class BufferedPrint : public Print {
+    private:
+        Print &_out;
+        size_t _len;
+        uint8_t _buffer[N];
+
+    public:
+        BufferedPrint(Print &out) : _out(out), _len(0) {}
+        ~BufferedPrint() { flush(); }
+
+        virtual size_t write(uint8_t val) {
+            if (_len == N) flush();
+            _buffer[_len++] = val;
+            return 1;
+        }
+
+        virtual size_t write(const uint8_t *buffer, size_t size) {
+            if (_len + size > N) {
+                flush();
+                // Too big to be worth copying
+                if (size >= N) return _out.write(buffer, size);
+            }
+            memcpy(&_buffer[_len], buffer, size);
+            _len += size;
+            return size;
+        }
+        using Print::write;
+
+        virtual int availableForWrite() { return N - _len; }
+
+        // Pass the buffered bytes on to the output
+        void flush() {
+            if (_len == 0) return;
+            _out.write(_buffer, _len);
+            _len = 0;
+        }
+};
+
+#endif
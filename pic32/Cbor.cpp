@@ -0,0 +1,388 @@
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+#include "Cbor.h"
+
+void CborWriter::put(const uint8_t *data, size_t len) {
+    if (_out.write(data, len) != len) _error = true;
+}
+
+// An item header: the major type in the top three bits and the argument
+// in the rest, or in the 1, 2 or 4 bytes after, big endian
+void CborWriter::head(uint8_t major, uint32_t value) {
+    uint8_t buf[5];
+    size_t len;
+
+    major <<= 5;
+    if (value < 24) {
+        buf[0] = major | value;
+        len = 1;
+    } else if (value <= 0xFF) {
+        buf[0] = major | 24;
+        buf[1] = value;
+        len = 2;
+    } else if (value <= 0xFFFF) {
+        buf[0] = major | 25;
+        buf[1] = value >> 8;
+        buf[2] = value;
+        len = 3;
+    } else {
+        buf[0] = major | 26;
+        buf[1] = value >> 24;
+        buf[2] = value >> 16;
+        buf[3] = value >> 8;
+        buf[4] = value;
+        len = 5;
+    }
+    put(buf, len);
+}
+
+void CborWriter::head64(uint8_t major, uint64_t value) {
+    if (value <= 0xFFFFFFFF) {
+        head(major, (uint32_t)value);
+        return;
+    }
+    uint8_t buf[9];
+    buf[0] = (major << 5) | 27;
+    for (int i = 8; i > 0; i--) {
+        buf[i] = value;
+        value >>= 8;
+    }
+    put(buf, sizeof(buf));
+}
+
+// A negative number n is sent as major type 1 with -1 - n, which is ~n
+void CborWriter::writeInt(int32_t value) {
+    if (value < 0) head(1, ~(uint32_t)value);
+    else head(0, value);
+}
+
+void CborWriter::writeInt64(int64_t value) {
+    if (value < 0) head64(1, ~(uint64_t)value);
+    else head64(0, value);
+}
+
+void CborWriter::writeBool(bool value) {
+    uint8_t b = value ? 0xF5 : 0xF4;
+    put(&b, 1);
+}
+
+void CborWriter::writeNull() {
+    uint8_t b = 0xF6;
+    put(&b, 1);
+}
+
+void CborWriter::writeFloat(float value) {
+    union { float f; uint32_t u; } v;
+    uint8_t buf[5];
+
+    v.f = value;
+    buf[0] = 0xFA;
+    buf[1] = v.u >> 24;
+    buf[2] = v.u >> 16;
+    buf[3] = v.u >> 8;
+    buf[4] = v.u;
+    put(buf, sizeof(buf));
+}
+
+void CborWriter::writeDouble(double value) {
+    if (((double)(float)value == value) || isnan(value)) {
+        writeFloat((float)value);
+        return;
+    }
+    union { double d; uint64_t u; } v;
+    uint8_t buf[9];
+
+    v.d = value;
+    buf[0] = 0xFB;
+    for (int i = 8; i > 0; i--) {
+        buf[i] = v.u;
+        v.u >>= 8;
+    }
+    put(buf, sizeof(buf));
+}
+
+void CborWriter::writeString(const char *str, size_t len) {
+    head(3, len);
+    put((const uint8_t *)str, len);
+}
+
+void CborWriter::writeBytes(const uint8_t *data, size_t len) {
+    head(2, len);
+    put(data, len);
+}
+
+void CborWriter::beginArray() {
+    uint8_t b = 0x9F;
+    put(&b, 1);
+}
+
+void CborWriter::beginMap() {
+    uint8_t b = 0xBF;
+    put(&b, 1);
+}
+
+void CborWriter::end() {
+    uint8_t b = 0xFF;
+    put(&b, 1);
+}
+
+bool CborReader::fill(uint8_t *buf, size_t len) {
+    if (_stream != NULL) return _stream->readBytes(buf, len) == len;
+    if (len > _len - _pos) {
+        _pos = _len;
+        return false;
+    }
+    memcpy(buf, _data + _pos, len);
+    _pos += len;
+    return true;
+}
+
+bool CborReader::discard(uint64_t len) {
+    if (_stream == NULL) {
+        if (len > _len - _pos) {
+            _pos = _len;
+            return false;
+        }
+        _pos += len;
+        return true;
+    }
+    uint8_t buf[16];
+    while (len > 0) {
+        size_t n = (len < sizeof(buf)) ? len : sizeof(buf);
+        if (!fill(buf, n)) return false;
+        len -= n;
+    }
+    return true;
+}
+
+static double cbor_half(uint16_t h) {
+    int exponent = (h >> 10) & 0x1F;
+    int mantissa = h & 0x3FF;
+    double v;
+    if (exponent == 0) v = ldexp(mantissa, -24);
+    else if (exponent != 31) v = ldexp(mantissa + 1024, exponent - 25);
+    else v = (mantissa == 0) ? INFINITY : NAN;
+    return (h & 0x8000) ? -v : v;
+}
+
+/**
+ * Read the header of the next item, passing over the rest of a string
+ * whose content was not read
+ * @returns The type of the item
+ */
+CborReader::Type CborReader::next() {
+    uint8_t buf[8];
+
+    if ((_type == Error) || ((_left > 0) && !discard(_left))) return _type = Error;
+    _left = 0;
+    _indefinite = false;
+    _value = 0;
+
+    if ((_stream == NULL) && (_pos == _len)) return _type = End;
+    if (!fill(buf, 1)) return _type = Error;
+
+    uint8_t major = buf[0] >> 5;
+    uint8_t info = buf[0] & 0x1F;
+    if (info < 24) {
+        _value = info;
+    } else if (info <= 27) {
+        size_t n = 1 << (info - 24);
+        if (!fill(buf, n)) return _type = Error;
+        for (size_t i = 0; i < n; i++) _value = (_value << 8) | buf[i];
+    } else if (info == 31) {
+        if ((major == 0) || (major == 1) || (major == 6)) return _type = Error;
+        _indefinite = true;
+    } else {
+        return _type = Error;
+    }
+
+    switch (major) {
+        case 0: return _type = Unsigned;
+        case 1: return _type = Negative;
+        case 2:
+        case 3:
+            if (!_indefinite) _left = _value;
+            return _type = (major == 2) ? Bytes : Text;
+        case 4: return _type = Array;
+        case 5: return _type = Map;
+        case 6: return _type = Tag;
+    }
+
+    // Major type 7: simple values and floats
+    if (info == 25) {
+        _float = cbor_half(_value);
+        return _type = Float;
+    }
+    if (info == 26) {
+        union { float f; uint32_t u; } v;
+        v.u = _value;
+        _float = v.f;
+        return _type = Float;
+    }
+    if (info == 27) {
+        union { double d; uint64_t u; } v;
+        v.u = _value;
+        _float = v.d;
+        return _type = Float;
+    }
+    if (_indefinite) {
+        _indefinite = false;
+        return _type = Break;
+    }
+    switch (_value) {
+        case 20: return _type = False;
+        case 21: return _type = True;
+        case 22: return _type = Null;
+        case 23: return _type = Undefined;
+    }
+    return _type = Simple;
+}
+
+bool CborReader::skipItem(uint8_t depth) {
+    if (depth > CBOR_MAX_DEPTH) {
+        _type = Error;
+        return false;
+    }
+
+    Type type = _type;
+    uint64_t items = _value * ((type == Map) ? 2 : 1);
+    switch (type) {
+        case Bytes:
+        case Text:
+            if (!_indefinite) {
+                if (!discard(_left)) {
+                    _type = Error;
+                    return false;
+                }
+                _left = 0;
+                return true;
+            }
+            // The chunks, up to the Break
+            while (next() == type) {
+                if (_indefinite || !skipItem(depth + 1)) break;
+            }
+            if (_type != Break) _type = Error;
+            return _type != Error;
+        case Array:
+        case Map:
+            if (_indefinite) {
+                while ((next() != Break) && (_type != Error) && (_type != End)) {
+                    if (!skipItem(depth + 1)) return false;
+                }
+                if (_type != Break) _type = Error;
+                return _type != Error;
+            }
+            while (items--) {
+                next();
+                if ((_type == Error) || (_type == End) || (_type == Break) || !skipItem(depth + 1)) {
+                    _type = Error;
+                    return false;
+                }
+            }
+            return true;
+        case Tag:
+            next();
+            if ((_type == End) || (_type == Break)) _type = Error;
+            return (_type != Error) && skipItem(depth + 1);
+        case Error:
+            return false;
+        default:
+            return true;
+    }
+}
+
+/**
+ * Pass over the whole of the current item: the content of a string, or
+ * everything in an array or map, or the item a tag applies to
+ * @returns true if the item was well formed and complete
+ */
+bool CborReader::skip() {
+    return skipItem(0);
+}
+
+bool CborReader::getUInt(uint32_t &value) const {
+    if ((_type != Unsigned) || (_value > 0xFFFFFFFF)) return false;
+    value = _value;
+    return true;
+}
+
+bool CborReader::getInt(long &value) const {
+    if (((_type != Unsigned) && (_type != Negative)) || (_value > LONG_MAX)) return false;
+    value = (_type == Negative) ? -1 - (long)_value : (long)_value;
+    return true;
+}
+
+bool CborReader::getUInt64(uint64_t &value) const {
+    if (_type != Unsigned) return false;
+    value = _value;
+    return true;
+}
+
+bool CborReader::getInt64(int64_t &value) const {
+    if (((_type != Unsigned) && (_type != Negative)) || (_value > INT64_MAX)) return false;
+    value = (_type == Negative) ? -1 - (int64_t)_value : (int64_t)_value;
+    return true;
+}
+
+bool CborReader::getBool(bool &value) const {
+    if ((_type != True) && (_type != False)) return false;
+    value = (_type == True);
+    return true;
+}
+
+bool CborReader::getDouble(double &value) const {
+    if (_type == Float) value = _float;
+    else if (_type == Unsigned) value = (double)_value;
+    else if (_type == Negative) value = -1.0 - (double)_value;
+    else return false;
+    return true;
+}
+
+bool CborReader::getFloat(float &value) const {
+    double v;
+    if (!getDouble(v)) return false;
+    value = (float)v;
+    return true;
+}
+
+bool CborReader::getString(char *buf, size_t size) {
+    if ((_type != Text) || _indefinite || (size == 0)) return false;
+    if (_left >= size) {
+        skip();
+        return false;
+    }
+    size_t len = _left;
+    _left = 0;
+    if (!fill((uint8_t *)buf, len)) {
+        _type = Error;
+        return false;
+    }
+    buf[len] = 0;
+    return true;
+}
+
+bool CborReader::getView(StringView &value) {
+    if (((_type != Text) && (_type != Bytes)) || _indefinite || (_stream != NULL)) return false;
+    if (_left > _len - _pos) {
+        _pos = _len;
+        _type = Error;
+        return false;
+    }
+    value = StringView((const char *)_data + _pos, _left);
+    _pos += _left;
+    _left = 0;
+    return true;
+}
+
+size_t CborReader::readData(uint8_t *buf, size_t len) {
+    if ((_type != Text) && (_type != Bytes)) return 0;
+    if (len > _left) len = _left;
+    if (!fill(buf, len)) {
+        _type = Error;
+        return 0;
+    }
+    _left -= len;
+    return len;
+}
@@ -0,0 +1,163 @@
+#ifndef _CBOR_H
+#define _CBOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Print.h"
+#include "Printable.h"
+#include "Stream.h"
+#include "StringView.h"
+
+// CBOR (RFC 8949) encoding and decoding, for sending structures in a few
+// bytes rather than as text. CborWriter writes each item straight to a
+// Print as it is given, so nothing is built up in memory:
+//
+//     CborWriter cbor(Serial);
+//     cbor.beginMap(3);
+//     cbor.writeString("t");
+//     cbor.writeUInt(millis());
+//     cbor.writeString("mV");
+//     cbor.writeInt(millivolts);
+//     cbor.writeString("temp");
+//     cbor.writeFloat(temp);
+//
+// Each item header is one write, and a string or byte string is a second,
+// so for a UART wrap the Print in a BufferedPrint to send a whole record
+// at once. A class can serialize itself by deriving from Printable and
+// writing CBOR from printTo(); it can then be printed, sent as one item
+// with CborWriter::write(), or framed with FrameStream.
+//
+// CborReader is a pull parser over a buffer or a Stream. next() reads the
+// next item's header and, for a number or simple value, the value itself;
+// arrays and maps are stepped into, so the items in them follow:
+//
+//     CborReader cbor(data, len);
+//     if (cbor.next() == CborReader::Map) {
+//         for (size_t fields = cbor.length(); fields > 0; fields--) {
+//             StringView key;
+//             if ((cbor.next() != CborReader::Text) || !cbor.getView(key)) break;
+//             cbor.next();
+//             if (key == "mV") cbor.getInt(millivolts);
+//             else cbor.skip();
+//         }
+//     }
+//
+// The content of a string is read with getString(), getView() (buffers
+// only, no copy) or readData(); if it is not read, the next call to next()
+// passes over it. skip() passes over the whole of the current item,
+// including anything in an array or map. Nothing is allocated. Indefinite
+// length strings come as a Text or Bytes item with isIndefinite() set,
+// followed by the chunks and a Break.
+
+class CborWriter
+{
+    private:
+        Print &_out;
+        bool _error;
+
+        void head(uint8_t major, uint32_t value);
+        void head64(uint8_t major, uint64_t value);
+        void put(const uint8_t *data, size_t len);
+
+    public:
+        CborWriter(Print &out) : _out(out), _error(false) {}
+
+        void writeUInt(uint32_t value) { head(0, value); }
+        void writeInt(int32_t value);
+        void writeUInt64(uint64_t value) { head64(0, value); }
+        void writeInt64(int64_t value);
+        void writeBool(bool value);
+        void writeNull();
+        void writeFloat(float value);
+        // As a float if that loses nothing, otherwise as a double
+        void writeDouble(double value);
+        void writeString(const StringView &str) { writeString(str.data(), str.length()); }
+        void writeString(const char *str, size_t len);
+        void writeBytes(const uint8_t *data, size_t len);
+        void writeTag(uint32_t tag) { head(6, tag); }
+
+        // Start an array of count items, or a map of count key and value pairs
+        void beginArray(size_t count) { head(4, count); }
+        void beginMap(size_t count) { head(5, count); }
+        // Start an array or map of unknown length, finished by end()
+        void beginArray();
+        void beginMap();
+        void end();
+
+        // A Printable that writes itself as one CBOR item
+        void write(const Printable &item) { item.printTo(_out); }
+
+        // False if any write to the Print came up short
+        bool ok() const { return !_error; }
+};
+
+#define CBOR_MAX_DEPTH 16                   // Nesting skip() will go through
+
+class CborReader
+{
+    public:
+        enum Type {
+            Unsigned, Negative, Bytes, Text, Array, Map, Tag,
+            False, True, Null, Undefined, Simple, Float, Break,
+            End,                            // No more data in a buffer
+            Error                           // Bad data, or a Stream timed out
+        };
+
+    private:
+        const uint8_t *_data;
+        size_t _len;
+        size_t _pos;
+        Stream *_stream;
+        Type _type;
+        bool _indefinite;
+        uint64_t _value;
+        double _float;
+        uint64_t _left;                     // Content of a string not yet read
+
+        bool fill(uint8_t *buf, size_t len);
+        bool discard(uint64_t len);
+        bool skipItem(uint8_t depth);
+
+    public:
+        CborReader(const uint8_t *data, size_t len) :
+            _data(data), _len(len), _pos(0), _stream(NULL), _type(End), _indefinite(false), _value(0), _float(0), _left(0) {}
+        CborReader(const StringView &data) :
+            _data((const uint8_t *)data.data()), _len(data.length()), _pos(0), _stream(NULL),
+            _type(End), _indefinite(false), _value(0), _float(0), _left(0) {}
+        // Reads wait for the Stream's timeout, and a timeout is an Error
+        CborReader(Stream &stream) :
+            _data(NULL), _len(0), _pos(0), _stream(&stream), _type(End), _indefinite(false), _value(0), _float(0), _left(0) {}
+
+        Type next();
+        bool skip();
+
+        Type type() const { return _type; }
+        bool isIndefinite() const { return _indefinite; }
+        // The number of items in an array, pairs in a map or bytes in a string
+        size_t length() const { return (size_t)_value; }
+        // The tag number, or the number of a Simple value
+        uint32_t tag() const { return (uint32_t)_value; }
+        // Bytes read from a buffer so far
+        size_t position() const { return _pos; }
+
+        // Fail if the item is the wrong type or the value does not fit
+        bool getUInt(uint32_t &value) const;
+        bool getInt(long &value) const;
+        bool getUInt64(uint64_t &value) const;
+        bool getInt64(int64_t &value) const;
+        bool getBool(bool &value) const;
+        // Either a Float or an integer
+        bool getDouble(double &value) const;
+        bool getFloat(float &value) const;
+
+        // Copy a Text item into buf with a terminating zero; fails, and
+        // passes over the text, if it is longer than size - 1
+        bool getString(char *buf, size_t size);
+        // Point value at a Text or Bytes item in the buffer being read
+        bool getView(StringView &value);
+        // Read up to len bytes of the content of a Text or Bytes item
+        size_t readData(uint8_t *buf, size_t len);
+};
+
+#endif
@@ -0,0 +1,190 @@
+#include <Arduino.h>
+#include "Coroutine.h"
+#include "sdk/chipspec.h"
+#include "sdk/gpio.h"
+
+extern "C" int pinToGPIO(int pin);
+
+// The size Coroutine.h promises, with the PIC32's 4-byte pointers
+#if (__SIZEOF_POINTER__ == 4)
+static_assert(sizeof(Coroutine) == 20, "Coroutine is no longer 20 bytes");
+#endif
+
+bool Coroutine::coNotified(uint32_t bits) {
+    if (_scheduler == NULL) return false;
+    return _scheduler->takeNotification(bits);
+}
+
+// Coroutines are only added and removed from the task running the scheduler
+// (including from inside step()), or before it starts, so the list needs no
+// locking.
+bool CoroutineScheduler::add(Coroutine &co) {
+    if (co._scheduler != NULL) return false;
+    if (co._status == Coroutine::Done) {
+        co.restart();
+    }
+    co._next = NULL;
+    co._scheduler = this;
+    if (_tail == NULL) {
+        _head = &co;
+    } else {
+        _tail->_next = &co;
+    }
+    _tail = &co;
+    return true;
+}
+
+bool CoroutineScheduler::remove(Coroutine &co) {
+    Coroutine *prev = NULL;
+    for (Coroutine *c = _head; c != NULL; prev = c, c = c->_next) {
+        if (c != &co) continue;
+        if (prev == NULL) {
+            _head = c->_next;
+        } else {
+            prev->_next = c->_next;
+        }
+        if (_tail == c) {
+            _tail = prev;
+        }
+        c->_next = NULL;
+        c->_scheduler = NULL;
+        return true;
+    }
+    return false;
+}
+
+// Step every coroutine that is not sleeping once, dropping the ones that
+// finish. Returns the most urgent status left: Ready if any coroutine wants
+// to run again straight away, Polling if any is waiting on a condition,
+// Sleeping if all are waiting for a time (the earliest of which is in _wake),
+// or Done if there are none left.
+Coroutine::Status CoroutineScheduler::runOnce() {
+    Coroutine::Status result = Coroutine::Done;
+    bool haveWake = false;
+
+    if (_task == NULL) {
+        _task = xTaskGetCurrentTaskHandle();
+    }
+
+    Coroutine *co = _head;
+    while (co != NULL) {
+        Coroutine *next = co->_next;    // step() may remove the coroutine
+
+        if ((co->_status != Coroutine::Sleeping) || co->coExpired()) {
+            co->_status = Coroutine::Ready;
+            co->step();
+        }
+
+        switch (co->_status) {
+            case Coroutine::Done:
+                remove(*co);
+                break;
+            case Coroutine::Sleeping:
+                if (!haveWake || ((int32_t)(co->_wake - _wake) < 0)) {
+                    _wake = co->_wake;
+                    haveWake = true;
+                }
+                if (result == Coroutine::Done) result = Coroutine::Sleeping;
+                break;
+            case Coroutine::Polling:
+                if (result != Coroutine::Ready) result = Coroutine::Polling;
+                break;
+            default:
+                result = Coroutine::Ready;
+                break;
+        }
+        co = next;
+    }
+
+    _passes++;
+    return result;
+}
+
+void CoroutineScheduler::run() {
+    _task = xTaskGetCurrentTaskHandle();
+
+    while (!empty()) {
+        TickType_t timeout;
+
+        switch (runOnce()) {
+            case Coroutine::Ready:
+                // Let other tasks at this priority have a turn
+                taskYIELD();
+                continue;
+            case Coroutine::Polling:
+                // Conditions such as Serial.available() or a CoEdge count can
+                // change without waking this task, so look again next tick
+                timeout = 1;
+                break;
+            case Coroutine::Sleeping:
+                timeout = _wake - xTaskGetTickCount();
+                if ((int32_t)timeout <= 0) continue;
+                break;
+            default:
+                return;
+        }
+
+        // notify() wakes the task early
+        ulTaskNotifyTake(pdTRUE, timeout);
+    }
+}
+
+void CoroutineScheduler::notify(uint32_t bits) {
+    __atomic_or_fetch(&_notified, bits, __ATOMIC_RELEASE);
+    if (_task != NULL) {
+        xTaskNotifyGive(_task);
+    }
+}
+
+void CoroutineScheduler::notifyFromISR(uint32_t bits, BaseType_t *woken) {
+    __atomic_or_fetch(&_notified, bits, __ATOMIC_RELEASE);
+    if (_task != NULL) {
+        vTaskNotifyGiveFromISR(_task, woken);
+    }
+}
+
+bool CoroutineScheduler::takeNotification(uint32_t bits) {
+    return (__atomic_fetch_and(&_notified, ~bits, __ATOMIC_ACQUIRE) & bits) != 0;
+}
+
+static CoEdge *coEdgePin[__CHIP_MAX_GPIO + 1] = {NULL};
+
+static void coEdgeISR(uint8_t pin, uint8_t state) {
+    (void)state;
+    CoEdge *edge = coEdgePin[pin];
+    if (edge != NULL) {
+        edge->edge();
+    }
+}
+
+bool CoEdge::begin() {
+    int gpio = pinToGPIO(_pin);
+    if (gpio < 0) return false;
+
+    coEdgePin[gpio] = this;
+    if ((_mode == RISING) || (_mode == CHANGE)) {
+        if (!gpio_connect_change_interrupt(gpio, gpioINTERRUPT_RISING, coEdgeISR)) return false;
+    }
+    if ((_mode == FALLING) || (_mode == CHANGE)) {
+        if (!gpio_connect_change_interrupt(gpio, gpioINTERRUPT_FALLING, coEdgeISR)) return false;
+    }
+    return true;
+}
+
+void CoEdge::end() {
+    int gpio = pinToGPIO(_pin);
+    if (gpio < 0) return;
+
+    gpio_disconnect_change_interrupt(gpio, gpioINTERRUPT_RISING);
+    gpio_disconnect_change_interrupt(gpio, gpioINTERRUPT_FALLING);
+    coEdgePin[gpio] = NULL;
+    _pending = 0;
+}
+
+bool CoEdge::take() {
+    uint32_t pending = __atomic_load_n(&_pending, __ATOMIC_RELAXED);
+    do {
+        if (pending == 0) return false;
+    } while (!__atomic_compare_exchange_n(&_pending, &pending, pending - 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+    return true;
+}
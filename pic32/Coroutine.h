@@ -0,0 +1,145 @@
+#ifndef _COROUTINE_H
+#define _COROUTINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+// Stackless coroutines for running many small jobs inside one task. A
+// coroutine is a class with a step() method written between CO_BEGIN() and
+// CO_END(); the CO_ macros save the position in step() and return to the
+// scheduler, and the next call jumps back to where it left off. Nothing is
+// kept on a stack between steps, so any variable that must survive a CO_
+// macro has to be a member, and the CO_ macros cannot be used inside a
+// switch statement of their own. A coroutine costs sizeof(Coroutine) (20
+// bytes) plus its members, against a whole stack for a task.
+//
+//     class Blinker : public Coroutine {
+//         int _n;
+//         void step() {
+//             CO_BEGIN();
+//             for (_n = 0; _n < 10; _n++) {
+//                 digitalWrite(LED, _n & 1);
+//                 CO_DELAY(100);
+//             }
+//             CO_END();
+//         }
+//     };
+//
+//     Blinker blinker;
+//     CoroutineScheduler scheduler;
+//     void loop() { scheduler.add(blinker); scheduler.run(); }
+
+class CoroutineScheduler;
+
+class Coroutine {
+    friend class CoroutineScheduler;
+
+    public:
+        enum Status : uint8_t {
+            Ready,          // Run again on the next pass
+            Polling,        // Waiting for a condition, checked every pass
+            Sleeping,       // Waiting until _wake
+            Done
+        };
+
+        Coroutine() : _line(0), _status(Ready), _timedOut(false), _wake(0), _next(NULL), _scheduler(NULL) {}
+        virtual ~Coroutine() {}
+
+        Status          status() const { return _status; }
+        bool            done() const { return _status == Done; }
+        bool            timedOut() const { return _timedOut; }
+        void            restart() { _line = 0; _status = Ready; }
+
+    protected:
+        virtual void    step() = 0;
+
+        // Used by the CO_ macros
+        uint16_t        _line;
+        Status          _status;
+        bool            _timedOut;
+        TickType_t      _wake;
+
+        void            coDeadline(uint32_t ms) { _wake = xTaskGetTickCount() + pdMS_TO_TICKS(ms); }
+        bool            coExpired() const { return (int32_t)(xTaskGetTickCount() - _wake) >= 0; }
+        bool            coNotified(uint32_t bits);
+
+    private:
+        Coroutine       *_next;
+        CoroutineScheduler *_scheduler;
+};
+
+#define CO_BEGIN() switch (_line) { case 0:
+
+#define CO_END() } _line = 0; _status = Coroutine::Done; return
+
+// Let every other coroutine run once
+#define CO_YIELD() do { _line = __LINE__; _status = Coroutine::Ready; return; case __LINE__:; } while (0)
+
+// Wait for a condition. It is evaluated once per scheduler pass.
+#define CO_AWAIT(cond) do { _line = __LINE__; case __LINE__: \
+    if (!(cond)) { _status = Coroutine::Polling; return; } } while (0)
+
+// Wait for a condition for at most ms milliseconds. timedOut() says which.
+#define CO_AWAIT_FOR(cond, ms) do { coDeadline(ms); _timedOut = false; _line = __LINE__; case __LINE__: \
+    if (!(cond)) { if (!coExpired()) { _status = Coroutine::Polling; return; } _timedOut = true; } } while (0)
+
+#define CO_DELAY(ms) do { coDeadline(ms); _line = __LINE__; _status = Coroutine::Sleeping; return; case __LINE__:; } while (0)
+
+// Wait for bits to be sent with CoroutineScheduler::notify(), consuming them
+#define CO_AWAIT_NOTIFY(bits) CO_AWAIT(coNotified(bits))
+
+// Wait for data from a Stream such as Serial
+#define CO_AWAIT_AVAILABLE(stream) CO_AWAIT((stream).available() > 0)
+
+// Wait for an edge counted by a CoEdge, consuming it
+#define CO_AWAIT_EDGE(edge) CO_AWAIT((edge).take())
+
+// Runs coroutines round robin in the calling task. When none are ready the
+// task blocks until the next coroutine is due to wake or the task is
+// notified, or for one tick at a time if any coroutine is polling a
+// condition.
+class CoroutineScheduler {
+    private:
+        Coroutine       *_head;
+        Coroutine       *_tail;
+        TaskHandle_t    _task;
+        volatile uint32_t _notified;
+        uint32_t        _passes;
+        TickType_t      _wake;          // Earliest wake time of the sleeping coroutines
+
+    public:
+        CoroutineScheduler() : _head(NULL), _tail(NULL), _task(NULL), _notified(0), _passes(0), _wake(0) {}
+
+        bool            add(Coroutine &co);
+        bool            remove(Coroutine &co);
+        Coroutine::Status runOnce();
+        void            run();
+        bool            empty() const { return _head == NULL; }
+        uint32_t        passes() const { return _passes; }
+
+        void            notify(uint32_t bits);
+        void            notifyFromISR(uint32_t bits, BaseType_t *woken);
+        bool            takeNotification(uint32_t bits);
+};
+
+// Counts edges on a pin from the change notification interrupt so that a
+// coroutine can wait for them with CO_AWAIT_EDGE().
+class CoEdge {
+    private:
+        uint8_t         _pin;
+        uint8_t         _mode;
+        volatile uint32_t _pending;
+
+    public:
+        CoEdge(uint8_t pin, uint8_t mode) : _pin(pin), _mode(mode), _pending(0) {}
+
+        bool            begin();
+        void            end();
+        bool            take();
+        void            edge() { __atomic_add_fetch(&_pending, 1, __ATOMIC_RELAXED); }
+};
+
+#endif
@@ -0,0 +1,224 @@
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "Print.h"
+#include "FixedString.h"
+#include "num_format.h"
+
+size_t FixedStringBase::printTo(Print &p) const {
+    return p.write(_buffer, _len);
+}
+
+void FixedStringBase::copy(const char *cstr, unsigned int length) {
+    _len = 0;
+    concat(cstr, length);
+}
+
+void FixedStringBase::copySubstring(FixedStringBase &out, unsigned int left, unsigned int right) const {
+    if (left > right) {
+        unsigned int temp = right;
+        right = left;
+        left = temp;
+    }
+    if (right > _len) right = _len;
+    if (left >= right) {
+        out.copy("", 0);
+        return;
+    }
+    out.copy(_buffer + left, right - left);
+}
+
+// Append as much as fits, and flag anything that didn't
+unsigned char FixedStringBase::concat(const char *cstr, unsigned int length) {
+    unsigned char ok = 1;
+    if (length > _capacity - _len) {
+        length = _capacity - _len;
+        _overflow = true;
+        ok = 0;
+    }
+    memmove(_buffer + _len, cstr, length);
+    _len += length;
+    _buffer[_len] = 0;
+    return ok;
+}
+
+unsigned char FixedStringBase::concat(const char *cstr) {
+    if (cstr == NULL) return 0;
+    return concat(cstr, strlen(cstr));
+}
+
+unsigned char FixedStringBase::concatInteger(unsigned long value, bool negative, unsigned char base) {
+    char buf[NUM_FORMAT_INT_SIZE];
+    size_t len = 0;
+    if (negative) buf[len++] = '-';
+    len += num_format_u32(&buf[len], value, base);
+    // String gives lower case letters in bases above 10
+    for (size_t i = 0; i < len; i++) buf[i] = tolower(buf[i]);
+    return concat(buf, len);
+}
+
+unsigned char FixedStringBase::concat(double num, unsigned char decimalPlaces) {
+    char buf[NUM_FORMAT_FLOAT_SIZE];
+    return concat(buf, num_format_float(buf, num, decimalPlaces));
+}
+
+int FixedStringBase::compareTo(const char *cstr) const {
+    if (cstr == NULL) return (_len > 0) ? *(unsigned char *)_buffer : 0;
+    return strcmp(_buffer, cstr);
+}
+
+unsigned char FixedStringBase::equals(const char *cstr) const {
+    if (cstr == NULL) return _len == 0;
+    return strcmp(_buffer, cstr) == 0;
+}
+
+unsigned char FixedStringBase::equalsIgnoreCase(const char *cstr) const {
+    if (cstr == NULL) return _len == 0;
+    const char *p = _buffer;
+    while (*p && *cstr) {
+        if (tolower(*p++) != tolower(*cstr++)) return 0;
+    }
+    return *p == *cstr;
+}
+
+unsigned char FixedStringBase::startsWith(const char *prefix, unsigned int offset) const {
+    if (prefix == NULL) return 0;
+    size_t len = strlen(prefix);
+    if ((offset > _len) || (len > _len - offset)) return 0;
+    return strncmp(_buffer + offset, prefix, len) == 0;
+}
+
+unsigned char FixedStringBase::endsWith(const char *suffix) const {
+    if (suffix == NULL) return 0;
+    size_t len = strlen(suffix);
+    if (len > _len) return 0;
+    return strcmp(_buffer + _len - len, suffix) == 0;
+}
+
+// Out of range indices get a dummy character, as String does
+char &FixedStringBase::operator [] (unsigned int index) {
+    static char dummy;
+    if (index >= _len) {
+        dummy = 0;
+        return dummy;
+    }
+    return _buffer[index];
+}
+
+void FixedStringBase::getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index) const {
+    if ((bufsize == 0) || (buf == NULL)) return;
+    if (index >= _len) {
+        buf[0] = 0;
+        return;
+    }
+    unsigned int n = bufsize - 1;
+    if (n > _len - index) n = _len - index;
+    memcpy(buf, _buffer + index, n);
+    buf[n] = 0;
+}
+
+int FixedStringBase::indexOf(char ch, unsigned int fromIndex) const {
+    if (fromIndex >= _len) return -1;
+    const char *p = (const char *)memchr(_buffer + fromIndex, ch, _len - fromIndex);
+    return (p == NULL) ? -1 : p - _buffer;
+}
+
+int FixedStringBase::indexOf(const char *str, unsigned int fromIndex) const {
+    if ((str == NULL) || (fromIndex >= _len)) return -1;
+    const char *p = strstr(_buffer + fromIndex, str);
+    return (p == NULL) ? -1 : p - _buffer;
+}
+
+int FixedStringBase::lastIndexOf(char ch, unsigned int fromIndex) const {
+    if (fromIndex >= _len) return -1;
+    for (int i = fromIndex; i >= 0; i--) {
+        if (_buffer[i] == ch) return i;
+    }
+    return -1;
+}
+
+int FixedStringBase::lastIndexOf(const char *str, unsigned int fromIndex) const {
+    if (str == NULL) return -1;
+    size_t len = strlen(str);
+    if ((len == 0) || (len > _len)) return -1;
+    if (fromIndex > _len - len) fromIndex = _len - len;
+    for (int i = fromIndex; i >= 0; i--) {
+        if (strncmp(_buffer + i, str, len) == 0) return i;
+    }
+    return -1;
+}
+
+FixedStringBase &FixedStringBase::replace(char find, char replace) {
+    for (unsigned int i = 0; i < _len; i++) {
+        if (_buffer[i] == find) _buffer[i] = replace;
+    }
+    return *this;
+}
+
+// Replacements that would run past the end are cut off there, and the
+// overflow flag is set
+FixedStringBase &FixedStringBase::replace(const char *find, const char *replace) {
+    if ((find == NULL) || (replace == NULL)) return *this;
+    unsigned int findLen = strlen(find);
+    unsigned int replaceLen = strlen(replace);
+    if (findLen == 0) return *this;
+
+    unsigned int index = 0;
+    char *p;
+    while ((index < _len) && ((p = strstr(_buffer + index, find)) != NULL)) {
+        index = p - _buffer;
+        unsigned int tail = index + findLen;
+        unsigned int tailLen = _len - tail;
+        unsigned int room = _capacity - index;
+        unsigned int copyLen = replaceLen;
+        if (copyLen + tailLen > room) {
+            _overflow = true;
+            if (copyLen > room) copyLen = room;
+            tailLen = room - copyLen;
+        }
+        memmove(_buffer + index + copyLen, _buffer + tail, tailLen);
+        memcpy(_buffer + index, replace, copyLen);
+        _len = index + copyLen + tailLen;
+        _buffer[_len] = 0;
+        index += copyLen;
+    }
+    return *this;
+}
+
+FixedStringBase &FixedStringBase::remove(unsigned int index, unsigned int count) {
+    if (index >= _len) return *this;
+    if (count > _len - index) count = _len - index;
+    memmove(_buffer + index, _buffer + index + count, _len - index - count);
+    _len -= count;
+    _buffer[_len] = 0;
+    return *this;
+}
+
+FixedStringBase &FixedStringBase::toLowerCase() {
+    for (unsigned int i = 0; i < _len; i++) _buffer[i] = tolower(_buffer[i]);
+    return *this;
+}
+
+FixedStringBase &FixedStringBase::toUpperCase() {
+    for (unsigned int i = 0; i < _len; i++) _buffer[i] = toupper(_buffer[i]);
+    return *this;
+}
+
+FixedStringBase &FixedStringBase::trim() {
+    unsigned int begin = 0;
+    while ((begin < _len) && isspace(_buffer[begin])) begin++;
+    unsigned int end = _len;
+    while ((end > begin) && isspace(_buffer[end - 1])) end--;
+    _len = end - begin;
+    memmove(_buffer, _buffer + begin, _len);
+    _buffer[_len] = 0;
+    return *this;
+}
+
+long FixedStringBase::toInt() const {
+    return atol(_buffer);
+}
+
+float FixedStringBase::toFloat() const {
+    return float(atof(_buffer));
+}
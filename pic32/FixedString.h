@@ -0,0 +1,181 @@
+#ifndef _FIXED_STRING_H
+#define _FIXED_STRING_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "WString.h"
+#include "Printable.h"
+
+// A string with the String API that never touches the heap, for tasks that
+// must not allocate after boot. FixedString<N> holds up to N characters in
+// the object itself. Anything that would make it longer is cut off at N
+// characters and sets the overflow flag, which stays set until
+// clearOverflow(); concat() also returns 0 when it had to cut. The result
+// of a + b has the size of a.
+//
+//     FixedString<32> line("T=");
+//     line += temperature;
+//     line += " C";
+//     if (line.overflowed()) ...
+//     Serial.println(line);
+//
+// The code is in FixedStringBase, which all sizes share, so each size only
+// adds its storage and the members that return a FixedString<N>. String
+// arguments can be a const char *, a String or a FixedString of any size.
+
+class FixedStringBase : public Printable
+{
+    typedef void (FixedStringBase::*IfHelperType)() const;
+    void IfHelper() const {}
+
+    private:
+        // Copying goes through the sized class so the buffer stays our own
+        FixedStringBase(const FixedStringBase &);
+        FixedStringBase &operator = (const FixedStringBase &);
+
+    protected:
+        char *_buffer;
+        unsigned int _capacity;
+        unsigned int _len;
+        bool _overflow;
+
+        FixedStringBase(char *buffer, unsigned int capacity) :
+            _buffer(buffer), _capacity(capacity), _len(0), _overflow(false) { _buffer[0] = 0; }
+
+        void copy(const char *cstr, unsigned int length);
+        void copySubstring(FixedStringBase &out, unsigned int left, unsigned int right) const;
+        unsigned char concatInteger(unsigned long value, bool negative, unsigned char base);
+
+    public:
+        virtual size_t printTo(Print &p) const;
+
+        unsigned int length() const { return _len; }
+        unsigned int capacity() const { return _capacity; }
+        bool overflowed() const { return _overflow; }
+        void clearOverflow() { _overflow = false; }
+        const char *c_str() const { return _buffer; }
+        String toString() const { return String(_buffer); }
+
+        // Always valid, unlike a String, but "if (s)" still works
+        operator IfHelperType() const { return &FixedStringBase::IfHelper; }
+
+        unsigned char concat(const char *cstr, unsigned int length);
+        unsigned char concat(const char *cstr);
+        unsigned char concat(const String &str) { return concat(str.c_str()); }
+        unsigned char concat(const FixedStringBase &str) { return concat(str._buffer, str._len); }
+        unsigned char concat(const __FlashStringHelper *str) { return concat((const char *)str); }
+        unsigned char concat(char c) { return concat(&c, 1); }
+        unsigned char concat(unsigned char num) { return concatInteger(num, false, 10); }
+        unsigned char concat(int num) { return concatInteger(num < 0 ? 0u - num : num, num < 0, 10); }
+        unsigned char concat(unsigned int num) { return concatInteger(num, false, 10); }
+        unsigned char concat(long num) { return concatInteger(num < 0 ? 0ul - num : num, num < 0, 10); }
+        unsigned char concat(unsigned long num) { return concatInteger(num, false, 10); }
+        unsigned char concat(float num) { return concat((double)num, 6); }
+        unsigned char concat(double num) { return concat(num, 6); }
+        unsigned char concat(double num, unsigned char decimalPlaces);
+
+        int compareTo(const char *cstr) const;
+        int compareTo(const String &s) const { return compareTo(s.c_str()); }
+        int compareTo(const FixedStringBase &s) const { return compareTo(s._buffer); }
+        unsigned char equals(const char *cstr) const;
+        unsigned char equals(const String &s) const { return equals(s.c_str()); }
+        unsigned char equals(const FixedStringBase &s) const { return (_len == s._len) && equals(s._buffer); }
+        template <typename T> unsigned char operator == (const T &rhs) const { return equals(rhs); }
+        template <typename T> unsigned char operator != (const T &rhs) const { return !equals(rhs); }
+        template <typename T> unsigned char operator < (const T &rhs) const { return compareTo(rhs) < 0; }
+        template <typename T> unsigned char operator > (const T &rhs) const { return compareTo(rhs) > 0; }
+        template <typename T> unsigned char operator <= (const T &rhs) const { return compareTo(rhs) <= 0; }
+        template <typename T> unsigned char operator >= (const T &rhs) const { return compareTo(rhs) >= 0; }
+        unsigned char equalsIgnoreCase(const char *cstr) const;
+        unsigned char equalsIgnoreCase(const String &s) const { return equalsIgnoreCase(s.c_str()); }
+        unsigned char equalsIgnoreCase(const FixedStringBase &s) const { return equalsIgnoreCase(s._buffer); }
+        unsigned char startsWith(const char *prefix, unsigned int offset = 0) const;
+        unsigned char startsWith(const String &prefix, unsigned int offset = 0) const { return startsWith(prefix.c_str(), offset); }
+        unsigned char startsWith(const FixedStringBase &prefix, unsigned int offset = 0) const { return startsWith(prefix._buffer, offset); }
+        unsigned char endsWith(const char *suffix) const;
+        unsigned char endsWith(const String &suffix) const { return endsWith(suffix.c_str()); }
+        unsigned char endsWith(const FixedStringBase &suffix) const { return endsWith(suffix._buffer); }
+
+        char charAt(unsigned int index) const { return (index < _len) ? _buffer[index] : 0; }
+        void setCharAt(unsigned int index, char c) { if (index < _len) _buffer[index] = c; }
+        char operator [] (unsigned int index) const { return charAt(index); }
+        char &operator [] (unsigned int index);
+        void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const;
+        void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const
+            { getBytes((unsigned char *)buf, bufsize, index); }
+
+        int indexOf(char ch, unsigned int fromIndex = 0) const;
+        int indexOf(const char *str, unsigned int fromIndex = 0) const;
+        int indexOf(const String &str, unsigned int fromIndex = 0) const { return indexOf(str.c_str(), fromIndex); }
+        int indexOf(const FixedStringBase &str, unsigned int fromIndex = 0) const { return indexOf(str._buffer, fromIndex); }
+        int lastIndexOf(char ch) const { return lastIndexOf(ch, _len - 1); }
+        int lastIndexOf(char ch, unsigned int fromIndex) const;
+        int lastIndexOf(const char *str) const { return lastIndexOf(str, _len); }
+        int lastIndexOf(const char *str, unsigned int fromIndex) const;
+        int lastIndexOf(const String &str) const { return lastIndexOf(str.c_str(), _len); }
+        int lastIndexOf(const String &str, unsigned int fromIndex) const { return lastIndexOf(str.c_str(), fromIndex); }
+        int lastIndexOf(const FixedStringBase &str) const { return lastIndexOf(str._buffer, _len); }
+        int lastIndexOf(const FixedStringBase &str, unsigned int fromIndex) const { return lastIndexOf(str._buffer, fromIndex); }
+
+        FixedStringBase &replace(char find, char replace);
+        FixedStringBase &replace(const char *find, const char *replace);
+        FixedStringBase &replace(const String &find, const String &replace) { return this->replace(find.c_str(), replace.c_str()); }
+        FixedStringBase &replace(const FixedStringBase &find, const FixedStringBase &replace) { return this->replace(find._buffer, replace._buffer); }
+        FixedStringBase &remove(unsigned int index) { return remove(index, (unsigned int)-1); }
+        FixedStringBase &remove(unsigned int index, unsigned int count);
+        FixedStringBase &toLowerCase();
+        FixedStringBase &toUpperCase();
+        FixedStringBase &trim();
+
+        long toInt() const;
+        float toFloat() const;
+};
+
+template <unsigned int N>
+class FixedString : public FixedStringBase
+{
+    private:
+        char _storage[N + 1];
+
+    public:
+        FixedString() : FixedStringBase(_storage, N) {}
+        FixedString(const char *cstr) : FixedStringBase(_storage, N) { if (cstr) copy(cstr, strlen(cstr)); }
+        FixedString(const String &str) : FixedStringBase(_storage, N) { if (str.c_str()) copy(str.c_str(), str.length()); }
+        FixedString(const FixedString &str) : FixedStringBase(_storage, N) { copy(str._buffer, str._len); }
+        FixedString(const FixedStringBase &str) : FixedStringBase(_storage, N) { copy(str.c_str(), str.length()); }
+        FixedString(const __FlashStringHelper *str) : FixedStringBase(_storage, N) { concat(str); }
+        explicit FixedString(char c) : FixedStringBase(_storage, N) { concat(c); }
+        explicit FixedString(unsigned char num, unsigned char base = 10) : FixedStringBase(_storage, N) { concatInteger(num, false, base); }
+        explicit FixedString(int num, unsigned char base = 10) : FixedStringBase(_storage, N)
+            { concatInteger(((num < 0) && (base == 10)) ? 0u - num : (unsigned int)num, (num < 0) && (base == 10), base); }
+        explicit FixedString(unsigned int num, unsigned char base = 10) : FixedStringBase(_storage, N) { concatInteger(num, false, base); }
+        explicit FixedString(long num, unsigned char base = 10) : FixedStringBase(_storage, N)
+            { concatInteger(((num < 0) && (base == 10)) ? 0ul - num : (unsigned long)num, (num < 0) && (base == 10), base); }
+        explicit FixedString(unsigned long num, unsigned char base = 10) : FixedStringBase(_storage, N) { concatInteger(num, false, base); }
+        explicit FixedString(float num, unsigned char decimalPlaces = 6) : FixedStringBase(_storage, N) { concat(num, decimalPlaces); }
+        explicit FixedString(double num, unsigned char decimalPlaces = 6) : FixedStringBase(_storage, N) { concat(num, decimalPlaces); }
+
+        FixedString &operator = (const FixedString &rhs) { if (this != &rhs) copy(rhs._buffer, rhs._len); return *this; }
+        FixedString &operator = (const FixedStringBase &rhs) { if (this != &rhs) copy(rhs.c_str(), rhs.length()); return *this; }
+        FixedString &operator = (const String &rhs) { copy(rhs.c_str() ? rhs.c_str() : "", rhs.length()); return *this; }
+        FixedString &operator = (const char *cstr) { copy(cstr ? cstr : "", cstr ? strlen(cstr) : 0); return *this; }
+        FixedString &operator = (const __FlashStringHelper *str) { return *this = (const char *)str; }
+
+        template <typename T> FixedString &operator += (const T &rhs) { concat(rhs); return *this; }
+        template <typename T> FixedString operator + (const T &rhs) const { FixedString r(*this); r.concat(rhs); return r; }
+
+        FixedString substring(unsigned int beginIndex) const { return substring(beginIndex, _len); }
+        FixedString substring(unsigned int beginIndex, unsigned int endIndex) const
+            { FixedString r; copySubstring(r, beginIndex, endIndex); return r; }
+
+        FixedString &replace(char find, char replace) { FixedStringBase::replace(find, replace); return *this; }
+        template <typename F, typename R> FixedString &replace(const F &find, const R &replace) { FixedStringBase::replace(find, replace); return *this; }
+        FixedString &remove(unsigned int index) { FixedStringBase::remove(index); return *this; }
+        FixedString &remove(unsigned int index, unsigned int count) { FixedStringBase::remove(index, count); return *this; }
+        FixedString &toLowerCase() { FixedStringBase::toLowerCase(); return *this; }
+        FixedString &toUpperCase() { FixedStringBase::toUpperCase(); return *this; }
+        FixedString &trim() { FixedStringBase::trim(); return *this; }
+};
+
+#endif
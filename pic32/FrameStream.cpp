@@ -0,0 +1,37 @@
+#include "Arduino.h"
+#include "FrameStream.h"
+
+// The decoder is given its buffer before the derived class has constructed
+// its storage, which is fine as it only keeps the pointer
+FrameStreamBase::FrameStreamBase(Stream &stream, uint8_t *buffer, size_t size) : _stream(stream) {
+    frame_decoder_init(&_decoder, buffer, size);
+    frame_begin(&_encoder, writeStream, this);
+}
+
+void FrameStreamBase::writeStream(void *ctx, const uint8_t *data, size_t len) {
+    ((FrameStreamBase *)ctx)->_stream.write(data, len);
+}
+
+void FrameStreamBase::send(const uint8_t *payload, size_t len) {
+    begin();
+    write(payload, len);
+    end();
+}
+
+void FrameStreamBase::begin() {
+    frame_begin(&_encoder, writeStream, this);
+}
+
+bool FrameStreamBase::receive(unsigned long timeout) {
+    unsigned long start = millis();
+    for (;;) {
+        while (_stream.available() > 0) {
+            int c = _stream.read();
+            if (c < 0) break;
+            if (frame_decode(&_decoder, c)) return true;
+        }
+        unsigned long elapsed = millis() - start;
+        if (elapsed >= timeout) return false;
+        _stream.waitAvailable(timeout - elapsed);
+    }
+}
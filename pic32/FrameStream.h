@@ -0,0 +1,69 @@
+#ifndef _FRAME_STREAM_H
+#define _FRAME_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Stream.h"
+#include "sdk/frame.h"
+
+// Sends and receives binary frames over any Stream, with the framing of
+// sdk/frame.h: COBS, a CRC-16 and a zero byte between frames. A frame that
+// is damaged on the way fails its CRC and is dropped, and the receiver is
+// back in step at the next frame.
+//
+//     FrameStream<64> link(Serial);
+//     link.send((const uint8_t *)&sample, sizeof(sample));
+//
+//     if (link.receive(100)) {
+//         handle(link.frame(), link.length());
+//     }
+//
+// A frame can also be built from pieces between begin() and end(). The
+// encoded bytes go to the Stream a COBS block (up to 254 bytes) at a time,
+// so a frame is never copied whole. N is the largest payload that can be
+// received; longer frames are dropped and counted as overruns.
+
+class FrameStreamBase
+{
+    private:
+        static void writeStream(void *ctx, const uint8_t *data, size_t len);
+
+        FrameStreamBase(const FrameStreamBase &);
+        FrameStreamBase &operator = (const FrameStreamBase &);
+
+    protected:
+        Stream &_stream;
+        frame_encoder_t _encoder;
+        frame_decoder_t _decoder;
+
+        FrameStreamBase(Stream &stream, uint8_t *buffer, size_t size);
+
+    public:
+        void send(const uint8_t *payload, size_t len);
+
+        void begin();
+        void write(const uint8_t *data, size_t len) { frame_put(&_encoder, data, len); }
+        void write(uint8_t b) { frame_put(&_encoder, &b, 1); }
+        void end() { frame_end(&_encoder); }
+
+        // Wait up to timeout milliseconds for a good frame
+        bool receive(unsigned long timeout);
+        // The payload of the frame from the last successful receive(),
+        // valid until the next call to receive()
+        const uint8_t *frame() const { return _decoder.buf; }
+        size_t length() const { return _decoder.length; }
+        const frame_stats_t &stats() const { return _decoder.stats; }
+};
+
+template <size_t N = 64>
+class FrameStream : public FrameStreamBase
+{
+    private:
+        uint8_t _storage[N + 2];                // Payload and CRC
+
+    public:
+        FrameStream(Stream &stream) : FrameStreamBase(stream, _storage, sizeof(_storage)) {}
+};
+
+#endif
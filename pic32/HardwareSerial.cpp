@@ -21,6 +21,12 @@ int HardwareSerial::availableForWrite() {
     return uart_tx_available(_uart);
 }
 
+// Block on the receive queue, rounding the timeout up to whole ticks
+bool HardwareSerial::waitAvailable(unsigned long timeout) {
+    TickType_t ticks = ((uint64_t)timeout * configTICK_RATE_HZ + 999) / 1000;
+    return uart_wait_rx(_uart, ticks);
+}
+
 int HardwareSerial::peek() {
     return uart_peek(_uart);
 }
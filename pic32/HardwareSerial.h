@@ -30,6 +30,7 @@ class HardwareSerial : public Stream {
         virtual int     peek();
         virtual int     read();
         virtual void    flush();
+        virtual bool    waitAvailable(unsigned long timeout);
         virtual void    purge();
         virtual size_t  write(uint8_t);
         virtual size_t write(const uint8_t *buffer, size_t size);
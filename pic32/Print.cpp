@@ -26,6 +26,7 @@
 #include "Arduino.h"
 
 #include "Print.h"
+#include "num_format.h"
 
 // Public Methods //////////////////////////////////////////////////////////////
 
@@ -77,13 +78,8 @@ size_t Print::print(long n, int base)
 {
   if (base == 0) {
     return write(n);
-  } else if (base == 10) {
-    if (n < 0) {
-      int t = print('-');
-      n = -n;
-      return printNumber(n, 10) + t;
-    }
-    return printNumber(n, 10);
+  } else if (base == 10 && n < 0) {
+    return printNumber(0UL - (unsigned long)n, 10, true);
   } else {
     return printNumber(n, base);
   }
@@ -107,16 +103,12 @@ size_t Print::print(const Printable& x)
 
 size_t Print::println(void)
 {
-  size_t n = print('\r');
-  n += print('\n');
-  return n;
+  return write("\r\n", 2);
 }
 
 size_t Print::println(const String &s)
 {
-  size_t n = print(s);
-  n += println();
-  return n;
+  return printLine(s.c_str(), s.length());
 }
 
 size_t Print::println(const __FlashStringHelper *s) {
@@ -125,58 +117,56 @@ size_t Print::println(const __FlashStringHelper *s) {
 
 size_t Print::println(const char c[])
 {
-  size_t n = print(c);
-  n += println();
-  return n;
+  return printLine(c, c == NULL ? 0 : strlen(c));
 }
 
 size_t Print::println(char c)
 {
-  size_t n = print(c);
-  n += println();
-  return n;
+  char buf[3] = { c, '\r', '\n' };
+  return write(buf, sizeof(buf));
 }
 
 size_t Print::println(unsigned char b, int base)
 {
-  size_t n = print(b, base);
-  n += println();
-  return n;
+  return println((unsigned long) b, base);
 }
 
 size_t Print::println(int num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  return println((long) num, base);
 }
 
 size_t Print::println(unsigned int num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  return println((unsigned long) num, base);
 }
 
 size_t Print::println(long num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  if (base == 0) {
+    size_t n = write(num);
+    n += println();
+    return n;
+  } else if (base == 10 && num < 0) {
+    return printNumber(0UL - (unsigned long)num, 10, true, true);
+  } else {
+    return printNumber(num, base, false, true);
+  }
 }
 
 size_t Print::println(unsigned long num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  if (base == 0) {
+    size_t n = write(num);
+    n += println();
+    return n;
+  }
+  return printNumber(num, base, false, true);
 }
 
 size_t Print::println(double num, int digits)
 {
-  size_t n = print(num, digits);
-  n += println();
-  return n;
+  return printFloat(num, digits, true);
 }
 
 size_t Print::println(const Printable& x)
@@ -188,76 +178,83 @@ size_t Print::println(const Printable& x)
 
 // Private Methods /////////////////////////////////////////////////////////////
 
-size_t Print::printNumber(unsigned long n, uint8_t base) {
-  char buf[8 * sizeof(long) + 1]; // Assumes 8-bit chars plus zero byte.
-  char *str = &buf[sizeof(buf) - 1];
-
-  *str = '\0';
+// Writes the text and a line ending together when they fit the stack buffer
+size_t Print::printLine(const char *str, size_t len)
+{
+  if (len > PRINT_BUFFER_SIZE - 2) {
+    size_t n = write(str, len);
+    n += println();
+    return n;
+  }
+  char buf[PRINT_BUFFER_SIZE];
+  memcpy(buf, str, len);
+  buf[len++] = '\r';
+  buf[len++] = '\n';
+  return write(buf, len);
+}
 
-  // prevent crash if called with base == 1
-  if (base < 2) base = 10;
+size_t Print::printNumber(unsigned long n, uint8_t base, bool negative, bool newline) {
+  char buf[NUM_FORMAT_INT_SIZE + 2]; // Room for the line ending
+  size_t len = 0;
 
-  do {
-    unsigned long m = n;
-    n /= base;
-    char c = m - base * n;
-    *--str = c < 10 ? c + '0' : c + 'A' - 10;
-  } while(n);
+  if (negative) buf[len++] = '-';
+  len += num_format_u32(&buf[len], n, base);
+  if (newline) {
+    buf[len++] = '\r';
+    buf[len++] = '\n';
+  }
 
-  return write(str);
+  return write(buf, len);
 }
 
-size_t Print::printFloat(double number, uint8_t digits) 
+size_t Print::printFloat(double number, uint8_t digits, bool newline) 
 { 
+  char buf[PRINT_BUFFER_SIZE];
   size_t n = 0;
-  
-  if (isnan(number)) return print("nan");
-  if (isinf(number)) return print("inf");
-  if (number > 4294967040.0) return print ("ovf");  // constant determined empirically
-  if (number <-4294967040.0) return print ("ovf");  // constant determined empirically
-  
-  // Handle negative numbers
-  if (number < 0.0)
-  {
-     n += print('-');
-     number = -number;
-  }
 
-  // Round correctly so that print(1.999, 2) prints as "2.00"
-  double rounding = 0.5;
-  for (uint8_t i=0; i<digits; ++i)
-    rounding /= 10.0;
-  
-  number += rounding;
+  if (isfinite(number) && (number > 4294967040.0 || number < -4294967040.0)) {  // constant determined empirically
+    return newline ? printLine("ovf", 3) : write("ovf");
+  }
 
-  // Extract the integer part of the number and print it
-  unsigned long int_part = (unsigned long)number;
-  double remainder = number - (double)int_part;
-  n += print(int_part);
+  size_t len = num_format_float(buf, number, digits);
 
-  // Print the decimal point, but only if there are digits beyond
-  if (digits > 0) {
-    n += print("."); 
+  // Places past what a double holds are zero, and may not fit the buffer
+  if (digits > NUM_FORMAT_FLOAT_DIGITS && isfinite(number)) {
+    for (uint8_t i = NUM_FORMAT_FLOAT_DIGITS; i < digits; i++) {
+      if (len > sizeof(buf) - 3) {
+        n += write(buf, len);
+        len = 0;
+      }
+      buf[len++] = '0';
+    }
   }
 
-  // Extract digits from the remainder one at a time
-  while (digits-- > 0)
-  {
-    remainder *= 10.0;
-    int toPrint = int(remainder);
-    n += print(toPrint);
-    remainder -= toPrint; 
-  } 
+  if (newline) {
+    buf[len++] = '\r';
+    buf[len++] = '\n';
+  }
+  n += write(buf, len);
   
   return n;
 }
 
-extern int _doprnt (char const *fmt, va_list ap, Print *stream);
-
+// Formats into the stack buffer, and only goes to the heap for output that
+// does not fit
 size_t Print::printf(const char *fmt, ...) {
+    char buf[PRINT_BUFFER_SIZE];
     va_list args;
     va_start(args, fmt);
-    size_t r = _doprnt(fmt, args, this);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (len < 0) return 0;
+    if ((size_t)len < sizeof(buf)) return write(buf, len);
+
+    char *big = (char *)malloc(len + 1);
+    if (big == NULL) return write(buf, sizeof(buf) - 1);
+    va_start(args, fmt);
+    vsnprintf(big, len + 1, fmt, args);
     va_end(args);
+    size_t r = write(big, len);
+    free(big);
     return r;
 }
@@ -32,12 +32,17 @@
 #define OCT 8
 #define BIN 2
 
+// Size of the stack buffer print(), println() and printf() format into, so
+// that each call ends in one write(buffer, size) rather than one per byte
+#define PRINT_BUFFER_SIZE 64
+
 class Print
 {
   private:
     int write_error;
-    size_t printNumber(unsigned long, uint8_t);
-    size_t printFloat(double, uint8_t);
+    size_t printNumber(unsigned long, uint8_t, bool negative = false, bool newline = false);
+    size_t printFloat(double, uint8_t, bool newline = false);
+    size_t printLine(const char *, size_t);
   protected:
     void setWriteError(int err = 1) { write_error = err; }
   public:
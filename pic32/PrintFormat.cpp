@@ -0,0 +1,138 @@
+#include "PrintFormat.h"
+#include "num_format.h"
+
+namespace PrintFormat {
+
+void Writer::put(const char *s, size_t n) {
+    while (n > 0) {
+        if (_len == sizeof(_buf)) {
+            _written += _out.write(_buf, _len);
+            _len = 0;
+        }
+        size_t chunk = sizeof(_buf) - _len;
+        if (chunk > n) chunk = n;
+        memcpy(_buf + _len, s, chunk);
+        _len += chunk;
+        s += chunk;
+        n -= chunk;
+    }
+}
+
+void Writer::pad(char c, size_t n) {
+    while (n-- > 0) put(&c, 1);
+}
+
+// Lay out a converted value in its field: sign, then the body and any
+// zeros that follow it, padded to the width with spaces on either side or
+// with zeros after the sign
+void Writer::field(const Spec &s, char sign, const char *body, size_t len, size_t zeros) {
+    size_t total = len + zeros + (sign ? 1 : 0);
+    size_t fill = (s.width > total) ? s.width - total : 0;
+    if (!s.left && !s.zero) pad(' ', fill);
+    if (sign) put(&sign, 1);
+    if (!s.left && s.zero) pad('0', fill);
+    put(body, len);
+    pad('0', zeros);
+    if (s.left) pad(' ', fill);
+}
+
+/**
+ * Copy the text up to the next conversion to the output, and read the
+ * conversion
+ * @param fmt Where to carry on in the format
+ * @param s Set to the conversion
+ * @returns Where to carry on after the conversion, or NULL at the end of the format
+ */
+const char *Writer::text(const char *fmt, Spec &s) {
+    for (;;) {
+        const char *start = fmt;
+        while ((*fmt != 0) && (*fmt != '%')) fmt++;
+        put(start, fmt - start);
+        if (*fmt == 0) return NULL;
+        fmt++;
+        if (*fmt == '%') {
+            put(fmt++, 1);
+            continue;
+        }
+
+        s.left = false;
+        s.zero = false;
+        s.sign = 0;
+        s.width = 0;
+        s.precision = -1;
+        for (;; fmt++) {
+            if (*fmt == '-') s.left = true;
+            else if (*fmt == '0') s.zero = true;
+            else if (*fmt == '+') s.sign = '+';
+            else if ((*fmt == ' ') && (s.sign == 0)) s.sign = ' ';
+            else if (*fmt != ' ') break;
+        }
+        for (; (*fmt >= '0') && (*fmt <= '9'); fmt++) {
+            s.width = s.width * 10 + (*fmt - '0');
+            if (s.width > PRINT_FORMAT_MAX_FIELD) s.width = PRINT_FORMAT_MAX_FIELD;
+        }
+        if (*fmt == '.') {
+            s.precision = 0;
+            for (fmt++; (*fmt >= '0') && (*fmt <= '9'); fmt++) {
+                s.precision = s.precision * 10 + (*fmt - '0');
+                if (s.precision > PRINT_FORMAT_MAX_FIELD) s.precision = PRINT_FORMAT_MAX_FIELD;
+            }
+        }
+        while ((*fmt == 'l') || (*fmt == 'h')) fmt++;
+        if (*fmt == 0) return NULL;
+        s.conversion = *fmt++;
+        return fmt;
+    }
+}
+
+void Writer::integer(const Spec &s, unsigned long magnitude, bool negative) {
+    char buf[NUM_FORMAT_INT_SIZE];
+    uint8_t base = 10;
+    switch (s.conversion) {
+        case 'x':
+        case 'X': base = 16; break;
+        case 'o': base = 8; break;
+        case 'b': base = 2; break;
+    }
+    size_t len = num_format_u32(buf, magnitude, base);
+    if (s.conversion == 'x') {
+        for (size_t i = 0; i < len; i++) {
+            if (buf[i] >= 'A') buf[i] += 'a' - 'A';
+        }
+    }
+    bool isSigned = (s.conversion == 'd') || (s.conversion == 'i');
+    field(s, negative ? '-' : (isSigned ? s.sign : 0), buf, len);
+}
+
+void Writer::floating(const Spec &s, double value) {
+    char buf[NUM_FORMAT_FLOAT_SIZE];
+    int digits = (s.precision < 0) ? 6 : s.precision;
+    size_t len = num_format_float(buf, value, (digits > NUM_FORMAT_FLOAT_DIGITS) ? NUM_FORMAT_FLOAT_DIGITS : digits);
+    // Places past what num_format_float() writes are zeros, but not after
+    // nan, inf or ovf
+    size_t zeros = 0;
+    if ((digits > NUM_FORMAT_FLOAT_DIGITS) && (memchr(buf, '.', len) != NULL)) zeros = digits - NUM_FORMAT_FLOAT_DIGITS;
+    if (buf[0] == '-') field(s, '-', buf + 1, len - 1, zeros);
+    else field(s, s.sign, buf, len, zeros);
+}
+
+void Writer::string(const Spec &s, const char *str, size_t len) {
+    if ((s.precision >= 0) && (len > (size_t)s.precision)) len = s.precision;
+    Spec spaces = s;
+    spaces.zero = false;
+    field(spaces, 0, str, len);
+}
+
+void Writer::character(const Spec &s, char c) {
+    Spec spaces = s;
+    spaces.zero = false;
+    field(spaces, 0, &c, 1);
+}
+
+size_t Writer::finish() {
+    if (_len > 0) _written += _out.write(_buf, _len);
+    _len = 0;
+    return _written;
+}
+
+}
@@ -0,0 +1,213 @@
+#ifndef _PRINT_FORMAT_H
+#define _PRINT_FORMAT_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "Print.h"
+#include "WString.h"
+#include "FixedString.h"
+#include "StringView.h"
+
+// Type safe printf for Print, checked when it is compiled. PRINT_FORMAT()
+// takes a string literal format and any number of arguments, and fails to
+// compile if a conversion does not suit its argument or the number of
+// arguments is wrong:
+//
+//     PRINT_FORMAT(Serial, "%s: %5d mV, %.2f C\r\n", name, millivolts, temp);
+//
+// Each argument is formatted by a function picked for its type when the
+// call is compiled, so there is no va_list and nothing for a wrong format
+// to misread at run time. The output goes into a PRINT_BUFFER_SIZE buffer
+// on the stack and on to the Print in one write (or a few, for long
+// output); nothing is allocated, and it is safe to use from any number of
+// tasks at once. Needs C++11.
+//
+// The conversions are %d %i %u %x %X %o %b (binary) %c %s %f and %%, with
+// the flags - 0 + and space, a width and a precision. Length modifiers
+// (l, h) are accepted and ignored, as the argument types are known. %s
+// takes a C string, String, FixedString or StringView; %f a float or
+// double; %c a char or integer; the rest any integer of up to 32 bits.
+// Widths and precisions go up to PRINT_FORMAT_MAX_FIELD; %f writes the
+// value to NUM_FORMAT_FLOAT_DIGITS decimal places at most, and zeros after.
+//
+// PrintFormat::format() is the same without the compile time check, for a
+// format that is not a literal.
+
+// Widths and precisions larger than this are taken as this
+#define PRINT_FORMAT_MAX_FIELD 1000
+
+namespace PrintFormat {
+
+enum Kind { KindSigned, KindUnsigned, KindChar, KindFloat, KindString, KindOther };
+
+template <typename T> struct KindOf { static constexpr Kind value = KindOther; };
+template <> struct KindOf<char> { static constexpr Kind value = KindChar; };
+template <> struct KindOf<signed char> { static constexpr Kind value = KindSigned; };
+template <> struct KindOf<short> { static constexpr Kind value = KindSigned; };
+template <> struct KindOf<int> { static constexpr Kind value = KindSigned; };
+template <> struct KindOf<long> { static constexpr Kind value = KindSigned; };
+template <> struct KindOf<bool> { static constexpr Kind value = KindUnsigned; };
+template <> struct KindOf<unsigned char> { static constexpr Kind value = KindUnsigned; };
+template <> struct KindOf<unsigned short> { static constexpr Kind value = KindUnsigned; };
+template <> struct KindOf<unsigned int> { static constexpr Kind value = KindUnsigned; };
+template <> struct KindOf<unsigned long> { static constexpr Kind value = KindUnsigned; };
+template <> struct KindOf<float> { static constexpr Kind value = KindFloat; };
+template <> struct KindOf<double> { static constexpr Kind value = KindFloat; };
+template <> struct KindOf<char *> { static constexpr Kind value = KindString; };
+template <> struct KindOf<const char *> { static constexpr Kind value = KindString; };
+template <size_t N> struct KindOf<char[N]> { static constexpr Kind value = KindString; };
+template <> struct KindOf<String> { static constexpr Kind value = KindString; };
+template <> struct KindOf<StringSumHelper> { static constexpr Kind value = KindString; };
+template <> struct KindOf<StringView> { static constexpr Kind value = KindString; };
+template <> struct KindOf<FixedStringBase> { static constexpr Kind value = KindString; };
+template <unsigned int N> struct KindOf<FixedString<N> > { static constexpr Kind value = KindString; };
+
+template <Kind... K> struct Kinds {};
+
+// Only used inside decltype(), to turn the argument types into Kinds
+template <typename... T> Kinds<KindOf<T>::value...> kindsOf(const T &...);
+
+constexpr const char *skipFlags(const char *f) {
+    return (*f == '-' || *f == '0' || *f == '+' || *f == ' ') ? skipFlags(f + 1) : f;
+}
+
+constexpr const char *skipDigits(const char *f) {
+    return (*f >= '0' && *f <= '9') ? skipDigits(f + 1) : f;
+}
+
+constexpr const char *skipLength(const char *f) {
+    return (*f == 'l' || *f == 'h') ? skipLength(f + 1) : f;
+}
+
+// The conversion character of the specification that starts after a %
+constexpr const char *conversion(const char *f) {
+    return skipLength(*skipDigits(skipFlags(f)) == '.' ? skipDigits(skipDigits(skipFlags(f)) + 1) : skipDigits(skipFlags(f)));
+}
+
+constexpr bool suits(char c, Kind k) {
+    return (c == 'd' || c == 'i' || c == 'u' || c == 'x' || c == 'X' || c == 'o' || c == 'b' || c == 'c') ?
+            (k == KindSigned || k == KindUnsigned || k == KindChar) :
+        (c == 'f') ? (k == KindFloat) :
+        (c == 's') ? (k == KindString) :
+        false;
+}
+
+template <typename K> struct Check;
+
+template <> struct Check<Kinds<> > {
+    static constexpr bool format(const char *f) {
+        return (*f == 0) ? true :
+            (*f != '%') ? format(f + 1) :
+            (f[1] == '%') ? format(f + 2) :
+            false;
+    }
+};
+
+template <Kind K, Kind... R> struct Check<Kinds<K, R...> > {
+    static constexpr bool format(const char *f) {
+        return (*f == 0) ? false :
+            (*f != '%') ? format(f + 1) :
+            (f[1] == '%') ? format(f + 2) :
+            (suits(*conversion(f + 1), K) && Check<Kinds<R...> >::format(conversion(f + 1) + 1));
+    }
+};
+
+template <bool ok> struct Checked {
+    static_assert(ok, "PRINT_FORMAT: the format does not match the arguments");
+    static constexpr int value = 0;
+};
+
+struct Spec {
+    char conversion;
+    bool left;
+    bool zero;
+    char sign;                              // '+', ' ' or 0
+    uint16_t width;
+    int16_t precision;                      // -1 if not given
+};
+
+// Collects the output on the stack and writes it on in as few writes as
+// the buffer allows
+class Writer {
+    private:
+        Print &_out;
+        size_t _len;
+        size_t _written;
+        char _buf[PRINT_BUFFER_SIZE];
+
+        void put(const char *s, size_t n);
+        void pad(char c, size_t n);
+        void field(const Spec &s, char sign, const char *body, size_t len, size_t zeros = 0);
+
+    public:
+        Writer(Print &out) : _out(out), _len(0), _written(0) {}
+
+        const char *text(const char *fmt, Spec &s);
+        void integer(const Spec &s, unsigned long magnitude, bool negative);
+        void floating(const Spec &s, double value);
+        void string(const Spec &s, const char *str, size_t len);
+        void character(const Spec &s, char c);
+        size_t finish();
+};
+
+template <typename T> inline void argSigned(Writer &w, const Spec &s, T v) {
+    if (s.conversion == 'c') w.character(s, (char)v);
+    else if ((s.conversion == 'd') || (s.conversion == 'i')) w.integer(s, (v < 0) ? 0ul - (unsigned long)v : (unsigned long)v, v < 0);
+    else w.integer(s, (unsigned long)v, false);
+}
+
+template <typename T> inline void argUnsigned(Writer &w, const Spec &s, T v) {
+    if (s.conversion == 'c') w.character(s, (char)v);
+    else w.integer(s, v, false);
+}
+
+inline void arg(Writer &w, const Spec &s, char v) { argSigned(w, s, v); }
+inline void arg(Writer &w, const Spec &s, signed char v) { argSigned(w, s, v); }
+inline void arg(Writer &w, const Spec &s, short v) { argSigned(w, s, v); }
+inline void arg(Writer &w, const Spec &s, int v) { argSigned(w, s, v); }
+inline void arg(Writer &w, const Spec &s, long v) { argSigned(w, s, v); }
+inline void arg(Writer &w, const Spec &s, bool v) { argUnsigned(w, s, (unsigned int)v); }
+inline void arg(Writer &w, const Spec &s, unsigned char v) { argUnsigned(w, s, v); }
+inline void arg(Writer &w, const Spec &s, unsigned short v) { argUnsigned(w, s, v); }
+inline void arg(Writer &w, const Spec &s, unsigned int v) { argUnsigned(w, s, v); }
+inline void arg(Writer &w, const Spec &s, unsigned long v) { argUnsigned(w, s, v); }
+inline void arg(Writer &w, const Spec &s, double v) { w.floating(s, v); }
+inline void arg(Writer &w, const Spec &s, const char *v) { if (v == NULL) v = "(null)"; w.string(s, v, strlen(v)); }
+inline void arg(Writer &w, const Spec &s, const String &v) { w.string(s, v.c_str() ? v.c_str() : "", v.length()); }
+inline void arg(Writer &w, const Spec &s, const StringView &v) { w.string(s, v.data(), v.length()); }
+inline void arg(Writer &w, const Spec &s, const FixedStringBase &v) { w.string(s, v.c_str(), v.length()); }
+
+inline void formatArgs(Writer &w, const char *fmt) {
+    Spec s;
+    while ((fmt = w.text(fmt, s)) != NULL);
+}
+
+template <typename T, typename... R>
+inline void formatArgs(Writer &w, const char *fmt, const T &first, const R &... rest) {
+    Spec s;
+    fmt = w.text(fmt, s);
+    if (fmt == NULL) return;
+    arg(w, s, first);
+    formatArgs(w, fmt, rest...);
+}
+
+template <typename... A>
+size_t format(Print &out, const char *fmt, const A &... args) {
+    Writer w(out);
+    formatArgs(w, fmt, args...);
+    return w.finish();
+}
+
+template <int checked, typename... A>
+inline size_t checkedFormat(Print &out, const char *fmt, const A &... args) {
+    return format(out, fmt, args...);
+}
+
+}
+
+#define PRINT_FORMAT(out, fmt, ...) \
+    PrintFormat::checkedFormat<PrintFormat::Checked<PrintFormat::Check< \
+        decltype(PrintFormat::kindsOf(__VA_ARGS__))>::format(fmt)>::value>(out, fmt, ##__VA_ARGS__)
+
+#endif
@@ -31,10 +31,12 @@ int Stream::timedRead()
 {
   int c;
   _startMillis = millis();
-  do {
+  for (;;) {
     c = read();
     if (c >= 0) return c;
-  } while(millis() - _startMillis < _timeout);
+    unsigned long elapsed = millis() - _startMillis;
+    if ((elapsed >= _timeout) || !waitAvailable(_timeout - elapsed)) break;
+  }
   return -1;     // -1 indicates timeout
 }
 
@@ -43,13 +45,28 @@ int Stream::timedPeek()
 {
   int c;
   _startMillis = millis();
-  do {
+  for (;;) {
     c = peek();
     if (c >= 0) return c;
-  } while(millis() - _startMillis < _timeout);
+    unsigned long elapsed = millis() - _startMillis;
+    if ((elapsed >= _timeout) || !waitAvailable(_timeout - elapsed)) break;
+  }
   return -1;     // -1 indicates timeout
 }
 
+// Sleep until data is available or the timeout (in milliseconds) passes.
+// Streams that can block on their data source override this; the default
+// checks once per tick so that lower priority tasks get to run meanwhile.
+bool Stream::waitAvailable(unsigned long timeout)
+{
+  unsigned long start = millis();
+  while (available() <= 0) {
+    if (millis() - start >= timeout) return false;
+    delay(1);
+  }
+  return true;
+}
+
 // returns peek of the next digit in the stream or -1 if timeout
 // discards non-numeric characters
 int Stream::peekNextDigit()
@@ -244,6 +261,29 @@ size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length)
   return index; // return number of characters, not including null terminator
 }
 
+StringView Stream::readLine(char *buffer, size_t length, char terminator)
+{
+  bool complete;
+  return readLine(buffer, length, complete, terminator);
+}
+
+StringView Stream::readLine(char *buffer, size_t length, bool &complete, char terminator)
+{
+  size_t n = 0;
+  complete = false;
+  while (n < length) {
+    int c = timedRead();
+    if (c < 0) break;
+    if (c == terminator) {
+      complete = true;
+      break;
+    }
+    buffer[n++] = (char)c;
+  }
+  if (n > 0 && buffer[n - 1] == '\r') n--;
+  return StringView(buffer, n);
+}
+
 String Stream::readString()
 {
   String ret;
@@ -24,6 +24,7 @@
 
 #include <inttypes.h>
 #include "Print.h"
+#include "StringView.h"
 
 // compatability macros for testing
 /*
@@ -49,6 +50,7 @@ class Stream : public Print
     virtual int read() = 0;
     virtual int peek() = 0;
     virtual void flush() = 0;
+    virtual bool waitAvailable(unsigned long timeout);  // sleeps until data is available, false on timeout
 
     Stream() {_timeout=1000;}
 
@@ -91,6 +93,13 @@ class Stream : public Print
   String readString();
   String readStringUntil(char terminator);
 
+  StringView readLine(char *buffer, size_t length, char terminator = '\n'); // reads a line into buffer without allocating
+  // returns a view of the line in buffer without the line ending, empty on timeout
+  // a line longer than length is returned in pieces
+  StringView readLine(char *buffer, size_t length, bool &complete, char terminator = '\n');
+  // as above, and sets complete if the terminator was read, so the end of a line can be told
+  // from a piece of a longer one, a timeout, or a blank line
+
   protected:
   long parseInt(char skipChar); // as above but the given skipChar is ignored
   // as above but the given skipChar is ignored
@@ -0,0 +1,235 @@
+#include "Arduino.h"
+#include "StreamMux.h"
+
+static TickType_t streamMuxTicks(unsigned long ms) {
+    return ((uint64_t)ms * configTICK_RATE_HZ + 999) / 1000;
+}
+
+#if (configSUPPORT_DYNAMIC_ALLOCATION == 1)
+bool StreamMuxChannel::begin(size_t txSize, size_t rxSize, uint8_t priority, Policy policy) {
+    if ((_tx != NULL) || (_rx != NULL)) return false;
+    _priority = priority;
+    _policy = policy;
+    _txSize = txSize;
+    if (txSize > 0) {
+        _lock = xSemaphoreCreateMutex();
+        _tx = xStreamBufferCreate(txSize, 1);
+        if ((_lock == NULL) || (_tx == NULL)) return false;
+    }
+    if (rxSize > 0) {
+        _rx = xStreamBufferCreate(rxSize, 1);
+        if (_rx == NULL) return false;
+    }
+    return true;
+}
+#endif
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+bool StreamMuxChannel::begin(uint8_t *txStorage, size_t txStorageSize, uint8_t *rxStorage, size_t rxStorageSize,
+    uint8_t priority, Policy policy) {
+    if ((_tx != NULL) || (_rx != NULL)) return false;
+    _priority = priority;
+    _policy = policy;
+    // A stream buffer keeps one byte of its storage free
+    _txSize = ((txStorage != NULL) && (txStorageSize > 1)) ? txStorageSize - 1 : 0;
+    if (_txSize > 0) {
+        _lock = xSemaphoreCreateMutexStatic(&_lockBuffer);
+        _tx = xStreamBufferCreateStatic(_txSize, 1, txStorage, &_txBuffer);
+    }
+    if ((rxStorage != NULL) && (rxStorageSize > 1)) {
+        _rx = xStreamBufferCreateStatic(rxStorageSize - 1, 1, rxStorage, &_rxBuffer);
+    }
+    return true;
+}
+#endif
+
+// The whole write goes into the buffer under the channel's lock, so it is
+// not split up by writes from other tasks. The writer task is woken as
+// soon as there is something for it, and before waiting for room, as only
+// it can make room.
+size_t StreamMuxChannel::write(const uint8_t *buffer, size_t size) {
+    if (_tx == NULL) return 0;
+
+    TimeOut_t start;
+    TickType_t ticks = streamMuxTicks(_timeout);
+    size_t done = 0;
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    vTaskSetTimeOutState(&start);
+    // A write that does not fit is dropped whole, so what is sent stays in
+    // whole records. Room only grows while the lock is held.
+    if ((_policy == Drop) && (xStreamBufferSpacesAvailable(_tx) < size)) {
+        _txDropped += size;
+        xSemaphoreGive(_lock);
+        return 0;
+    }
+    while (done < size) {
+        size_t n = xStreamBufferSend(_tx, buffer + done, size - done, 0);
+        done += n;
+        if (n > 0) _mux->wake();
+        if (done == size) break;
+        if (xTaskCheckForTimeOut(&start, &ticks) == pdTRUE) break;
+
+        // Wait for room for half the buffer, or for the rest if less
+        size_t piece = size - done;
+        if (piece > _txSize / 2) piece = _txSize / 2;
+        if (piece == 0) piece = 1;
+        n = xStreamBufferSend(_tx, buffer + done, piece, ticks);
+        done += n;
+        if (n > 0) _mux->wake();
+    }
+    _txDropped += size - done;
+    xSemaphoreGive(_lock);
+    return done;
+}
+
+int StreamMuxChannel::availableForWrite() {
+    return (_tx == NULL) ? 0 : xStreamBufferSpacesAvailable(_tx);
+}
+
+int StreamMuxChannel::available() {
+    if (_rx == NULL) return 0;
+    return xStreamBufferBytesAvailable(_rx) + ((_peeked >= 0) ? 1 : 0);
+}
+
+// A stream buffer cannot be peeked, so a byte that is peeked at, or waited
+// for, is kept back for the next read()
+int StreamMuxChannel::read() {
+    uint8_t b;
+    if (_peeked >= 0) {
+        int c = _peeked;
+        _peeked = -1;
+        return c;
+    }
+    if ((_rx == NULL) || (xStreamBufferReceive(_rx, &b, 1, 0) == 0)) return -1;
+    return b;
+}
+
+int StreamMuxChannel::peek() {
+    uint8_t b;
+    if (_peeked < 0) {
+        if ((_rx == NULL) || (xStreamBufferReceive(_rx, &b, 1, 0) == 0)) return -1;
+        _peeked = b;
+    }
+    return _peeked;
+}
+
+bool StreamMuxChannel::waitAvailable(unsigned long timeout) {
+    uint8_t b;
+    if (_peeked >= 0) return true;
+    if ((_rx == NULL) || (xStreamBufferReceive(_rx, &b, 1, streamMuxTicks(timeout)) == 0)) return false;
+    _peeked = b;
+    return true;
+}
+
+void StreamMuxChannel::flush() {
+    if ((_tx == NULL) || (_mux->_writer == NULL)) return;
+    while (!xStreamBufferIsEmpty(_tx)) vTaskDelay(1);
+}
+
+StreamMux::StreamMux(Stream &port) : _port(port), _writer(NULL), _reader(NULL), _last(0), _unknown(0), _batchLen(0) {
+    for (uint8_t i = 0; i < STREAM_MUX_CHANNELS; i++) {
+        _channels[i]._mux = this;
+        _channels[i]._id = i;
+    }
+}
+
+bool StreamMux::begin(UBaseType_t priority) {
+    bool receive = false;
+
+    if (_writer != NULL) return false;
+    for (uint8_t i = 0; i < STREAM_MUX_CHANNELS; i++) {
+        if (_channels[i]._rx != NULL) receive = true;
+    }
+    frame_decoder_init(&_decoder, _frame, sizeof(_frame));
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    _writer = xTaskCreateStatic(writerTask, "MuxTx", STREAM_MUX_STACK_SIZE, this, priority, _writerStack, &_writerTask);
+    if (receive) {
+        _reader = xTaskCreateStatic(readerTask, "MuxRx", STREAM_MUX_STACK_SIZE, this, priority, _readerStack, &_readerTask);
+    }
+#else
+    if (xTaskCreate(writerTask, "MuxTx", STREAM_MUX_STACK_SIZE, this, priority, &_writer) != pdPASS) {
+        _writer = NULL;
+        return false;
+    }
+    if (receive && (xTaskCreate(readerTask, "MuxRx", STREAM_MUX_STACK_SIZE, this, priority, &_reader) != pdPASS)) {
+        _reader = NULL;
+        return false;
+    }
+#endif
+    return true;
+}
+
+// The channel with data and the highest priority. Among channels of the
+// same priority the search starts after the one sent last, so they take turns.
+StreamMuxChannel *StreamMux::nextChannel() {
+    StreamMuxChannel *best = NULL;
+    for (uint8_t i = 1; i <= STREAM_MUX_CHANNELS; i++) {
+        StreamMuxChannel *c = &_channels[(_last + i) % STREAM_MUX_CHANNELS];
+        if ((c->_tx == NULL) || xStreamBufferIsEmpty(c->_tx)) continue;
+        if ((best == NULL) || (c->_priority > best->_priority)) best = c;
+    }
+    if (best != NULL) _last = best->_id;
+    return best;
+}
+
+void StreamMux::writeBatch(void *ctx, const uint8_t *data, size_t len) {
+    StreamMux *mux = (StreamMux *)ctx;
+    if (mux->_batchLen + len > sizeof(mux->_batch)) mux->flushBatch();
+    memcpy(mux->_batch + mux->_batchLen, data, len);
+    mux->_batchLen += len;
+}
+
+void StreamMux::flushBatch() {
+    if (_batchLen == 0) return;
+    _port.write(_batch, _batchLen);
+    _batchLen = 0;
+}
+
+// Send frames until every channel is empty, one frame of up to
+// STREAM_MUX_PAYLOAD bytes at a time, so a channel of higher priority
+// that gets data meanwhile is sent next
+void StreamMux::sendAll() {
+    StreamMuxChannel *c;
+    while ((c = nextChannel()) != NULL) {
+        size_t n = xStreamBufferReceive(c->_tx, _payload + 1, STREAM_MUX_PAYLOAD, 0);
+        if (n == 0) continue;
+        _payload[0] = c->_id;
+        frame_begin(&_encoder, writeBatch, this);
+        frame_put(&_encoder, _payload, n + 1);
+        frame_end(&_encoder);
+    }
+    flushBatch();
+}
+
+void StreamMux::writerTask(void *arg) {
+    StreamMux *mux = (StreamMux *)arg;
+    for (;;) {
+        // Starting with a pass sends anything written before begin()
+        mux->sendAll();
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+void StreamMux::deliver(const uint8_t *frame, size_t len) {
+    if (len == 0) return;
+    StreamMuxChannel *c = (frame[0] < STREAM_MUX_CHANNELS) ? &_channels[frame[0]] : NULL;
+    if ((c == NULL) || (c->_rx == NULL)) {
+        _unknown++;
+        return;
+    }
+    size_t n = xStreamBufferSend(c->_rx, frame + 1, len - 1, 0);
+    c->_rxDropped += len - 1 - n;
+}
+
+void StreamMux::readerTask(void *arg) {
+    StreamMux *mux = (StreamMux *)arg;
+    int c;
+    for (;;) {
+        while ((c = mux->_port.read()) >= 0) {
+            if (frame_decode(&mux->_decoder, c)) mux->deliver(mux->_decoder.buf, mux->_decoder.length);
+        }
+        mux->_port.waitAvailable(1000);
+    }
+}
@@ -0,0 +1,175 @@
+#ifndef _STREAM_MUX_H
+#define _STREAM_MUX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "stream_buffer.h"
+
+#include "Stream.h"
+#include "sdk/frame.h"
+
+// Several independent Streams over one serial port, so that the console,
+// the log and binary telemetry from different tasks no longer break into
+// each other's lines. Each channel is a Stream with its own transmit
+// buffer; writing to it only copies into that buffer. One writer task
+// takes the channels' data in order of priority, wraps each piece in a
+// frame tagged with the channel number (see sdk/frame.h), and sends the
+// frames in batches with as few writes to the port as it can. Frames that
+// come in are passed to the receive buffers of their channels by a reader
+// task. tools/streammux.py splits the channels apart again on the host.
+//
+//     StreamMux mux(Serial);
+//     Stream &console = mux.channel(0);
+//     Stream &telemetry = mux.channel(1);
+//
+//     void setup() {
+//         Serial.begin(921600);
+//         mux.channel(0).begin(512, 64);
+//         mux.channel(1).begin(1024, 0, 1, StreamMuxChannel::Drop);
+//         mux.begin();
+//     }
+//
+// With configSUPPORT_STATIC_ALLOCATION the buffers can be given instead,
+// and the tasks' stacks are part of the StreamMux:
+//
+//     static uint8_t consoleTx[512 + 1] portSTATIC_STORAGE;
+//     mux.channel(0).begin(consoleTx, sizeof(consoleTx), NULL, 0);
+//
+// Flow control is per channel: when a channel's buffer is full a write
+// either waits, up to the channel's setTimeout(), for the writer task to
+// make room (Block), or is dropped whole (Drop), so a channel that floods
+// never holds up the others. Received data for a
+// channel whose buffer is full is dropped and counted. Each write() to a
+// channel stays in one piece, in order, however many tasks share it.
+//
+// Once begin() has been called the mux owns the port; nothing else should
+// read from or write to it.
+
+#define STREAM_MUX_CHANNELS 8
+#define STREAM_MUX_PAYLOAD 128                  // Most data bytes in one frame
+#define STREAM_MUX_BATCH 512                    // Bytes collected for one write to the port
+#define STREAM_MUX_STACK_SIZE (configMINIMAL_STACK_SIZE + 128)
+
+class StreamMux;
+
+class StreamMuxChannel : public Stream
+{
+    friend class StreamMux;
+
+    public:
+        enum Policy : uint8_t {
+            Block,                              // Wait for room, up to the timeout
+            Drop                                // Drop writes that do not fit
+        };
+
+    private:
+        StreamMux *_mux;
+        uint8_t _id;
+        uint8_t _priority;
+        Policy _policy;
+        StreamBufferHandle_t _tx;
+        StreamBufferHandle_t _rx;
+        SemaphoreHandle_t _lock;
+        size_t _txSize;
+        int _peeked;
+        uint32_t _txDropped;
+        uint32_t _rxDropped;
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+        StaticStreamBuffer_t _txBuffer;
+        StaticStreamBuffer_t _rxBuffer;
+        StaticSemaphore_t _lockBuffer;
+#endif
+
+        StreamMuxChannel() : _mux(NULL), _id(0), _priority(0), _policy(Block), _tx(NULL), _rx(NULL), _lock(NULL),
+            _txSize(0), _peeked(-1), _txDropped(0), _rxDropped(0) {}
+        StreamMuxChannel(const StreamMuxChannel &);
+        StreamMuxChannel &operator = (const StreamMuxChannel &);
+
+    public:
+        // Give the channel buffers, which must be done before StreamMux::begin().
+        // A size of 0 leaves that direction unused. Channels with a higher
+        // priority are sent first; the same priority takes turns.
+#if (configSUPPORT_DYNAMIC_ALLOCATION == 1)
+        bool begin(size_t txSize, size_t rxSize = 0, uint8_t priority = 0, Policy policy = Block);
+#endif
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+        // The same with buffers the caller provides, which hold one byte
+        // less than their size. A NULL buffer leaves that direction unused.
+        bool begin(uint8_t *txStorage, size_t txStorageSize, uint8_t *rxStorage, size_t rxStorageSize,
+            uint8_t priority = 0, Policy policy = Block);
+#endif
+
+        virtual size_t write(uint8_t b) { return write(&b, 1); }
+        virtual size_t write(const uint8_t *buffer, size_t size);
+        using Print::write;
+        virtual int availableForWrite();
+
+        virtual int available();
+        virtual int read();
+        virtual int peek();
+        virtual bool waitAvailable(unsigned long timeout);
+        // Wait until the writer task has taken everything written so far
+        virtual void flush();
+
+        uint8_t id() const { return _id; }
+        // Bytes lost because a buffer was full
+        uint32_t txDropped() const { return _txDropped; }
+        uint32_t rxDropped() const { return _rxDropped; }
+};
+
+class StreamMux
+{
+    friend class StreamMuxChannel;
+
+    private:
+        Stream &_port;
+        StreamMuxChannel _channels[STREAM_MUX_CHANNELS];
+        TaskHandle_t _writer;
+        TaskHandle_t _reader;
+        uint8_t _last;                          // Channel sent last, for taking turns
+        uint32_t _unknown;                      // Frames received for channels not in use
+
+        frame_encoder_t _encoder;
+        frame_decoder_t _decoder;
+        size_t _batchLen;
+        uint8_t _batch[STREAM_MUX_BATCH];
+        uint8_t _payload[STREAM_MUX_PAYLOAD + 1];
+        uint8_t _frame[STREAM_MUX_PAYLOAD + 3];  // Channel, data and CRC of a received frame
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+        StaticTask_t _writerTask;
+        StaticTask_t _readerTask;
+        StackType_t _writerStack[STREAM_MUX_STACK_SIZE];
+        StackType_t _readerStack[STREAM_MUX_STACK_SIZE];
+#endif
+
+        StreamMux(const StreamMux &);
+        StreamMux &operator = (const StreamMux &);
+
+        static void writerTask(void *arg);
+        static void readerTask(void *arg);
+        static void writeBatch(void *ctx, const uint8_t *data, size_t len);
+        StreamMuxChannel *nextChannel();
+        void sendAll();
+        void flushBatch();
+        void deliver(const uint8_t *frame, size_t len);
+        void wake() { if (_writer != NULL) xTaskNotifyGive(_writer); }
+
+    public:
+        StreamMux(Stream &port);
+
+        // Start the writer task, and the reader task if any channel has a
+        // receive buffer
+        bool begin(UBaseType_t priority = configARDUINO_TASK_PRIORITY);
+
+        StreamMuxChannel &channel(uint8_t id) { return _channels[id % STREAM_MUX_CHANNELS]; }
+
+        const frame_stats_t &rxStats() const { return _decoder.stats; }
+        uint32_t unknownFrames() const { return _unknown; }
+};
+
+#endif
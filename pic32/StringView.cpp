@@ -0,0 +1,196 @@
+#include <ctype.h>
+#include <limits.h>
+
+#include "StringView.h"
+
+String StringView::toString() const {
+    String s;
+    if (!s.reserve(_len)) return s;
+    for (size_t i = 0; i < _len; i++) s += _data[i];
+    return s;
+}
+
+bool StringView::equalsIgnoreCase(const StringView &s) const {
+    if (_len != s._len) return false;
+    for (size_t i = 0; i < _len; i++) {
+        if (tolower(_data[i]) != tolower(s._data[i])) return false;
+    }
+    return true;
+}
+
+int StringView::compareTo(const StringView &s) const {
+    int r = memcmp(_data, s._data, (_len < s._len) ? _len : s._len);
+    if (r != 0) return r;
+    return (_len < s._len) ? -1 : (_len > s._len);
+}
+
+int StringView::indexOf(char ch, size_t fromIndex) const {
+    if (fromIndex >= _len) return -1;
+    const char *p = (const char *)memchr(_data + fromIndex, ch, _len - fromIndex);
+    return (p == NULL) ? -1 : p - _data;
+}
+
+int StringView::indexOf(const StringView &str, size_t fromIndex) const {
+    if ((str._len == 0) || (str._len > _len)) return -1;
+    size_t last = _len - str._len;
+    for (size_t i = fromIndex; i <= last; i++) {
+        const char *p = (const char *)memchr(_data + i, str._data[0], last - i + 1);
+        if (p == NULL) return -1;
+        i = p - _data;
+        if (memcmp(p, str._data, str._len) == 0) return i;
+    }
+    return -1;
+}
+
+int StringView::lastIndexOf(char ch) const {
+    for (size_t i = _len; i > 0; i--) {
+        if (_data[i - 1] == ch) return i - 1;
+    }
+    return -1;
+}
+
+// As String::substring(), the ends are swapped if need be and clipped to the view
+StringView StringView::substring(size_t beginIndex, size_t endIndex) const {
+    if (beginIndex > endIndex) {
+        size_t temp = endIndex;
+        endIndex = beginIndex;
+        beginIndex = temp;
+    }
+    if (endIndex > _len) endIndex = _len;
+    if (beginIndex > endIndex) beginIndex = endIndex;
+    return StringView(_data + beginIndex, endIndex - beginIndex);
+}
+
+StringView StringView::trim() const {
+    size_t begin = 0;
+    size_t end = _len;
+    while ((begin < end) && isspace(_data[begin])) begin++;
+    while ((end > begin) && isspace(_data[end - 1])) end--;
+    return StringView(_data + begin, end - begin);
+}
+
+bool StringView::parseInt(long &value) const {
+    size_t i = 0;
+    bool negative = false;
+    if ((_len > 0) && ((_data[0] == '-') || (_data[0] == '+'))) {
+        negative = (_data[0] == '-');
+        i++;
+    }
+    if (i == _len) return false;
+
+    unsigned long limit = negative ? (unsigned long)LONG_MAX + 1 : LONG_MAX;
+    unsigned long v = 0;
+    for (; i < _len; i++) {
+        unsigned int d = _data[i] - '0';
+        if (d > 9) return false;
+        if (v > (limit - d) / 10) return false;
+        v = v * 10 + d;
+    }
+    value = negative ? (long)(0ul - v) : (long)v;
+    return true;
+}
+
+// Hex digits in either case, with or without a leading 0x
+bool StringView::parseHex(unsigned long &value) const {
+    size_t i = 0;
+    if ((_len > 2) && (_data[0] == '0') && ((_data[1] == 'x') || (_data[1] == 'X'))) i = 2;
+    if (i == _len) return false;
+
+    unsigned long v = 0;
+    for (; i < _len; i++) {
+        char c = _data[i];
+        unsigned int d;
+        if ((c >= '0') && (c <= '9')) d = c - '0';
+        else if ((c >= 'a') && (c <= 'f')) d = c - 'a' + 10;
+        else if ((c >= 'A') && (c <= 'F')) d = c - 'A' + 10;
+        else return false;
+        if (v > (ULONG_MAX >> 4)) return false;
+        v = (v << 4) | d;
+    }
+    value = v;
+    return true;
+}
+
+// Digits with an optional point and exponent. The first nineteen
+// significant digits, as many as a uint64_t holds, are gathered as an
+// integer and scaled by a power of ten once, rather than with a floating
+// point operation per digit. That is more than the seventeen it takes to
+// tell any two doubles apart.
+bool StringView::parseDouble(double &value) const {
+    static const double powersOf10[16] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+    };
+    size_t i = 0;
+    bool negative = false;
+    if ((_len > 0) && ((_data[0] == '-') || (_data[0] == '+'))) {
+        negative = (_data[0] == '-');
+        i++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+    for (; (i < _len) && isdigit(_data[i]); i++) {
+        any = true;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (_data[i] - '0');
+            if (mantissa) digits++;
+        } else {
+            exponent++;
+        }
+    }
+    if ((i < _len) && (_data[i] == '.')) {
+        for (i++; (i < _len) && isdigit(_data[i]); i++) {
+            any = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (_data[i] - '0');
+                if (mantissa) digits++;
+                exponent--;
+            }
+        }
+    }
+    if (!any) return false;
+
+    if ((i < _len) && ((_data[i] == 'e') || (_data[i] == 'E'))) {
+        long e;
+        if (!substring(i + 1).parseInt(e)) return false;
+        if (e > 400) e = 400;
+        if (e < -400) e = -400;
+        exponent += e;
+        i = _len;
+    }
+    if (i != _len) return false;
+
+    int e = (exponent < 0) ? -exponent : exponent;
+    double scale = 1.0;
+    while (e >= 16) {
+        scale *= 1e16;
+        e -= 16;
+    }
+    scale *= powersOf10[e];
+    double v = (exponent < 0) ? (double)mantissa / scale : (double)mantissa * scale;
+    value = negative ? -v : v;
+    return true;
+}
+
+bool StringView::parseFloat(float &value) const {
+    double v;
+    if (!parseDouble(v)) return false;
+    value = (float)v;
+    return true;
+}
+
+bool StringTokenizer::next(StringView &token) {
+    if (_done) return false;
+    int i = _rest.indexOf(_separator);
+    if (i < 0) {
+        token = _rest;
+        _rest = _rest.substring(_rest.length());
+        _done = true;
+    } else {
+        token = _rest.substring(0, i);
+        _rest = _rest.substring(i + 1);
+    }
+    return true;
+}
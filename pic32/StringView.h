@@ -0,0 +1,94 @@
+#ifndef _STRING_VIEW_H
+#define _STRING_VIEW_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "WString.h"
+#include "FixedString.h"
+
+// A read only window onto characters owned by something else: a String, a
+// FixedString, a C string or a buffer filled by Stream::readLine(). Taking
+// a substring or splitting a view only makes another pointer and length,
+// so a line can be picked apart without any copies or heap. A view is only
+// valid while the characters it points at are, and it is not necessarily
+// zero terminated.
+//
+//     char buf[83];
+//     StringView line = Serial.readLine(buf, sizeof(buf));
+//     if (line.startsWith("$GPGGA,")) {
+//         StringTokenizer fields(line, ',');
+//         StringView field;
+//         float lat;
+//         fields.next(field);                 // $GPGGA
+//         fields.next(field);                 // time
+//         if (fields.next(field) && field.parseFloat(lat)) ...
+//     }
+//
+// The parse functions take the whole view, with an optional sign, and fail
+// on anything else; toInt(), toFloat() and toHex() give 0 instead.
+
+class StringView
+{
+    private:
+        const char *_data;
+        size_t _len;
+
+    public:
+        StringView() : _data(""), _len(0) {}
+        StringView(const char *cstr) : _data(cstr ? cstr : ""), _len(cstr ? strlen(cstr) : 0) {}
+        StringView(const char *data, size_t len) : _data(data), _len(len) {}
+        StringView(const String &str) : _data(str.c_str() ? str.c_str() : ""), _len(str.length()) {}
+        StringView(const FixedStringBase &str) : _data(str.c_str()), _len(str.length()) {}
+
+        const char *data() const { return _data; }
+        size_t length() const { return _len; }
+        bool isEmpty() const { return _len == 0; }
+        char charAt(size_t index) const { return (index < _len) ? _data[index] : 0; }
+        char operator [] (size_t index) const { return charAt(index); }
+        String toString() const;
+
+        bool equals(const StringView &s) const { return (_len == s._len) && (memcmp(_data, s._data, _len) == 0); }
+        bool equalsIgnoreCase(const StringView &s) const;
+        bool operator == (const StringView &s) const { return equals(s); }
+        bool operator != (const StringView &s) const { return !equals(s); }
+        int compareTo(const StringView &s) const;
+        bool startsWith(const StringView &prefix) const { return (prefix._len <= _len) && (memcmp(_data, prefix._data, prefix._len) == 0); }
+        bool endsWith(const StringView &suffix) const
+            { return (suffix._len <= _len) && (memcmp(_data + _len - suffix._len, suffix._data, suffix._len) == 0); }
+
+        int indexOf(char ch, size_t fromIndex = 0) const;
+        int indexOf(const StringView &str, size_t fromIndex = 0) const;
+        int lastIndexOf(char ch) const;
+        StringView substring(size_t beginIndex) const { return substring(beginIndex, _len); }
+        StringView substring(size_t beginIndex, size_t endIndex) const;
+        StringView trim() const;
+
+        bool parseInt(long &value) const;
+        bool parseHex(unsigned long &value) const;
+        bool parseFloat(float &value) const;
+        bool parseDouble(double &value) const;
+        long toInt() const { long v; return parseInt(v) ? v : 0; }
+        unsigned long toHex() const { unsigned long v; return parseHex(v) ? v : 0; }
+        float toFloat() const { float v; return parseFloat(v) ? v : 0; }
+};
+
+// Splits a view into the fields between separators. Empty fields are kept,
+// so "a,,b" gives "a", "" and "b", and an empty view gives one empty field.
+class StringTokenizer
+{
+    private:
+        StringView _rest;
+        char _separator;
+        bool _done;
+
+    public:
+        StringTokenizer(const StringView &str, char separator) : _rest(str), _separator(separator), _done(false) {}
+
+        // Set token to the next field, or return false if there are no more
+        bool next(StringView &token);
+        // Everything not yet returned by next()
+        StringView rest() const { return _rest; }
+};
+
+#endif
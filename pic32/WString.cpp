@@ -20,6 +20,7 @@
 */
 
 #include "WString.h"
+#include "num_format.h"
 
 #include <stdio.h>
 
@@ -78,7 +79,7 @@ String::String(unsigned char value, unsigned char base)
 String::String(int value, unsigned char base)
 {
 	init();
-	char buf[18];
+	char buf[34];
 	itoa(value, buf, base);
 	*this = buf;
 }
@@ -86,7 +87,7 @@ String::String(int value, unsigned char base)
 String::String(unsigned int value, unsigned char base)
 {
 	init();
-	char buf[17];
+	char buf[33];
 	utoa(value, buf, base);
 	*this = buf;
 }
@@ -110,19 +111,21 @@ String::String(unsigned long value, unsigned char base)
 String::String(float value, unsigned char decimalPlaces)
 {
 	init();
-	char buf[33];
-	*this = dtostrf(value, (decimalPlaces + 2), decimalPlaces, buf);
+	char buf[NUM_FORMAT_FLOAT_SIZE];
+	num_format_float(buf, value, decimalPlaces);
+	*this = buf;
 }
 
 String::String(double value, unsigned char decimalPlaces)
 {
 	init();
-	char buf[33];
-	*this = dtostrf(value, (decimalPlaces + 2), decimalPlaces, buf);
+	char buf[NUM_FORMAT_FLOAT_SIZE];
+	num_format_float(buf, value, decimalPlaces);
+	*this = buf;
 }
 String::~String()
 {
-	free(buffer);
+	if (buffer != sso) free(buffer);
 }
 
 /*********************************************/
@@ -139,7 +142,7 @@ inline void String::init(void)
 
 void String::invalidate(void)
 {
-	if (buffer) free(buffer);
+	if (buffer != sso) free(buffer);
 	buffer = NULL;
 	capacity = len = 0;
 }
@@ -156,7 +159,24 @@ unsigned char String::reserve(unsigned int size)
 
 unsigned char String::changeBuffer(unsigned int maxStrLen)
 {
-	char *newbuffer = (char *)realloc(buffer, maxStrLen + 1);
+	// Short strings need no heap at all
+	if (maxStrLen <= STRING_SSO_CAPACITY && (!buffer || buffer == sso)) {
+		buffer = sso;
+		capacity = STRING_SSO_CAPACITY;
+		return 1;
+	}
+
+	// Grow by half as much again, so appending in a loop reallocates a
+	// logarithmic number of times rather than on every append, but fall
+	// back to the exact size if the heap can't spare the extra
+	unsigned int grown = capacity + capacity / 2;
+	char *newbuffer = NULL;
+	if (grown > maxStrLen) newbuffer = allocBuffer(grown);
+	if (newbuffer) {
+		maxStrLen = grown;
+	} else {
+		newbuffer = allocBuffer(maxStrLen);
+	}
 	if (newbuffer) {
 		buffer = newbuffer;
 		capacity = maxStrLen;
@@ -165,6 +185,15 @@ unsigned char String::changeBuffer(unsigned int maxStrLen)
 	return 0;
 }
 
+// Resize the heap buffer, or move a short string out to the heap
+char *String::allocBuffer(unsigned int maxStrLen)
+{
+	if (buffer != sso) return (char *)realloc(buffer, maxStrLen + 1);
+	char *newbuffer = (char *)malloc(maxStrLen + 1);
+	if (newbuffer) memcpy(newbuffer, sso, len + 1);
+	return newbuffer;
+}
+
 /*********************************************/
 /*  Copy and Move                            */
 /*********************************************/
@@ -196,16 +225,24 @@ String & String::copy(const __FlashStringHelper *pstr, unsigned int length)
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
 void String::move(String &rhs)
 {
-	if (buffer) {
-		if (capacity >= rhs.len) {
-			strcpy(buffer, rhs.buffer);
-			len = rhs.len;
-			rhs.len = 0;
+	if (!rhs.buffer) {
+		invalidate();
+		return;
+	}
+	// Copy if our buffer is big enough, or if there is no heap buffer to
+	// take over because the string is inside the other object
+	if ((buffer && capacity >= rhs.len) || rhs.buffer == rhs.sso) {
+		if (!reserve(rhs.len)) {
+			invalidate();
 			return;
-		} else {
-			free(buffer);
 		}
+		memcpy(buffer, rhs.buffer, rhs.len + 1);
+		len = rhs.len;
+		rhs.len = 0;
+		rhs.buffer[0] = 0;
+		return;
 	}
+	if (buffer != sso) free(buffer);
 	buffer = rhs.buffer;
 	capacity = rhs.capacity;
 	len = rhs.len;
@@ -299,14 +336,14 @@ unsigned char String::concat(unsigned char num)
 
 unsigned char String::concat(int num)
 {
-	char buf[7];
+	char buf[12];
 	itoa(num, buf, 10);
 	return concat(buf, strlen(buf));
 }
 
 unsigned char String::concat(unsigned int num)
 {
-	char buf[6];
+	char buf[11];
 	utoa(num, buf, 10);
 	return concat(buf, strlen(buf));
 }
@@ -327,16 +364,14 @@ unsigned char String::concat(unsigned long num)
 
 unsigned char String::concat(float num)
 {
-	char buf[20];
-	char* string = dtostrf(num, 8, 6, buf);
-	return concat(string, strlen(string));
+	char buf[NUM_FORMAT_FLOAT_SIZE];
+	return concat(buf, num_format_float(buf, num, 6));
 }
 
 unsigned char String::concat(double num)
 {
-	char buf[20];
-	char* string = dtostrf(num, 8, 6, buf);
-	return concat(string, strlen(string));
+	char buf[NUM_FORMAT_FLOAT_SIZE];
+	return concat(buf, num_format_float(buf, num, 6));
 }
 
 unsigned char String::concat(const __FlashStringHelper * str)
@@ -667,14 +702,14 @@ String & String::replace(const String& find, const String& replace)
 		char *writeTo = buffer;
 		while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
 			unsigned int n = foundAt - readFrom;
-			memcpy(writeTo, readFrom, n);
+			memmove(writeTo, readFrom, n);
 			writeTo += n;
 			memcpy(writeTo, replace.buffer, replace.len);
 			writeTo += replace.len;
 			readFrom = foundAt + find.len;
 			len += diff;
 		}
-		strcpy(writeTo, readFrom);
+		memmove(writeTo, readFrom, strlen(readFrom) + 1);
 	} else {
 		unsigned int size = len; // compute size needed for result
 		while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
@@ -709,7 +744,7 @@ String & String::remove(unsigned int index, unsigned int count){
 	if (index + count > len) { count = len - index; }
 	char *writeTo = buffer + index;
 	len = len - count;
-	strncpy(writeTo, buffer + index + count,len - index);
+	memmove(writeTo, buffer + index + count, len - index);
 	buffer[len] = 0;
     return *this;
 }
@@ -740,7 +775,7 @@ String & String::trim(void)
 	char *end = buffer + len - 1;
 	while (isspace(*end) && end >= begin) end--;
 	len = end + 1 - begin;
-	if (begin > buffer) memcpy(buffer, begin, len);
+	if (begin > buffer) memmove(buffer, begin, len);
 	buffer[len] = 0;
     return *this;
 }
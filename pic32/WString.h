@@ -44,6 +44,10 @@ class __FlashStringHelper;
 // result objects are assumed to be writable by subsequent concatenations.
 class StringSumHelper;
 
+// Strings of up to this many characters are kept inside the String object
+// rather than on the heap
+#define STRING_SSO_CAPACITY 11
+
 // The string class
 class String
 {
@@ -194,10 +198,12 @@ protected:
 	unsigned int capacity;  // the array length minus one (for the '\0')
 	unsigned int len;       // the String length (not counting the '\0')
 	unsigned char flags;    // unused, for future features
+	char sso[STRING_SSO_CAPACITY + 1]; // the array for short strings
 protected:
 	void init(void);
 	void invalidate(void);
 	unsigned char changeBuffer(unsigned int maxStrLen);
+	char *allocBuffer(unsigned int maxStrLen);
 	unsigned char concat(const char *cstr, unsigned int length);
 
 	// copy and move
@@ -1,6 +1,11 @@
+#include <stdio.h>
+#include <string.h>
+
 #include "FreeRTOS.h"
 #include "task.h"
 
+#include "sdk/uart.h"
+
 void vAssertCalled( const char * pcFile, unsigned long ulLine ) {
 }
 
@@ -8,8 +13,27 @@ void vApplicationStackOverflowHook( TaskHandle_t pxTask, char *pcTaskName ) {
     TRISECLR = 1 << 6;
     LATESET = 1 << 6;
     taskDISABLE_INTERRUPTS();
+    if (uart_is_open(0)) {
+        char errormsg[40];
+        sprintf(errormsg, "Stack overflow in task %.*s\r\n", configMAX_TASK_NAME_LEN, pcTaskName);
+        uart_write_bytes_emergency(0, (uint8_t *)errormsg, strlen(errormsg));
+    }
+    for( ;; );
+}
+
+#if (configUSE_LAZY_FPU_SWITCHING == 1)
+void vApplicationFPUContextsExhaustedHook( TaskHandle_t pxTask, char *pcTaskName ) {
+    TRISECLR = 1 << 6;
+    LATESET = 1 << 6;
+    taskDISABLE_INTERRUPTS();
+    if (uart_is_open(0)) {
+        char errormsg[80];
+        sprintf(errormsg, "Out of FPU contexts in task %.*s, raise configLAZY_FPU_CONTEXTS\r\n", configMAX_TASK_NAME_LEN, pcTaskName);
+        uart_write_bytes_emergency(0, (uint8_t *)errormsg, strlen(errormsg));
+    }
     for( ;; );
 }
+#endif
 
 void vApplicationMallocFailedHook( TaskHandle_t pxTask, char *pcTaskName ) {
     TRISECLR = 1 << 6;
@@ -18,4 +42,24 @@ void vApplicationMallocFailedHook( TaskHandle_t pxTask, char *pcTaskName ) {
     for( ;; );
 }
 
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+void vApplicationGetIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer, uint32_t *pulIdleTaskStackSize ) {
+    static StaticTask_t xIdleTaskTCB portSTATIC_STORAGE;
+    static StackType_t uxIdleTaskStack[configMINIMAL_STACK_SIZE] portSTATIC_STORAGE;
+
+    *ppxIdleTaskTCBBuffer = &xIdleTaskTCB;
+    *ppxIdleTaskStackBuffer = uxIdleTaskStack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+
+#if (configUSE_TIMERS == 1)
+void vApplicationGetTimerTaskMemory( StaticTask_t **ppxTimerTaskTCBBuffer, StackType_t **ppxTimerTaskStackBuffer, uint32_t *pulTimerTaskStackSize ) {
+    static StaticTask_t xTimerTaskTCB portSTATIC_STORAGE;
+    static StackType_t uxTimerTaskStack[configTIMER_TASK_STACK_DEPTH] portSTATIC_STORAGE;
 
+    *ppxTimerTaskTCBBuffer = &xTimerTaskTCB;
+    *ppxTimerTaskStackBuffer = uxTimerTaskStack;
+    *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
+#endif
+#endif
@@ -5,6 +5,10 @@
 
 #include "sdk/cpu.h"
 
+void __attribute__((weak)) yield() {
+    taskYIELD();
+}
+
 void delay(uint32_t ms) {
     vTaskDelay(ms * portTICK_PERIOD_MS);
 }
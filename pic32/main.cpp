@@ -3,20 +3,114 @@
 #include "FreeRTOS.h"
 #include "task.h"
 
+#include "sdk/cpu.h"
+#include "sdk/htimer.h"
+#include "sdk/stackwatch.h"
+#include "sdk/workqueue.h"
+
 extern void setup();
 extern void loop();
+extern void loop2() __attribute__((weak));
+extern void loop3() __attribute__((weak));
+extern void loop4() __attribute__((weak));
+extern void loop5() __attribute__((weak));
+extern void loop6() __attribute__((weak));
+extern void loop7() __attribute__((weak));
+extern void loop8() __attribute__((weak));
+
+extern "C" {
+extern const ArduinoTaskDescriptor _arduino_tasks_begin[];
+extern const ArduinoTaskDescriptor _arduino_tasks_end[];
+}
+
+#if (configARDUINO_LOOPS < 1) || (configARDUINO_LOOPS > 8)
+#error "configARDUINO_LOOPS must be between 1 and 8"
+#endif
 
 #define hwUNLOCK_KEY_0                  ( 0xAA996655UL )
 #define hwUNLOCK_KEY_1                  ( 0x556699AAUL )
 
+#define arduinoEXTRA_LOOPS (configARDUINO_LOOPS - 1)
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+static StackType_t arduinoTaskStack[configARDUINO_TASK_STACK_SIZE] portSTATIC_STORAGE;
+static StaticTask_t arduinoTaskBuffer portSTATIC_STORAGE;
+#if (arduinoEXTRA_LOOPS > 0)
+static StackType_t arduinoLoopStack[arduinoEXTRA_LOOPS][configARDUINO_LOOP_STACK_SIZE] portSTATIC_STORAGE;
+static StaticTask_t arduinoLoopBuffer[arduinoEXTRA_LOOPS] portSTATIC_STORAGE;
+#endif
+#endif
+
+static void arduinoLoopTask(void *params) {
+    void (*fn)() = (void (*)())params;
+    while (1) {
+        fn();
+    }
+}
+
+static void startLoopTasks() {
+#if (arduinoEXTRA_LOOPS > 0)
+    static void (* const loops[])() = { loop2, loop3, loop4, loop5, loop6, loop7, loop8 };
+    static const char * const names[] = { "Loop2", "Loop3", "Loop4", "Loop5", "Loop6", "Loop7", "Loop8" };
+
+    for (int i = 0; i < arduinoEXTRA_LOOPS; i++) {
+        if (loops[i] == NULL) continue;
+        TaskHandle_t handle;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+        handle = xTaskCreateStatic(arduinoLoopTask, names[i], configARDUINO_LOOP_STACK_SIZE, (void *)loops[i],
+            configARDUINO_TASK_PRIORITY, arduinoLoopStack[i], &arduinoLoopBuffer[i]);
+#else
+        if (xTaskCreate(arduinoLoopTask, names[i], configARDUINO_LOOP_STACK_SIZE, (void *)loops[i],
+            configARDUINO_TASK_PRIORITY, &handle) != pdPASS) continue;
+#endif
+#if (configUSE_STACKWATCH == 1)
+        stackwatch_register(handle, configARDUINO_LOOP_STACK_SIZE, "configARDUINO_LOOP_STACK_SIZE");
+#endif
+        (void)handle;
+    }
+#endif
+}
+
 static void arduinoTask(void *params) {
     setup();
 
+    startLoopTasks();
+
     while (1) {
         loop();
     }
 }
 
+static void registeredTask(void *params) {
+    const ArduinoTaskDescriptor *desc = (const ArduinoTaskDescriptor *)params;
+    desc->function();
+    vTaskDelete(NULL);
+}
+
+static void startRegisteredTasks() {
+    for (const ArduinoTaskDescriptor *desc = _arduino_tasks_begin; desc < _arduino_tasks_end; desc++) {
+        TaskHandle_t handle = NULL;
+        if ((desc->stackBuffer != NULL) && (desc->taskBuffer != NULL)) {
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+            handle = xTaskCreateStatic(registeredTask, desc->name, desc->stack, (void *)desc,
+                desc->priority, desc->stackBuffer, desc->taskBuffer);
+#endif
+        } else {
+            if (xTaskCreate(registeredTask, desc->name, desc->stack, (void *)desc, desc->priority, &handle) != pdPASS) {
+                handle = NULL;
+            }
+        }
+        if (desc->handle != NULL) {
+            *desc->handle = handle;
+        }
+#if (configUSE_STACKWATCH == 1)
+        if (handle != NULL) {
+            stackwatch_register(handle, desc->stack, NULL);
+        }
+#endif
+    }
+}
+
 void __attribute__ ((nomips16)) _configSystem(uint32_t clk)
 {
     uint32_t    stInt;
@@ -117,6 +211,7 @@ void __attribute__ ((nomips16)) _enableMultiVectorInterrupts()
 #else 
     _CP0_BIS_CAUSE( 0x00800000U );
     INTCONSET = _INTCON_MVEC_MASK;
+    cpu_configure_shadow_sets();
     __builtin_enable_interrupts();
 #endif
 }
@@ -131,7 +226,30 @@ int main() {
 
     init();
 
-    xTaskCreate(arduinoTask, "Arduino", 2048, NULL, tskIDLE_PRIORITY + 2, NULL);
+#if (configUSE_KTRACE == 1)
+    ktrace_init();
+#endif
+
+    TaskHandle_t arduinoTaskHandle;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    arduinoTaskHandle = xTaskCreateStatic(arduinoTask, "Arduino", configARDUINO_TASK_STACK_SIZE, NULL, configARDUINO_TASK_PRIORITY, arduinoTaskStack, &arduinoTaskBuffer);
+#else
+    xTaskCreate(arduinoTask, "Arduino", configARDUINO_TASK_STACK_SIZE, NULL, configARDUINO_TASK_PRIORITY, &arduinoTaskHandle);
+#endif
+
+    startRegisteredTasks();
+
+#if (configUSE_WORKQUEUE == 1)
+    workqueue_start();
+#endif
+#if (configUSE_HTIMER == 1)
+    htimer_start_service();
+#endif
+
+#if (configUSE_STACKWATCH == 1)
+    stackwatch_register(arduinoTaskHandle, configARDUINO_TASK_STACK_SIZE, "configARDUINO_TASK_STACK_SIZE");
+    stackwatch_start();
+#endif
     
     vTaskStartScheduler();
 
@@ -0,0 +1,173 @@
+/**
+ * @file num_format.c
+ * Number to text conversion for Print and String.
+ *
+ * Decimal digits come out two at a time from a table of digit pairs, so a
+ * 32-bit number takes at most five divisions by 100, which the compiler
+ * turns into a multiply. Bases that are powers of two are done with shifts
+ * and masks. Floats are rounded once, by scaling the fraction to a whole
+ * number of the requested decimal places, rather than taking a double
+ * multiply and cast for every digit.
+ */
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "num_format.h"
+
+static const char numDigitPairs[200] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const char numDigits[36] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+static const uint32_t numPowersOf10[10] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+static uint8_t num_decimal_digits(uint32_t value) {
+    uint8_t n = 1;
+    while ((n < 10) && (value >= numPowersOf10[n])) n++;
+    return n;
+}
+
+// Write value as exactly width decimal digits, zero padded, ending at end
+static void num_put_decimal(char *end, uint32_t value, uint8_t width) {
+    while (width >= 2) {
+        uint32_t q = value / 100;
+        end -= 2;
+        memcpy(end, &numDigitPairs[(value - q * 100) * 2], 2);
+        value = q;
+        width -= 2;
+    }
+    if (width) *--end = '0' + value;
+}
+
+/**
+ * Write an unsigned number as text
+ * @param buf The buffer to write to, at least NUM_FORMAT_INT_SIZE bytes
+ * @param value The number
+ * @param base The base, from 2 to 36 (anything else is taken as 10)
+ * @returns The number of characters written, not counting the terminating zero
+ */
+size_t num_format_u32(char *buf, uint32_t value, uint8_t base) {
+    size_t len;
+
+    if ((base < 2) || (base > 36)) base = 10;
+
+    if (base == 10) {
+        len = num_decimal_digits(value);
+        num_put_decimal(buf + len, value, len);
+    } else if ((base & (base - 1)) == 0) {
+        uint8_t shift = __builtin_ctz(base);
+        uint8_t bits = (value == 0) ? 1 : 32 - __builtin_clz(value);
+        len = (bits + shift - 1) / shift;
+        char *p = buf + len;
+        while (p > buf) {
+            *--p = numDigits[value & (base - 1)];
+            value >>= shift;
+        }
+    } else {
+        char rev[32];
+        uint8_t n = 0;
+        do {
+            uint32_t q = value / base;
+            rev[n++] = numDigits[value - q * base];
+            value = q;
+        } while (value);
+        for (len = 0; n > 0; len++) buf[len] = rev[--n];
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+/**
+ * Write a signed number as text. Only base 10 has a sign: in any other base
+ * the bits are written as an unsigned number.
+ * @param buf The buffer to write to, at least NUM_FORMAT_INT_SIZE bytes
+ * @param value The number
+ * @param base The base, from 2 to 36 (anything else is taken as 10)
+ * @returns The number of characters written, not counting the terminating zero
+ */
+size_t num_format_i32(char *buf, int32_t value, uint8_t base) {
+    if ((value < 0) && ((base == 10) || (base < 2) || (base > 36))) {
+        buf[0] = '-';
+        return 1 + num_format_u32(buf + 1, 0u - (uint32_t)value, 10);
+    }
+    return num_format_u32(buf, (uint32_t)value, base);
+}
+
+// Decimal text of a whole number too big for 32 bits. The 64-bit divide
+// is only paid for values past 32 bits.
+static size_t num_format_u64(char *buf, uint64_t value) {
+    if (value <= UINT32_MAX) return num_format_u32(buf, (uint32_t)value, 10);
+    uint64_t high = value / 1000000000;
+    size_t len = num_format_u64(buf, high);
+    num_put_decimal(buf + len + 9, (uint32_t)(value - high * 1000000000), 9);
+    buf[len + 9] = '\0';
+    return len + 9;
+}
+
+/**
+ * Write a number in fixed point, rounded half up to the given number of
+ * decimal places. NaN and infinities are written as "nan" and "inf", and
+ * numbers of 1.8e19 or more as "ovf".
+ * @param buf The buffer to write to, at least NUM_FORMAT_FLOAT_SIZE bytes
+ * @param value The number
+ * @param digits The number of decimal places, at most NUM_FORMAT_FLOAT_DIGITS
+ * @returns The number of characters written, not counting the terminating zero
+ */
+size_t num_format_float(char *buf, double value, uint8_t digits) {
+    char *p = buf;
+
+    if (isnan(value)) {
+        strcpy(buf, "nan");
+        return 3;
+    }
+    if (isinf(value)) {
+        strcpy(buf, "inf");
+        return 3;
+    }
+    if (value < 0.0) {
+        *p++ = '-';
+        value = -value;
+    }
+    if (value >= 1.8e19) {
+        strcpy(p, "ovf");
+        return p - buf + 3;
+    }
+    if (digits > NUM_FORMAT_FLOAT_DIGITS) digits = NUM_FORMAT_FLOAT_DIGITS;
+
+    // Taking the whole part off is exact, so the only rounding is the scale
+    uint64_t whole = (uint64_t)value;
+    uint64_t frac = 0;
+    if (digits > 0) {
+        uint64_t scale = numPowersOf10[digits > 9 ? 9 : digits];
+        if (digits > 9) scale *= numPowersOf10[digits - 9];
+        frac = (uint64_t)((value - (double)whole) * (double)scale + 0.5);
+        if (frac >= scale) {
+            frac -= scale;
+            whole++;
+        }
+    } else {
+        whole = (uint64_t)(value + 0.5);
+    }
+
+    p += num_format_u64(p, whole);
+    if (digits > 0) {
+        *p++ = '.';
+        if (digits > 9) {
+            uint64_t high = frac / 1000000000;
+            num_put_decimal(p + digits - 9, (uint32_t)high, digits - 9);
+            num_put_decimal(p + digits, (uint32_t)(frac - high * 1000000000), 9);
+        } else {
+            num_put_decimal(p + digits, (uint32_t)frac, digits);
+        }
+        p += digits;
+    }
+    *p = '\0';
+    return p - buf;
+}
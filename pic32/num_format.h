@@ -0,0 +1,27 @@
+#ifndef _NUM_FORMAT_H
+#define _NUM_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Most decimal places num_format_float() writes. Any more would only be
+// noise from the double, so the caller pads with zeros if it wants them.
+#define NUM_FORMAT_FLOAT_DIGITS 18
+
+// Buffer sizes, including the terminating zero
+#define NUM_FORMAT_INT_SIZE 34      // Sign and 32 binary digits
+#define NUM_FORMAT_FLOAT_SIZE (1 + 20 + 1 + NUM_FORMAT_FLOAT_DIGITS + 1)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern size_t num_format_u32(char *buf, uint32_t value, uint8_t base);
+extern size_t num_format_i32(char *buf, int32_t value, uint8_t base);
+extern size_t num_format_float(char *buf, double value, uint8_t digits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,112 @@
+/**
+ * @file amutex.c
+ * Adaptive mutex for very short critical sections. Blocking on a FreeRTOS
+ * mutex costs two context switches even when the holder is about to release
+ * it, so a task that finds the mutex held first spins on the core timer for
+ * a short while, trying again each time round.
+ *
+ * There is only one core, so the holder can only release the mutex during
+ * the spin if it gets to run. The spin therefore yields on each pass, and it
+ * is cut short and the task blocks as soon as the holder is not ready to run
+ * at the spinning task's priority: a holder that is blocked, or of lower
+ * priority, will not finish while we spin, and blocking lends it our
+ * priority through the mutex.
+ */
+#include <p32xxxx.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "sdk/cpu.h"
+#include "sdk/amutex.h"
+
+/**
+ * Create an adaptive mutex
+ * @param m The mutex
+ * @param spinUs How long to spin, in microseconds, before blocking
+ * @returns 1 if the mutex was created, 0 otherwise
+ */
+int amutex_init(amutex_t *m, uint32_t spinUs) {
+    memset(&m->stats, 0, sizeof(amutex_stats_t));
+    m->spin = spinUs * (cpu_get_system_clock() / 2000000);
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    m->mutex = xSemaphoreCreateMutexStatic(&m->mutexBuffer);
+#else
+    m->mutex = xSemaphoreCreateMutex();
+#endif
+    return m->mutex != NULL;
+}
+
+// Whether the holder could release the mutex if we yield to it
+static int amutex_holder_can_run(amutex_t *m) {
+    TaskHandle_t holder = xSemaphoreGetMutexHolder(m->mutex);
+    if (holder == NULL) return 1;
+    return (eTaskGetState(holder) == eReady) && (uxTaskPriorityGet(holder) >= uxTaskPriorityGet(NULL));
+}
+
+/**
+ * Take the mutex
+ * @param m The mutex
+ * @param timeout How long to block, in ticks, once spinning has failed
+ * @returns 1 if the mutex was taken, 0 on timeout
+ */
+int amutex_lock(amutex_t *m, TickType_t timeout) {
+    uint32_t start, now;
+
+    // The statistics are only updated while holding the mutex
+    if (xSemaphoreTake(m->mutex, 0) == pdTRUE) {
+        m->stats.locks++;
+        m->stats.uncontended++;
+        return 1;
+    }
+
+    cpu_ct_read_count(start);
+    now = start;
+    while (((now - start) < m->spin) && amutex_holder_can_run(m)) {
+        taskYIELD();
+        if (xSemaphoreTake(m->mutex, 0) == pdTRUE) {
+            cpu_ct_read_count(now);
+            m->stats.locks++;
+            m->stats.spun++;
+            if ((now - start) > m->stats.spinMax) m->stats.spinMax = now - start;
+            return 1;
+        }
+        cpu_ct_read_count(now);
+    }
+
+    if (xSemaphoreTake(m->mutex, timeout) == pdTRUE) {
+        m->stats.locks++;
+        m->stats.blocked++;
+        return 1;
+    }
+
+    taskENTER_CRITICAL();
+    m->stats.timeouts++;
+    taskEXIT_CRITICAL();
+    return 0;
+}
+
+void amutex_unlock(amutex_t *m) {
+    xSemaphoreGive(m->mutex);
+}
+
+/**
+ * Take a copy of the contention counters
+ * @param m The mutex
+ * @param stats The structure to copy the counters into
+ * @returns 1
+ */
+int amutex_get_stats(amutex_t *m, amutex_stats_t *stats) {
+    taskENTER_CRITICAL();
+    memcpy(stats, &m->stats, sizeof(amutex_stats_t));
+    taskEXIT_CRITICAL();
+    return 1;
+}
+
+void amutex_reset_stats(amutex_t *m) {
+    taskENTER_CRITICAL();
+    memset(&m->stats, 0, sizeof(amutex_stats_t));
+    taskEXIT_CRITICAL();
+}
@@ -11,18 +11,25 @@
 
 #include "sdk/cpu.h"
 #include "sdk/uart.h"
+#include "sdk/isrprof.h"
 
 /**
  * Globally disable all interrupts
  */
 void cpu_disable_interrupts() {
     taskDISABLE_INTERRUPTS();
+#if (configUSE_ISR_PROFILING == 1)
+    isrprof_disable_start(__builtin_return_address(0));
+#endif
 }
 
 /**
  * Globally enable interrupts
  */
 void cpu_enable_interrupts() {
+#if (configUSE_ISR_PROFILING == 1)
+    isrprof_disable_end();
+#endif
     taskENABLE_INTERRUPTS();
 }
 
@@ -171,6 +178,24 @@ void cpu_ct_init(uint32_t initcompare) {
     asm volatile("mtc0 %0, $11" : "+r"(initcompare));
 }
 
+/**
+ * Assign shadow register sets to interrupt priority levels. With
+ * configUSE_SHADOW_REGISTER_SETS set, IPL n uses shadow set n, except for the
+ * kernel interrupt priority which must stay on the normal register set as the
+ * kernel saves and restores the task context from it. Otherwise every level
+ * uses the normal register set. This must be called before interrupts are
+ * enabled.
+ */
+void cpu_configure_shadow_sets() {
+#if defined(__PIC32MZ__)
+#if (configUSE_SHADOW_REGISTER_SETS == 1)
+    PRISS = 0x76543210 & ~(0xFUL << (configKERNEL_INTERRUPT_PRIORITY * 4));
+#else
+    PRISS = 0;
+#endif
+#endif
+}
+
 void __attribute__((nomips16)) cpu_general_exception() {
     cpu_disable_interrupts();
     if (!uart_is_open(0)) {
@@ -0,0 +1,307 @@
+/**
+ * @file edf.c
+ * Earliest deadline first scheduling for periodic tasks, such as control
+ * loops, built on task priorities rather than a change to the kernel.
+ *
+ * Each EDF task has a period, a worst case execution time and a deadline
+ * relative to the start of each period. A task is only created if the total
+ * density of the EDF tasks (the sum of wcet / min(deadline, period)) stays
+ * within configEDF_UTILISATION_LIMIT percent. That is the EDF schedulability
+ * test, so the deadlines are met provided no job runs for longer than its
+ * wcet and the time taken by interrupts and by tasks above the band, such
+ * as the workqueue lanes, is left out of the limit. Tasks below the band,
+ * loop() and the timer task among them by default, do not count.
+ *
+ * The tasks whose job for the current period is waiting to run are ranked
+ * by absolute deadline across the priorities configEDF_PRIORITY_LOW to
+ * configEDF_PRIORITY_HIGH - 1, earliest highest, one priority each. A task
+ * waiting for its next period is left at configEDF_PRIORITY_HIGH, so that
+ * when it is released it preempts the running job just long enough to take
+ * its place in the ranking.
+ *
+ * The task function is an ordinary loop that calls edf_wait_next_period()
+ * at the end of each job:
+ *
+ *     void control(void *params) {
+ *         for (;;) {
+ *             run_control_loop();
+ *             edf_wait_next_period();
+ *         }
+ *     }
+ */
+#include <p32xxxx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "sdk/uart.h"
+#include "sdk/edf.h"
+
+#if (configUSE_EDF == 1)
+
+#if (configEDF_PRIORITY_LOW >= configEDF_PRIORITY_HIGH) || (configEDF_PRIORITY_HIGH >= configMAX_PRIORITIES)
+#error The EDF priority band must lie between configEDF_PRIORITY_LOW and configEDF_PRIORITY_HIGH below configMAX_PRIORITIES
+#endif
+
+// Jobs sharing a priority would run in turn rather than by deadline
+#if (configEDF_MAX_TASKS > configEDF_PRIORITY_HIGH - configEDF_PRIORITY_LOW)
+#error The EDF priority band needs a priority for each of configEDF_MAX_TASKS
+#endif
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1) && !defined(configEDF_STACK_SIZE)
+#define configEDF_STACK_SIZE (configMINIMAL_STACK_SIZE * 2)
+#endif
+
+typedef struct {
+    TaskHandle_t task;
+    TaskFunction_t code;
+    void *params;
+    TickType_t release;                     // Start of the current period
+    TickType_t deadline;                    // Absolute deadline of the current job
+    uint32_t density;                       // Parts per thousand
+    uint8_t waiting;                        // Released and not finished
+    uint8_t inUse;                          // Taken, from admission until the task function returns
+    edf_stats_t stats;
+} edf_task_t;
+
+static edf_task_t edfTask[configEDF_MAX_TASKS];
+static uint8_t edfTasks = 0;
+static uint32_t edfDensity = 0;
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+static StackType_t edfStack[configEDF_MAX_TASKS][configEDF_STACK_SIZE] portSTATIC_STORAGE;
+static StaticTask_t edfTaskBuffer[configEDF_MAX_TASKS] portSTATIC_STORAGE;
+#endif
+
+static edf_task_t *edf_find(TaskHandle_t task) {
+    for (uint8_t i = 0; i < edfTasks; i++) {
+        if (edfTask[i].inUse && (edfTask[i].task == task)) return &edfTask[i];
+    }
+    return NULL;
+}
+
+// Give the waiting jobs their priorities by deadline. The scheduler must
+// be suspended.
+static void edf_rank() {
+    edf_task_t *order[configEDF_MAX_TASKS];
+    uint8_t count = 0;
+
+    for (uint8_t i = 0; i < edfTasks; i++) {
+        edf_task_t *t = &edfTask[i];
+        if (!t->inUse || (t->task == NULL)) continue;
+        if (!t->waiting) {
+            if (uxTaskPriorityGet(t->task) != configEDF_PRIORITY_HIGH) vTaskPrioritySet(t->task, configEDF_PRIORITY_HIGH);
+            continue;
+        }
+        // Insertion sort, earliest deadline first
+        uint8_t j = count++;
+        while ((j > 0) && ((int32_t)(t->deadline - order[j - 1]->deadline) < 0)) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = t;
+    }
+
+    UBaseType_t priority = configEDF_PRIORITY_HIGH - 1;
+    for (uint8_t i = 0; i < count; i++) {
+        if (uxTaskPriorityGet(order[i]->task) != priority) vTaskPrioritySet(order[i]->task, priority);
+        if (priority > configEDF_PRIORITY_LOW) priority--;
+    }
+}
+
+static void edf_task_entry(void *params) {
+    edf_task_t *t = (edf_task_t *)params;
+
+    // Set here as well, as xTaskCreateStatic() only returns the handle
+    // after this task may have run
+    vTaskSuspendAll();
+    t->task = xTaskGetCurrentTaskHandle();
+    edf_rank();
+    xTaskResumeAll();
+    t->code(t->params);
+
+    // The task function returned, so leave the EDF set for good
+    vTaskSuspendAll();
+    t->waiting = 0;
+    t->inUse = 0;
+    edfDensity -= t->density;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    xTaskResumeAll();
+    // The stack and TCB are the slot's, so they must not be reused while the
+    // idle task still has this task to clean up. It waits here instead, and
+    // is deleted by the edf_task_create() that takes the slot next.
+    vTaskSuspend(NULL);
+#else
+    t->task = NULL;
+    xTaskResumeAll();
+    vTaskDelete(NULL);
+#endif
+}
+
+/**
+ * Create a periodic task scheduled by deadline, if the EDF tasks can still
+ * all meet their deadlines with it added. The first job is released
+ * straight away.
+ * @param code The task function, which calls edf_wait_next_period() at the
+ *             end of each job
+ * @param name The task name
+ * @param stack The stack size in words. With static allocation every EDF
+ *              task has a stack of configEDF_STACK_SIZE, and a larger one
+ *              is refused.
+ * @param params Passed to the task function
+ * @param period Ticks between releases
+ * @param wcet The longest a job may run for, in ticks
+ * @param deadline Ticks from each release by which the job must finish, or
+ *                 0 for the end of the period
+ * @param handle Set to the task handle, or NULL
+ * @returns 1 if the task was admitted and created, 0 otherwise
+ */
+int edf_task_create(TaskFunction_t code, const char *name, uint16_t stack, void *params,
+        TickType_t period, TickType_t wcet, TickType_t deadline, TaskHandle_t *handle) {
+    if ((period == 0) || (wcet == 0)) return 0;
+    if ((deadline == 0) || (deadline > period)) deadline = period;
+    if (wcet > deadline) return 0;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    if (stack > configEDF_STACK_SIZE) return 0;
+#endif
+
+    uint32_t density = ((uint64_t)wcet * 1000 + deadline - 1) / deadline;
+    int slot = -1;
+    TaskHandle_t exited = NULL;
+
+    vTaskSuspendAll();
+    if (edfDensity + density <= configEDF_UTILISATION_LIMIT * 10) {
+        for (uint8_t i = 0; i < edfTasks; i++) {
+            if (!edfTask[i].inUse) {
+                slot = i;
+                break;
+            }
+        }
+        if ((slot < 0) && (edfTasks < configEDF_MAX_TASKS)) {
+            slot = edfTasks++;
+        }
+    }
+    if (slot >= 0) {
+        edf_task_t *t = &edfTask[slot];
+        exited = t->task;
+        memset(t, 0, sizeof(edf_task_t));
+        t->inUse = 1;
+        t->code = code;
+        t->params = params;
+        t->density = density;
+        t->stats.period = period;
+        t->stats.wcet = wcet;
+        t->stats.deadline = deadline;
+        t->release = xTaskGetTickCount();
+        t->deadline = t->release + deadline;
+        t->waiting = 1;
+        edfDensity += density;
+    }
+    xTaskResumeAll();
+    if (slot < 0) return 0;
+
+    // It starts at the top of the band and ranks itself when it first runs
+    edf_task_t *t = &edfTask[slot];
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    if (exited != NULL) vTaskDelete(exited);
+    t->task = xTaskCreateStatic(edf_task_entry, name, configEDF_STACK_SIZE, t, configEDF_PRIORITY_HIGH,
+        edfStack[slot], &edfTaskBuffer[slot]);
+    if (t->task == NULL) {
+#else
+    (void)exited;
+    if (xTaskCreate(edf_task_entry, name, stack, t, configEDF_PRIORITY_HIGH, &t->task) != pdPASS) {
+#endif
+        vTaskSuspendAll();
+        t->task = NULL;
+        t->inUse = 0;
+        edfDensity -= density;
+        xTaskResumeAll();
+        return 0;
+    }
+    if (handle != NULL) *handle = t->task;
+    return 1;
+}
+
+/**
+ * End the current job and wait for the next period. Must be called from an
+ * EDF task. If the job overran into the next period, that job starts at
+ * once.
+ */
+void edf_wait_next_period() {
+    edf_task_t *t = edf_find(xTaskGetCurrentTaskHandle());
+    if (t == NULL) return;
+
+    TickType_t now = xTaskGetTickCount();
+    TickType_t previous = t->release;
+
+    vTaskSuspendAll();
+    t->waiting = 0;
+    t->stats.jobs++;
+    if ((now - t->release) > t->stats.responseMax) t->stats.responseMax = now - t->release;
+    if ((int32_t)(now - t->deadline) > 0) t->stats.misses++;
+    t->release += t->stats.period;
+    edf_rank();
+    xTaskResumeAll();
+
+    vTaskDelayUntil(&previous, t->stats.period);
+
+    vTaskSuspendAll();
+    t->deadline = t->release + t->stats.deadline;
+    t->waiting = 1;
+    edf_rank();
+    xTaskResumeAll();
+}
+
+/**
+ * @returns The total density of the admitted EDF tasks, in parts per thousand
+ */
+uint32_t edf_utilisation() {
+    return edfDensity;
+}
+
+/**
+ * Take a copy of the counters for an EDF task
+ * @param index The task number, in order of creation
+ * @param stats The structure to copy the counters into
+ * @returns 1 if the task exists, 0 otherwise
+ */
+int edf_get_stats(uint8_t index, edf_stats_t *stats) {
+    int ok = 0;
+    vTaskSuspendAll();
+    if ((index < edfTasks) && edfTask[index].inUse && (edfTask[index].task != NULL)) {
+        memcpy(stats, &edfTask[index].stats, sizeof(edf_stats_t));
+        ok = 1;
+    }
+    xTaskResumeAll();
+    return ok;
+}
+
+/**
+ * Print the EDF task set and its counters to a UART
+ * @param uart The UART (which must be open) to print to
+ * @returns 1 if the report was printed, 0 otherwise
+ */
+int edf_report(uint8_t uart) {
+    char line[80];
+    edf_stats_t s;
+
+    if (!uart_is_open(uart)) return 0;
+
+    sprintf(line, "EDF density %lu.%lu%% of %u%%\r\n", (unsigned long)(edfDensity / 10),
+        (unsigned long)(edfDensity % 10), configEDF_UTILISATION_LIMIT);
+    uart_write_bytes(uart, (const uint8_t *)line, strlen(line));
+    const char *head = "Task     period  wcet deadline      jobs  misses response max\r\n";
+    uart_write_bytes(uart, (const uint8_t *)head, strlen(head));
+    for (uint8_t i = 0; i < edfTasks; i++) {
+        if (!edf_get_stats(i, &s)) continue;
+        sprintf(line, "%-8s %6lu %5lu %8lu %9lu %7lu %12lu\r\n", pcTaskGetName(edfTask[i].task),
+            (unsigned long)s.period, (unsigned long)s.wcet, (unsigned long)s.deadline,
+            (unsigned long)s.jobs, (unsigned long)s.misses, (unsigned long)s.responseMax);
+        uart_write_bytes(uart, (const uint8_t *)line, strlen(line));
+    }
+    return 1;
+}
+
+#endif
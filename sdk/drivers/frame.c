@@ -0,0 +1,235 @@
+/**
+ * @file frame.c
+ * Binary framing for links such as UARTs: each frame is the payload and a
+ * CRC-16 (CCITT, polynomial 0x1021, initial value 0xFFFF, sent high byte
+ * first), COBS encoded so that it contains no zero bytes, followed by a
+ * zero byte as the delimiter. A receiver that joins part way through, or
+ * loses bytes, is back in step at the next zero. COBS adds one byte per
+ * 254 bytes of payload, where SLIP could double the size of the frame.
+ *
+ * The encoder works a COBS block (at most 254 bytes) at a time and hands
+ * each one to a write function, so a frame can be built up from several
+ * pieces with frame_put() without ever being held whole in memory, and a
+ * UART sees one write per block rather than one per byte.
+ *
+ * The decoder takes one byte at a time, so it can be fed from wherever the
+ * bytes arrive, and reports each frame whose CRC checks out.
+ *
+ * Nothing here touches the hardware, so the codec is also built and tested
+ * on the host (tests/host/test_frame.cpp). Sending and receiving on a UART
+ * is in frame_uart.c.
+ */
+#include <string.h>
+
+#include "sdk/frame.h"
+
+#define frameCRC_INIT 0xFFFF
+
+// Decoder states
+#define frameIDLE 0                 // Nothing since the last delimiter
+#define frameDECODING 1
+#define frameSKIPPING 2             // Waiting for the delimiter after an overrun
+
+static const uint16_t frameCrcTable[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+
+/**
+ * Update a CRC-16 (CCITT, not reflected) over some bytes. Start with
+ * 0xFFFF; the CRC of data followed by its own CRC, high byte first, is 0.
+ * @param crc The CRC so far
+ * @param data The bytes to add
+ * @param len The number of bytes
+ * @returns The updated CRC
+ */
+uint16_t frame_crc16(uint16_t crc, const uint8_t *data, size_t len) {
+    while (len--) {
+        crc = (crc << 8) ^ frameCrcTable[(crc >> 8) ^ *data++];
+    }
+    return crc;
+}
+
+static void frame_flush_block(frame_encoder_t *e) {
+    e->block[0] = e->count;
+    e->write(e->ctx, e->block, e->count);
+    e->count = 1;
+}
+
+static inline void frame_put_byte(frame_encoder_t *e, uint8_t b) {
+    if (b == 0) {
+        frame_flush_block(e);
+        return;
+    }
+    e->block[e->count++] = b;
+    if (e->count == 255) frame_flush_block(e);
+}
+
+/**
+ * Start a frame
+ * @param e The encoder
+ * @param write Called with each piece of the encoded frame
+ * @param ctx Passed to write
+ */
+void frame_begin(frame_encoder_t *e, frame_write_t write, void *ctx) {
+    e->write = write;
+    e->ctx = ctx;
+    e->crc = frameCRC_INIT;
+    e->count = 1;
+}
+
+/**
+ * Add payload bytes to the frame being built
+ * @param e The encoder
+ * @param data The bytes
+ * @param len The number of bytes
+ */
+void frame_put(frame_encoder_t *e, const uint8_t *data, size_t len) {
+    e->crc = frame_crc16(e->crc, data, len);
+    while (len--) frame_put_byte(e, *data++);
+}
+
+/**
+ * Finish the frame with its CRC and the delimiter
+ * @param e The encoder
+ */
+void frame_end(frame_encoder_t *e) {
+    frame_put_byte(e, e->crc >> 8);
+    frame_put_byte(e, e->crc & 0xFF);
+    // The delimiter goes out with the last block
+    e->block[0] = e->count;
+    e->block[e->count] = 0;
+    e->write(e->ctx, e->block, e->count + 1);
+    e->count = 1;
+}
+
+typedef struct {
+    uint8_t *out;
+    size_t size;
+    size_t len;
+} frame_buffer_t;
+
+static void frame_write_buffer(void *ctx, const uint8_t *data, size_t len) {
+    frame_buffer_t *b = (frame_buffer_t *)ctx;
+    if (b->len + len > b->size) {
+        b->size = 0;
+        return;
+    }
+    memcpy(b->out + b->len, data, len);
+    b->len += len;
+}
+
+/**
+ * Frame a payload into a buffer
+ * @param payload The payload
+ * @param len The length of the payload
+ * @param out The buffer for the frame, frameENCODED_SIZE(len) bytes is always enough
+ * @param size The size of the buffer
+ * @returns The length of the frame, or 0 if it did not fit
+ */
+size_t frame_encode(const uint8_t *payload, size_t len, uint8_t *out, size_t size) {
+    frame_encoder_t e;
+    frame_buffer_t b = { out, size, 0 };
+    frame_begin(&e, frame_write_buffer, &b);
+    frame_put(&e, payload, len);
+    frame_end(&e);
+    return (b.size == 0) ? 0 : b.len;
+}
+
+/**
+ * Set up a decoder
+ * @param d The decoder
+ * @param buf Where to assemble frames, which must have room for the largest
+ *            payload plus the two CRC bytes
+ * @param size The size of buf
+ */
+void frame_decoder_init(frame_decoder_t *d, uint8_t *buf, size_t size) {
+    memset(d, 0, sizeof(frame_decoder_t));
+    d->buf = buf;
+    d->size = size;
+    d->state = frameIDLE;
+}
+
+static inline int frame_store(frame_decoder_t *d, uint8_t b) {
+    if (d->len == d->size) {
+        d->stats.overruns++;
+        d->state = frameSKIPPING;
+        return 0;
+    }
+    d->buf[d->len++] = b;
+    return 1;
+}
+
+/**
+ * Feed a received byte to a decoder
+ * @param d The decoder
+ * @param byte The byte
+ * @returns 1 if the byte completed a good frame, whose payload is then the
+ *          first d->length bytes of the decoder's buffer until the next
+ *          byte is fed in, 0 otherwise
+ */
+int frame_decode(frame_decoder_t *d, uint8_t byte) {
+    if (byte == 0) {
+        int ok = 0;
+        if (d->state == frameDECODING) {
+            if ((d->left != 0) || (d->len < 2)) {
+                d->stats.formatErrors++;
+            } else if (frame_crc16(frameCRC_INIT, d->buf, d->len) != 0) {
+                d->stats.crcErrors++;
+            } else {
+                d->length = d->len - 2;
+                d->stats.frames++;
+                ok = 1;
+            }
+        }
+        d->len = 0;
+        d->left = 0;
+        d->state = frameIDLE;
+        return ok;
+    }
+
+    if (d->state == frameSKIPPING) return 0;
+
+    if (d->left == 0) {
+        // A new block. The block before it stood for a zero at its end,
+        // unless it was a full one.
+        if ((d->state == frameDECODING) && (d->code != 0xFF) && !frame_store(d, 0)) return 0;
+        d->state = frameDECODING;
+        d->code = byte;
+        d->left = byte - 1;
+        return 0;
+    }
+
+    if (frame_store(d, byte)) d->left--;
+    return 0;
+}
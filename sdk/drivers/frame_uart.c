@@ -0,0 +1,54 @@
+/**
+ * @file frame_uart.c
+ * Sends and receives the frames of frame.c directly on a UART
+ */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "sdk/uart.h"
+#include "sdk/frame.h"
+
+static void frame_write_uart(void *ctx, const uint8_t *data, size_t len) {
+    uart_write_bytes((uint8_t)(uintptr_t)ctx, data, len);
+}
+
+/**
+ * Send a payload as a frame on a UART. Other tasks writing to the UART at
+ * the same time can land between the blocks of a frame, so one task should
+ * own the UART, or the callers should take turns.
+ * @param uart The UART (which must be open) to send on
+ * @param payload The payload
+ * @param len The length of the payload
+ * @returns 1 if the frame was sent, 0 otherwise
+ */
+int frame_send(uint8_t uart, const uint8_t *payload, size_t len) {
+    frame_encoder_t e;
+
+    if (!uart_is_open(uart)) return 0;
+    frame_begin(&e, frame_write_uart, (void *)(uintptr_t)uart);
+    frame_put(&e, payload, len);
+    frame_end(&e);
+    return 1;
+}
+
+/**
+ * Wait for the next good frame from a UART, sleeping while no data is
+ * arriving. Bytes after the frame stay in the UART's receive buffer.
+ * @param uart The UART (which must be open) to receive from
+ * @param d The decoder
+ * @param timeout The longest to wait, in ticks
+ * @returns 1 if a frame arrived, which is in the decoder's buffer, 0 on timeout
+ */
+int frame_receive(uint8_t uart, frame_decoder_t *d, TickType_t timeout) {
+    TimeOut_t start;
+    int c;
+
+    vTaskSetTimeOutState(&start);
+    for (;;) {
+        while ((c = uart_read(uart)) >= 0) {
+            if (frame_decode(d, c)) return 1;
+        }
+        if (xTaskCheckForTimeOut(&start, &timeout) == pdTRUE) return 0;
+        uart_wait_rx(uart, timeout);
+    }
+}
@@ -6,9 +6,12 @@
 #include <p32xxxx.h>
 #include <sys/attribs.h>
 
+#include "FreeRTOS.h"
+
 #include "sdk/gpio.h"
 #include "sdk/chipspec.h"
 #include "sdk/cpu.h"
+#include "sdk/isrprof.h"
 
 struct cnInterruptCallback {
     gpioISR_t fallingEdge;
@@ -528,34 +531,45 @@ int gpio_disconnect_external_interrupt(uint8_t interrupt) {
 }
 
 
-void __ISR(_EXTERNAL_0_VECTOR, IPL6AUTO) gpio_ext_0() {
+void __ISR(_EXTERNAL_0_VECTOR, cpuISR_IPL6) gpio_ext_0() {
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(_EXTERNAL_0_VECTOR);
     if (externalInterrupt[0] != NULL) externalInterrupt[0]();
+    isrprof_exit(_EXTERNAL_0_VECTOR, 6, start);
 }
 
-void __ISR(_EXTERNAL_1_VECTOR, IPL6AUTO) gpio_ext_1() {
+void __ISR(_EXTERNAL_1_VECTOR, cpuISR_IPL6) gpio_ext_1() {
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(_EXTERNAL_1_VECTOR);
     if (externalInterrupt[1] != NULL) externalInterrupt[1]();
+    isrprof_exit(_EXTERNAL_1_VECTOR, 6, start);
 }
 
-void __ISR(_EXTERNAL_2_VECTOR, IPL6AUTO) gpio_ext_2() {
+void __ISR(_EXTERNAL_2_VECTOR, cpuISR_IPL6) gpio_ext_2() {
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(_EXTERNAL_2_VECTOR);
     if (externalInterrupt[2] != NULL) externalInterrupt[2]();
+    isrprof_exit(_EXTERNAL_2_VECTOR, 6, start);
 }
 
-void __ISR(_EXTERNAL_3_VECTOR, IPL6AUTO) gpio_ext_3() {
+void __ISR(_EXTERNAL_3_VECTOR, cpuISR_IPL6) gpio_ext_3() {
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(_EXTERNAL_3_VECTOR);
     if (externalInterrupt[3] != NULL) externalInterrupt[3]();
+    isrprof_exit(_EXTERNAL_3_VECTOR, 6, start);
 }
 
-void __ISR(_EXTERNAL_4_VECTOR, IPL6AUTO) gpio_ext_4() {
+void __ISR(_EXTERNAL_4_VECTOR, cpuISR_IPL6) gpio_ext_4() {
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(_EXTERNAL_4_VECTOR);
     if (externalInterrupt[4] != NULL) externalInterrupt[4]();
+    isrprof_exit(_EXTERNAL_4_VECTOR, 6, start);
 }
 
 #if defined(_CHANGE_NOTICE_A_VECTOR)
-void __ISR(_CHANGE_NOTICE_A_VECTOR, IPL6AUTO) gpio_cn_a() {
+void __ISR(_CHANGE_NOTICE_A_VECTOR, cpuISR_IPL6) gpio_cn_a() {
     static uint32_t storedState = 0;
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(_CHANGE_NOTICE_A_VECTOR);
 
     uint32_t currentState = PORTA & CNENA;
@@ -574,12 +588,14 @@ void __ISR(_CHANGE_NOTICE_A_VECTOR, IPL6AUTO) gpio_cn_a() {
         }
         bit <<= 1;
     }
+    isrprof_exit(_CHANGE_NOTICE_A_VECTOR, 6, start);
 }
 #endif
 
 #if defined(_CHANGE_NOTICE_B_VECTOR)
-void __ISR(_CHANGE_NOTICE_B_VECTOR, IPL6AUTO) gpio_cn_b() {
+void __ISR(_CHANGE_NOTICE_B_VECTOR, cpuISR_IPL6) gpio_cn_b() {
     static uint32_t storedState = 0;
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(_CHANGE_NOTICE_B_VECTOR);
 
     uint32_t currentState = PORTB & CNENB;
@@ -598,12 +614,14 @@ void __ISR(_CHANGE_NOTICE_B_VECTOR, IPL6AUTO) gpio_cn_b() {
         }
         bit <<= 1;
     }
+    isrprof_exit(_CHANGE_NOTICE_B_VECTOR, 6, start);
 }
 #endif
 
 #if defined(_CHANGE_NOTICE_C_VECTOR)
-void __ISR(_CHANGE_NOTICE_C_VECTOR, IPL6AUTO) gpio_cn_c() {
+void __ISR(_CHANGE_NOTICE_C_VECTOR, cpuISR_IPL6) gpio_cn_c() {
     static uint32_t storedState = 0;
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(_CHANGE_NOTICE_C_VECTOR);
 
     uint32_t currentState = PORTC & CNENC;
@@ -622,12 +640,14 @@ void __ISR(_CHANGE_NOTICE_C_VECTOR, IPL6AUTO) gpio_cn_c() {
         }
         bit <<= 1;
     }
+    isrprof_exit(_CHANGE_NOTICE_C_VECTOR, 6, start);
 }
 #endif
 
 #if defined(_CHANGE_NOTICE_D_VECTOR)
-void __ISR(_CHANGE_NOTICE_D_VECTOR, IPL6AUTO) gpio_cn_d() {
+void __ISR(_CHANGE_NOTICE_D_VECTOR, cpuISR_IPL6) gpio_cn_d() {
     static uint32_t storedState = 0;
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(_CHANGE_NOTICE_D_VECTOR);
 
     uint32_t currentState = PORTD & CNEND;
@@ -646,12 +666,14 @@ void __ISR(_CHANGE_NOTICE_D_VECTOR, IPL6AUTO) gpio_cn_d() {
         }
         bit <<= 1;
     }
+    isrprof_exit(_CHANGE_NOTICE_D_VECTOR, 6, start);
 }
 #endif
 
 #if defined(_CHANGE_NOTICE_E_VECTOR)
-void __ISR(_CHANGE_NOTICE_E_VECTOR, IPL6AUTO) gpio_cn_e() {
+void __ISR(_CHANGE_NOTICE_E_VECTOR, cpuISR_IPL6) gpio_cn_e() {
     static uint32_t storedState = 0;
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(_CHANGE_NOTICE_E_VECTOR);
 
     uint32_t currentState = PORTE & CNENE;
@@ -670,12 +692,14 @@ void __ISR(_CHANGE_NOTICE_E_VECTOR, IPL6AUTO) gpio_cn_e() {
         }
         bit <<= 1;
     }
+    isrprof_exit(_CHANGE_NOTICE_E_VECTOR, 6, start);
 }
 #endif
 
 #if defined(_CHANGE_NOTICE_F_VECTOR)
-void __ISR(_CHANGE_NOTICE_F_VECTOR, IPL6AUTO) gpio_cn_f() {
+void __ISR(_CHANGE_NOTICE_F_VECTOR, cpuISR_IPL6) gpio_cn_f() {
     static uint32_t storedState = 0;
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(_CHANGE_NOTICE_F_VECTOR);
 
     uint32_t currentState = PORTF & CNENF;
@@ -694,12 +718,14 @@ void __ISR(_CHANGE_NOTICE_F_VECTOR, IPL6AUTO) gpio_cn_f() {
         }
         bit <<= 1;
     }
+    isrprof_exit(_CHANGE_NOTICE_F_VECTOR, 6, start);
 }
 #endif
 
 #if defined(_CHANGE_NOTICE_G_VECTOR)
-void __ISR(_CHANGE_NOTICE_G_VECTOR, IPL6AUTO) gpio_cn_g() {
+void __ISR(_CHANGE_NOTICE_G_VECTOR, cpuISR_IPL6) gpio_cn_g() {
     static uint32_t storedState = 0;
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(_CHANGE_NOTICE_G_VECTOR);
 
     uint32_t currentState = PORTG & CNENG;
@@ -718,12 +744,14 @@ void __ISR(_CHANGE_NOTICE_G_VECTOR, IPL6AUTO) gpio_cn_g() {
         }
         bit <<= 1;
     }
+    isrprof_exit(_CHANGE_NOTICE_G_VECTOR, 6, start);
 }
 #endif
 
 #if defined(_CHANGE_NOTICE_H_VECTOR)
-void __ISR(_CHANGE_NOTICE_H_VECTOR, IPL6AUTO) gpio_cn_h() {
+void __ISR(_CHANGE_NOTICE_H_VECTOR, cpuISR_IPL6) gpio_cn_h() {
     static uint32_t storedState = 0;
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(_CHANGE_NOTICE_H_VECTOR);
 
     uint32_t currentState = PORTH & CNENH;
@@ -742,12 +770,14 @@ void __ISR(_CHANGE_NOTICE_H_VECTOR, IPL6AUTO) gpio_cn_h() {
         }
         bit <<= 1;
     }
+    isrprof_exit(_CHANGE_NOTICE_H_VECTOR, 6, start);
 }
 #endif
 
 #if defined(_CHANGE_NOTICE_J_VECTOR)
-void __ISR(_CHANGE_NOTICE_J_VECTOR, IPL6AUTO) gpio_cn_j() {
+void __ISR(_CHANGE_NOTICE_J_VECTOR, cpuISR_IPL6) gpio_cn_j() {
     static uint32_t storedState = 0;
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(_CHANGE_NOTICE_J_VECTOR);
 
     uint32_t currentState = PORTJ & CNENJ;
@@ -766,12 +796,14 @@ void __ISR(_CHANGE_NOTICE_J_VECTOR, IPL6AUTO) gpio_cn_j() {
         }
         bit <<= 1;
     }
+    isrprof_exit(_CHANGE_NOTICE_J_VECTOR, 6, start);
 }
 #endif
 
 #if defined(_CHANGE_NOTICE_K_VECTOR)
-void __ISR(_CHANGE_NOTICE_K_VECTOR, IPL6AUTO) gpio_cn_k() {
+void __ISR(_CHANGE_NOTICE_K_VECTOR, cpuISR_IPL6) gpio_cn_k() {
     static uint32_t storedState = 0;
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(_CHANGE_NOTICE_K_VECTOR);
 
     uint32_t currentState = PORTK & CNENK;
@@ -790,6 +822,7 @@ void __ISR(_CHANGE_NOTICE_K_VECTOR, IPL6AUTO) gpio_cn_k() {
         }
         bit <<= 1;
     }
+    isrprof_exit(_CHANGE_NOTICE_K_VECTOR, 6, start);
 }
 #endif
 
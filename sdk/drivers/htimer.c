@@ -0,0 +1,383 @@
+/**
+ * @file htimer.c
+ * Timer service for applications with many timers running at once, such as
+ * protocol retransmits. The FreeRTOS timer task keeps its active timers in a
+ * sorted list, so starting or resetting one walks the list, and it takes one
+ * command from a short queue per wake. Here the active timers are kept in a
+ * binary min-heap ordered by expiry time. Each timer records its position in
+ * the heap, so starting, stopping and resetting are all O(log n) and the
+ * next timer due is always at the root. The heap itself is in
+ * htimer_heap.c.
+ *
+ * Tasks and interrupts send start and stop commands through a queue of
+ * configHTIMER_QUEUE_LENGTH to the service task, which takes every command
+ * waiting each time it wakes before running the callbacks of the timers
+ * that have expired. The expiry time is worked out when the command is sent,
+ * so time spent in the queue does not delay the timer.
+ *
+ * With configUSE_HTIMER_HIRES set there is also a second heap of high
+ * resolution timers, timed in core timer counts and set in microseconds. The
+ * next one due is programmed into Timer2/3 as a 32-bit one-shot, and their
+ * callbacks run in the Timer3 interrupt at IPL3, so they may use the FromISR
+ * API. They can be started and stopped from tasks and from interrupts up to
+ * configMAX_SYSCALL_INTERRUPT_PRIORITY. Periods shorter than
+ * configHTIMER_HIRES_MIN_PERIOD_US are refused, and a periodic timer that
+ * falls more than a period behind skips the periods it missed rather than
+ * running its callback for each of them, so the interrupt cannot get stuck
+ * catching up.
+ */
+#include <p32xxxx.h>
+#include <sys/attribs.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "sdk/cpu.h"
+#include "sdk/htimer.h"
+#include "sdk/htimer_heap.h"
+#include "sdk/isrprof.h"
+#if (configUSE_STACKWATCH == 1)
+#include "sdk/stackwatch.h"
+#endif
+
+#if (configUSE_HTIMER == 1)
+
+#if (configHTIMER_MAX_TIMERS >= htimerINACTIVE) || (configHTIMER_HIRES_MAX_TIMERS >= htimerINACTIVE)
+#error Too many timers for a 16-bit heap index
+#endif
+
+typedef struct {
+    htimer_t *timer;
+    uint32_t expiry;
+    uint32_t period;
+    uint8_t op;
+} htimer_command_t;
+
+static htimer_t *htimerNode[configHTIMER_MAX_TIMERS];
+static htimer_heap_t htimerHeap = { htimerNode, 0, configHTIMER_MAX_TIMERS };
+static QueueHandle_t htimerQueue = NULL;
+static TaskHandle_t htimerTask = NULL;
+static htimer_stats_t htimerStats;
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+static StackType_t htimerStack[configHTIMER_STACK_SIZE] portSTATIC_STORAGE;
+static StaticTask_t htimerTaskBuffer portSTATIC_STORAGE;
+static uint8_t htimerQueueStorage[configHTIMER_QUEUE_LENGTH * sizeof(htimer_command_t)] portSTATIC_STORAGE;
+static StaticQueue_t htimerQueueBuffer portSTATIC_STORAGE;
+#endif
+
+static void htimer_service(void *params) {
+    (void)params;
+    htimer_command_t cmd;
+
+    for (;;) {
+        TickType_t wait = portMAX_DELAY;
+        if (htimerHeap.count > 0) {
+            int32_t due = (int32_t)(htimerHeap.node[0]->expiry - xTaskGetTickCount());
+            wait = (due > 0) ? (TickType_t)due : 0;
+        }
+
+        if (xQueueReceive(htimerQueue, &cmd, wait) == pdTRUE) {
+            uint32_t batch = 0;
+            do {
+                if (!htimer_heap_apply(&htimerHeap, cmd.timer, cmd.op, cmd.expiry, cmd.period)) {
+                    htimerStats.overflows++;
+                }
+                batch++;
+            } while (xQueueReceive(htimerQueue, &cmd, 0) == pdTRUE);
+
+            taskENTER_CRITICAL();
+            htimerStats.commands += batch;
+            htimerStats.batches++;
+            if (batch > htimerStats.maxBatch) htimerStats.maxBatch = batch;
+            htimerStats.active = htimerHeap.count;
+            if (htimerHeap.count > htimerStats.maxActive) htimerStats.maxActive = htimerHeap.count;
+            taskEXIT_CRITICAL();
+        }
+
+        TickType_t now = xTaskGetTickCount();
+        while ((htimerHeap.count > 0) && ((int32_t)(now - htimerHeap.node[0]->expiry) >= 0)) {
+            htimer_t *timer = htimer_heap_pop_expired(&htimerHeap);
+            timer->callback(timer, timer->arg);
+            htimerStats.fired++;
+        }
+        htimerStats.active = htimerHeap.count;
+    }
+}
+
+/**
+ * Start a timer from a task. Starting a timer that is already running
+ * restarts it with the new delay and period.
+ * @param timer The timer
+ * @param delay Ticks from now until the callback is first run
+ * @param period Ticks between runs after that, or 0 to run once
+ * @param wait How long to wait, in ticks, for room in the command queue
+ * @returns 1 if the command was queued, 0 otherwise
+ */
+int htimer_start(htimer_t *timer, TickType_t delay, TickType_t period, TickType_t wait) {
+    if ((htimerQueue == NULL) || (timer->callback == NULL)) return 0;
+    htimer_command_t cmd = { timer, xTaskGetTickCount() + delay, period, htimerCMD_START };
+    return xQueueSend(htimerQueue, &cmd, wait) == pdTRUE;
+}
+
+/**
+ * Start a timer from an interrupt handler
+ * @param timer The timer
+ * @param delay Ticks from now until the callback is first run
+ * @param period Ticks between runs after that, or 0 to run once
+ * @param woken Set to pdTRUE if the service task should run when the
+ *              interrupt returns
+ * @returns 1 if the command was queued, 0 if the queue was full
+ */
+int htimer_start_from_isr(htimer_t *timer, TickType_t delay, TickType_t period, BaseType_t *woken) {
+    if ((htimerQueue == NULL) || (timer->callback == NULL)) return 0;
+    htimer_command_t cmd = { timer, xTaskGetTickCountFromISR() + delay, period, htimerCMD_START };
+    return xQueueSendFromISR(htimerQueue, &cmd, woken) == pdTRUE;
+}
+
+/**
+ * Stop a timer from a task. Stopping a timer that is not running does
+ * nothing.
+ * @param timer The timer
+ * @param wait How long to wait, in ticks, for room in the command queue
+ * @returns 1 if the command was queued, 0 otherwise
+ */
+int htimer_stop(htimer_t *timer, TickType_t wait) {
+    if (htimerQueue == NULL) return 0;
+    htimer_command_t cmd = { timer, 0, 0, htimerCMD_STOP };
+    return xQueueSend(htimerQueue, &cmd, wait) == pdTRUE;
+}
+
+/**
+ * Stop a timer from an interrupt handler
+ * @param timer The timer
+ * @param woken Set to pdTRUE if the service task should run when the
+ *              interrupt returns
+ * @returns 1 if the command was queued, 0 if the queue was full
+ */
+int htimer_stop_from_isr(htimer_t *timer, BaseType_t *woken) {
+    if (htimerQueue == NULL) return 0;
+    htimer_command_t cmd = { timer, 0, 0, htimerCMD_STOP };
+    return xQueueSendFromISR(htimerQueue, &cmd, woken) == pdTRUE;
+}
+
+/**
+ * Check whether a timer is running. Commands still waiting in the queue are
+ * not taken into account.
+ * @param timer The timer
+ * @returns 1 if the timer is in a heap, 0 otherwise
+ */
+int htimer_is_active(htimer_t *timer) {
+    return timer->index != htimerINACTIVE;
+}
+
+/**
+ * Take a copy of the service counters
+ * @param stats The structure to copy the counters into
+ * @returns 1
+ */
+int htimer_get_stats(htimer_stats_t *stats) {
+    taskENTER_CRITICAL();
+    memcpy(stats, &htimerStats, sizeof(htimer_stats_t));
+    taskEXIT_CRITICAL();
+    return 1;
+}
+
+#if (configUSE_HTIMER_HIRES == 1)
+
+#define htimerHIRES_IPL 3
+
+#if (htimerHIRES_IPL > configMAX_SYSCALL_INTERRUPT_PRIORITY)
+#error The high resolution timer interrupt must be able to use the FreeRTOS API
+#endif
+
+#ifndef configHTIMER_HIRES_MIN_PERIOD_US
+#define configHTIMER_HIRES_MIN_PERIOD_US 20
+#endif
+
+static htimer_t *htimerHiresNode[configHTIMER_HIRES_MAX_TIMERS];
+static htimer_heap_t htimerHiresHeap = { htimerHiresNode, 0, configHTIMER_HIRES_MAX_TIMERS };
+static uint32_t htimerCoreHz;       // Core timer, which the expiry times are in
+static uint32_t htimerTimerHz;      // Timer2/3 input clock
+
+static uint32_t htimer_timer_clock() {
+#if defined(__PIC32MZ__)
+    return cpu_get_system_clock() / (PB3DIVbits.PBDIV + 1);
+#else
+    return cpu_get_peripheral_clock();
+#endif
+}
+
+static void htimer_hires_init() {
+    htimerCoreHz = cpu_get_system_clock() / 2;
+    htimerTimerHz = htimer_timer_clock();
+
+    // Timer2 and Timer3 as one 32-bit timer, 1:1 prescale, interrupting from Timer3
+    T2CON = 0;
+    T3CON = 0;
+    T2CONSET = _T2CON_T32_MASK;
+    TMR2 = 0;
+    PR2 = 0xFFFFFFFF;
+    cpu_clear_interrupt_flag(_TIMER_3_VECTOR);
+    cpu_set_interrupt_priority(_TIMER_3_VECTOR, htimerHIRES_IPL, 0);
+    cpu_set_interrupt_enable(_TIMER_3_VECTOR);
+}
+
+// Program the one-shot for the timer at the root. Interrupts up to
+// htimerHIRES_IPL must be masked.
+static void htimer_hires_arm() {
+    uint32_t now;
+
+    T2CONCLR = _T2CON_ON_MASK;
+    cpu_clear_interrupt_flag(_TIMER_3_VECTOR);
+    if (htimerHiresHeap.count == 0) return;
+
+    cpu_ct_read_count(now);
+    int32_t due = (int32_t)(htimerHiresHeap.node[0]->expiry - now);
+    uint32_t ticks = (due > 0) ? (uint32_t)(((uint64_t)due * htimerTimerHz) / htimerCoreHz) : 0;
+    if (ticks == 0) {
+        // Already due, so take the interrupt as soon as the mask is lifted
+        cpu_set_interrupt_flag(_TIMER_3_VECTOR);
+        return;
+    }
+    TMR2 = 0;
+    PR2 = ticks;
+    T2CONSET = _T2CON_ON_MASK;
+}
+
+/**
+ * Start a high resolution timer, or restart it if it is running. The
+ * callback runs in an interrupt at IPL3; it may wake tasks with the FromISR
+ * API, passing NULL for the woken flag, as the handler requests a context
+ * switch whenever it has run a callback.
+ * @param timer The timer
+ * @param us Microseconds from now until the callback is first run, at most
+ *           2^31 core timer counts (about 21 seconds at 200MHz)
+ * @param periodUs Microseconds between runs after that, at least
+ *                 configHTIMER_HIRES_MIN_PERIOD_US, or 0 to run once
+ * @returns 1 if the timer was started, 0 if the time is too long, the period
+ *          too short, the heap is full or the service has not been started
+ */
+int htimer_hires_start(htimer_t *timer, uint32_t us, uint32_t periodUs) {
+    uint32_t now;
+
+    if ((htimerCoreHz == 0) || (timer->callback == NULL)) return 0;
+    if ((periodUs != 0) && (periodUs < configHTIMER_HIRES_MIN_PERIOD_US)) return 0;
+    uint64_t delay = ((uint64_t)us * htimerCoreHz) / 1000000;
+    uint64_t period = ((uint64_t)periodUs * htimerCoreHz) / 1000000;
+    if ((delay > INT32_MAX) || (period > INT32_MAX)) return 0;
+
+    UBaseType_t status = taskENTER_CRITICAL_FROM_ISR();
+    cpu_ct_read_count(now);
+    int ok = htimer_heap_apply(&htimerHiresHeap, timer, htimerCMD_START, now + (uint32_t)delay, (uint32_t)period);
+    if (ok) {
+        htimer_hires_arm();
+    }
+    taskEXIT_CRITICAL_FROM_ISR(status);
+    return ok;
+}
+
+/**
+ * Stop a high resolution timer
+ * @param timer The timer
+ * @returns 1
+ */
+int htimer_hires_stop(htimer_t *timer) {
+    UBaseType_t status = taskENTER_CRITICAL_FROM_ISR();
+    if (timer->index != htimerINACTIVE) {
+        int root = (timer->index == 0);
+        htimer_heap_remove(&htimerHiresHeap, timer);
+        if (root) {
+            htimer_hires_arm();
+        }
+    }
+    taskEXIT_CRITICAL_FROM_ISR(status);
+    return 1;
+}
+
+void __ISR(_TIMER_3_VECTOR, cpuISR_IPL3) htimer_hires_isr() {
+    isrprof_enter(start);
+    uint32_t now;
+    BaseType_t ran = pdFALSE;
+
+    T2CONCLR = _T2CON_ON_MASK;
+    cpu_clear_interrupt_flag(_TIMER_3_VECTOR);
+
+    UBaseType_t status = taskENTER_CRITICAL_FROM_ISR();
+    cpu_ct_read_count(now);
+    while ((htimerHiresHeap.count > 0) && ((int32_t)(now - htimerHiresHeap.node[0]->expiry) >= 0)) {
+        htimer_t *timer = htimerHiresHeap.node[0];
+        uint32_t late = now - timer->expiry;
+        if ((timer->period != 0) && (late >= timer->period)) {
+            // Run once for the periods missed, and go on from the next one due
+            uint32_t missed = late / timer->period;
+            timer->expiry += missed * timer->period;
+            htimerStats.missed += missed;
+        }
+        timer = htimer_heap_pop_expired(&htimerHiresHeap);
+        timer->callback(timer, timer->arg);
+        ran = pdTRUE;
+        cpu_ct_read_count(now);
+    }
+    htimer_hires_arm();
+    taskEXIT_CRITICAL_FROM_ISR(status);
+
+    isrprof_exit(_TIMER_3_VECTOR, htimerHIRES_IPL, start);
+    portEND_SWITCHING_ISR(ran);
+}
+
+#else
+
+int htimer_hires_start(htimer_t *timer, uint32_t us, uint32_t periodUs) {
+    (void)timer;
+    (void)us;
+    (void)periodUs;
+    return 0;
+}
+
+int htimer_hires_stop(htimer_t *timer) {
+    (void)timer;
+    return 0;
+}
+
+#endif
+
+/**
+ * Create the service task and its command queue, and set up Timer2/3 if
+ * high resolution timers are enabled
+ * @returns 1 if the service was started, 0 otherwise
+ */
+int htimer_start_service() {
+    if (htimerTask != NULL) return 0;
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    htimerQueue = xQueueCreateStatic(configHTIMER_QUEUE_LENGTH, sizeof(htimer_command_t), htimerQueueStorage, &htimerQueueBuffer);
+#else
+    htimerQueue = xQueueCreate(configHTIMER_QUEUE_LENGTH, sizeof(htimer_command_t));
+#endif
+    if (htimerQueue == NULL) return 0;
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    htimerTask = xTaskCreateStatic(htimer_service, "HTimer", configHTIMER_STACK_SIZE, NULL,
+        configHTIMER_TASK_PRIORITY, htimerStack, &htimerTaskBuffer);
+    if (htimerTask == NULL) return 0;
+#else
+    if (xTaskCreate(htimer_service, "HTimer", configHTIMER_STACK_SIZE, NULL,
+            configHTIMER_TASK_PRIORITY, &htimerTask) != pdPASS) {
+        htimerTask = NULL;
+        return 0;
+    }
+#endif
+#if (configUSE_STACKWATCH == 1)
+    stackwatch_register(htimerTask, configHTIMER_STACK_SIZE, "configHTIMER_STACK_SIZE");
+#endif
+
+#if (configUSE_HTIMER_HIRES == 1)
+    htimer_hires_init();
+#endif
+    return 1;
+}
+
+#endif
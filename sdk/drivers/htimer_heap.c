@@ -0,0 +1,134 @@
+/**
+ * @file htimer_heap.c
+ * The binary min-heap of htimer.c, ordered by expiry time. Each timer keeps
+ * its position in the heap, so a timer anywhere in it can be stopped or
+ * moved in O(log n) without searching for it. Expiry times are compared as
+ * the signed difference, so the order holds across the wrap of the count
+ * as long as no two timers are more than 2^31 apart.
+ */
+#include "FreeRTOS.h"
+
+#include "sdk/htimer_heap.h"
+
+#if (configUSE_HTIMER == 1)
+
+static inline int htimer_before(const htimer_t *a, const htimer_t *b) {
+    return (int32_t)(a->expiry - b->expiry) < 0;
+}
+
+static inline void htimer_place(htimer_heap_t *heap, htimer_t *timer, uint16_t i) {
+    heap->node[i] = timer;
+    timer->index = i;
+}
+
+/**
+ * Move the timer at a position up towards the root until its parent is due
+ * no later than it is, keeping each timer's index up to date
+ * @param heap The heap
+ * @param i The position of the timer
+ */
+void htimer_sift_up(htimer_heap_t *heap, uint16_t i) {
+    htimer_t *timer = heap->node[i];
+    while (i > 0) {
+        uint16_t parent = (i - 1) / 2;
+        if (!htimer_before(timer, heap->node[parent])) break;
+        htimer_place(heap, heap->node[parent], i);
+        i = parent;
+    }
+    htimer_place(heap, timer, i);
+}
+
+/**
+ * Move the timer at a position down until neither child is due before it
+ * @param heap The heap
+ * @param i The position of the timer
+ */
+void htimer_sift_down(htimer_heap_t *heap, uint16_t i) {
+    htimer_t *timer = heap->node[i];
+    for (;;) {
+        uint32_t child = 2 * (uint32_t)i + 1;
+        if (child >= heap->count) break;
+        if ((child + 1 < heap->count) && htimer_before(heap->node[child + 1], heap->node[child])) child++;
+        if (!htimer_before(heap->node[child], timer)) break;
+        htimer_place(heap, heap->node[child], i);
+        i = child;
+    }
+    htimer_place(heap, timer, i);
+}
+
+// Move a timer whose expiry has changed to its new place
+static void htimer_heap_update(htimer_heap_t *heap, htimer_t *timer) {
+    uint16_t i = timer->index;
+    htimer_sift_down(heap, i);
+    if (timer->index == i) {
+        htimer_sift_up(heap, i);
+    }
+}
+
+static int htimer_heap_insert(htimer_heap_t *heap, htimer_t *timer) {
+    if (heap->count >= heap->size) return 0;
+    htimer_place(heap, timer, heap->count);
+    heap->count++;
+    htimer_sift_up(heap, timer->index);
+    return 1;
+}
+
+/**
+ * Take a timer out of the heap, wherever it is, and mark it inactive
+ * @param heap The heap, which the timer must be in
+ * @param timer The timer
+ */
+void htimer_heap_remove(htimer_heap_t *heap, htimer_t *timer) {
+    uint16_t i = timer->index;
+    heap->count--;
+    if (i != heap->count) {
+        htimer_place(heap, heap->node[heap->count], i);
+        htimer_heap_update(heap, heap->node[i]);
+    }
+    timer->index = htimerINACTIVE;
+}
+
+/**
+ * Start (or restart) or stop a timer
+ * @param heap The heap
+ * @param timer The timer
+ * @param op htimerCMD_START or htimerCMD_STOP
+ * @param expiry When a started timer is due
+ * @param period Time between runs of a started timer after that, or 0
+ * @returns 1, or 0 if a timer could not be started as the heap is full
+ */
+int htimer_heap_apply(htimer_heap_t *heap, htimer_t *timer, uint8_t op, uint32_t expiry, uint32_t period) {
+    if (op == htimerCMD_STOP) {
+        if (timer->index != htimerINACTIVE) {
+            htimer_heap_remove(heap, timer);
+        }
+        return 1;
+    }
+
+    timer->expiry = expiry;
+    timer->period = period;
+    if (timer->index != htimerINACTIVE) {
+        htimer_heap_update(heap, timer);
+        return 1;
+    }
+    return htimer_heap_insert(heap, timer);
+}
+
+/**
+ * Take the timer at the root, which has expired, rearming it if periodic
+ * @param heap The heap, which must not be empty
+ * @returns The timer
+ */
+htimer_t *htimer_heap_pop_expired(htimer_heap_t *heap) {
+    htimer_t *timer = heap->node[0];
+    if (timer->period != 0) {
+        // From the old expiry rather than now, so a periodic timer does not drift
+        timer->expiry += timer->period;
+        htimer_sift_down(heap, 0);
+    } else {
+        htimer_heap_remove(heap, timer);
+    }
+    return timer;
+}
+
+#endif
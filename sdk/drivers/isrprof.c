@@ -0,0 +1,341 @@
+/**
+ * @file isrprof.c
+ * Interrupt profiler. When configUSE_ISR_PROFILING is set the SDK interrupt
+ * handlers stamp the core timer on entry and exit (see isrprof_enter() and
+ * isrprof_exit()) and the duration is accumulated per vector into a slot
+ * holding the count, minimum, maximum, total and a log2 histogram.
+ *
+ * The windows during which cpu_disable_interrupts() has interrupts masked
+ * are also timed, along with the address they were masked from, and the
+ * kernel tick handler records how late it ran compared to the compare match
+ * that triggered it.
+ *
+ * From these a worst-case latency is derived for each priority level: an
+ * interrupt at level n can be held off by any disable window (if n is at or
+ * below configMAX_SYSCALL_INTERRUPT_PRIORITY) and by any handler running at
+ * level n or above.
+ *
+ * Entry stamps are taken after the compiler generated prologue so the
+ * register save and restore is not included in the handler durations. That
+ * cost is measured separately by isrprof_benchmark_entry(), which raises core
+ * software interrupt 1 and times how long it takes to reach the handler, so
+ * the default and shadow register set interrupt models can be compared.
+ */
+#include <p32xxxx.h>
+#include <sys/attribs.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+
+#include "sdk/cpu.h"
+#include "sdk/uart.h"
+#include "sdk/isrprof.h"
+
+#if (configUSE_ISR_PROFILING == 1)
+
+static isrprof_slot_t isrprofSlot[configISRPROF_SLOTS];
+static uint8_t isrprofSlotIndex[256] = {0};    // Vector to slot number + 1
+static uint8_t isrprofSlotsUsed = 0;
+static uint32_t isrprofIplMax[8] = {0};
+
+static volatile uint8_t isrprofDisableActive = 0;
+static uint32_t isrprofDisableStart = 0;
+static void *isrprofDisableCaller = NULL;
+static uint32_t isrprofDisableMax = 0;
+static void *isrprofDisableMaxCaller = NULL;
+
+static uint32_t isrprofTickLatencyMax = 0;
+
+#define isrprofBENCH_IPL 4
+#define isrprofBENCH_CAUSE_BIT (1 << 9)     // Cause<IP1>, core software interrupt 1
+
+static volatile uint32_t isrprofBenchEntry = 0;
+static volatile uint8_t isrprofBenchDone = 0;
+
+/**
+ * Find, or allocate, the slot for a vector
+ * @param vector The interrupt vector
+ * @param ipl The priority level the vector runs at
+ * @returns The slot, or NULL if all slots are in use
+ */
+static isrprof_slot_t *isrprof_get_vector_slot(uint8_t vector, uint8_t ipl) {
+    uint8_t idx = isrprofSlotIndex[vector];
+    if (idx != 0) {
+        return &isrprofSlot[idx - 1];
+    }
+
+    isrprof_slot_t *slot = NULL;
+    uint32_t status = __builtin_disable_interrupts();
+    if (isrprofSlotIndex[vector] != 0) {
+        slot = &isrprofSlot[isrprofSlotIndex[vector] - 1];
+    } else if (isrprofSlotsUsed < configISRPROF_SLOTS) {
+        slot = &isrprofSlot[isrprofSlotsUsed];
+        memset(slot, 0, sizeof(isrprof_slot_t));
+        slot->vector = vector;
+        slot->ipl = ipl;
+        slot->min = 0xFFFFFFFF;
+        isrprofSlotsUsed++;
+        isrprofSlotIndex[vector] = isrprofSlotsUsed;
+    }
+    _CP0_SET_STATUS(status);
+    return slot;
+}
+
+/**
+ * Record one execution of an interrupt handler. This is normally called
+ * through the isrprof_exit() macro at the end of the handler.
+ * @param vector The interrupt vector
+ * @param ipl The priority level the handler runs at
+ * @param start The core timer count at entry to the handler
+ */
+void isrprof_record(uint8_t vector, uint8_t ipl, uint32_t start) {
+    uint32_t end;
+    cpu_ct_read_count(end);
+    uint32_t duration = end - start;
+
+    isrprof_slot_t *slot = isrprof_get_vector_slot(vector, ipl);
+    if (slot == NULL) return;
+
+    slot->count++;
+    slot->total += duration;
+    if (duration < slot->min) slot->min = duration;
+    if (duration > slot->max) slot->max = duration;
+
+    uint32_t bucket = (duration == 0) ? 0 : 32 - __builtin_clz(duration);
+    if (bucket >= isrprofBUCKETS) bucket = isrprofBUCKETS - 1;
+    slot->histogram[bucket]++;
+
+    if (duration > isrprofIplMax[ipl & 7]) isrprofIplMax[ipl & 7] = duration;
+}
+
+/**
+ * Record how late the kernel tick interrupt was serviced
+ * @param latency Core timer ticks between the compare match and the handler
+ */
+void isrprof_tick_latency(uint32_t latency) {
+    if (latency > isrprofTickLatencyMax) isrprofTickLatencyMax = latency;
+}
+
+/**
+ * Mark the start of an interrupt disable window. Called by
+ * cpu_disable_interrupts() after interrupts have been masked.
+ * @param caller The address interrupts were disabled from
+ */
+void isrprof_disable_start(void *caller) {
+    if (isrprofDisableActive) return;
+    isrprofDisableActive = 1;
+    isrprofDisableCaller = caller;
+    cpu_ct_read_count(isrprofDisableStart);
+}
+
+/**
+ * Mark the end of an interrupt disable window. Called by
+ * cpu_enable_interrupts() before interrupts are unmasked.
+ */
+void isrprof_disable_end() {
+    if (!isrprofDisableActive) return;
+    uint32_t now;
+    cpu_ct_read_count(now);
+    uint32_t duration = now - isrprofDisableStart;
+    if (duration > isrprofDisableMax) {
+        isrprofDisableMax = duration;
+        isrprofDisableMaxCaller = isrprofDisableCaller;
+    }
+    isrprofDisableActive = 0;
+}
+
+/**
+ * Discard all collected statistics
+ */
+void isrprof_reset() {
+    uint32_t status = __builtin_disable_interrupts();
+    memset(isrprofSlot, 0, sizeof(isrprofSlot));
+    memset(isrprofSlotIndex, 0, sizeof(isrprofSlotIndex));
+    memset(isrprofIplMax, 0, sizeof(isrprofIplMax));
+    isrprofSlotsUsed = 0;
+    isrprofDisableMax = 0;
+    isrprofDisableMaxCaller = NULL;
+    isrprofTickLatencyMax = 0;
+    _CP0_SET_STATUS(status);
+}
+
+/**
+ * Take a consistent copy of one profile slot
+ * @param index The slot number, starting at 0
+ * @param slot The structure to copy the slot into
+ * @returns 1 if the slot is in use, 0 otherwise
+ */
+int isrprof_get_slot(uint8_t index, isrprof_slot_t *slot) {
+    if (index >= isrprofSlotsUsed) return 0;
+    uint32_t status = __builtin_disable_interrupts();
+    memcpy(slot, &isrprofSlot[index], sizeof(isrprof_slot_t));
+    _CP0_SET_STATUS(status);
+    return 1;
+}
+
+/**
+ * Get the longest period interrupts have been disabled by cpu_disable_interrupts()
+ * @param caller If not NULL receives the address interrupts were disabled from
+ * @returns The duration in core timer ticks
+ */
+uint32_t isrprof_get_disable_max(void **caller) {
+    if (caller != NULL) *caller = isrprofDisableMaxCaller;
+    return isrprofDisableMax;
+}
+
+/**
+ * Get the worst-case latency seen by an interrupt priority level. This is the
+ * longest time an interrupt at that level could have been held off by a
+ * disable window or by a handler at the same or higher level. For the kernel
+ * interrupt level the measured tick latency is also taken into account.
+ * @param ipl The interrupt priority level (1-7)
+ * @returns The latency in core timer ticks
+ */
+uint32_t isrprof_get_ipl_latency(uint8_t ipl) {
+    if ((ipl < 1) || (ipl > 7)) return 0;
+
+    uint32_t worst = 0;
+    if (ipl <= configMAX_SYSCALL_INTERRUPT_PRIORITY) {
+        worst = isrprofDisableMax;
+    }
+    for (int i = ipl; i < 8; i++) {
+        if (isrprofIplMax[i] > worst) worst = isrprofIplMax[i];
+    }
+    if ((ipl == configKERNEL_INTERRUPT_PRIORITY) && (isrprofTickLatencyMax > worst)) {
+        worst = isrprofTickLatencyMax;
+    }
+    return worst;
+}
+
+/**
+ * Convert core timer ticks into nanoseconds
+ * @param ticks The number of core timer ticks
+ * @returns The equivalent time in nanoseconds
+ */
+uint32_t isrprof_ticks_to_ns(uint32_t ticks) {
+    return (uint32_t)(((uint64_t)ticks * 1000000000ULL) / (cpu_get_system_clock() / 2));
+}
+
+// Core software interrupt 1 belongs to the work queue when that is enabled
+#if (configUSE_WORKQUEUE == 0)
+void __ISR(_CORE_SOFTWARE_1_VECTOR, cpuISR_IPL4) isrprof_bench_isr() {
+    uint32_t now;
+    cpu_ct_read_count(now);
+    isrprofBenchEntry = now;
+    _CP0_BIC_CAUSE(isrprofBENCH_CAUSE_BIT);
+    cpu_clear_interrupt_flag(_CORE_SOFTWARE_1_VECTOR);
+    isrprofBenchDone = 1;
+}
+#endif
+
+/**
+ * Measure the time from raising an interrupt to the first instruction of the
+ * handler body, including the compiler generated prologue. The measurement
+ * uses core software interrupt 1 at IPL4, so it reflects the register save
+ * cost of the current interrupt model (configUSE_SHADOW_REGISTER_SETS).
+ * This must be called from task level with interrupts enabled. It is not
+ * available when configUSE_WORKQUEUE is set, as the work queue uses the same
+ * interrupt.
+ * @param iterations The number of interrupts to time
+ * @param min Receives the shortest entry time in CPU cycles
+ * @param avg Receives the average entry time in CPU cycles
+ * @param max Receives the longest entry time in CPU cycles
+ * @returns 1 if the benchmark ran, 0 otherwise
+ */
+int isrprof_benchmark_entry(uint32_t iterations, uint32_t *min, uint32_t *avg, uint32_t *max) {
+#if (configUSE_WORKQUEUE == 1)
+    return 0;
+#else
+    uint32_t lo = 0xFFFFFFFF, hi = 0;
+    uint64_t total = 0;
+
+    if (iterations == 0) return 0;
+
+    cpu_clear_interrupt_flag(_CORE_SOFTWARE_1_VECTOR);
+    cpu_set_interrupt_priority(_CORE_SOFTWARE_1_VECTOR, isrprofBENCH_IPL, 0);
+    cpu_set_interrupt_enable(_CORE_SOFTWARE_1_VECTOR);
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint32_t start;
+        isrprofBenchDone = 0;
+        cpu_ct_read_count(start);
+        _CP0_BIS_CAUSE(isrprofBENCH_CAUSE_BIT);
+        while (!isrprofBenchDone);
+
+        // The core timer runs at half the CPU clock
+        uint32_t cycles = (isrprofBenchEntry - start) * 2;
+        if (cycles < lo) lo = cycles;
+        if (cycles > hi) hi = cycles;
+        total += cycles;
+    }
+
+    cpu_clear_interrupt_enable(_CORE_SOFTWARE_1_VECTOR);
+    cpu_set_interrupt_priority(_CORE_SOFTWARE_1_VECTOR, 0, 0);
+
+    if (min != NULL) *min = lo;
+    if (avg != NULL) *avg = (uint32_t)(total / iterations);
+    if (max != NULL) *max = hi;
+    return 1;
+#endif
+}
+
+static int isrprof_print(uint8_t uart, const char *str) {
+    return uart_write_bytes(uart, (const uint8_t *)str, strlen(str));
+}
+
+/**
+ * Print a summary of the collected statistics to a UART
+ * @param uart The UART (which must be open) to print to
+ * @returns 1 if the report was printed, 0 otherwise
+ */
+int isrprof_report(uint8_t uart) {
+    char line[100];
+    isrprof_slot_t slot;
+
+    if (!uart_is_open(uart)) return 0;
+
+    isrprof_print(uart, "ISR profile (ns)\r\n vec ipl      count        min        avg        max\r\n");
+    for (uint8_t i = 0; isrprof_get_slot(i, &slot); i++) {
+        uint32_t avg = slot.count ? (uint32_t)(slot.total / slot.count) : 0;
+        sprintf(line, " %3d  %2d %10lu %10lu %10lu %10lu\r\n",
+            slot.vector, slot.ipl, (unsigned long)slot.count,
+            (unsigned long)isrprof_ticks_to_ns(slot.min),
+            (unsigned long)isrprof_ticks_to_ns(avg),
+            (unsigned long)isrprof_ticks_to_ns(slot.max));
+        isrprof_print(uart, line);
+
+        isrprof_print(uart, "     ");
+        for (int b = 0; b < isrprofBUCKETS; b++) {
+            if (slot.histogram[b] == 0) continue;
+            sprintf(line, " <%lu:%lu", (unsigned long)isrprof_ticks_to_ns(1UL << b), (unsigned long)slot.histogram[b]);
+            isrprof_print(uart, line);
+        }
+        isrprof_print(uart, "\r\n");
+    }
+
+    void *caller;
+    uint32_t dis = isrprof_get_disable_max(&caller);
+    sprintf(line, "Interrupts disabled: max %lu ns at %p\r\n", (unsigned long)isrprof_ticks_to_ns(dis), caller);
+    isrprof_print(uart, line);
+
+    sprintf(line, "Tick latency: max %lu ns\r\n", (unsigned long)isrprof_ticks_to_ns(isrprofTickLatencyMax));
+    isrprof_print(uart, line);
+
+    uint32_t bmin, bavg, bmax;
+    if (isrprof_benchmark_entry(64, &bmin, &bavg, &bmax)) {
+        sprintf(line, "Entry to handler (%s): min %lu avg %lu max %lu cycles\r\n",
+            (configUSE_SHADOW_REGISTER_SETS == 1) ? "shadow sets" : "auto save",
+            (unsigned long)bmin, (unsigned long)bavg, (unsigned long)bmax);
+        isrprof_print(uart, line);
+    }
+
+    isrprof_print(uart, "Worst-case latency per IPL (ns)\r\n");
+    for (uint8_t ipl = 1; ipl < 8; ipl++) {
+        sprintf(line, " IPL%d %10lu\r\n", ipl, (unsigned long)isrprof_ticks_to_ns(isrprof_get_ipl_latency(ipl)));
+        isrprof_print(uart, line);
+    }
+    return 1;
+}
+
+#endif
@@ -0,0 +1,308 @@
+/**
+ * @file ktrace.c
+ * Kernel event trace recorder. The FreeRTOS trace macros are mapped (by
+ * sdk/ktrace.h) onto the functions in this file, which timestamp each event
+ * with the core timer and store it in a fixed size binary ring buffer in RAM.
+ *
+ * The buffer can be drained over a UART with ktrace_dump() and decoded on
+ * the host with tools/ktrace_decode.py. With configKTRACE_PERSISTENT set the
+ * buffer lives in the persistent (not cleared at reset) data section, so the
+ * events leading up to a crash or watchdog reset can be recovered afterwards.
+ *
+ * Recording an event is a constant time operation: interrupts are disabled,
+ * the core timer is read and one 8 byte record is written. The cost, in CPU
+ * cycles, is measured when the recorder starts and is reported in the dump
+ * header so the decoder can account for it.
+ */
+#include <p32xxxx.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "sdk/cpu.h"
+#include "sdk/uart.h"
+
+#if (configUSE_KTRACE == 1)
+
+#include "sdk/ktrace.h"
+
+#if ((configKTRACE_BUFFER_SIZE & (configKTRACE_BUFFER_SIZE - 1)) != 0)
+#error "configKTRACE_BUFFER_SIZE must be a power of two"
+#endif
+
+#define ktraceCALIBRATION_EVENTS 16
+
+#if (configKTRACE_PERSISTENT == 1)
+#define KTRACE_STORAGE __attribute__((persistent, aligned(8)))
+#else
+#define KTRACE_STORAGE __attribute__((aligned(8)))
+#endif
+
+struct ktraceHeaderStruct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t capacity;
+    uint32_t head;              // Total number of records ever written
+    uint32_t timerFrequency;    // Core timer frequency in Hz
+    uint32_t overhead;          // CPU cycles consumed per recorded event
+    uint32_t maxTasks;
+    uint32_t nameLength;
+    char names[configKTRACE_MAX_TASKS][configMAX_TASK_NAME_LEN];
+};
+
+static struct {
+    struct ktraceHeaderStruct header;
+    ktrace_record_t records[configKTRACE_BUFFER_SIZE];
+} ktraceBuffer KTRACE_STORAGE;
+
+static volatile uint8_t ktraceRunning = 0;
+static uint8_t ktraceCurrentTask = 0;
+static UBaseType_t ktraceNextTaskNumber = 1;    // 0 is left for events before the scheduler runs
+static uint8_t ktraceHeld = 0;                  // The buffer holds a trace from before the last reset
+
+// The names of the tasks created since reset. The header's table belongs to
+// the trace in the buffer, which may be from before the reset, so it only
+// takes these when the buffer is cleared and while it is recording.
+static char ktraceNames[configKTRACE_MAX_TASKS][configMAX_TASK_NAME_LEN];
+
+/**
+ * Record a single event in the trace buffer. Safe to call from any context,
+ * including interrupts above configMAX_SYSCALL_INTERRUPT_PRIORITY.
+ * @param event The event identifier (one of ktraceEV_*)
+ * @param param Event specific parameter
+ */
+void __attribute__((nomips16)) ktrace_event(uint8_t event, uint16_t param) {
+    if (!ktraceRunning) return;
+
+    uint32_t status = __builtin_disable_interrupts();
+    uint32_t ts;
+    cpu_ct_read_count(ts);
+
+    ktrace_record_t *rec = &ktraceBuffer.records[ktraceBuffer.header.head & (configKTRACE_BUFFER_SIZE - 1)];
+    ktraceBuffer.header.head++;
+    rec->timestamp = ts;
+    rec->event = event;
+    rec->task = ktraceCurrentTask;
+    rec->param = param;
+
+    _CP0_SET_STATUS(status);
+}
+
+/**
+ * Record an event whose parameter is a task
+ * @param event The event identifier
+ * @param tcb The task the event refers to
+ */
+void ktrace_task_event(uint8_t event, void *tcb) {
+    if (!ktraceRunning) return;
+    ktrace_event(event, uxTaskGetTaskNumber((TaskHandle_t)tcb));
+}
+
+/**
+ * Record an event whose parameter is a kernel object (queue, semaphore, mutex).
+ * Objects are identified by their word address within the data RAM, which
+ * fits in 16 bits on parts with up to 256KB of RAM.
+ * @param event The event identifier
+ * @param object The object the event refers to
+ */
+void ktrace_object_event(uint8_t event, void *object) {
+    if (!ktraceRunning) return;
+    ktrace_event(event, ((uint32_t)object >> 2) & 0xFFFF);
+}
+
+/**
+ * Called by the kernel each time a task is switched in. The task number is
+ * cached so every other event can be attributed to the running task without
+ * another call into the kernel.
+ * @param tcb The task being switched in
+ */
+void ktrace_switched_in(void *tcb) {
+    ktraceCurrentTask = uxTaskGetTaskNumber((TaskHandle_t)tcb);
+    ktrace_event(ktraceEV_SWITCH_IN, ktraceCurrentTask);
+}
+
+/**
+ * Called by the kernel when a task is created. The kernel leaves task numbers
+ * at 0 unless told otherwise, so each task is numbered here, before any other
+ * event can refer to it. The name of the task is kept in a name table
+ * (indexed by task number) for use by the decoder, and in the header's unless
+ * that belongs to a trace held over from before a reset.
+ * @param tcb The newly created task
+ */
+void ktrace_task_created(void *tcb) {
+    UBaseType_t num = ktraceNextTaskNumber++;
+    vTaskSetTaskNumber((TaskHandle_t)tcb, num);
+    if (num < configKTRACE_MAX_TASKS) {
+        strncpy(ktraceNames[num], pcTaskGetName((TaskHandle_t)tcb), configMAX_TASK_NAME_LEN);
+        if (!ktraceHeld) {
+            memcpy(ktraceBuffer.header.names[num], ktraceNames[num], configMAX_TASK_NAME_LEN);
+        }
+    }
+    ktrace_event(ktraceEV_TASK_CREATE, num);
+}
+
+/**
+ * Measure the number of CPU cycles used to record one event. The calibration
+ * records are discarded afterwards.
+ * @returns The cost of one event in CPU cycles
+ */
+static uint32_t ktrace_measure_overhead() {
+    uint32_t head = ktraceBuffer.header.head;
+    uint32_t start, end;
+
+    ktraceRunning = 1;
+    cpu_ct_read_count(start);
+    for (int i = 0; i < ktraceCALIBRATION_EVENTS; i++) {
+        ktrace_event(ktraceEV_NONE, 0);
+    }
+    cpu_ct_read_count(end);
+    ktraceRunning = 0;
+
+    ktraceBuffer.header.head = head;
+
+    // The core timer runs at half the CPU clock
+    return ((end - start) * 2 + (ktraceCALIBRATION_EVENTS / 2)) / ktraceCALIBRATION_EVENTS;
+}
+
+/**
+ * Erase the trace buffer and reinitialise the header. The header's name
+ * table is replaced with the names of the tasks created since reset, which
+ * are the ones the new trace will refer to.
+ */
+void ktrace_clear() {
+    uint8_t running = ktraceRunning;
+    ktraceRunning = 0;
+    ktraceBuffer.header.magic = ktraceMAGIC;
+    ktraceBuffer.header.version = ktraceVERSION;
+    ktraceBuffer.header.recordSize = sizeof(ktrace_record_t);
+    ktraceBuffer.header.capacity = configKTRACE_BUFFER_SIZE;
+    ktraceBuffer.header.head = 0;
+    ktraceBuffer.header.timerFrequency = cpu_get_system_clock() / 2;
+    ktraceBuffer.header.overhead = 0;
+    ktraceBuffer.header.maxTasks = configKTRACE_MAX_TASKS;
+    ktraceBuffer.header.nameLength = configMAX_TASK_NAME_LEN;
+    memcpy(ktraceBuffer.header.names, ktraceNames, sizeof(ktraceNames));
+    ktraceHeld = 0;
+    ktraceRunning = running;
+}
+
+/**
+ * Start (or resume) recording events
+ */
+void ktrace_start() {
+    if (ktraceBuffer.header.magic != ktraceMAGIC) {
+        ktrace_clear();
+    }
+    if (ktraceBuffer.header.overhead == 0) {
+        ktraceBuffer.header.overhead = ktrace_measure_overhead();
+    }
+    ktraceRunning = 1;
+}
+
+/**
+ * Stop recording events. The buffer contents are retained.
+ */
+void ktrace_stop() {
+    ktraceRunning = 0;
+}
+
+/**
+ * Test if the recorder is currently running
+ * @returns 1 if events are being recorded, 0 otherwise
+ */
+int ktrace_is_running() {
+    return ktraceRunning;
+}
+
+/**
+ * Get the measured cost of recording one event
+ * @returns The overhead in CPU cycles
+ */
+uint32_t ktrace_get_overhead() {
+    return ktraceBuffer.header.overhead;
+}
+
+/**
+ * Get the number of events recorded since the buffer was last cleared. Only
+ * the most recent configKTRACE_BUFFER_SIZE of these are retained.
+ * @returns The number of events recorded
+ */
+uint32_t ktrace_get_count() {
+    return ktraceBuffer.header.head;
+}
+
+/**
+ * Initialise the recorder. This must be called before any tasks are created
+ * so that their names are captured. If a persistent trace survived the last
+ * reset it is left untouched, and the recorder stopped, until it has been
+ * collected with ktrace_dump() and restarted with ktrace_clear() and
+ * ktrace_start().
+ */
+void ktrace_init() {
+#if (configKTRACE_PERSISTENT == 1)
+    if ((ktraceBuffer.header.magic == ktraceMAGIC) && (ktraceBuffer.header.head != 0)) {
+        ktraceRunning = 0;
+        ktraceHeld = 1;
+        return;
+    }
+#endif
+    ktrace_clear();
+    ktrace_start();
+}
+
+/**
+ * Send the trace header and records to a UART, oldest record first.
+ * @param uart The UART to send through
+ * @param write The function used to send each block
+ * @returns The number of bytes sent
+ */
+static int ktrace_send(uint8_t uart, int (*write)(uint8_t, const uint8_t *, size_t)) {
+    uint8_t running = ktraceRunning;
+    ktraceRunning = 0;
+
+    uint32_t head = ktraceBuffer.header.head;
+    uint32_t first = 0;
+    uint32_t count = head;
+    if (head > configKTRACE_BUFFER_SIZE) {
+        first = head & (configKTRACE_BUFFER_SIZE - 1);
+        count = configKTRACE_BUFFER_SIZE;
+    }
+
+    int sent = write(uart, (const uint8_t *)&ktraceBuffer.header, sizeof(ktraceBuffer.header));
+
+    uint32_t tail = configKTRACE_BUFFER_SIZE - first;
+    if (tail > count) tail = count;
+    sent += write(uart, (const uint8_t *)&ktraceBuffer.records[first], tail * sizeof(ktrace_record_t));
+    if (count > tail) {
+        sent += write(uart, (const uint8_t *)&ktraceBuffer.records[0], (count - tail) * sizeof(ktrace_record_t));
+    }
+
+    ktraceRunning = running;
+    return sent;
+}
+
+/**
+ * Drain the trace buffer through a UART in the binary format understood by
+ * tools/ktrace_decode.py. Recording is suspended while the data is sent.
+ * @param uart The UART (which must be open) to send the trace through
+ * @returns The number of bytes sent
+ */
+int ktrace_dump(uint8_t uart) {
+    if (!uart_is_open(uart)) return 0;
+    return ktrace_send(uart, uart_write_bytes);
+}
+
+/**
+ * Drain the trace buffer through a UART from an exception handler or other
+ * context where the scheduler cannot be relied upon.
+ * @param uart The UART (which must be open) to send the trace through
+ * @returns The number of bytes sent
+ */
+int ktrace_dump_emergency(uint8_t uart) {
+    if (!uart_is_open(uart)) return 0;
+    return ktrace_send(uart, uart_write_bytes_emergency);
+}
+
+#endif
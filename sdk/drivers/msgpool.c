@@ -0,0 +1,369 @@
+/**
+ * @file msgpool.c
+ * Fixed size message pools for passing large items between tasks without
+ * copying them. A producer takes a block from a pool, fills it in and passes
+ * the pointer on through a pointer sized queue or a task notification; the
+ * consumer frees it back to the pool when done. Only the pointer is ever
+ * copied, so a 1500 byte packet costs the same to pass as a 4 byte one.
+ *
+ * Each block carries a reference count so one message can be handed to
+ * several consumers: call msgpool_ref() once for every extra consumer before
+ * passing it on and the block returns to the pool when the last one frees
+ * it. The free blocks are themselves kept in a queue, which gives blocking
+ * allocation with a timeout when the pool is empty, and allocation and
+ * freeing from interrupt handlers, for free.
+ */
+#include <p32xxxx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "sdk/cpu.h"
+#include "sdk/uart.h"
+#include "sdk/msgpool.h"
+
+static inline msgpool_header_t *msgpool_header(const void *msg) {
+    return (msgpool_header_t *)((uint8_t *)msg - sizeof(msgpool_header_t));
+}
+
+/**
+ * Set up a pool of equally sized blocks
+ * @param pool The pool to initialise
+ * @param storage At least msgpoolSTORAGE_SIZE(size, count) bytes, 8-byte
+ *                aligned, which must stay valid for as long as the pool is used
+ * @param size The payload size of each block in bytes
+ * @param count The number of blocks
+ * @returns 1 if the pool was set up, 0 otherwise
+ */
+int msgpool_init(msgpool_t *pool, void *storage, uint16_t size, uint16_t count) {
+    if ((pool == NULL) || (storage == NULL) || (size == 0) || (count == 0)) return 0;
+    if (((uint32_t)storage & 7) != 0) return 0;
+
+    pool->blocks = (uint8_t *)storage;
+    pool->size = size;
+    pool->stride = msgpoolSTRIDE(size);
+    pool->count = count;
+    pool->lowest = count;
+
+    // The free queue storage follows the blocks
+    uint8_t *queueStorage = pool->blocks + (uint32_t)pool->stride * count;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    pool->free = xQueueCreateStatic(count, sizeof(void *), queueStorage, &pool->freeQueue);
+#else
+    (void)queueStorage;
+    pool->free = xQueueCreate(count, sizeof(void *));
+#endif
+    if (pool->free == NULL) return 0;
+
+    for (uint16_t i = 0; i < count; i++) {
+        msgpool_header_t *h = (msgpool_header_t *)(pool->blocks + (uint32_t)pool->stride * i);
+        h->pool = pool;
+        h->refs = 0;
+        h->length = 0;
+        void *msg = h + 1;
+        xQueueSend(pool->free, &msg, 0);
+    }
+    return 1;
+}
+
+static void *msgpool_claim(msgpool_t *pool, void *msg) {
+    msgpool_header_t *h = msgpool_header(msg);
+    h->refs = 1;
+    h->length = 0;
+
+    uint16_t avail = uxQueueMessagesWaitingFromISR(pool->free);
+    if (avail < pool->lowest) pool->lowest = avail;
+    return msg;
+}
+
+/**
+ * Take a block from a pool, waiting for one to be freed if the pool is empty
+ * @param pool The pool
+ * @param timeout How long to wait, in ticks
+ * @returns The block with one reference and a length of 0, or NULL if none
+ *          became free in time
+ */
+void *msgpool_alloc(msgpool_t *pool, TickType_t timeout) {
+    void *msg;
+    if (xQueueReceive(pool->free, &msg, timeout) != pdTRUE) return NULL;
+    return msgpool_claim(pool, msg);
+}
+
+/**
+ * Take a block from a pool from an interrupt handler
+ * @param pool The pool
+ * @returns The block, or NULL if the pool is empty
+ */
+void *msgpool_alloc_from_isr(msgpool_t *pool) {
+    void *msg;
+    if (xQueueReceiveFromISR(pool->free, &msg, NULL) != pdTRUE) return NULL;
+    return msgpool_claim(pool, msg);
+}
+
+/**
+ * Add references to a message, one for each extra consumer it is going to
+ * be passed to. May be called from an interrupt handler.
+ * @param msg The message
+ * @param count The number of references to add
+ */
+void msgpool_ref(void *msg, uint16_t count) {
+    __atomic_add_fetch(&msgpool_header(msg)->refs, count, __ATOMIC_RELAXED);
+}
+
+/**
+ * Drop a reference to a message, returning it to its pool if it was the last
+ * @param msg The message
+ */
+void msgpool_free(void *msg) {
+    msgpool_header_t *h = msgpool_header(msg);
+    configASSERT(h->refs != 0);
+    if (__atomic_sub_fetch(&h->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        xQueueSend(h->pool->free, &msg, 0);
+    }
+}
+
+/**
+ * Drop a reference to a message from an interrupt handler
+ * @param msg The message
+ * @param woken Set to pdTRUE if a task waiting for a block was woken, or NULL
+ */
+void msgpool_free_from_isr(void *msg, BaseType_t *woken) {
+    msgpool_header_t *h = msgpool_header(msg);
+    configASSERT(h->refs != 0);
+    if (__atomic_sub_fetch(&h->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        xQueueSendFromISR(h->pool->free, &msg, woken);
+    }
+}
+
+uint16_t msgpool_get_length(const void *msg) {
+    return msgpool_header(msg)->length;
+}
+
+/**
+ * Record how many bytes of a message are in use
+ * @param msg The message
+ * @param length The length, which may not exceed the block size
+ * @returns 1 if the length was set, 0 if it is too long
+ */
+int msgpool_set_length(void *msg, uint16_t length) {
+    msgpool_header_t *h = msgpool_header(msg);
+    if (length > h->pool->size) return 0;
+    h->length = length;
+    return 1;
+}
+
+uint16_t msgpool_get_size(const void *msg) {
+    return msgpool_header(msg)->pool->size;
+}
+
+uint16_t msgpool_available(msgpool_t *pool) {
+    return uxQueueMessagesWaiting(pool->free);
+}
+
+/**
+ * Get the fewest free blocks there have ever been, for sizing the pool
+ * @param pool The pool
+ * @returns The low water mark in blocks
+ */
+uint16_t msgpool_lowest(msgpool_t *pool) {
+    return pool->lowest;
+}
+
+/**
+ * Pass a message on through a queue created with an item size of
+ * sizeof(void *). Ownership of the reference passes to the receiver.
+ * @param queue The queue
+ * @param msg The message
+ * @param timeout How long to wait for space, in ticks
+ * @returns 1 if the message was queued, 0 if not (the caller still owns it)
+ */
+int msgpool_send(QueueHandle_t queue, void *msg, TickType_t timeout) {
+    return xQueueSend(queue, &msg, timeout) == pdTRUE;
+}
+
+int msgpool_send_from_isr(QueueHandle_t queue, void *msg, BaseType_t *woken) {
+    return xQueueSendFromISR(queue, &msg, woken) == pdTRUE;
+}
+
+/**
+ * Receive a message passed with msgpool_send()
+ * @param queue The queue
+ * @param timeout How long to wait, in ticks
+ * @returns The message, which must be freed, or NULL on timeout
+ */
+void *msgpool_receive(QueueHandle_t queue, TickType_t timeout) {
+    void *msg;
+    if (xQueueReceive(queue, &msg, timeout) != pdTRUE) return NULL;
+    return msg;
+}
+
+/**
+ * Pass a message directly to a task in its notification value. This is
+ * cheaper than a queue but only one message can be outstanding, and the
+ * task must not use its notification value for anything else.
+ * @param task The receiving task
+ * @param msg The message
+ * @returns 1 if the message was passed, 0 if the task has not yet taken the
+ *          previous one (the caller still owns it)
+ */
+int msgpool_notify(TaskHandle_t task, void *msg) {
+    return xTaskNotify(task, (uint32_t)msg, eSetValueWithoutOverwrite) == pdPASS;
+}
+
+int msgpool_notify_from_isr(TaskHandle_t task, void *msg, BaseType_t *woken) {
+    return xTaskNotifyFromISR(task, (uint32_t)msg, eSetValueWithoutOverwrite, woken) == pdPASS;
+}
+
+/**
+ * Wait for a message passed to the calling task with msgpool_notify()
+ * @param timeout How long to wait, in ticks
+ * @returns The message, which must be freed, or NULL on timeout
+ */
+void *msgpool_wait(TickType_t timeout) {
+    uint32_t value;
+    if (xTaskNotifyWait(0, 0xFFFFFFFF, &value, timeout) != pdTRUE) return NULL;
+    return (void *)value;
+}
+
+#if (configUSE_MSGPOOL_BENCHMARK == 1) && (configSUPPORT_DYNAMIC_ALLOCATION == 1)
+
+static TaskHandle_t msgpoolBenchCaller = NULL;
+static QueueHandle_t msgpoolBenchQueue = NULL;
+static uint8_t *msgpoolBenchItem = NULL;
+static uint32_t msgpoolBenchMessages = 0;
+static volatile uint32_t msgpoolBenchWakeups = 0;
+static volatile uint32_t msgpoolBenchBlocks = 0;
+static volatile uint8_t msgpoolBenchPooled = 0;
+static volatile uint32_t msgpoolBenchSum = 0;
+
+// Counted by the traceTASK_SWITCHED_IN() hook in FreeRTOSConfig.h while the
+// flag is set
+volatile unsigned long msgpoolBenchSwitches = 0;
+volatile unsigned char msgpoolBenchCounting = 0;
+
+// Runs above the producer, so every message should switch to it and back:
+// each receive that finds the queue empty has to block, and the next
+// message wakes it again.
+static void msgpool_bench_consumer(void *params) {
+    for (;;) {
+        if (uxQueueMessagesWaiting(msgpoolBenchQueue) == 0) msgpoolBenchBlocks++;
+        if (msgpoolBenchPooled) {
+            uint8_t *msg = msgpool_receive(msgpoolBenchQueue, portMAX_DELAY);
+            msgpoolBenchSum += msg[0];
+            msgpool_free(msg);
+        } else {
+            xQueueReceive(msgpoolBenchQueue, msgpoolBenchItem, portMAX_DELAY);
+            msgpoolBenchSum += msgpoolBenchItem[0];
+        }
+        if (++msgpoolBenchWakeups == msgpoolBenchMessages) {
+            xTaskNotifyGive(msgpoolBenchCaller);
+        }
+    }
+}
+
+static int msgpool_bench_run(int pooled, uint16_t size, uint32_t messages, uint32_t *ticks) {
+    msgpool_t pool;
+    uint8_t *storage = NULL;
+    uint8_t *item = NULL;
+    TaskHandle_t consumer = NULL;
+    uint32_t start, end;
+    int ok = 0;
+
+    msgpoolBenchCaller = xTaskGetCurrentTaskHandle();
+    msgpoolBenchMessages = messages;
+    msgpoolBenchWakeups = 0;
+    msgpoolBenchBlocks = 0;
+    msgpoolBenchPooled = pooled;
+    msgpoolBenchQueue = NULL;
+    pool.free = NULL;
+
+    if (pooled) {
+        storage = pvPortMalloc(msgpoolSTORAGE_SIZE(size, 4));
+        if ((storage == NULL) || !msgpool_init(&pool, storage, size, 4)) goto done;
+        msgpoolBenchQueue = xQueueCreate(4, sizeof(void *));
+    } else {
+        item = pvPortMalloc(size);
+        msgpoolBenchItem = pvPortMalloc(size);
+        if ((item == NULL) || (msgpoolBenchItem == NULL)) goto done;
+        memset(item, 0, size);
+        msgpoolBenchQueue = xQueueCreate(4, size);
+    }
+    if (msgpoolBenchQueue == NULL) goto done;
+
+    if (xTaskCreate(msgpool_bench_consumer, "MsgBench", configMINIMAL_STACK_SIZE + 64, NULL,
+            uxTaskPriorityGet(NULL) + 1, &consumer) != pdPASS) goto done;
+
+    msgpoolBenchSwitches = 0;
+    msgpoolBenchCounting = 1;
+    cpu_ct_read_count(start);
+    for (uint32_t i = 0; i < messages; i++) {
+        if (pooled) {
+            uint8_t *msg = msgpool_alloc(&pool, portMAX_DELAY);
+            msg[0] = (uint8_t)i;
+            msgpool_set_length(msg, size);
+            msgpool_send(msgpoolBenchQueue, msg, portMAX_DELAY);
+        } else {
+            item[0] = (uint8_t)i;
+            xQueueSend(msgpoolBenchQueue, item, portMAX_DELAY);
+        }
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    cpu_ct_read_count(end);
+    msgpoolBenchCounting = 0;
+    *ticks = end - start;
+    ok = 1;
+
+done:
+    if (consumer != NULL) vTaskDelete(consumer);
+    if (msgpoolBenchQueue != NULL) vQueueDelete(msgpoolBenchQueue);
+    msgpoolBenchQueue = NULL;
+    if (pool.free != NULL) vQueueDelete(pool.free);
+    vPortFree(storage);
+    vPortFree(item);
+    vPortFree(msgpoolBenchItem);
+    msgpoolBenchItem = NULL;
+    return ok;
+}
+
+/**
+ * Compare passing messages by copy through xQueueSend() with passing pool
+ * blocks by pointer, printing the throughput to a UART. A consumer task one
+ * priority above the caller receives every message.
+ * @param uart The UART (which must be open) to print to
+ * @param size The message size in bytes
+ * @param messages The number of messages to pass each way
+ * @returns 1 if the benchmark ran, 0 otherwise
+ */
+int msgpool_benchmark(uint8_t uart, uint16_t size, uint32_t messages) {
+    char line[96];
+    uint32_t ticks;
+    const uint32_t hz = cpu_get_system_clock() / 2;
+
+    if (!uart_is_open(uart) || (size == 0) || (messages == 0)) return 0;
+
+    sprintf(line, "%u byte messages x %lu\r\n", size, (unsigned long)messages);
+    uart_write_bytes(uart, (const uint8_t *)line, strlen(line));
+    for (int pooled = 0; pooled < 2; pooled++) {
+        if (!msgpool_bench_run(pooled, size, messages, &ticks)) return 0;
+        uint64_t bytesPerSecond = (uint64_t)size * messages * hz / ticks;
+        // Every task switched in is counted, so more than two for each
+        // block means other tasks ran as well
+        sprintf(line, "%-6s %10lu bytes/s %7lu cycles/msg %7lu blocks %7lu switches\r\n",
+            pooled ? "pool" : "copy", (unsigned long)bytesPerSecond,
+            (unsigned long)((uint64_t)ticks * 2 / messages), (unsigned long)msgpoolBenchBlocks,
+            msgpoolBenchSwitches);
+        uart_write_bytes(uart, (const uint8_t *)line, strlen(line));
+    }
+    return 1;
+}
+
+#else
+
+int msgpool_benchmark(uint8_t uart, uint16_t size, uint32_t messages) {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,280 @@
+/**
+ * @file pubsub.c
+ * Publish/subscribe event bus. Topics are numbered at compile time and each
+ * one maps to a bit of the subscribing task's notification value, so
+ * publishing to any number of subscribers is one xTaskNotify() with eSetBits
+ * each rather than a queue copy each. A task subscribes with a mask of the
+ * topics it wants and waits for any of them with pubsub_wait().
+ *
+ * A topic can carry a payload, which must be a msgpool block (or NULL for a
+ * plain event). Every subscriber gets its own reference to the same block, so
+ * nothing is copied. Each subscriber holds only the latest payload of each
+ * topic: publishing again before the subscriber has taken the previous one
+ * drops the older reference and counts it as overwritten.
+ *
+ * The subscribing tasks must not use their notification value for anything
+ * else. Latency from publishing to the subscriber waking is measured with the
+ * core timer and kept per topic.
+ */
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "sdk/msgpool.h"
+#include "sdk/pubsub.h"
+
+// Reads the clock the latencies are measured with. The core timer unless
+// FreeRTOSConfig.h picks another, as the host tests do.
+#ifndef pubsubTIMESTAMP
+#include "sdk/cpu.h"
+#define pubsubTIMESTAMP(dest) cpu_ct_read_count(dest)
+#endif
+
+static pubsub_subscriber_t *pubsubSubscriber[configPUBSUB_MAX_SUBSCRIBERS] = {NULL};
+static pubsub_stats_t pubsubStats[configPUBSUB_TOPICS];
+
+/**
+ * Subscribe the calling task to a set of topics
+ * @param sub The subscriber record, which must stay valid until unsubscribed
+ * @param topics The topics wanted, made up of pubsubTOPIC() bits
+ * @returns 1 if subscribed, 0 if the subscriber table is full
+ */
+int pubsub_subscribe(pubsub_subscriber_t *sub, uint32_t topics) {
+    int ok = 0;
+
+    memset(sub, 0, sizeof(pubsub_subscriber_t));
+    sub->task = xTaskGetCurrentTaskHandle();
+    sub->mask = topics;
+
+    taskENTER_CRITICAL();
+    for (int i = 0; i < configPUBSUB_MAX_SUBSCRIBERS; i++) {
+        if (pubsubSubscriber[i] == NULL) {
+            pubsubSubscriber[i] = sub;
+            ok = 1;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+    return ok;
+}
+
+/**
+ * Change the topics a subscriber receives. Pending payloads of topics that
+ * are dropped stay until taken.
+ * @param sub The subscriber
+ * @param topics The new set of topics
+ * @returns 1
+ */
+int pubsub_set_filter(pubsub_subscriber_t *sub, uint32_t topics) {
+    sub->mask = topics;
+    return 1;
+}
+
+/**
+ * Remove a subscriber, dropping any payloads it had not taken
+ * @param sub The subscriber
+ * @returns 1 if it was subscribed, 0 otherwise
+ */
+int pubsub_unsubscribe(pubsub_subscriber_t *sub) {
+    int ok = 0;
+
+    taskENTER_CRITICAL();
+    for (int i = 0; i < configPUBSUB_MAX_SUBSCRIBERS; i++) {
+        if (pubsubSubscriber[i] == sub) {
+            pubsubSubscriber[i] = NULL;
+            ok = 1;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    if (ok) {
+        for (int t = 0; t < configPUBSUB_TOPICS; t++) {
+            if (sub->payload[t] != NULL) {
+                msgpool_free(sub->payload[t]);
+                sub->payload[t] = NULL;
+            }
+        }
+    }
+    return ok;
+}
+
+/**
+ * Store a payload in a subscriber's slot. Must be called with interrupts
+ * masked.
+ * @returns The payload that was replaced, which the caller must free
+ */
+static void *pubsub_deliver(pubsub_subscriber_t *sub, uint8_t topic, void *msg, uint32_t now) {
+    const uint32_t bit = pubsubTOPIC(topic);
+    void *old = sub->payload[topic];
+
+    // A payload still in the slot was never taken, even if pubsub_wait()
+    // has already reported the topic, so replacing it loses it too
+    if ((sub->pending & bit) || (old != NULL)) {
+        pubsubStats[topic].overwritten++;
+    }
+    if (!(sub->pending & bit)) {
+        sub->published[topic] = now;
+        sub->pending |= bit;
+    }
+    if (msg != NULL) {
+        msgpool_ref(msg, 1);
+    }
+    sub->payload[topic] = msg;
+    return old;
+}
+
+/**
+ * Publish to a topic. Every subscriber to the topic is notified and given its
+ * own reference to the payload; the caller keeps its reference and should
+ * free it afterwards.
+ * @param topic The topic ID
+ * @param msg A msgpool block, or NULL
+ * @returns The number of subscribers notified
+ */
+int pubsub_publish(uint8_t topic, void *msg) {
+    uint32_t now;
+    int count = 0;
+
+    if (topic >= configPUBSUB_TOPICS) return 0;
+    pubsubTIMESTAMP(now);
+
+    for (int i = 0; i < configPUBSUB_MAX_SUBSCRIBERS; i++) {
+        void *old = NULL;
+        TaskHandle_t task = NULL;
+
+        taskENTER_CRITICAL();
+        pubsub_subscriber_t *sub = pubsubSubscriber[i];
+        if ((sub != NULL) && (sub->mask & pubsubTOPIC(topic))) {
+            old = pubsub_deliver(sub, topic, msg, now);
+            task = sub->task;
+        }
+        taskEXIT_CRITICAL();
+
+        if (task != NULL) {
+            if (old != NULL) msgpool_free(old);
+            xTaskNotify(task, pubsubTOPIC(topic), eSetBits);
+            count++;
+        }
+    }
+
+    taskENTER_CRITICAL();
+    pubsubStats[topic].published++;
+    taskEXIT_CRITICAL();
+    return count;
+}
+
+/**
+ * Publish to a topic from an interrupt handler
+ * @param topic The topic ID
+ * @param msg A msgpool block, or NULL
+ * @param woken Set to pdTRUE if a subscriber of higher priority than the
+ *              interrupted task was woken
+ * @returns The number of subscribers notified
+ */
+int pubsub_publish_from_isr(uint8_t topic, void *msg, BaseType_t *woken) {
+    uint32_t now;
+    int count = 0;
+
+    if (topic >= configPUBSUB_TOPICS) return 0;
+    pubsubTIMESTAMP(now);
+
+    for (int i = 0; i < configPUBSUB_MAX_SUBSCRIBERS; i++) {
+        void *old = NULL;
+        TaskHandle_t task = NULL;
+
+        UBaseType_t status = taskENTER_CRITICAL_FROM_ISR();
+        pubsub_subscriber_t *sub = pubsubSubscriber[i];
+        if ((sub != NULL) && (sub->mask & pubsubTOPIC(topic))) {
+            old = pubsub_deliver(sub, topic, msg, now);
+            task = sub->task;
+        }
+        taskEXIT_CRITICAL_FROM_ISR(status);
+
+        if (task != NULL) {
+            if (old != NULL) msgpool_free_from_isr(old, woken);
+            xTaskNotifyFromISR(task, pubsubTOPIC(topic), eSetBits, woken);
+            count++;
+        }
+    }
+
+    UBaseType_t status = taskENTER_CRITICAL_FROM_ISR();
+    pubsubStats[topic].published++;
+    taskEXIT_CRITICAL_FROM_ISR(status);
+    return count;
+}
+
+/**
+ * Wait for any of the subscribed topics to be published
+ * @param sub The calling task's subscriber record
+ * @param timeout How long to wait, in ticks
+ * @returns The pubsubTOPIC() bits of the topics published, 0 on timeout
+ */
+uint32_t pubsub_wait(pubsub_subscriber_t *sub, TickType_t timeout) {
+    uint32_t bits = 0;
+    uint32_t now;
+    TimeOut_t start;
+
+    vTaskSetTimeOutState(&start);
+    for (;;) {
+        // Only this subscriber's bits are cleared so nothing else is lost
+        if (xTaskNotifyWait(0, sub->mask, &bits, timeout) != pdTRUE) return 0;
+        bits &= sub->mask;
+        if (bits != 0) break;
+        // Woken for a topic since dropped from the filter, so wait again for
+        // whatever is left of the timeout
+        if (xTaskCheckForTimeOut(&start, &timeout) != pdFALSE) return 0;
+    }
+    pubsubTIMESTAMP(now);
+
+    taskENTER_CRITICAL();
+    for (uint8_t t = 0; t < configPUBSUB_TOPICS; t++) {
+        if (!(bits & sub->pending & pubsubTOPIC(t))) continue;
+        uint32_t latency = now - sub->published[t];
+        pubsub_stats_t *s = &pubsubStats[t];
+        if ((s->delivered == 0) || (latency < s->latencyMin)) s->latencyMin = latency;
+        if (latency > s->latencyMax) s->latencyMax = latency;
+        s->latencyTotal += latency;
+        s->delivered++;
+    }
+    sub->pending &= ~bits;
+    taskEXIT_CRITICAL();
+    return bits;
+}
+
+/**
+ * Take the payload of a topic from a subscriber's slot
+ * @param sub The calling task's subscriber record
+ * @param topic The topic ID
+ * @returns The payload, which the caller must free, or NULL if there is none
+ */
+void *pubsub_take(pubsub_subscriber_t *sub, uint8_t topic) {
+    void *msg;
+    if (topic >= configPUBSUB_TOPICS) return NULL;
+
+    taskENTER_CRITICAL();
+    msg = sub->payload[topic];
+    sub->payload[topic] = NULL;
+    taskEXIT_CRITICAL();
+    return msg;
+}
+
+/**
+ * Take a copy of the counters for a topic
+ * @param topic The topic ID
+ * @param stats The structure to copy the counters into
+ * @returns 1 if the topic exists, 0 otherwise
+ */
+int pubsub_get_stats(uint8_t topic, pubsub_stats_t *stats) {
+    if (topic >= configPUBSUB_TOPICS) return 0;
+    taskENTER_CRITICAL();
+    memcpy(stats, &pubsubStats[topic], sizeof(pubsub_stats_t));
+    taskEXIT_CRITICAL();
+    return 1;
+}
+
+void pubsub_reset_stats() {
+    taskENTER_CRITICAL();
+    memset(pubsubStats, 0, sizeof(pubsubStats));
+    taskEXIT_CRITICAL();
+}
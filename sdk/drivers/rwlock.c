@@ -0,0 +1,409 @@
+/**
+ * @file rwlock.c
+ * Reader/writer lock for data that many tasks read and few write, such as
+ * configuration tables, where a mutex would make the readers queue behind
+ * each other for no reason.
+ *
+ * Readers get in with nothing more than a critical section while no writer
+ * holds or is waiting for the lock. A writer takes the gate, a FreeRTOS
+ * mutex it holds until it unlocks, and then waits for the readers already
+ * inside to leave. Readers that arrive while a writer is in or waiting queue
+ * on the gate instead, so writers are not starved, and since the gate is a
+ * mutex the tasks queueing on it lend their priority to the writer.
+ *
+ * Priority inheritance also works the other way. Each read hold counts as a
+ * mutex held by the reader, so while a writer waits for readers to leave it
+ * raises them to its own priority with the kernel's mutex inheritance, and
+ * each reader drops back when it unlocks (and holds no other mutex).
+ * Only the first configRWLOCK_MAX_READERS readers are tracked for this; any
+ * more still work but are not raised.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "sdk/cpu.h"
+#include "sdk/uart.h"
+#include "sdk/amutex.h"
+#include "sdk/rwlock.h"
+
+#if (configUSE_MUTEXES != 1)
+#error The reader/writer lock needs configUSE_MUTEXES
+#endif
+
+// Reads the clock the waits are measured with. The core timer unless
+// FreeRTOSConfig.h picks another, as the host tests do.
+#ifndef rwlockTIMESTAMP
+#define rwlockTIMESTAMP(dest) cpu_ct_read_count(dest)
+#endif
+
+/**
+ * Create a reader/writer lock
+ * @param lock The lock
+ * @returns 1 if the lock was created, 0 otherwise
+ */
+int rwlock_init(rwlock_t *lock) {
+    memset(lock, 0, sizeof(rwlock_t));
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    lock->gate = xSemaphoreCreateMutexStatic(&lock->gateBuffer);
+    lock->drained = xSemaphoreCreateBinaryStatic(&lock->drainedBuffer);
+#else
+    lock->gate = xSemaphoreCreateMutex();
+    lock->drained = xSemaphoreCreateBinary();
+#endif
+    return (lock->gate != NULL) && (lock->drained != NULL);
+}
+
+// Must be called in a critical section
+static int rwlock_is_reader(rwlock_t *lock, TaskHandle_t self) {
+    for (int i = 0; i < configRWLOCK_MAX_READERS; i++) {
+        if (lock->reader[i] == self) return 1;
+    }
+    return 0;
+}
+
+// Must be called in a critical section
+static void rwlock_add_reader(rwlock_t *lock, TaskHandle_t self) {
+    lock->readers++;
+    if (lock->readers > lock->stats.maxReaders) lock->stats.maxReaders = lock->readers;
+    lock->stats.reads++;
+    for (int i = 0; i < configRWLOCK_MAX_READERS; i++) {
+        if (lock->reader[i] == NULL) {
+            lock->reader[i] = self;
+            (void)pvTaskIncrementMutexHeldCount();
+            break;
+        }
+    }
+}
+
+/**
+ * Take the lock for reading. A task may hold it for reading more than once,
+ * but must not then ask for it for writing. A task that already holds it
+ * for reading gets in again even while a writer is waiting, as the writer
+ * is waiting for it; this needs it to be one of the tracked readers, so
+ * only nest read locks when there are at most configRWLOCK_MAX_READERS.
+ * @param lock The lock
+ * @param timeout How long to wait, in ticks, if a writer has the lock
+ * @returns 1 if the lock was taken, 0 on timeout
+ */
+int rwlock_read_lock(rwlock_t *lock, TickType_t timeout) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    uint32_t start, now;
+
+    taskENTER_CRITICAL();
+    if (((lock->writer == NULL) && (lock->writersWaiting == 0)) || rwlock_is_reader(lock, self)) {
+        rwlock_add_reader(lock, self);
+        taskEXIT_CRITICAL();
+        return 1;
+    }
+    taskEXIT_CRITICAL();
+
+    // Queue behind the writer, lending it our priority
+    rwlockTIMESTAMP(start);
+    if (xSemaphoreTake(lock->gate, timeout) != pdTRUE) {
+        taskENTER_CRITICAL();
+        lock->stats.timeouts++;
+        taskEXIT_CRITICAL();
+        return 0;
+    }
+    rwlockTIMESTAMP(now);
+
+    taskENTER_CRITICAL();
+    rwlock_add_reader(lock, self);
+    lock->stats.readContended++;
+    if ((now - start) > lock->stats.readWaitMax) lock->stats.readWaitMax = now - start;
+    taskEXIT_CRITICAL();
+
+    xSemaphoreGive(lock->gate);
+    return 1;
+}
+
+void rwlock_read_unlock(rwlock_t *lock) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    BaseType_t yield = pdFALSE;
+    int drained = 0;
+
+    taskENTER_CRITICAL();
+    for (int i = 0; i < configRWLOCK_MAX_READERS; i++) {
+        if (lock->reader[i] == self) {
+            lock->reader[i] = NULL;
+            // Drops any priority lent by a writer, unless we hold a mutex too
+            yield = xTaskPriorityDisinherit(self);
+            break;
+        }
+    }
+    lock->readers--;
+    drained = (lock->readers == 0) && (lock->writer != NULL);
+    taskEXIT_CRITICAL();
+
+    if (drained) {
+        xSemaphoreGive(lock->drained);
+    }
+    if (yield) {
+        taskYIELD();
+    }
+}
+
+/**
+ * Take the lock for writing. Readers that arrive after this is called wait
+ * until the writer has finished.
+ * @param lock The lock
+ * @param timeout How long to wait, in ticks, for other writers and then for
+ *                the readers to leave
+ * @returns 1 if the lock was taken, 0 on timeout
+ */
+int rwlock_write_lock(rwlock_t *lock, TickType_t timeout) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    TimeOut_t timeOut;
+    uint32_t start, now;
+    int contended = 0;
+
+    vTaskSetTimeOutState(&timeOut);
+    rwlockTIMESTAMP(start);
+
+    taskENTER_CRITICAL();
+    lock->writersWaiting++;
+    taskEXIT_CRITICAL();
+
+    if (xSemaphoreTake(lock->gate, 0) != pdTRUE) {
+        contended = 1;
+        if (xSemaphoreTake(lock->gate, timeout) != pdTRUE) {
+            taskENTER_CRITICAL();
+            lock->writersWaiting--;
+            lock->stats.timeouts++;
+            taskEXIT_CRITICAL();
+            return 0;
+        }
+    }
+
+    // Clear a wake left over from a writer that gave up
+    xSemaphoreTake(lock->drained, 0);
+
+    taskENTER_CRITICAL();
+    lock->writersWaiting--;
+    lock->writer = self;
+    if (lock->readers > 0) {
+        for (int i = 0; i < configRWLOCK_MAX_READERS; i++) {
+            if (lock->reader[i] != NULL) {
+                xTaskPriorityInherit(lock->reader[i]);
+            }
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    while (lock->readers > 0) {
+        contended = 1;
+        if ((xTaskCheckForTimeOut(&timeOut, &timeout) == pdTRUE) || (xSemaphoreTake(lock->drained, timeout) != pdTRUE)) {
+            taskENTER_CRITICAL();
+            lock->writer = NULL;
+            for (int i = 0; i < configRWLOCK_MAX_READERS; i++) {
+                if ((lock->reader[i] != NULL) && (lock->reader[i] != self)) {
+                    vTaskPriorityDisinheritAfterTimeout(lock->reader[i], tskIDLE_PRIORITY);
+                }
+            }
+            lock->stats.timeouts++;
+            taskEXIT_CRITICAL();
+            xSemaphoreGive(lock->gate);
+            return 0;
+        }
+    }
+
+    rwlockTIMESTAMP(now);
+    taskENTER_CRITICAL();
+    lock->stats.writes++;
+    if (contended) {
+        lock->stats.writeContended++;
+        if ((now - start) > lock->stats.writeWaitMax) lock->stats.writeWaitMax = now - start;
+    }
+    taskEXIT_CRITICAL();
+    return 1;
+}
+
+void rwlock_write_unlock(rwlock_t *lock) {
+    taskENTER_CRITICAL();
+    lock->writer = NULL;
+    taskEXIT_CRITICAL();
+    xSemaphoreGive(lock->gate);
+}
+
+/**
+ * Take a copy of the contention counters
+ * @param lock The lock
+ * @param stats The structure to copy the counters into
+ * @returns 1
+ */
+int rwlock_get_stats(rwlock_t *lock, rwlock_stats_t *stats) {
+    taskENTER_CRITICAL();
+    memcpy(stats, &lock->stats, sizeof(rwlock_stats_t));
+    taskEXIT_CRITICAL();
+    return 1;
+}
+
+void rwlock_reset_stats(rwlock_t *lock) {
+    taskENTER_CRITICAL();
+    memset(&lock->stats, 0, sizeof(rwlock_stats_t));
+    taskEXIT_CRITICAL();
+}
+
+#if (configUSE_RWLOCK_BENCHMARK == 1) && (configSUPPORT_DYNAMIC_ALLOCATION == 1)
+
+#define rwlockBENCH_MAX_TASKS 16
+#define rwlockBENCH_READ_US 10
+#define rwlockBENCH_WRITE_US 20
+#define rwlockBENCH_IDLE_US 5
+
+enum { rwlockBENCH_MUTEX, rwlockBENCH_AMUTEX, rwlockBENCH_RWLOCK };
+
+static TaskHandle_t rwlockBenchCaller = NULL;
+static SemaphoreHandle_t rwlockBenchMutex = NULL;
+static amutex_t rwlockBenchAmutex;
+static rwlock_t rwlockBenchLock;
+static volatile uint8_t rwlockBenchMode;
+static volatile uint8_t rwlockBenchStop;
+static volatile uint32_t rwlockBenchReads;
+static volatile uint32_t rwlockBenchWrites;
+
+static void rwlock_bench_busy(uint32_t us) {
+    uint32_t start, now;
+    const uint32_t ticks = us * (cpu_get_system_clock() / 2000000);
+    cpu_ct_read_count(start);
+    do {
+        cpu_ct_read_count(now);
+    } while ((now - start) < ticks);
+}
+
+static void rwlock_bench_worker(void *params) {
+    const int writer = (int)params;
+
+    while (!rwlockBenchStop) {
+        switch (rwlockBenchMode) {
+            case rwlockBENCH_MUTEX:
+                xSemaphoreTake(rwlockBenchMutex, portMAX_DELAY);
+                rwlock_bench_busy(writer ? rwlockBENCH_WRITE_US : rwlockBENCH_READ_US);
+                xSemaphoreGive(rwlockBenchMutex);
+                break;
+            case rwlockBENCH_AMUTEX:
+                amutex_lock(&rwlockBenchAmutex, portMAX_DELAY);
+                rwlock_bench_busy(writer ? rwlockBENCH_WRITE_US : rwlockBENCH_READ_US);
+                amutex_unlock(&rwlockBenchAmutex);
+                break;
+            default:
+                if (writer) {
+                    rwlock_write_lock(&rwlockBenchLock, portMAX_DELAY);
+                    rwlock_bench_busy(rwlockBENCH_WRITE_US);
+                    rwlock_write_unlock(&rwlockBenchLock);
+                } else {
+                    rwlock_read_lock(&rwlockBenchLock, portMAX_DELAY);
+                    rwlock_bench_busy(rwlockBENCH_READ_US);
+                    rwlock_read_unlock(&rwlockBenchLock);
+                }
+                break;
+        }
+        taskENTER_CRITICAL();
+        if (writer) {
+            rwlockBenchWrites++;
+        } else {
+            rwlockBenchReads++;
+        }
+        taskEXIT_CRITICAL();
+        rwlock_bench_busy(rwlockBENCH_IDLE_US);
+    }
+
+    xTaskNotifyGive(rwlockBenchCaller);
+    vTaskSuspend(NULL);
+}
+
+static int rwlock_bench_run(uint8_t mode, uint8_t readers, uint8_t writers, uint32_t ms) {
+    TaskHandle_t worker[rwlockBENCH_MAX_TASKS] = {NULL};
+    const UBaseType_t priority = uxTaskPriorityGet(NULL);
+    uint8_t created = 0;
+    int ok = 1;
+
+    rwlockBenchMode = mode;
+    rwlockBenchStop = 0;
+    rwlockBenchReads = 0;
+    rwlockBenchWrites = 0;
+
+    // Stay above the workers so that we get back in to stop them
+    vTaskPrioritySet(NULL, priority + 1);
+    for (uint8_t i = 0; i < readers + writers; i++) {
+        if (xTaskCreate(rwlock_bench_worker, "RWBench", configMINIMAL_STACK_SIZE + 64, (void *)(int)(i >= readers),
+                priority, &worker[i]) != pdPASS) {
+            ok = 0;
+            break;
+        }
+        created++;
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(ms));
+    rwlockBenchStop = 1;
+    vTaskPrioritySet(NULL, priority);
+    for (uint8_t i = 0; i < created; i++) {
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+    }
+    for (uint8_t i = 0; i < created; i++) {
+        vTaskDelete(worker[i]);
+    }
+    return ok;
+}
+
+/**
+ * Compare a FreeRTOS mutex, an adaptive mutex and the reader/writer lock
+ * with the same tasks contending for each, printing the throughput and
+ * contention counters to a UART. The mutexes make the readers exclusive too.
+ * Every worker runs at the caller's priority.
+ * @param uart The UART (which must be open) to print to
+ * @param readers The number of reader tasks
+ * @param writers The number of writer tasks
+ * @param ms How long to run each lock for, in milliseconds
+ * @returns 1 if the benchmark ran, 0 otherwise
+ */
+int rwlock_benchmark(uint8_t uart, uint8_t readers, uint8_t writers, uint32_t ms) {
+    static const char *name[] = { "mutex", "amutex", "rwlock" };
+    char line[100];
+
+    if (!uart_is_open(uart) || (readers + writers == 0) || (readers + writers > rwlockBENCH_MAX_TASKS) || (ms == 0)) return 0;
+
+    rwlockBenchCaller = xTaskGetCurrentTaskHandle();
+    rwlockBenchMutex = xSemaphoreCreateMutex();
+    if ((rwlockBenchMutex == NULL) || !amutex_init(&rwlockBenchAmutex, rwlockBENCH_WRITE_US) || !rwlock_init(&rwlockBenchLock)) return 0;
+
+    sprintf(line, "%u readers, %u writers, %lu ms each\r\n", readers, writers, (unsigned long)ms);
+    uart_write_bytes(uart, (const uint8_t *)line, strlen(line));
+    for (uint8_t mode = rwlockBENCH_MUTEX; mode <= rwlockBENCH_RWLOCK; mode++) {
+        if (!rwlock_bench_run(mode, readers, writers, ms)) return 0;
+        sprintf(line, "%-6s %8lu reads/s %8lu writes/s\r\n", name[mode],
+            (unsigned long)((uint64_t)rwlockBenchReads * 1000 / ms), (unsigned long)((uint64_t)rwlockBenchWrites * 1000 / ms));
+        uart_write_bytes(uart, (const uint8_t *)line, strlen(line));
+    }
+
+    amutex_stats_t a;
+    amutex_get_stats(&rwlockBenchAmutex, &a);
+    sprintf(line, "amutex: %lu uncontended, %lu spun (max %lu ticks), %lu blocked\r\n", (unsigned long)a.uncontended,
+        (unsigned long)a.spun, (unsigned long)a.spinMax, (unsigned long)a.blocked);
+    uart_write_bytes(uart, (const uint8_t *)line, strlen(line));
+
+    rwlock_stats_t r;
+    rwlock_get_stats(&rwlockBenchLock, &r);
+    sprintf(line, "rwlock: %lu/%lu reads/writes contended, %u readers max, wait max %lu/%lu ticks\r\n",
+        (unsigned long)r.readContended, (unsigned long)r.writeContended, r.maxReaders,
+        (unsigned long)r.readWaitMax, (unsigned long)r.writeWaitMax);
+    uart_write_bytes(uart, (const uint8_t *)line, strlen(line));
+
+    vSemaphoreDelete(rwlockBenchMutex);
+    vSemaphoreDelete(rwlockBenchAmutex.mutex);
+    vSemaphoreDelete(rwlockBenchLock.gate);
+    vSemaphoreDelete(rwlockBenchLock.drained);
+    return 1;
+}
+
+#else
+
+int rwlock_benchmark(uint8_t uart, uint8_t readers, uint8_t writers, uint32_t ms) {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,299 @@
+/**
+ * @file stackwatch.c
+ * Stack usage monitor. A low priority task periodically samples the stack
+ * high water mark of every task, and the fill pattern left in the ISR stack,
+ * keeping the lowest free space ever seen along with a short history of
+ * recent samples.
+ *
+ * Tasks whose allocated stack size is known (the idle and timer tasks, the
+ * sampler itself and anything passed to stackwatch_register()) also get a
+ * recommended size: the measured usage plus a safety margin. These can be
+ * written out with stackwatch_dump_config() as a measured_stacks.h file which
+ * FreeRTOSConfig.h picks up when configUSE_MEASURED_STACK_SIZES is set, so
+ * that the stacks are shrunk to fit on the next build.
+ *
+ * The recommendations are only as good as the workload that was running
+ * while the samples were taken, so exercise every code path first.
+ */
+#include <p32xxxx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+#include "sdk/uart.h"
+#include "sdk/stackwatch.h"
+
+#if (configUSE_STACKWATCH == 1)
+
+#define stackwatchISR_FILL_BYTE 0xee
+
+static stackwatch_entry_t stackwatchEntry[configSTACKWATCH_MAX_TASKS];
+static uint8_t stackwatchEntries = 0;
+static TaskHandle_t stackwatchTask = NULL;
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+static StackType_t stackwatchStack[configSTACKWATCH_STACK_SIZE] portSTATIC_STORAGE;
+static StaticTask_t stackwatchTaskBuffer portSTATIC_STORAGE;
+#endif
+
+/**
+ * Find the entry for a task, optionally creating it. Must be called with
+ * the scheduler suspended or from a critical section.
+ * @param task The task to look up
+ * @param create Create a new entry if none exists
+ * @returns The entry, or NULL if not found or the table is full
+ */
+static stackwatch_entry_t *stackwatch_find(TaskHandle_t task, int create) {
+    for (int i = 0; i < stackwatchEntries; i++) {
+        if (stackwatchEntry[i].task == task) {
+            return &stackwatchEntry[i];
+        }
+    }
+    if (!create || (stackwatchEntries >= configSTACKWATCH_MAX_TASKS)) {
+        return NULL;
+    }
+    stackwatch_entry_t *e = &stackwatchEntry[stackwatchEntries++];
+    memset(e, 0, sizeof(stackwatch_entry_t));
+    e->task = task;
+    e->lowest = 0xFFFFFFFF;
+    return e;
+}
+
+/**
+ * Tell the monitor how large a task's stack is so that usage and a size
+ * recommendation can be reported for it.
+ * @param task The task
+ * @param size The stack depth (in words) the task was created with
+ * @param macro The name of the config macro that sets the stack size, used
+ *              by stackwatch_dump_config(), or NULL
+ * @returns 1 if the task was registered, 0 if the table is full
+ */
+int stackwatch_register(TaskHandle_t task, uint32_t size, const char *macro) {
+    int ok = 0;
+    taskENTER_CRITICAL();
+    stackwatch_entry_t *e = stackwatch_find(task, 1);
+    if (e != NULL) {
+        e->size = size;
+        e->macro = macro;
+        ok = 1;
+    }
+    taskEXIT_CRITICAL();
+    return ok;
+}
+
+/**
+ * Get the amount of ISR stack that has never been used
+ * @returns The free space in words, or 0 if the ISR stack is not being filled
+ *          (configCHECK_FOR_STACK_OVERFLOW less than 3)
+ */
+uint32_t stackwatch_isr_free() {
+#if (configCHECK_FOR_STACK_OVERFLOW > 2)
+    extern StackType_t xISRStack[];
+    const uint8_t *p = (const uint8_t *)xISRStack;
+    uint32_t i = 0;
+
+    // The stack grows down so the untouched fill is at the bottom
+    while ((i < sizeof(StackType_t) * configISR_STACK_SIZE) && (p[i] == stackwatchISR_FILL_BYTE)) {
+        i++;
+    }
+    return i / sizeof(StackType_t);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Take one sample of every task's stack high water mark. This is called
+ * periodically by the monitor task but may also be called directly.
+ */
+void stackwatch_sample() {
+    static TaskStatus_t status[configSTACKWATCH_MAX_TASKS];
+
+    // Fails (returning 0) if there are more tasks than configSTACKWATCH_MAX_TASKS
+    UBaseType_t count = uxTaskGetSystemState(status, configSTACKWATCH_MAX_TASKS, NULL);
+
+    vTaskSuspendAll();
+    for (UBaseType_t i = 0; i < count; i++) {
+        stackwatch_entry_t *e = stackwatch_find(status[i].xHandle, 1);
+        if (e == NULL) continue;
+
+        if (e->name[0] == 0) {
+            strncpy(e->name, status[i].pcTaskName, configMAX_TASK_NAME_LEN - 1);
+        }
+
+        if (e->size == 0) {
+            if (status[i].xHandle == xTaskGetIdleTaskHandle()) {
+                e->size = configMINIMAL_STACK_SIZE;
+                e->macro = "configMINIMAL_STACK_SIZE";
+            }
+#if (configUSE_TIMERS == 1)
+            else if (status[i].xHandle == xTimerGetTimerDaemonTaskHandle()) {
+                e->size = configTIMER_TASK_STACK_DEPTH;
+                e->macro = "configTIMER_TASK_STACK_DEPTH";
+            }
+#endif
+        }
+
+        uint32_t free = status[i].usStackHighWaterMark;
+        if (free < e->lowest) e->lowest = free;
+        e->history[e->next] = free;
+        e->next = (e->next + 1) % configSTACKWATCH_HISTORY;
+        if (e->samples < configSTACKWATCH_HISTORY) e->samples++;
+    }
+    xTaskResumeAll();
+}
+
+/**
+ * Take a copy of one monitor entry
+ * @param index The entry number, starting at 0
+ * @param entry The structure to copy the entry into
+ * @returns 1 if the entry exists, 0 otherwise
+ */
+int stackwatch_get_entry(uint8_t index, stackwatch_entry_t *entry) {
+    int ok = 0;
+    vTaskSuspendAll();
+    if (index < stackwatchEntries) {
+        memcpy(entry, &stackwatchEntry[index], sizeof(stackwatch_entry_t));
+        ok = 1;
+    }
+    xTaskResumeAll();
+    return ok;
+}
+
+/**
+ * Calculate the recommended stack size for a measured usage
+ * @param used The largest number of words seen in use
+ * @returns The recommended stack size in words
+ */
+uint32_t stackwatch_recommend(uint32_t used) {
+    uint32_t margin = used * configSTACKWATCH_MARGIN_PERCENT / 100;
+    if (margin < configSTACKWATCH_MARGIN_MIN) {
+        margin = configSTACKWATCH_MARGIN_MIN;
+    }
+    // Keep the stack a multiple of 8 bytes for the ABI alignment
+    return (used + margin + 1) & ~1UL;
+}
+
+static void stackwatch_monitor(void *params) {
+    TickType_t last = xTaskGetTickCount();
+    for (;;) {
+        stackwatch_sample();
+        vTaskDelayUntil(&last, pdMS_TO_TICKS(configSTACKWATCH_PERIOD_MS));
+    }
+}
+
+/**
+ * Start the monitor task.
+ * @returns 1 if the monitor was started, 0 otherwise
+ */
+int stackwatch_start() {
+    if (stackwatchTask != NULL) return 0;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    stackwatchTask = xTaskCreateStatic(stackwatch_monitor, "StkMon", configSTACKWATCH_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, stackwatchStack, &stackwatchTaskBuffer);
+    if (stackwatchTask == NULL) return 0;
+#else
+    if (xTaskCreate(stackwatch_monitor, "StkMon", configSTACKWATCH_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, &stackwatchTask) != pdPASS) {
+        stackwatchTask = NULL;
+        return 0;
+    }
+#endif
+    stackwatch_register(stackwatchTask, configSTACKWATCH_STACK_SIZE, "configSTACKWATCH_STACK_SIZE");
+    return 1;
+}
+
+static int stackwatch_print(uint8_t uart, const char *str) {
+    return uart_write_bytes(uart, (const uint8_t *)str, strlen(str));
+}
+
+/**
+ * Print the stack usage of every task, and the ISR stack, to a UART
+ * @param uart The UART (which must be open) to print to
+ * @returns 1 if the report was printed, 0 otherwise
+ */
+int stackwatch_report(uint8_t uart) {
+    char line[80];
+    stackwatch_entry_t e;
+
+    if (!uart_is_open(uart)) return 0;
+
+    stackwatch_print(uart, "Task      size  used lowest recommend  history (free)\r\n");
+    for (uint8_t i = 0; stackwatch_get_entry(i, &e); i++) {
+        if (e.samples == 0) continue;
+        if (e.size != 0) {
+            uint32_t used = e.size - e.lowest;
+            sprintf(line, "%-8s %5lu %5lu %6lu %9lu ", e.name, (unsigned long)e.size,
+                (unsigned long)used, (unsigned long)e.lowest, (unsigned long)stackwatch_recommend(used));
+        } else {
+            sprintf(line, "%-8s     ?     ? %6lu         ? ", e.name, (unsigned long)e.lowest);
+        }
+        stackwatch_print(uart, line);
+
+        // Oldest sample first
+        uint8_t pos = (e.samples < configSTACKWATCH_HISTORY) ? 0 : e.next;
+        for (uint8_t s = 0; s < e.samples; s++) {
+            sprintf(line, " %u", e.history[pos]);
+            stackwatch_print(uart, line);
+            pos = (pos + 1) % configSTACKWATCH_HISTORY;
+        }
+        stackwatch_print(uart, "\r\n");
+    }
+
+#if (configCHECK_FOR_STACK_OVERFLOW > 2)
+    uint32_t isrFree = stackwatch_isr_free();
+    uint32_t isrUsed = configISR_STACK_SIZE - isrFree;
+    sprintf(line, "%-8s %5lu %5lu %6lu %9lu\r\n", "(ISR)", (unsigned long)configISR_STACK_SIZE,
+        (unsigned long)isrUsed, (unsigned long)isrFree, (unsigned long)stackwatch_recommend(isrUsed));
+    stackwatch_print(uart, line);
+#endif
+    return 1;
+}
+
+/**
+ * Print a measured_stacks.h file containing the recommended size for every
+ * stack that has a config macro. Save the output as
+ * sdk/freertos/targets/MZ/measured_stacks.h and set
+ * configUSE_MEASURED_STACK_SIZES to build with the measured sizes.
+ * @param uart The UART (which must be open) to print to
+ * @returns 1 if the file was printed, 0 otherwise
+ */
+int stackwatch_dump_config(uint8_t uart) {
+    char line[80];
+    stackwatch_entry_t e, other;
+
+    if (!uart_is_open(uart)) return 0;
+
+    stackwatch_print(uart, "/* Generated by stackwatch_dump_config() */\r\n");
+    for (uint8_t i = 0; stackwatch_get_entry(i, &e); i++) {
+        if ((e.macro == NULL) || (e.size == 0) || (e.samples == 0)) continue;
+
+        // Several tasks may share a macro; emit it once with the largest size
+        int seen = 0;
+        uint32_t rec = stackwatch_recommend(e.size - e.lowest);
+        for (uint8_t j = 0; stackwatch_get_entry(j, &other); j++) {
+            if ((j == i) || (other.macro == NULL) || (other.samples == 0)) continue;
+            if (strcmp(other.macro, e.macro) != 0) continue;
+            if (j < i) {
+                seen = 1;
+                break;
+            }
+            uint32_t r = stackwatch_recommend(other.size - other.lowest);
+            if (r > rec) rec = r;
+        }
+        if (seen) continue;
+
+        sprintf(line, "#define %-32s %lu\r\n", e.macro, (unsigned long)rec);
+        stackwatch_print(uart, line);
+    }
+
+#if (configCHECK_FOR_STACK_OVERFLOW > 2)
+    sprintf(line, "#define %-32s %lu\r\n", "configISR_STACK_SIZE",
+        (unsigned long)stackwatch_recommend(configISR_STACK_SIZE - stackwatch_isr_free()));
+    stackwatch_print(uart, line);
+#endif
+    return 1;
+}
+
+#endif
@@ -0,0 +1,200 @@
+/**
+ * @file switchbench.c
+ * Context switch benchmark. Two tasks hand control back and forth with task
+ * notifications and the core timer is read on each side of every switch, so
+ * the result is the cost of a notify, a full switch through vPortYieldISR and
+ * the return from the wait.
+ *
+ * Either task can be made to use the FPU between switches. Running the same
+ * benchmark in a build with configUSE_LAZY_FPU_SWITCHING set and one without
+ * compares the two ways the port handles FPU state: eager switching pays for
+ * the FPU registers on every switch into or out of an FPU task, lazy switching
+ * only when a different task starts using the FPU.
+ *
+ * The calling task must have a priority below configMAX_PRIORITIES - 2, the
+ * benchmark tasks run above everything else until they have finished.
+ */
+#include <p32xxxx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "sdk/cpu.h"
+#include "sdk/uart.h"
+#include "sdk/switchbench.h"
+
+#if (configUSE_SWITCH_BENCHMARK == 1)
+
+#define switchbenchSTACK_SIZE (configMINIMAL_STACK_SIZE + 64)
+
+#if (portLAZY_FPU_SWITCHING == 1)
+extern volatile uint32_t ulPortFPUOwnerChanges;
+#endif
+
+static TaskHandle_t switchbenchCaller = NULL;
+static TaskHandle_t switchbenchPong = NULL;
+static uint32_t switchbenchIterations = 0;
+static uint8_t switchbenchFpuTasks = 0;
+
+static volatile uint32_t switchbenchStamp = 0;
+static uint32_t switchbenchMin = 0;
+static uint32_t switchbenchMax = 0;
+static uint64_t switchbenchTotal = 0;
+static uint32_t switchbenchCount = 0;
+
+static volatile double switchbenchAccumulator = 1.0;
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+static StackType_t switchbenchStack[2][switchbenchSTACK_SIZE] portSTATIC_STORAGE;
+static StaticTask_t switchbenchTaskBuffer[2] portSTATIC_STORAGE;
+#endif
+
+static void switchbench_record() {
+    uint32_t now;
+    cpu_ct_read_count(now);
+
+    // The core timer runs at half the CPU clock
+    uint32_t cycles = (now - switchbenchStamp) * 2;
+    if (cycles < switchbenchMin) switchbenchMin = cycles;
+    if (cycles > switchbenchMax) switchbenchMax = cycles;
+    switchbenchTotal += cycles;
+    switchbenchCount++;
+}
+
+static void switchbench_fpu_work(int enabled) {
+    if (enabled) {
+        switchbenchAccumulator = switchbenchAccumulator * 1.000001 + 0.5;
+    }
+}
+
+static void switchbench_uses_fpu(int enabled) {
+#if (__mips_hard_float == 1) && (configUSE_TASK_FPU_SUPPORT == 1)
+    if (enabled) {
+        portTASK_USES_FLOATING_POINT();
+    }
+#endif
+}
+
+// Higher priority side: woken by ping, records the switch in, then blocks
+// again which switches straight back to ping.
+static void switchbench_pong(void *params) {
+    switchbench_uses_fpu(switchbenchFpuTasks >= 1);
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        switchbench_record();
+        switchbench_fpu_work(switchbenchFpuTasks >= 1);
+        cpu_ct_read_count(switchbenchStamp);
+    }
+}
+
+static void switchbench_ping(void *params) {
+    switchbench_uses_fpu(switchbenchFpuTasks >= 2);
+    for (uint32_t i = 0; i < switchbenchIterations; i++) {
+        switchbench_fpu_work(switchbenchFpuTasks >= 2);
+        cpu_ct_read_count(switchbenchStamp);
+        xTaskNotifyGive(switchbenchPong);
+        switchbench_record();
+    }
+    xTaskNotifyGive(switchbenchCaller);
+    vTaskSuspend(NULL);
+}
+
+static TaskHandle_t switchbench_create(TaskFunction_t fn, const char *name, UBaseType_t prio, int index) {
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    return xTaskCreateStatic(fn, name, switchbenchSTACK_SIZE, NULL, prio, switchbenchStack[index], &switchbenchTaskBuffer[index]);
+#else
+    TaskHandle_t task = NULL;
+    if (xTaskCreate(fn, name, switchbenchSTACK_SIZE, NULL, prio, &task) != pdPASS) {
+        return NULL;
+    }
+    return task;
+#endif
+}
+
+/**
+ * Measure the context switch time between two tasks
+ * @param iterations The number of round trips, each of which is two switches
+ * @param fpuTasks How many of the two tasks use the FPU (0, 1 or 2)
+ * @param result Receives the timings in CPU cycles
+ * @returns 1 if the benchmark ran, 0 otherwise
+ */
+int switchbench_run(uint32_t iterations, uint8_t fpuTasks, switchbench_result_t *result) {
+    if ((iterations == 0) || (fpuTasks > 2)) return 0;
+    if (uxTaskPriorityGet(NULL) >= configMAX_PRIORITIES - 2) return 0;
+#if (__mips_hard_float == 0) || (configUSE_TASK_FPU_SUPPORT == 0)
+    if (fpuTasks != 0) return 0;
+#endif
+
+    switchbenchCaller = xTaskGetCurrentTaskHandle();
+    switchbenchIterations = iterations;
+    switchbenchFpuTasks = fpuTasks;
+    switchbenchMin = 0xFFFFFFFF;
+    switchbenchMax = 0;
+    switchbenchTotal = 0;
+    switchbenchCount = 0;
+
+#if (portLAZY_FPU_SWITCHING == 1)
+    uint32_t changes = ulPortFPUOwnerChanges;
+#endif
+
+    // Pong is created first so it is already waiting when ping starts
+    switchbenchPong = switchbench_create(switchbench_pong, "SwPong", configMAX_PRIORITIES - 1, 0);
+    if (switchbenchPong == NULL) return 0;
+    TaskHandle_t ping = switchbench_create(switchbench_ping, "SwPing", configMAX_PRIORITIES - 2, 1);
+    if (ping == NULL) {
+        vTaskDelete(switchbenchPong);
+        return 0;
+    }
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    vTaskDelete(ping);
+    vTaskDelete(switchbenchPong);
+
+    result->min = switchbenchMin;
+    result->max = switchbenchMax;
+    result->avg = (uint32_t)(switchbenchTotal / switchbenchCount);
+#if (portLAZY_FPU_SWITCHING == 1)
+    result->ownerChanges = ulPortFPUOwnerChanges - changes;
+#else
+    result->ownerChanges = 0;
+#endif
+    return 1;
+}
+
+static int switchbench_print(uint8_t uart, const char *str) {
+    return uart_write_bytes(uart, (const uint8_t *)str, strlen(str));
+}
+
+/**
+ * Run the benchmark with no, one and two FPU tasks and print the results
+ * to a UART
+ * @param uart The UART (which must be open) to print to
+ * @param iterations The number of round trips for each run
+ * @returns 1 if the report was printed, 0 otherwise
+ */
+int switchbench_report(uint8_t uart, uint32_t iterations) {
+    char line[80];
+    switchbench_result_t r;
+
+    if (!uart_is_open(uart)) return 0;
+
+#if (portLAZY_FPU_SWITCHING == 1)
+    switchbench_print(uart, "FPU switching: lazy\r\n");
+#elif (__mips_hard_float == 1) && (configUSE_TASK_FPU_SUPPORT == 1)
+    switchbench_print(uart, "FPU switching: eager\r\n");
+#else
+    switchbench_print(uart, "FPU switching: none\r\n");
+#endif
+    switchbench_print(uart, "FPU tasks   min   avg   max  owner changes (cycles per switch)\r\n");
+    for (uint8_t fpu = 0; fpu <= 2; fpu++) {
+        if (!switchbench_run(iterations, fpu, &r)) continue;
+        sprintf(line, "%9u %5lu %5lu %5lu %14lu\r\n", fpu, (unsigned long)r.min,
+            (unsigned long)r.avg, (unsigned long)r.max, (unsigned long)r.ownerChanges);
+        switchbench_print(uart, line);
+    }
+    return 1;
+}
+
+#endif
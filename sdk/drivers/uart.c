@@ -14,6 +14,7 @@
 #include "sdk/uart.h"
 #include "sdk/chipspec.h"
 #include "sdk/cpu.h"
+#include "sdk/isrprof.h"
 
 typedef struct {
     volatile p32_regset mode;
@@ -39,6 +40,18 @@ struct uartControlDataStruct {
     SemaphoreHandle_t writeSemaphore;
 };
 
+#define uartQUEUE_LENGTH 64
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+#if (configUART_TX_BUFFERED == 1)
+static StaticQueue_t uartTxQueue[__CHIP_HAS_UART] portSTATIC_STORAGE;
+static uint8_t uartTxStorage[__CHIP_HAS_UART][uartQUEUE_LENGTH * sizeof(uart_queue_t)] portSTATIC_STORAGE;
+#endif
+static StaticQueue_t uartRxQueue[__CHIP_HAS_UART] portSTATIC_STORAGE;
+static uint8_t uartRxStorage[__CHIP_HAS_UART][uartQUEUE_LENGTH * sizeof(uart_queue_t)] portSTATIC_STORAGE;
+static StaticSemaphore_t uartWriteMutex[__CHIP_HAS_UART] portSTATIC_STORAGE;
+#endif
+
 static struct uartControlDataStruct uartControlData[__CHIP_HAS_UART] = {
 #if (__CHIP_HAS_UART > 0)
     { QUEUES, "UART0", _UART1_TX_VECTOR, _UART1_RX_VECTOR, _UART1_FAULT_VECTOR, (p32_uart *)&U1MODE, NULL },
@@ -263,6 +276,20 @@ int uart_peek(uint8_t uart) {
     return b;
 }
 
+/**
+ * Block until there is data in the UART receive queue, without using the CPU
+ * while waiting. The RX interrupt wakes the task as soon as a byte arrives.
+ * @param uart The number of the UART (0-5) to wait on
+ * @param timeout The longest to wait, in ticks
+ * @returns 1 if there is data to read, 0 on timeout
+ */
+int uart_wait_rx(uint8_t uart, TickType_t timeout) {
+    if (uart >= __CHIP_HAS_UART) return 0;
+    if (uartControlData[uart].rxBuffer == NULL) return 0;
+    uart_queue_t b = 0;
+    return xQueuePeek(uartControlData[uart].rxBuffer, &b, timeout) == pdTRUE;
+}
+
 /** 
  * Configure the TX pin of the selected UART through PPS
  * @param uart The index of the UART
@@ -364,13 +391,22 @@ int uart_open(uint8_t uart) {
     if (uart >= __CHIP_HAS_UART) return 0;
 
 #if (configUART_TX_BUFFERED == 1)
-    uartControlData[uart].txBuffer = xQueueCreate(64, sizeof(uart_queue_t));
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    uartControlData[uart].txBuffer = xQueueCreateStatic(uartQUEUE_LENGTH, sizeof(uart_queue_t), uartTxStorage[uart], &uartTxQueue[uart]);
+#else
+    uartControlData[uart].txBuffer = xQueueCreate(uartQUEUE_LENGTH, sizeof(uart_queue_t));
+#endif
     cpu_set_interrupt_priority(uartControlData[uart].txVector, 2, 0);
     cpu_clear_interrupt_flag(uartControlData[uart].txVector);
 #endif
 
-    uartControlData[uart].rxBuffer = xQueueCreate(64, sizeof(uart_queue_t));
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    uartControlData[uart].rxBuffer = xQueueCreateStatic(uartQUEUE_LENGTH, sizeof(uart_queue_t), uartRxStorage[uart], &uartRxQueue[uart]);
+    uartControlData[uart].writeSemaphore = xSemaphoreCreateMutexStatic(&uartWriteMutex[uart]);
+#else
+    uartControlData[uart].rxBuffer = xQueueCreate(uartQUEUE_LENGTH, sizeof(uart_queue_t));
     uartControlData[uart].writeSemaphore = xSemaphoreCreateMutex();
+#endif
 
     cpu_set_interrupt_priority(uartControlData[uart].rxVector, 2, 0);
     cpu_clear_interrupt_flag(uartControlData[uart].rxVector);
@@ -423,78 +459,84 @@ int uart_close(uint8_t uart) {
 }
 
 static void inline uart_handle_rx(uint8_t uart) {
+    BaseType_t woken = pdFALSE;
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(uartControlData[uart].rxVector);
     if (uartControlData[uart].reg->sta.reg & 1) {
         uart_queue_t data = uartControlData[uart].reg->rxreg.reg;
         if (uxQueueSpacesAvailable(uartControlData[uart].rxBuffer) > 0) {
-            xQueueSendToBackFromISR(uartControlData[uart].rxBuffer, &data, NULL);
+            xQueueSendToBackFromISR(uartControlData[uart].rxBuffer, &data, &woken);
         }
     }
+    isrprof_exit(uartControlData[uart].rxVector, 2, start);
+    // Switch straight to a task blocked in uart_wait_rx()
+    portEND_SWITCHING_ISR(woken);
 }
 
 #if (__CHIP_HAS_UART > 0)
-void __ISR(_UART1_RX_VECTOR, IPL2AUTO) uart_0_rx() { uart_handle_rx(0); }
+void __ISR(_UART1_RX_VECTOR, cpuISR_IPL2) uart_0_rx() { uart_handle_rx(0); }
 #endif
 
 #if (__CHIP_HAS_UART > 1)
-void __ISR(_UART2_RX_VECTOR, IPL2AUTO) uart_1_rx() { uart_handle_rx(1); }
+void __ISR(_UART2_RX_VECTOR, cpuISR_IPL2) uart_1_rx() { uart_handle_rx(1); }
 #endif
 
 #if (__CHIP_HAS_UART > 2)
-void __ISR(_UART3_RX_VECTOR, IPL2AUTO) uart_2_rx() { uart_handle_rx(2); }
+void __ISR(_UART3_RX_VECTOR, cpuISR_IPL2) uart_2_rx() { uart_handle_rx(2); }
 #endif
 
 #if (__CHIP_HAS_UART > 3)
-void __ISR(_UART4_RX_VECTOR, IPL2AUTO) uart_3_rx() { uart_handle_rx(3); }
+void __ISR(_UART4_RX_VECTOR, cpuISR_IPL2) uart_3_rx() { uart_handle_rx(3); }
 #endif
 
 #if (__CHIP_HAS_UART > 4)
-void __ISR(_UART5_RX_VECTOR, IPL2AUTO) uart_4_rx() { uart_handle_rx(4); }
+void __ISR(_UART5_RX_VECTOR, cpuISR_IPL2) uart_4_rx() { uart_handle_rx(4); }
 #endif
 
 #if (__CHIP_HAS_UART > 5)
-void __ISR(_UART6_RX_VECTOR, IPL2AUTO) uart_5_rx() { uart_handle_rx(5); }
+void __ISR(_UART6_RX_VECTOR, cpuISR_IPL2) uart_5_rx() { uart_handle_rx(5); }
 #endif
 
 
 
 #if (configUART_TX_BUFFERED == 1)
 static inline void uart_handle_tx(uint8_t uart) {
+    isrprof_enter(start);
     cpu_clear_interrupt_flag(uartControlData[uart].txVector);
 
     if (uxQueueMessagesWaitingFromISR(uartControlData[uart].txBuffer) == 0) {
         cpu_clear_interrupt_enable(uartControlData[uart].txVector);
-        return;
+    } else {
+        uart_queue_t b = 0;
+        xQueueReceiveFromISR(uartControlData[uart].txBuffer, &b, NULL);
+        uartControlData[uart].reg->txreg.reg = b;
     }
-
-    uart_queue_t b = 0;
-    xQueueReceiveFromISR(uartControlData[uart].txBuffer, &b, NULL);
-    uartControlData[uart].reg->txreg.reg = b;
+    isrprof_exit(uartControlData[uart].txVector, 2, start);
 }
 
 
 #if (__CHIP_HAS_UART > 0)
-void __ISR(_UART1_TX_VECTOR, IPL2AUTO) uart_0_tx() { uart_handle_tx(0); }
+void __ISR(_UART1_TX_VECTOR, cpuISR_IPL2) uart_0_tx() { uart_handle_tx(0); }
 #endif
 
 #if (__CHIP_HAS_UART > 1)
-void __ISR(_UART2_TX_VECTOR, IPL2AUTO) uart_1_tx() { uart_handle_tx(1); }
+void __ISR(_UART2_TX_VECTOR, cpuISR_IPL2) uart_1_tx() { uart_handle_tx(1); }
 #endif
 
 #if (__CHIP_HAS_UART > 2)
-void __ISR(_UART3_TX_VECTOR, IPL2AUTO) uart_2_tx() { uart_handle_tx(2); }
+void __ISR(_UART3_TX_VECTOR, cpuISR_IPL2) uart_2_tx() { uart_handle_tx(2); }
 #endif
 
 #if (__CHIP_HAS_UART > 3)
-void __ISR(_UART4_TX_VECTOR, IPL2AUTO) uart_3_tx() { uart_handle_tx(3); }
+void __ISR(_UART4_TX_VECTOR, cpuISR_IPL2) uart_3_tx() { uart_handle_tx(3); }
 #endif
 
 #if (__CHIP_HAS_UART > 4)
-void __ISR(_UART5_TX_VECTOR, IPL2AUTO) uart_4_tx() { uart_handle_tx(4); }
+void __ISR(_UART5_TX_VECTOR, cpuISR_IPL2) uart_4_tx() { uart_handle_tx(4); }
 #endif
 
 #if (__CHIP_HAS_UART > 5)
-void __ISR(_UART6_TX_VECTOR, IPL2AUTO) uart_5_tx() { uart_handle_tx(5); }
+void __ISR(_UART6_TX_VECTOR, cpuISR_IPL2) uart_5_tx() { uart_handle_tx(5); }
 #endif
 #endif
 
@@ -0,0 +1,247 @@
+/**
+ * @file workqueue.c
+ * Deferred interrupt work queue. Interrupt handlers hand anything slow to a
+ * worker task instead of doing it at IPL2 or IPL6, and instead of funnelling
+ * it through xTimerPendFunctionCallFromISR() and the single timer task.
+ *
+ * There are configWORKQUEUE_LANES lanes, each with its own worker task at the
+ * priority given in configWORKQUEUE_LANE_PRIORITIES, so urgent work is not
+ * held up behind bulk work. Submitting is lock free: an item is pushed onto
+ * the lane's list with a compare-and-swap, which is safe at any interrupt
+ * priority, including above configMAX_SYSCALL_INTERRUPT_PRIORITY where no
+ * FreeRTOS API may be called. From there the worker is woken directly, or
+ * through core software interrupt 1 (at IPL2) when the submitter is running
+ * at too high a priority to notify it itself.
+ *
+ * Submitting an item that is already waiting to run does not queue it again,
+ * it only counts as coalesced, so an interrupt that fires many times before the worker
+ * gets to it costs one run. The item is marked idle just before its function
+ * is called, so anything submitted during the run gets another one.
+ */
+#include <p32xxxx.h>
+#include <sys/attribs.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "sdk/cpu.h"
+#include "sdk/uart.h"
+#include "sdk/workqueue.h"
+#if (configUSE_STACKWATCH == 1)
+#include "sdk/stackwatch.h"
+#endif
+
+#if (configUSE_WORKQUEUE == 1)
+
+#define workqueueDOORBELL_IPL 2
+
+typedef struct {
+    workqueue_item_t *volatile head;    // Pushed items, newest first
+    TaskHandle_t worker;
+    workqueue_stats_t stats;
+} workqueue_lane_t;
+
+static workqueue_lane_t workqueueLane[configWORKQUEUE_LANES];
+static const UBaseType_t workqueuePriority[configWORKQUEUE_LANES] = configWORKQUEUE_LANE_PRIORITIES;
+static volatile uint32_t workqueueDoorbell = 0;    // Lanes to wake from the doorbell interrupt
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+static StackType_t workqueueStack[configWORKQUEUE_LANES][configWORKQUEUE_STACK_SIZE] portSTATIC_STORAGE;
+static StaticTask_t workqueueTaskBuffer[configWORKQUEUE_LANES] portSTATIC_STORAGE;
+#endif
+
+static void workqueue_worker(void *params) {
+    workqueue_lane_t *lane = (workqueue_lane_t *)params;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Take everything queued so far and put it back in submission order
+        workqueue_item_t *item = __atomic_exchange_n(&lane->head, NULL, __ATOMIC_ACQUIRE);
+        workqueue_item_t *fifo = NULL;
+        while (item != NULL) {
+            workqueue_item_t *next = item->next;
+            item->next = fifo;
+            fifo = item;
+            item = next;
+        }
+
+        while (fifo != NULL) {
+            item = fifo;
+            fifo = item->next;
+
+            uint32_t now;
+            cpu_ct_read_count(now);
+            uint32_t latency = now - item->queued;
+            if (latency > lane->stats.latencyMax) lane->stats.latencyMax = latency;
+            lane->stats.latencyTotal += latency;
+            __atomic_sub_fetch(&lane->stats.depth, 1, __ATOMIC_RELAXED);
+
+            // Idle again from here on, so it may be resubmitted while running
+            __atomic_store_n(&item->queued, 0, __ATOMIC_RELEASE);
+            item->function(item->arg);
+            lane->stats.executed++;
+        }
+    }
+}
+
+/**
+ * Push an item onto its lane unless it is already queued
+ * @returns 1 if the item was pushed, 0 if it was coalesced or invalid
+ */
+static int workqueue_push(workqueue_item_t *item) {
+    if ((item->lane >= configWORKQUEUE_LANES) || (item->function == NULL)) return 0;
+    workqueue_lane_t *lane = &workqueueLane[item->lane];
+
+    // A queued value of 0 means idle, so never store 0 as the timestamp
+    uint32_t now;
+    cpu_ct_read_count(now);
+    uint32_t idle = 0;
+    if (!__atomic_compare_exchange_n(&item->queued, &idle, now | 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        __atomic_add_fetch(&lane->stats.coalesced, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    workqueue_item_t *head = __atomic_load_n(&lane->head, __ATOMIC_RELAXED);
+    do {
+        item->next = head;
+    } while (!__atomic_compare_exchange_n(&lane->head, &head, item, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    __atomic_add_fetch(&lane->stats.submitted, 1, __ATOMIC_RELAXED);
+    uint32_t depth = __atomic_add_fetch(&lane->stats.depth, 1, __ATOMIC_RELAXED);
+    if (depth > lane->stats.maxDepth) lane->stats.maxDepth = depth;
+    return 1;
+}
+
+/**
+ * Queue an item from a task. Items queued before workqueue_start() run once
+ * it has created the workers.
+ * @param item The item
+ * @returns 1 if the item will run, including when it was already queued, 0
+ *          if it is invalid
+ */
+int workqueue_submit(workqueue_item_t *item) {
+    if (workqueue_push(item)) {
+        TaskHandle_t worker = workqueueLane[item->lane].worker;
+        if (worker != NULL) xTaskNotifyGive(worker);
+        return 1;
+    }
+    return item->queued != 0;
+}
+
+/**
+ * Queue an item from an interrupt handler of any priority
+ * @param item The item
+ * @param woken Set to pdTRUE if a worker of higher priority than the
+ *              interrupted task was woken, or NULL
+ * @returns 1 if the item will run, 0 if it is invalid
+ */
+int workqueue_submit_from_isr(workqueue_item_t *item, BaseType_t *woken) {
+    if ((item->lane >= configWORKQUEUE_LANES) || (item->function == NULL)) return 0;
+
+    // The worker is woken even when the item was coalesced, as the submit
+    // that queued it may not have woken it yet
+    workqueue_push(item);
+    if (workqueueLane[item->lane].worker == NULL) return 1;
+
+    uint32_t ipl = (_CP0_GET_STATUS() >> 10) & 0x7;
+    if (ipl <= configMAX_SYSCALL_INTERRUPT_PRIORITY) {
+        vTaskNotifyGiveFromISR(workqueueLane[item->lane].worker, woken);
+    } else {
+        // Raised through IFS0SET rather than Cause<IP1>, as a read-modify-write
+        // of Cause here could undo, or be undone by, one in the code interrupted
+        __atomic_or_fetch(&workqueueDoorbell, 1UL << item->lane, __ATOMIC_RELAXED);
+        cpu_set_interrupt_flag(_CORE_SOFTWARE_1_VECTOR);
+    }
+    return 1;
+}
+
+void __ISR(_CORE_SOFTWARE_1_VECTOR, cpuISR_IPL2) workqueue_doorbell_isr() {
+    BaseType_t woken = pdFALSE;
+
+    cpu_clear_interrupt_flag(_CORE_SOFTWARE_1_VECTOR);
+
+    uint32_t lanes = __atomic_exchange_n(&workqueueDoorbell, 0, __ATOMIC_ACQUIRE);
+    for (uint8_t i = 0; i < configWORKQUEUE_LANES; i++) {
+        if ((lanes & (1UL << i)) && (workqueueLane[i].worker != NULL)) {
+            vTaskNotifyGiveFromISR(workqueueLane[i].worker, &woken);
+        }
+    }
+    portEND_SWITCHING_ISR(woken);
+}
+
+/**
+ * Create the worker tasks and enable the doorbell interrupt
+ * @returns 1 if the work queue was started, 0 otherwise
+ */
+int workqueue_start() {
+    for (uint8_t i = 0; i < configWORKQUEUE_LANES; i++) {
+        char name[configMAX_TASK_NAME_LEN];
+        if (workqueueLane[i].worker != NULL) return 0;
+        snprintf(name, sizeof(name), "Work%u", i);
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+        workqueueLane[i].worker = xTaskCreateStatic(workqueue_worker, name, configWORKQUEUE_STACK_SIZE, &workqueueLane[i],
+            workqueuePriority[i], workqueueStack[i], &workqueueTaskBuffer[i]);
+        if (workqueueLane[i].worker == NULL) return 0;
+#else
+        if (xTaskCreate(workqueue_worker, name, configWORKQUEUE_STACK_SIZE, &workqueueLane[i],
+                workqueuePriority[i], &workqueueLane[i].worker) != pdPASS) {
+            workqueueLane[i].worker = NULL;
+            return 0;
+        }
+#endif
+#if (configUSE_STACKWATCH == 1)
+        stackwatch_register(workqueueLane[i].worker, configWORKQUEUE_STACK_SIZE, "configWORKQUEUE_STACK_SIZE");
+#endif
+        // Anything submitted before now
+        if (__atomic_load_n(&workqueueLane[i].head, __ATOMIC_ACQUIRE) != NULL) {
+            xTaskNotifyGive(workqueueLane[i].worker);
+        }
+    }
+
+    cpu_clear_interrupt_flag(_CORE_SOFTWARE_1_VECTOR);
+    cpu_set_interrupt_priority(_CORE_SOFTWARE_1_VECTOR, workqueueDOORBELL_IPL, 0);
+    cpu_set_interrupt_enable(_CORE_SOFTWARE_1_VECTOR);
+    return 1;
+}
+
+/**
+ * Take a copy of the counters for a lane
+ * @param lane The lane number
+ * @param stats The structure to copy the counters into
+ * @returns 1 if the lane exists, 0 otherwise
+ */
+int workqueue_get_stats(uint8_t lane, workqueue_stats_t *stats) {
+    if (lane >= configWORKQUEUE_LANES) return 0;
+    taskENTER_CRITICAL();
+    memcpy(stats, &workqueueLane[lane].stats, sizeof(workqueue_stats_t));
+    taskEXIT_CRITICAL();
+    return 1;
+}
+
+/**
+ * Print the counters of every lane to a UART
+ * @param uart The UART (which must be open) to print to
+ * @returns 1 if the report was printed, 0 otherwise
+ */
+int workqueue_report(uint8_t uart) {
+    char line[100];
+    workqueue_stats_t s;
+
+    if (!uart_is_open(uart)) return 0;
+
+    const char *head = "Lane prio  submitted  coalesced   executed depth max  latency avg/max (ticks)\r\n";
+    uart_write_bytes(uart, (const uint8_t *)head, strlen(head));
+    for (uint8_t i = 0; workqueue_get_stats(i, &s); i++) {
+        uint32_t avg = (s.executed > 0) ? (uint32_t)(s.latencyTotal / s.executed) : 0;
+        sprintf(line, "%4u %4lu %10lu %10lu %10lu %5lu %3lu %8lu/%lu\r\n", i, (unsigned long)workqueuePriority[i],
+            (unsigned long)s.submitted, (unsigned long)s.coalesced, (unsigned long)s.executed,
+            (unsigned long)s.depth, (unsigned long)s.maxDepth, (unsigned long)avg, (unsigned long)s.latencyMax);
+        uart_write_bytes(uart, (const uint8_t *)line, strlen(line));
+    }
+    return 1;
+}
+
+#endif
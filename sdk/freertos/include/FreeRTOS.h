@@ -794,6 +794,10 @@ hold explicit before calling the code. */
 	#define configUSE_TIME_SLICING 1
 #endif
 
+#ifndef configUSE_TIME_SLICE_TABLE
+	#define configUSE_TIME_SLICE_TABLE 0
+#endif
+
 #ifndef configINCLUDE_APPLICATION_DEFINED_PRIVILEGED_FUNCTIONS
 	#define configINCLUDE_APPLICATION_DEFINED_PRIVILEGED_FUNCTIONS 0
 #endif
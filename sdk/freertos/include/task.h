@@ -1017,6 +1017,39 @@ void vTaskGetInfo( TaskHandle_t xTask, TaskStatus_t *pxTaskStatus, BaseType_t xG
  */
 void vTaskPrioritySet( TaskHandle_t xTask, UBaseType_t uxNewPriority ) PRIVILEGED_FUNCTION;
 
+/**
+ * task. h
+ * <pre>void vTaskSetTimeSlice( UBaseType_t uxPriority, TickType_t xTicks );</pre>
+ *
+ * configUSE_TIME_SLICE_TABLE must be defined as 1 for this function to be
+ * available.
+ *
+ * Set how many ticks a task running at a priority keeps the processor for
+ * before another ready task of the same priority is given a turn.  The
+ * default, or 0, is one tick.  Tasks of higher priority still preempt
+ * immediately.  The table can also be set at build time by defining
+ * configTIME_SLICE_TICKS as an initialiser with one entry per priority.
+ *
+ * @param uxPriority The priority to set the time slice for.
+ *
+ * @param xTicks The length of the time slice in ticks.
+ *
+ * \defgroup vTaskSetTimeSlice vTaskSetTimeSlice
+ * \ingroup TaskCtrl
+ */
+void vTaskSetTimeSlice( UBaseType_t uxPriority, TickType_t xTicks ) PRIVILEGED_FUNCTION;
+
+/**
+ * task. h
+ * <pre>TickType_t xTaskGetTimeSlice( UBaseType_t uxPriority );</pre>
+ *
+ * Returns the time slice, in ticks, of a priority.  See vTaskSetTimeSlice().
+ *
+ * \defgroup xTaskGetTimeSlice xTaskGetTimeSlice
+ * \ingroup TaskCtrl
+ */
+TickType_t xTaskGetTimeSlice( UBaseType_t uxPriority ) PRIVILEGED_FUNCTION;
+
 /**
  * task. h
  * <pre>void vTaskSuspend( TaskHandle_t xTaskToSuspend );</pre>
@@ -50,14 +50,58 @@
 #define configUSE_IDLE_HOOK						0
 #define configUSE_TICK_HOOK						0
 #define configTICK_RATE_HZ						( ( TickType_t ) 1000 )
+
+/* Up to 32 priorities can be used; the highest ready priority is found with
+a single clz of a 32-bit mask whatever the number.  With
+configUSE_TIME_SLICE_TABLE set to 1 each priority can have its own round
+robin time slice, set with vTaskSetTimeSlice() or here with
+configTIME_SLICE_TICKS, e.g. { 0, 0, 5, 0, 0 } to let loop() tasks run for
+5 ticks at a time.  0 means one tick.  It is off by default, which leaves
+the usual one tick slice and no per-tick check of the table. */
+#ifndef configMAX_PRIORITIES
 #define configMAX_PRIORITIES					( 5UL )
+#endif
+#ifndef configUSE_TIME_SLICE_TABLE
+#define configUSE_TIME_SLICE_TABLE				0
+#endif
+
+/* The task running setup() and loop(), and the number of loop functions the
+core will run (loop(), then loop2() up to loop8() if the sketch defines them).
+Additional loops run at the same priority as loop() once setup() returns. */
+#define configARDUINO_TASK_PRIORITY             ( tskIDLE_PRIORITY + 2 )
+#define configARDUINO_LOOPS                     1
+
+/* Stack sizes, in words.  Set configUSE_MEASURED_STACK_SIZES to override any
+of these with the values in measured_stacks.h, as generated from a running
+system by stackwatch_dump_config(). */
+#define configUSE_MEASURED_STACK_SIZES          0
+#if (configUSE_MEASURED_STACK_SIZES == 1)
+#include "measured_stacks.h"
+#endif
+#ifndef configMINIMAL_STACK_SIZE
 #define configMINIMAL_STACK_SIZE				( 190 )
+#endif
+#ifndef configISR_STACK_SIZE
 #define configISR_STACK_SIZE					( 400 )
+#endif
+#ifndef configARDUINO_TASK_STACK_SIZE
+#define configARDUINO_TASK_STACK_SIZE           ( 2048 )
+#endif
+#ifndef configARDUINO_LOOP_STACK_SIZE
+#define configARDUINO_LOOP_STACK_SIZE           ( 1024 )
+#endif
+
 #define configTOTAL_HEAP_SIZE					( ( size_t ) 60000 )
 #define configMAX_TASK_NAME_LEN					( 8 )
 #define configUSE_TRACE_FACILITY				1
 #define configUSE_STATS_FORMATTING_FUNCTIONS    1
 #define configUSE_16_BIT_TICKS					0
+
+/* Set to 1 to allocate the kernel tasks, the Arduino task and all driver
+objects from the .rtos_static linker section instead of the heap.  The heap
+remains available for application use. */
+#define configSUPPORT_STATIC_ALLOCATION         0
+#define configSUPPORT_DYNAMIC_ALLOCATION        1
 #define configIDLE_SHOULD_YIELD					1
 #define configUSE_MUTEXES						1
 #define configCHECK_FOR_STACK_OVERFLOW			3 /* Three also checks the system/interrupt stack. */
@@ -70,6 +114,92 @@
 
 #define configUART_TX_BUFFERED                  0
 
+/* Give each interrupt priority level above the kernel its own shadow register
+set so SDK interrupt handlers do not have to save and restore the GPRs. */
+#define configUSE_SHADOW_REGISTER_SETS          0
+
+/* Kernel event trace recorder (sdk/drivers/ktrace.c).  The buffer size is in
+records of 8 bytes and must be a power of two.  With configKTRACE_PERSISTENT
+set the buffer survives a reset so it can be collected after a crash. */
+#define configUSE_KTRACE                        0
+#define configKTRACE_BUFFER_SIZE                1024
+#define configKTRACE_MAX_TASKS                  16
+#define configKTRACE_PERSISTENT                 0
+#define configKTRACE_TICKS                      0
+
+/* Interrupt profiler (sdk/drivers/isrprof.c).  Times every SDK interrupt
+handler and every cpu_disable_interrupts() window.  The slot count is the
+number of distinct vectors that can be tracked. */
+#define configUSE_ISR_PROFILING                 0
+#define configISRPROF_SLOTS                     16
+
+/* Stack usage monitor (sdk/drivers/stackwatch.c).  Recommended sizes are the
+measured usage plus MARGIN_PERCENT, and never less than MARGIN_MIN words. */
+#define configUSE_STACKWATCH                    0
+#define configSTACKWATCH_PERIOD_MS              1000
+#define configSTACKWATCH_MAX_TASKS              16
+#define configSTACKWATCH_HISTORY                8
+#define configSTACKWATCH_MARGIN_PERCENT         25
+#define configSTACKWATCH_MARGIN_MIN             32
+#ifndef configSTACKWATCH_STACK_SIZE
+#define configSTACKWATCH_STACK_SIZE             ( configMINIMAL_STACK_SIZE + 64 )
+#endif
+
+/* Build msgpool_benchmark() (sdk/drivers/msgpool.c), which compares passing
+messages by pointer with copying them through a queue.  It counts the context
+switches with the traceTASK_SWITCHED_IN() hook below. */
+#define configUSE_MSGPOOL_BENCHMARK             0
+
+/* Publish/subscribe bus (sdk/drivers/pubsub.c).  Each topic uses one bit of
+the subscriber's notification value so there can be at most 32. */
+#define configPUBSUB_TOPICS                     16
+#define configPUBSUB_MAX_SUBSCRIBERS            8
+
+/* Deferred interrupt work queue (sdk/drivers/workqueue.c).  Each lane has a
+worker task at the matching priority, most urgent first.  Core software
+interrupt 1 is used to wake the workers from interrupts above
+configMAX_SYSCALL_INTERRUPT_PRIORITY, so isrprof_benchmark_entry() is not
+available while the work queue is in use. */
+#define configUSE_WORKQUEUE                     0
+#define configWORKQUEUE_LANES                   3
+#define configWORKQUEUE_LANE_PRIORITIES         { configMAX_PRIORITIES - 1, configMAX_PRIORITIES - 2, tskIDLE_PRIORITY + 1 }
+#ifndef configWORKQUEUE_STACK_SIZE
+#define configWORKQUEUE_STACK_SIZE              ( configMINIMAL_STACK_SIZE + 128 )
+#endif
+
+/* Heap based timer service (sdk/drivers/htimer.c) for when there are too many
+timers for the sorted list of the FreeRTOS timer task.  High resolution timers
+take over Timer2/3 and run their callbacks at IPL3. */
+#define configUSE_HTIMER                        0
+#define configHTIMER_MAX_TIMERS                 256
+#define configHTIMER_QUEUE_LENGTH               32
+#define configHTIMER_TASK_PRIORITY              configTIMER_TASK_PRIORITY
+#ifndef configHTIMER_STACK_SIZE
+#define configHTIMER_STACK_SIZE                 ( configMINIMAL_STACK_SIZE * 2 )
+#endif
+#define configUSE_HTIMER_HIRES                  0
+#define configHTIMER_HIRES_MAX_TIMERS           16
+#define configHTIMER_HIRES_MIN_PERIOD_US         20
+
+/* Reader/writer lock (sdk/drivers/rwlock.c).  A writer waiting for readers to
+leave lends its priority to the first MAX_READERS of them.  The benchmark
+compares it with a mutex and the adaptive mutex (sdk/drivers/amutex.c). */
+#define configRWLOCK_MAX_READERS                8
+#define configUSE_RWLOCK_BENCHMARK              0
+
+/* Earliest deadline first scheduling of periodic tasks (sdk/drivers/edf.c).
+EDF tasks are ranked by deadline across the priorities from LOW to HIGH - 1,
+and HIGH is used briefly as each job is released.  Tasks are only admitted
+while the total density stays within UTILISATION_LIMIT percent.  The band
+needs a priority for each task and sits just above loop() and the timer
+task, so configMAX_PRIORITIES must be raised to use it: to at least
+HIGH + 1, or HIGH + 3 to keep workqueue lanes 0 and 1 above it. */
+#define configUSE_EDF                           0
+#define configEDF_MAX_TASKS                     8
+#define configEDF_PRIORITY_LOW                  ( configTIMER_TASK_PRIORITY + 1 )
+#define configEDF_PRIORITY_HIGH                 ( configEDF_PRIORITY_LOW + configEDF_MAX_TASKS )
+#define configEDF_UTILISATION_LIMIT             90
+
 /* Enable support for Task based FPU operations. This will enable support for
 FPU context saving during switches only on architectures with hardware FPU.
 
@@ -77,6 +207,20 @@ NOTE: This constant is defined in the project options as configurations are
 provided that both enable and disable floating point support.  */
 #define configUSE_TASK_FPU_SUPPORT				1
 
+/* With lazy FPU switching the FPU registers are not part of the task context.
+Tasks run with CP1 disabled until they execute an FPU instruction, and the
+coprocessor unusable exception then moves the registers between the previous
+owner and the current task.  Up to configLAZY_FPU_CONTEXTS tasks can use the
+FPU at once; portTASK_USES_FLOATING_POINT() is optional in this mode and only
+reserves a context early.  A task that needs a context when all of them are
+taken halts the system through vApplicationFPUContextsExhaustedHook(), so
+count every task that does any floating point, printing included.  The
+switch benchmark (sdk/drivers/switchbench.c) measures context switch time
+for comparing the two modes. */
+#define configUSE_LAZY_FPU_SWITCHING			0
+#define configLAZY_FPU_CONTEXTS					4
+#define configUSE_SWITCH_BENCHMARK				0
+
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES					0
 #define configMAX_CO_ROUTINE_PRIORITIES			( 2 )
@@ -85,7 +229,9 @@ provided that both enable and disable floating point support.  */
 #define configUSE_TIMERS						1
 #define configTIMER_TASK_PRIORITY				( 2 )
 #define configTIMER_QUEUE_LENGTH				5
+#ifndef configTIMER_TASK_STACK_DEPTH
 #define configTIMER_TASK_STACK_DEPTH			( configMINIMAL_STACK_SIZE * 2 )
+#endif
 
 /* Set the following definitions to 1 to include the API function, or zero
 to exclude the API function. */
@@ -100,6 +246,9 @@ to exclude the API function. */
 #define INCLUDE_uxTaskGetStackHighWaterMark		1
 #define INCLUDE_eTaskGetState					1
 #define INCLUDE_xTimerPendFunctionCall			1
+#define INCLUDE_xQueueGetMutexHolder			1
+#define INCLUDE_xTaskGetIdleTaskHandle          configUSE_STACKWATCH
+#define INCLUDE_xTimerGetTimerDaemonTaskHandle  configUSE_STACKWATCH
 
 /* The priority at which the tick interrupt runs.  This should probably be
 kept at 1. */
@@ -114,6 +263,23 @@ interrupts. */
 #ifndef __LANGUAGE_ASSEMBLY
 	extern void vAssertCalled( const char * pcFile, unsigned long ulLine );
 	#define configASSERT( x ) if( ( x ) == 0  ) vAssertCalled( __FILE__, __LINE__ )
+
+	#if (configUSE_KTRACE == 1)
+	#include "sdk/ktrace.h"
+	#endif
+
+	/* Count the tasks switched in while msgpool_benchmark() runs, as well as
+	recording them when the trace recorder is on. */
+	#if (configUSE_MSGPOOL_BENCHMARK == 1)
+		extern volatile unsigned long msgpoolBenchSwitches;
+		extern volatile unsigned char msgpoolBenchCounting;
+		#if (configUSE_KTRACE == 1)
+			#undef traceTASK_SWITCHED_IN
+			#define traceTASK_SWITCHED_IN() do { ktrace_switched_in( pxCurrentTCB ); if( msgpoolBenchCounting != 0 ) msgpoolBenchSwitches++; } while( 0 )
+		#else
+			#define traceTASK_SWITCHED_IN() do { if( msgpoolBenchCounting != 0 ) msgpoolBenchSwitches++; } while( 0 )
+		#endif
+	#endif
 #endif
     
 #endif /* FREERTOS_CONFIG_H */
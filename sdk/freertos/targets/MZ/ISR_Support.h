@@ -33,6 +33,27 @@
 #define portFPCSR_STACK_LOCATION        0
 #define portTASK_HAS_FPU_STACK_LOCATION     0
 #define portFPU_CONTEXT_SIZE            264
+#define portLAZY_FPU_FRAME_SIZE         104
+
+#ifndef configUSE_LAZY_FPU_SWITCHING
+	#define configUSE_LAZY_FPU_SWITCHING	0
+#endif
+
+/* With eager switching the FPU registers of tasks that have called
+portTASK_USES_FLOATING_POINT() are saved in the context frame.  With lazy
+switching context frames never hold FPU state; it is swapped on demand by
+vPortCoprocessorUnusableHandler() instead. */
+#if ( __mips_hard_float == 1 ) && ( configUSE_TASK_FPU_SUPPORT == 1 ) && ( configUSE_LAZY_FPU_SWITCHING == 0 )
+	#define portEAGER_FPU_SWITCHING		1
+#else
+	#define portEAGER_FPU_SWITCHING		0
+#endif
+
+#if ( __mips_hard_float == 1 ) && ( configUSE_TASK_FPU_SUPPORT == 1 ) && ( configUSE_LAZY_FPU_SWITCHING == 1 )
+	#define portLAZY_FPU_SWITCHING		1
+#else
+	#define portLAZY_FPU_SWITCHING		0
+#endif
 
 /******************************************************************/
 .macro  portSAVE_FPU_REGS    offset, base
@@ -125,7 +146,7 @@
 	mfc0		k0, _CP0_CAUSE
 	addiu		sp, sp, -portCONTEXT_SIZE
 
-	#if ( __mips_hard_float == 1 ) && ( configUSE_TASK_FPU_SUPPORT == 1 )
+	#if ( portEAGER_FPU_SWITCHING == 1 )
 		/* Test if we are already using the system stack. Only tasks may use the
 		FPU so if we are already in a nested interrupt then the FPU context does
 		not require saving. */
@@ -244,7 +265,7 @@
 	sw			s6, 8(s5)
 
 	/* Save the FPU context if the nesting count was zero. */
-	#if ( __mips_hard_float == 1 ) && ( configUSE_TASK_FPU_SUPPORT == 1 )
+	#if ( portEAGER_FPU_SWITCHING == 1 )
 		la			s6, uxInterruptNesting
 		lw			s6, 0(s6)
 		addiu		s6, s6, -1
@@ -292,7 +313,7 @@
 	la			s6, uxSavedTaskStackPointer
 	lw			s5, (s6)
 
-    #if ( __mips_hard_float == 1 ) && ( configUSE_TASK_FPU_SUPPORT == 1 )
+    #if ( portEAGER_FPU_SWITCHING == 1 )
 		/* Restore the FPU context if required. */
 		lw			s6, portTASK_HAS_FPU_STACK_LOCATION(s5)
 		beq			s6, zero, 1f
@@ -367,7 +388,7 @@
 	addiu		k1, k1, -1
 	sw			k1, 0(k0)
 
-	#if ( __mips_hard_float == 1 ) && ( configUSE_TASK_FPU_SUPPORT == 1 )
+	#if ( portEAGER_FPU_SWITCHING == 1 )
 		/* If the nesting count is now zero then the FPU context may be restored. */
 		bne			k1, zero, 1f
 		nop
@@ -420,7 +441,7 @@
 
 		addiu		sp, sp,	portCONTEXT_SIZE
 
-	#endif // ( __mips_hard_float == 1 ) && ( configUSE_TASK_FPU_SUPPORT == 1 )
+	#endif // ( portEAGER_FPU_SWITCHING == 1 )
 
 	mtc0		k0, _CP0_STATUS
 	mtc0 		k1, _CP0_EPC
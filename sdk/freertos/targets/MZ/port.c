@@ -40,6 +40,7 @@
 #include "task.h"
 
 #include "sdk/cpu.h"
+#include "sdk/isrprof.h"
 
 #if !defined(__PIC32MZ__)
     #error This port is designed to work with XC32 on PIC32MZ MCUs.  Please update your C compiler version or settings.
@@ -49,6 +50,17 @@
 	#error configMAX_SYSCALL_INTERRUPT_PRIORITY must be less than 7 and greater than 0
 #endif
 
+#if( ( configKERNEL_INTERRUPT_PRIORITY < 1 ) || ( configKERNEL_INTERRUPT_PRIORITY > configMAX_SYSCALL_INTERRUPT_PRIORITY ) )
+	#error configKERNEL_INTERRUPT_PRIORITY must be at least 1 and no higher than configMAX_SYSCALL_INTERRUPT_PRIORITY
+#endif
+
+/* cpu_configure_shadow_sets() keeps the kernel priority on the normal register
+set, but the cpuISR_IPLn attributes in sdk/cpu.h give every level from 2 up a
+shadow set, so the kernel has to be at IPL1. */
+#if( ( configUSE_SHADOW_REGISTER_SETS == 1 ) && ( configKERNEL_INTERRUPT_PRIORITY != 1 ) )
+	#error configKERNEL_INTERRUPT_PRIORITY must be 1 when configUSE_SHADOW_REGISTER_SETS is 1
+#endif
+
 /* Hardware specifics. */
 #define portTIMER_PRESCALE	8
 #define portPRESCALE_BITS	1
@@ -66,7 +78,10 @@
 
 /* The EXL bit is set to ensure interrupts do not occur while the context of
 the first task is being restored. */
-#if ( __mips_hard_float == 1 )
+#if ( __mips_hard_float == 1 ) && ( portLAZY_FPU_SWITCHING == 1 )
+    /* CP1 is only enabled once the task has been given the FPU. */
+    #define portINITIAL_SR			( portIE_BIT | portEXL_BIT | portMX_BIT | portFR_BIT )
+#elif ( __mips_hard_float == 1 )
     #define portINITIAL_SR			( portIE_BIT | portEXL_BIT | portMX_BIT | portFR_BIT | portCU1_BIT )
 #else
     #define portINITIAL_SR			( portIE_BIT | portEXL_BIT | portMX_BIT )
@@ -143,7 +158,19 @@ task stack, not the ISR stack). */
  */
 static void prvTaskExitError( void );
 
+/* Core timer compare value for the next tick.  The core timer rate is rarely
+an exact multiple of configTICK_RATE_HZ, so each tick advances the compare by
+ulTickReload and the remainder is carried in ulTickFraction (in units of
+1/configTICK_RATE_HZ core timer counts), adding one count whenever it wraps.
+Over any second the compare advances by exactly the core timer rate. */
 static uint32_t tickCounter = 0;
+static uint32_t ulTickReload = 0;
+static uint32_t ulTickRemainder = 0;
+static uint32_t ulTickFraction = 0;
+
+/* Ticks that were processed late because the compare had already passed by
+the time the tick interrupt ran. */
+volatile uint32_t ulPortMissedTicks = 0;
 
 /*-----------------------------------------------------------*/
 
@@ -169,6 +196,37 @@ const StackType_t * const xISRStackTop = &( xISRStack[ ( configISR_STACK_SIZE &
 	uint32_t ulTaskHasFPUContext = 0;
 #endif
 
+#if ( portLAZY_FPU_SWITCHING == 1 )
+
+	/* FPU registers of a task that does not currently own the FPU.  The layout
+	matches the FPU part of an eager context frame (portFPU_CONTEXT_SIZE). */
+	typedef struct xFPU_CONTEXT
+	{
+		uint32_t ulFCSR;
+		uint32_t ulPadding;
+		uint64_t ullRegisters[ 32 ];
+	} FPUContext_t;
+
+	static FPUContext_t xFPUContexts[ configLAZY_FPU_CONTEXTS ] __attribute__(( aligned( 8 ) ));
+	static void *pvFPUContextOwner[ configLAZY_FPU_CONTEXTS ] = { NULL };
+
+	/* The task whose registers are currently in the FPU, read by vPortYieldISR
+	to decide whether the task being switched in may have CP1 enabled. */
+	void * volatile pvPortFPUOwnerTCB = NULL;
+	static FPUContext_t *pxFPUOwnerContext = NULL;
+
+	/* Number of times the FPU has changed hands. */
+	volatile uint32_t ulPortFPUOwnerChanges = 0;
+
+	extern void *pxCurrentTCB;
+
+	/* Called, and must not return, when a task needs an FPU context and all
+	configLAZY_FPU_CONTEXTS are held by other tasks.  Their registers are only
+	kept in those contexts, so none can be given up. */
+	extern void vApplicationFPUContextsExhaustedHook( TaskHandle_t xTask, char *pcTaskName );
+
+#endif
+
 /*-----------------------------------------------------------*/
 
 /*
@@ -237,7 +295,13 @@ __attribute__(( weak )) void vApplicationSetupTickTimerInterrupt( void )
 {
 //const uint32_t ulCompareMatch = ( (cpu_get_peripheral_clock() / portTIMER_PRESCALE) / configTICK_RATE_HZ ) - 1UL;
 
-    tickCounter = cpu_get_system_clock() / 2 / configTICK_RATE_HZ;
+const uint32_t ulCoreTimerHz = cpu_get_system_clock() / 2;
+
+    ulTickReload = ulCoreTimerHz / configTICK_RATE_HZ;
+    ulTickRemainder = ulCoreTimerHz % configTICK_RATE_HZ;
+    ulTickFraction = 0;
+
+    tickCounter = ulTickReload;
     cpu_ct_init(tickCounter);
 
 //	T1CON = 0x0000;
@@ -273,6 +337,16 @@ extern void *pxCurrentTCB;
 	}
 	#endif /* configCHECK_FOR_STACK_OVERFLOW > 2 */
 
+	/* The yield and tick handlers save the interrupted task's registers, so
+	they must run in the register set the tasks use.  This is checked here
+	rather than with configASSERT(), which may do nothing, as running with the
+	wrong set corrupts every task's context; stop instead. */
+	if( ( ( PRISS >> ( configKERNEL_INTERRUPT_PRIORITY * 4 ) ) & 0x0FUL ) != 0 )
+	{
+		cpu_disable_interrupts();
+		for( ;; );
+	}
+
     cpu_clear_interrupt_flag(_CORE_SOFTWARE_0_VECTOR);
     cpu_set_interrupt_priority(_CORE_SOFTWARE_0_VECTOR, configKERNEL_INTERRUPT_PRIORITY, 0);
     cpu_set_interrupt_enable(_CORE_SOFTWARE_0_VECTOR);
@@ -297,19 +371,56 @@ extern void *pxCurrentTCB;
 }
 /*-----------------------------------------------------------*/
 
+static inline void prvAdvanceTickCompare( void )
+{
+	tickCounter += ulTickReload;
+	ulTickFraction += ulTickRemainder;
+	if( ulTickFraction >= configTICK_RATE_HZ )
+	{
+		ulTickFraction -= configTICK_RATE_HZ;
+		tickCounter++;
+	}
+}
+/*-----------------------------------------------------------*/
+
 void vPortIncrementTick( void )
 {
 UBaseType_t uxSavedStatus;
+uint32_t ulNow;
 
-    tickCounter += cpu_get_system_clock() / 2 / configTICK_RATE_HZ;
-    cpu_ct_write_compare(tickCounter);
+	isrprof_enter( ulEntryCount );
+	#if ( configUSE_ISR_PROFILING == 1 )
+	{
+		/* tickCounter still holds the compare value that raised this
+		interrupt, so the difference is how late the tick is running. */
+		isrprof_tick_latency( ulEntryCount - tickCounter );
+	}
+	#endif
 
 	uxSavedStatus = uxPortSetInterruptMaskFromISR();
 	{
-		if( xTaskIncrementTick() != pdFALSE )
+		for( ;; )
 		{
-			/* Pend a context switch. */
-			_CP0_BIS_CAUSE( portCORE_SW_0 );
+			if( xTaskIncrementTick() != pdFALSE )
+			{
+				/* Pend a context switch. */
+				_CP0_BIS_CAUSE( portCORE_SW_0 );
+			}
+
+			prvAdvanceTickCompare();
+			cpu_ct_write_compare( tickCounter );
+
+			/* If the next compare is already behind the count then this
+			interrupt ran more than a tick late.  The compare would not match
+			again until the count wrapped, so process the missed tick now
+			rather than losing it.  ulTickReload is zero if the application
+			set up its own tick source, which is never treated as late. */
+			cpu_ct_read_count( ulNow );
+			if( ( ulTickReload == 0 ) || ( ( int32_t ) ( tickCounter - ulNow ) > 0 ) )
+			{
+				break;
+			}
+			ulPortMissedTicks++;
 		}
 	}
 	vPortClearInterruptMaskFromISR( uxSavedStatus );
@@ -319,6 +430,8 @@ UBaseType_t uxSavedStatus;
 
 	/* Clear timer interrupt. */
 	configCLEAR_TICK_TIMER_INTERRUPT();
+
+	isrprof_exit( _CORE_TIMER_VECTOR, configKERNEL_INTERRUPT_PRIORITY, ulEntryCount );
 }
 /*-----------------------------------------------------------*/
 
@@ -346,7 +459,117 @@ void vPortClearInterruptMaskFromISR( UBaseType_t uxSavedStatusRegister )
 }
 /*-----------------------------------------------------------*/
 
-#if ( __mips_hard_float == 1 ) && ( configUSE_TASK_FPU_SUPPORT == 1 )
+#if ( portLAZY_FPU_SWITCHING == 1 )
+
+	/* Find the FPU context belonging to a task, claiming a free one if it has
+	none.  A newly claimed context holds the initial FCSR and zeroed registers.
+	Must be called with interrupts disabled. */
+	static FPUContext_t *prvGetFPUContext( void *pvTCB )
+	{
+	UBaseType_t x, xFree = configLAZY_FPU_CONTEXTS;
+
+		for( x = 0; x < configLAZY_FPU_CONTEXTS; x++ )
+		{
+			if( pvFPUContextOwner[ x ] == pvTCB )
+			{
+				return &( xFPUContexts[ x ] );
+			}
+			else if( ( pvFPUContextOwner[ x ] == NULL ) && ( xFree == configLAZY_FPU_CONTEXTS ) )
+			{
+				xFree = x;
+			}
+		}
+
+		if( xFree == configLAZY_FPU_CONTEXTS )
+		{
+			return NULL;
+		}
+
+		memset( &( xFPUContexts[ xFree ] ), 0, sizeof( FPUContext_t ) );
+		xFPUContexts[ xFree ].ulFCSR = portINITIAL_FPSCR;
+		pvFPUContextOwner[ xFree ] = pvTCB;
+		return &( xFPUContexts[ xFree ] );
+	}
+
+	/* Called from vPortCoprocessorUnusableHandler() with CP1 enabled and
+	interrupts disabled.  Moves the FPU registers from the previous owner to
+	the current task. */
+	void vPortFPUTakeOwnership( void )
+	{
+	extern void vPortSaveFPUContext( FPUContext_t *pxContext );
+	extern void vPortRestoreFPUContext( FPUContext_t *pxContext );
+	FPUContext_t *pxContext;
+
+		/* The owner can trap too if an interrupt handler that used the FPU
+		restored a status value with CP1 disabled. */
+		if( pvPortFPUOwnerTCB == pxCurrentTCB )
+		{
+			return;
+		}
+
+		pxContext = prvGetFPUContext( pxCurrentTCB );
+
+		/* More tasks are using the FPU than configLAZY_FPU_CONTEXTS allows.
+		This has to stop here, as configASSERT() may do nothing. */
+		if( pxContext == NULL )
+		{
+			vApplicationFPUContextsExhaustedHook( ( TaskHandle_t ) pxCurrentTCB, pcTaskGetName( ( TaskHandle_t ) pxCurrentTCB ) );
+			for( ;; );
+		}
+
+		if( pxFPUOwnerContext != NULL )
+		{
+			vPortSaveFPUContext( pxFPUOwnerContext );
+		}
+		vPortRestoreFPUContext( pxContext );
+
+		pvPortFPUOwnerTCB = pxCurrentTCB;
+		pxFPUOwnerContext = pxContext;
+		ulPortFPUOwnerChanges++;
+	}
+
+	void vPortReleaseFPUContext( void *pvTCB )
+	{
+	UBaseType_t x;
+
+		portENTER_CRITICAL();
+
+		if( pvPortFPUOwnerTCB == pvTCB )
+		{
+			/* The registers are discarded, not saved. */
+			pvPortFPUOwnerTCB = NULL;
+			pxFPUOwnerContext = NULL;
+		}
+
+		for( x = 0; x < configLAZY_FPU_CONTEXTS; x++ )
+		{
+			if( pvFPUContextOwner[ x ] == pvTCB )
+			{
+				pvFPUContextOwner[ x ] = NULL;
+			}
+		}
+
+		portEXIT_CRITICAL();
+	}
+
+	void vPortTaskUsesFPU(void)
+	{
+	FPUContext_t *pxContext;
+
+		/* Nothing has to be done for the FPU to be usable.  Claiming the context
+		now just means running out of them shows up here rather than on the
+		first FPU instruction. */
+		portENTER_CRITICAL();
+		pxContext = prvGetFPUContext( pxCurrentTCB );
+		if( pxContext == NULL )
+		{
+			vApplicationFPUContextsExhaustedHook( ( TaskHandle_t ) pxCurrentTCB, pcTaskGetName( ( TaskHandle_t ) pxCurrentTCB ) );
+			for( ;; );
+		}
+		portEXIT_CRITICAL();
+	}
+
+#elif ( __mips_hard_float == 1 ) && ( configUSE_TASK_FPU_SUPPORT == 1 )
 
 	void vPortTaskUsesFPU(void)
 	{
@@ -79,6 +79,11 @@ typedef unsigned long UBaseType_t;
 #define portBYTE_ALIGNMENT			8
 #define portSTACK_GROWTH			-1
 #define portTICK_PERIOD_MS			( ( TickType_t ) 1000 / configTICK_RATE_HZ )
+
+/* Statically allocated kernel objects, stacks and driver buffers are placed in
+their own uninitialised section so the linker can report and limit their size.
+The startup code does not clear this section. */
+#define portSTATIC_STORAGE			__attribute__( ( section( ".rtos_static" ), aligned( portBYTE_ALIGNMENT ) ) )
 /*-----------------------------------------------------------*/
 
 /* Critical section management. */
@@ -154,6 +159,20 @@ extern void vPortClearInterruptMaskFromISR( UBaseType_t );
 	#define portTASK_USES_FLOATING_POINT() vPortTaskUsesFPU()
 #endif
 
+#ifndef configUSE_LAZY_FPU_SWITCHING
+	#define configUSE_LAZY_FPU_SWITCHING 0
+#endif
+
+#if ( __mips_hard_float == 1 ) && ( configUSE_TASK_FPU_SUPPORT == 1 ) && ( configUSE_LAZY_FPU_SWITCHING == 1 )
+	#define portLAZY_FPU_SWITCHING 1
+
+	/* A deleted task gives back its FPU context. */
+	void vPortReleaseFPUContext( void *pvTCB );
+	#define portCLEAN_UP_TCB( pxTCB ) vPortReleaseFPUContext( pxTCB )
+#else
+	#define portLAZY_FPU_SWITCHING 0
+#endif
+
 #ifndef configUSE_PORT_OPTIMISED_TASK_SELECTION
 	#define configUSE_PORT_OPTIMISED_TASK_SELECTION 1
 #endif
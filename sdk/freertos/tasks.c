@@ -360,6 +360,19 @@ PRIVILEGED_DATA static List_t xPendingReadyList;						/*< Tasks that have been r
 
 #endif
 
+#if ( ( configUSE_PREEMPTION == 1 ) && ( configUSE_TIME_SLICING == 1 ) && ( configUSE_TIME_SLICE_TABLE == 1 ) )
+
+	/* The number of ticks a task of each priority runs for before another
+	task of the same priority gets a turn.  0 means one tick. */
+	#ifdef configTIME_SLICE_TICKS
+		PRIVILEGED_DATA static TickType_t xTimeSliceTicks[ configMAX_PRIORITIES ] = configTIME_SLICE_TICKS;
+	#else
+		PRIVILEGED_DATA static TickType_t xTimeSliceTicks[ configMAX_PRIORITIES ];
+	#endif
+	PRIVILEGED_DATA static TickType_t xTimeSliceUsed = ( TickType_t ) 0U;	/*< Ticks the current task has run for since it was switched in. */
+
+#endif
+
 /* Global POSIX errno. Its value is changed upon context switching to match
 the errno of the currently running task. */
 #if ( configUSE_POSIX_ERRNO == 1 )
@@ -1699,6 +1712,38 @@ static void prvAddNewTaskToReadyList( TCB_t *pxNewTCB )
 #endif /* INCLUDE_vTaskPrioritySet */
 /*-----------------------------------------------------------*/
 
+#if ( ( configUSE_PREEMPTION == 1 ) && ( configUSE_TIME_SLICING == 1 ) && ( configUSE_TIME_SLICE_TABLE == 1 ) )
+
+	void vTaskSetTimeSlice( UBaseType_t uxPriority, TickType_t xTicks )
+	{
+		configASSERT( uxPriority < ( UBaseType_t ) configMAX_PRIORITIES );
+
+		if( uxPriority < ( UBaseType_t ) configMAX_PRIORITIES )
+		{
+			taskENTER_CRITICAL();
+			{
+				xTimeSliceTicks[ uxPriority ] = xTicks;
+			}
+			taskEXIT_CRITICAL();
+		}
+	}
+	/*-----------------------------------------------------------*/
+
+	TickType_t xTaskGetTimeSlice( UBaseType_t uxPriority )
+	{
+		configASSERT( uxPriority < ( UBaseType_t ) configMAX_PRIORITIES );
+
+		if( uxPriority >= ( UBaseType_t ) configMAX_PRIORITIES )
+		{
+			return ( TickType_t ) 0U;
+		}
+
+		return ( xTimeSliceTicks[ uxPriority ] == ( TickType_t ) 0U ) ? ( TickType_t ) 1U : xTimeSliceTicks[ uxPriority ];
+	}
+
+#endif /* configUSE_TIME_SLICE_TABLE */
+/*-----------------------------------------------------------*/
+
 #if ( INCLUDE_vTaskSuspend == 1 )
 
 	void vTaskSuspend( TaskHandle_t xTaskToSuspend )
@@ -2822,7 +2867,23 @@ BaseType_t xSwitchRequired = pdFALSE;
 		{
 			if( listCURRENT_LIST_LENGTH( &( pxReadyTasksLists[ pxCurrentTCB->uxPriority ] ) ) > ( UBaseType_t ) 1 )
 			{
-				xSwitchRequired = pdTRUE;
+				#if ( configUSE_TIME_SLICE_TABLE == 1 )
+				{
+					/* Only switch once the slice for this priority is used up. */
+					if( ++xTimeSliceUsed >= xTimeSliceTicks[ pxCurrentTCB->uxPriority ] )
+					{
+						xSwitchRequired = pdTRUE;
+					}
+					else
+					{
+						mtCOVERAGE_TEST_MARKER();
+					}
+				}
+				#else
+				{
+					xSwitchRequired = pdTRUE;
+				}
+				#endif /* configUSE_TIME_SLICE_TABLE */
 			}
 			else
 			{
@@ -3036,9 +3097,24 @@ void vTaskSwitchContext( void )
 		}
 		#endif
 
-		/* Select a new task to run using either the generic C or port
-		optimised asm code. */
-		taskSELECT_HIGHEST_PRIORITY_TASK(); /*lint !e9079 void * is used as this macro is used with timers and co-routines too.  Alignment is known to be fine as the type of the pointer stored and retrieved is the same. */
+		#if ( ( configUSE_PREEMPTION == 1 ) && ( configUSE_TIME_SLICING == 1 ) && ( configUSE_TIME_SLICE_TABLE == 1 ) )
+		{
+			/* The incoming task starts a new time slice, unless it is the
+			same task carrying on. */
+			TCB_t * const pxPreviousTCB = pxCurrentTCB;
+			taskSELECT_HIGHEST_PRIORITY_TASK(); /*lint !e9079 */
+			if( pxCurrentTCB != pxPreviousTCB )
+			{
+				xTimeSliceUsed = ( TickType_t ) 0U;
+			}
+		}
+		#else
+		{
+			/* Select a new task to run using either the generic C or port
+			optimised asm code. */
+			taskSELECT_HIGHEST_PRIORITY_TASK(); /*lint !e9079 void * is used as this macro is used with timers and co-routines too.  Alignment is known to be fine as the type of the pointer stored and retrieved is the same. */
+		}
+		#endif
 		traceTASK_SWITCHED_IN();
 
 		/* After the new task is switched in, update the global errno. */
@@ -0,0 +1,44 @@
+#ifndef _SDK_AMUTEX_H
+#define _SDK_AMUTEX_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+typedef struct {
+    uint32_t locks;
+    uint32_t uncontended;                   // Taken straight away
+    uint32_t spun;                          // Taken while spinning
+    uint32_t blocked;                       // Taken after blocking
+    uint32_t timeouts;
+    uint32_t spinMax;                       // Longest spin that got the mutex, core timer ticks
+} amutex_stats_t;
+
+// An adaptive mutex for very short critical sections: a task that finds it
+// held spins for up to spin core timer ticks, while the holder is able to
+// run, before blocking on the underlying FreeRTOS mutex.
+typedef struct {
+    SemaphoreHandle_t mutex;
+    uint32_t spin;
+    amutex_stats_t stats;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    StaticSemaphore_t mutexBuffer;
+#endif
+} amutex_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int amutex_init(amutex_t *m, uint32_t spinUs);
+extern int amutex_lock(amutex_t *m, TickType_t timeout);
+extern void amutex_unlock(amutex_t *m);
+extern int amutex_get_stats(amutex_t *m, amutex_stats_t *stats);
+extern void amutex_reset_stats(amutex_t *m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -15,6 +15,26 @@ typedef struct {
     volatile uint32_t   rsv3;
 } p32_regbuf;
 
+// Interrupt attributes for SDK interrupt handlers. With shadow register sets
+// enabled each priority level has its own register set (see
+// cpu_configure_shadow_sets()) so the handlers need not save the GPRs.
+// IPL1 is reserved for the kernel and always uses the normal register set.
+#if (configUSE_SHADOW_REGISTER_SETS == 1)
+#define cpuISR_IPL2 IPL2SRS
+#define cpuISR_IPL3 IPL3SRS
+#define cpuISR_IPL4 IPL4SRS
+#define cpuISR_IPL5 IPL5SRS
+#define cpuISR_IPL6 IPL6SRS
+#define cpuISR_IPL7 IPL7SRS
+#else
+#define cpuISR_IPL2 IPL2AUTO
+#define cpuISR_IPL3 IPL3AUTO
+#define cpuISR_IPL4 IPL4AUTO
+#define cpuISR_IPL5 IPL5AUTO
+#define cpuISR_IPL6 IPL6AUTO
+#define cpuISR_IPL7 IPL7AUTO
+#endif
+
 // These are done as macros instead of functions to make them super-fast
 #define cpu_ct_read_count(dest) asm volatile("mfc0 %0,$9" : "=r" (dest))
 #define cpu_ct_read_compare(dest) asm volatile("mfc0 %0,$11" : "=r" (dest))
@@ -39,6 +59,7 @@ extern void cpu_unlock();
 extern void cpu_lock();
 extern void cpu_reset();
 extern void cpu_ct_init(uint32_t initcompare);
+extern void cpu_configure_shadow_sets();
 
 #ifdef __cplusplus
 }
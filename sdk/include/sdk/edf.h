@@ -0,0 +1,33 @@
+#ifndef _SDK_EDF_H
+#define _SDK_EDF_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef struct {
+    uint32_t jobs;
+    uint32_t misses;                        // Jobs finished after their deadline
+    uint32_t responseMax;                   // Ticks from release to the end of the job
+    TickType_t period;
+    TickType_t wcet;
+    TickType_t deadline;                    // Relative to the release
+} edf_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int edf_task_create(TaskFunction_t code, const char *name, uint16_t stack, void *params,
+    TickType_t period, TickType_t wcet, TickType_t deadline, TaskHandle_t *handle);
+extern void edf_wait_next_period();
+extern uint32_t edf_utilisation();
+extern int edf_get_stats(uint8_t index, edf_stats_t *stats);
+extern int edf_report(uint8_t uart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
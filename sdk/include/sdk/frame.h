@@ -0,0 +1,60 @@
+#ifndef _SDK_FRAME_H
+#define _SDK_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+
+// Called by the encoder with each piece of encoded output
+typedef void (*frame_write_t)(void *ctx, const uint8_t *data, size_t len);
+
+typedef struct {
+    frame_write_t write;
+    void *ctx;
+    uint16_t crc;
+    uint8_t count;                  // Bytes in block, including the code byte
+    uint8_t block[256];             // The COBS block being built, code byte first, and room for the delimiter
+} frame_encoder_t;
+
+typedef struct {
+    uint32_t frames;                // Good frames delivered
+    uint32_t crcErrors;
+    uint32_t formatErrors;          // Broken COBS or frames too short for a CRC
+    uint32_t overruns;              // Frames too big for the buffer
+} frame_stats_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    size_t length;                  // Payload bytes of the last good frame
+    uint8_t code;                   // Code byte of the current block
+    uint8_t left;                   // Bytes left in the current block
+    uint8_t state;
+    frame_stats_t stats;
+} frame_decoder_t;
+
+// The most bytes a payload of n bytes can take once framed: the CRC, one
+// code byte per 254 bytes and the delimiter
+#define frameENCODED_SIZE(n) ((n) + 2 + ((n) + 2) / 254 + 2)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern uint16_t frame_crc16(uint16_t crc, const uint8_t *data, size_t len);
+extern void frame_begin(frame_encoder_t *e, frame_write_t write, void *ctx);
+extern void frame_put(frame_encoder_t *e, const uint8_t *data, size_t len);
+extern void frame_end(frame_encoder_t *e);
+extern size_t frame_encode(const uint8_t *payload, size_t len, uint8_t *out, size_t size);
+extern void frame_decoder_init(frame_decoder_t *d, uint8_t *buf, size_t size);
+extern int frame_decode(frame_decoder_t *d, uint8_t byte);
+extern int frame_send(uint8_t uart, const uint8_t *payload, size_t len);
+extern int frame_receive(uint8_t uart, frame_decoder_t *d, TickType_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _SDK_HTIMER_H
+#define _SDK_HTIMER_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#define htimerINACTIVE 0xFFFF
+
+typedef struct htimer htimer_t;
+typedef void (*htimerCallback_t)(htimer_t *timer, void *arg);
+
+// A timer, owned by the application and usually static. Tick timers run
+// their callbacks in the htimer service task; high resolution timers run
+// them in the Timer3 interrupt at configHTIMER_HIRES_IPL. A timer must only
+// be used as one kind or the other.
+struct htimer {
+    htimerCallback_t callback;
+    void *arg;
+    uint32_t expiry;                        // Tick count, or core timer count for high resolution timers
+    uint32_t period;                        // Same units as expiry, 0 for a one-shot timer
+    volatile uint16_t index;                // Position in the heap, htimerINACTIVE when stopped
+};
+
+#define htimerINIT(callback, arg) { (callback), (arg), 0, 0, htimerINACTIVE }
+
+typedef struct {
+    uint32_t commands;
+    uint32_t batches;                       // Wakes of the service task that handled commands
+    uint32_t maxBatch;
+    uint32_t fired;
+    uint32_t active;
+    uint32_t maxActive;
+    uint32_t overflows;                     // Starts refused because the heap was full
+    uint32_t missed;                        // Periods of high resolution timers skipped after falling behind
+} htimer_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int htimer_start_service();
+extern int htimer_start(htimer_t *timer, TickType_t delay, TickType_t period, TickType_t wait);
+extern int htimer_start_from_isr(htimer_t *timer, TickType_t delay, TickType_t period, BaseType_t *woken);
+extern int htimer_stop(htimer_t *timer, TickType_t wait);
+extern int htimer_stop_from_isr(htimer_t *timer, BaseType_t *woken);
+extern int htimer_is_active(htimer_t *timer);
+extern int htimer_get_stats(htimer_stats_t *stats);
+
+extern int htimer_hires_start(htimer_t *timer, uint32_t us, uint32_t periodUs);
+extern int htimer_hires_stop(htimer_t *timer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _SDK_HTIMER_HEAP_H
+#define _SDK_HTIMER_HEAP_H
+
+#include <stdint.h>
+
+#include "sdk/htimer.h"
+
+// The min-heap the htimer service keeps its active timers in, for
+// htimer.c's use. It holds no lock of its own and calls nothing else, so
+// it also builds and is tested on the host.
+
+typedef struct {
+    htimer_t **node;
+    uint16_t count;
+    uint16_t size;
+} htimer_heap_t;
+
+#define htimerCMD_START 0
+#define htimerCMD_STOP 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void htimer_sift_up(htimer_heap_t *heap, uint16_t i);
+extern void htimer_sift_down(htimer_heap_t *heap, uint16_t i);
+extern void htimer_heap_remove(htimer_heap_t *heap, htimer_t *timer);
+extern int htimer_heap_apply(htimer_heap_t *heap, htimer_t *timer, uint8_t op, uint32_t expiry, uint32_t period);
+extern htimer_t *htimer_heap_pop_expired(htimer_heap_t *heap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef _SDK_ISRPROF_H
+#define _SDK_ISRPROF_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "sdk/cpu.h"
+
+#define isrprofBUCKETS 16
+
+typedef struct {
+    uint8_t vector;
+    uint8_t ipl;
+    uint32_t count;
+    uint32_t min;                           // Core timer ticks
+    uint32_t max;                           // Core timer ticks
+    uint64_t total;                         // Core timer ticks
+    uint32_t histogram[isrprofBUCKETS];     // Bucket n counts durations < 2^n ticks
+} isrprof_slot_t;
+
+// These are macros so that they cost nothing when profiling is disabled.
+// isrprof_enter() declares the variable holding the entry timestamp, so it
+// must come before isrprof_exit() in the same scope.
+#if (configUSE_ISR_PROFILING == 1)
+#define isrprof_enter(ts) uint32_t ts; cpu_ct_read_count(ts)
+#define isrprof_exit(vector, ipl, ts) isrprof_record((vector), (ipl), (ts))
+#else
+#define isrprof_enter(ts)
+#define isrprof_exit(vector, ipl, ts)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void isrprof_record(uint8_t vector, uint8_t ipl, uint32_t start);
+extern void isrprof_tick_latency(uint32_t latency);
+extern void isrprof_disable_start(void *caller);
+extern void isrprof_disable_end();
+extern void isrprof_reset();
+extern int isrprof_get_slot(uint8_t index, isrprof_slot_t *slot);
+extern uint32_t isrprof_get_disable_max(void **caller);
+extern uint32_t isrprof_get_ipl_latency(uint8_t ipl);
+extern uint32_t isrprof_ticks_to_ns(uint32_t ticks);
+extern int isrprof_benchmark_entry(uint32_t iterations, uint32_t *min, uint32_t *avg, uint32_t *max);
+extern int isrprof_report(uint8_t uart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef _SDK_KTRACE_H
+#define _SDK_KTRACE_H
+
+#include <stdint.h>
+
+// This header is pulled in by FreeRTOSConfig.h when configUSE_KTRACE is 1
+// so that the kernel trace macros are defined before FreeRTOS.h provides its
+// empty defaults. It must therefore not depend on any FreeRTOS types.
+
+#define ktraceMAGIC                 0x52544B46UL    // "FKTR"
+#define ktraceVERSION               1
+
+// Event identifiers. These are part of the binary format understood by
+// tools/ktrace_decode.py, so only ever add to the end of the list.
+#define ktraceEV_NONE               0x00
+#define ktraceEV_SWITCH_IN          0x01
+#define ktraceEV_SWITCH_OUT         0x02
+#define ktraceEV_READY              0x03
+#define ktraceEV_TASK_CREATE        0x04
+#define ktraceEV_TASK_DELETE        0x05
+#define ktraceEV_DELAY              0x06
+#define ktraceEV_DELAY_UNTIL        0x07
+#define ktraceEV_SUSPEND            0x08
+#define ktraceEV_RESUME             0x09
+#define ktraceEV_PRIORITY_SET       0x0A
+#define ktraceEV_PRIORITY_INHERIT   0x0B
+#define ktraceEV_PRIORITY_DISINHERIT 0x0C
+#define ktraceEV_QUEUE_CREATE       0x10
+#define ktraceEV_QUEUE_DELETE       0x11
+#define ktraceEV_QUEUE_SEND         0x12
+#define ktraceEV_QUEUE_SEND_FAILED  0x13
+#define ktraceEV_QUEUE_SEND_ISR     0x14
+#define ktraceEV_QUEUE_RECEIVE      0x15
+#define ktraceEV_QUEUE_RECEIVE_FAILED 0x16
+#define ktraceEV_QUEUE_RECEIVE_ISR  0x17
+#define ktraceEV_QUEUE_PEEK         0x18
+#define ktraceEV_BLOCK_SEND         0x19
+#define ktraceEV_BLOCK_RECEIVE      0x1A
+#define ktraceEV_BLOCK_PEEK         0x1B
+#define ktraceEV_NOTIFY             0x20
+#define ktraceEV_NOTIFY_ISR         0x21
+#define ktraceEV_NOTIFY_WAIT_BLOCK  0x22
+#define ktraceEV_NOTIFY_TAKE_BLOCK  0x23
+#define ktraceEV_TICK               0x30
+#define ktraceEV_USER               0x80
+
+// One trace record. Kept at 8 bytes so a record can be written with two
+// word stores.
+typedef struct {
+    uint32_t timestamp;     // Core timer count (SYSCLK / 2)
+    uint8_t event;          // One of ktraceEV_*
+    uint8_t task;           // Kernel task number of the running task
+    uint16_t param;         // Event specific: task number or object id
+} ktrace_record_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void ktrace_init();
+extern void ktrace_start();
+extern void ktrace_stop();
+extern void ktrace_clear();
+extern int ktrace_is_running();
+extern uint32_t ktrace_get_overhead();
+extern uint32_t ktrace_get_count();
+extern void ktrace_event(uint8_t event, uint16_t param);
+extern void ktrace_task_event(uint8_t event, void *tcb);
+extern void ktrace_object_event(uint8_t event, void *object);
+extern void ktrace_switched_in(void *tcb);
+extern void ktrace_task_created(void *tcb);
+extern int ktrace_dump(uint8_t uart);
+extern int ktrace_dump_emergency(uint8_t uart);
+
+#ifdef __cplusplus
+}
+#endif
+
+// Kernel hooks. These expand inside tasks.c and queue.c so may refer to the
+// locals the kernel passes (or, for the notify hooks, has in scope as pxTCB).
+#define traceTASK_SWITCHED_IN()                     ktrace_switched_in(pxCurrentTCB)
+#define traceTASK_SWITCHED_OUT()                    ktrace_event(ktraceEV_SWITCH_OUT, 0)
+#define traceMOVED_TASK_TO_READY_STATE(pxTCB)       ktrace_task_event(ktraceEV_READY, pxTCB)
+#define traceTASK_CREATE(pxNewTCB)                  ktrace_task_created(pxNewTCB)
+#define traceTASK_DELETE(pxTCB)                     ktrace_task_event(ktraceEV_TASK_DELETE, pxTCB)
+#define traceTASK_DELAY()                           ktrace_event(ktraceEV_DELAY, 0)
+#define traceTASK_DELAY_UNTIL(xTimeToWake)          ktrace_event(ktraceEV_DELAY_UNTIL, (uint16_t)(xTimeToWake))
+#define traceTASK_SUSPEND(pxTCB)                    ktrace_task_event(ktraceEV_SUSPEND, pxTCB)
+#define traceTASK_RESUME(pxTCB)                     ktrace_task_event(ktraceEV_RESUME, pxTCB)
+#define traceTASK_RESUME_FROM_ISR(pxTCB)            ktrace_task_event(ktraceEV_RESUME, pxTCB)
+#define traceTASK_PRIORITY_SET(pxTCB, uxNewPriority) ktrace_task_event(ktraceEV_PRIORITY_SET, pxTCB)
+#define traceTASK_PRIORITY_INHERIT(pxTCB, uxPriority) ktrace_task_event(ktraceEV_PRIORITY_INHERIT, pxTCB)
+#define traceTASK_PRIORITY_DISINHERIT(pxTCB, uxPriority) ktrace_task_event(ktraceEV_PRIORITY_DISINHERIT, pxTCB)
+
+#define traceQUEUE_CREATE(pxQueue)                  ktrace_object_event(ktraceEV_QUEUE_CREATE, pxQueue)
+#define traceQUEUE_DELETE(pxQueue)                  ktrace_object_event(ktraceEV_QUEUE_DELETE, pxQueue)
+#define traceQUEUE_SEND(pxQueue)                    ktrace_object_event(ktraceEV_QUEUE_SEND, pxQueue)
+#define traceQUEUE_SEND_FAILED(pxQueue)             ktrace_object_event(ktraceEV_QUEUE_SEND_FAILED, pxQueue)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue)           ktrace_object_event(ktraceEV_QUEUE_SEND_ISR, pxQueue)
+#define traceQUEUE_RECEIVE(pxQueue)                 ktrace_object_event(ktraceEV_QUEUE_RECEIVE, pxQueue)
+#define traceQUEUE_RECEIVE_FAILED(pxQueue)          ktrace_object_event(ktraceEV_QUEUE_RECEIVE_FAILED, pxQueue)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue)        ktrace_object_event(ktraceEV_QUEUE_RECEIVE_ISR, pxQueue)
+#define traceQUEUE_PEEK(pxQueue)                    ktrace_object_event(ktraceEV_QUEUE_PEEK, pxQueue)
+#define traceBLOCKING_ON_QUEUE_SEND(pxQueue)        ktrace_object_event(ktraceEV_BLOCK_SEND, pxQueue)
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue)     ktrace_object_event(ktraceEV_BLOCK_RECEIVE, pxQueue)
+#define traceBLOCKING_ON_QUEUE_PEEK(pxQueue)        ktrace_object_event(ktraceEV_BLOCK_PEEK, pxQueue)
+
+#define traceTASK_NOTIFY()                          ktrace_task_event(ktraceEV_NOTIFY, pxTCB)
+#define traceTASK_NOTIFY_FROM_ISR()                 ktrace_task_event(ktraceEV_NOTIFY_ISR, pxTCB)
+#define traceTASK_NOTIFY_GIVE_FROM_ISR()            ktrace_task_event(ktraceEV_NOTIFY_ISR, pxTCB)
+#define traceTASK_NOTIFY_WAIT_BLOCK()               ktrace_event(ktraceEV_NOTIFY_WAIT_BLOCK, 0)
+#define traceTASK_NOTIFY_TAKE_BLOCK()               ktrace_event(ktraceEV_NOTIFY_TAKE_BLOCK, 0)
+
+#if (configKTRACE_TICKS == 1)
+#define traceTASK_INCREMENT_TICK(xTickCount)        ktrace_event(ktraceEV_TICK, (uint16_t)(xTickCount))
+#endif
+
+#endif
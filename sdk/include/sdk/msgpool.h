@@ -0,0 +1,65 @@
+#ifndef _SDK_MSGPOOL_H
+#define _SDK_MSGPOOL_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "task.h"
+
+// Every block is preceded by this header. The payload pointer handed to
+// callers points just past it.
+typedef struct {
+    struct msgpool *pool;
+    volatile uint32_t refs;
+    uint16_t length;                // Bytes of payload in use
+} __attribute__((aligned(8))) msgpool_header_t;
+
+typedef struct msgpool {
+    QueueHandle_t free;             // Pointers to the free blocks
+    uint8_t *blocks;
+    uint16_t size;                  // Payload bytes per block
+    uint16_t stride;                // Header plus payload, rounded up to 8 bytes
+    uint16_t count;
+    uint16_t lowest;                // Fewest free blocks ever seen
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    StaticQueue_t freeQueue;
+#endif
+} msgpool_t;
+
+#define msgpoolSTRIDE(size) ((sizeof(msgpool_header_t) + (size) + 7) & ~7UL)
+
+// Bytes of storage msgpool_init() needs for a pool. The storage must be
+// 8-byte aligned.
+#define msgpoolSTORAGE_SIZE(size, count) ((count) * (msgpoolSTRIDE(size) + sizeof(void *)))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int msgpool_init(msgpool_t *pool, void *storage, uint16_t size, uint16_t count);
+extern void *msgpool_alloc(msgpool_t *pool, TickType_t timeout);
+extern void *msgpool_alloc_from_isr(msgpool_t *pool);
+extern void msgpool_ref(void *msg, uint16_t count);
+extern void msgpool_free(void *msg);
+extern void msgpool_free_from_isr(void *msg, BaseType_t *woken);
+extern uint16_t msgpool_get_length(const void *msg);
+extern int msgpool_set_length(void *msg, uint16_t length);
+extern uint16_t msgpool_get_size(const void *msg);
+extern uint16_t msgpool_available(msgpool_t *pool);
+extern uint16_t msgpool_lowest(msgpool_t *pool);
+
+extern int msgpool_send(QueueHandle_t queue, void *msg, TickType_t timeout);
+extern int msgpool_send_from_isr(QueueHandle_t queue, void *msg, BaseType_t *woken);
+extern void *msgpool_receive(QueueHandle_t queue, TickType_t timeout);
+extern int msgpool_notify(TaskHandle_t task, void *msg);
+extern int msgpool_notify_from_isr(TaskHandle_t task, void *msg, BaseType_t *woken);
+extern void *msgpool_wait(TickType_t timeout);
+
+extern int msgpool_benchmark(uint8_t uart, uint16_t size, uint32_t messages);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _SDK_PUBSUB_H
+#define _SDK_PUBSUB_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if (configPUBSUB_TOPICS > 32)
+#error configPUBSUB_TOPICS cannot be more than 32, one per notification bit
+#endif
+
+// Topic IDs are fixed at compile time by the application, numbered from 0 to
+// configPUBSUB_TOPICS - 1, e.g.
+//
+//     enum { TOPIC_UART_FRAME, TOPIC_BUTTON, TOPIC_SENSOR };
+//     pubsub_subscribe(&sub, pubsubTOPIC(TOPIC_UART_FRAME) | pubsubTOPIC(TOPIC_BUTTON));
+#define pubsubTOPIC(id) (1UL << (id))
+
+// One per subscribing task, owned by the application. Each topic has a slot
+// holding the latest payload published that the task has not taken yet.
+typedef struct {
+    TaskHandle_t task;
+    volatile uint32_t mask;
+    volatile uint32_t pending;                  // Published but not yet returned by pubsub_wait()
+    void *payload[configPUBSUB_TOPICS];
+    uint32_t published[configPUBSUB_TOPICS];    // Core timer count at the first publish pending
+} pubsub_subscriber_t;
+
+typedef struct {
+    uint32_t published;
+    uint32_t delivered;
+    uint32_t overwritten;                       // Published again before being taken
+    uint32_t latencyMin;                        // Core timer ticks, publish to wake
+    uint32_t latencyMax;
+    uint64_t latencyTotal;
+} pubsub_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int pubsub_subscribe(pubsub_subscriber_t *sub, uint32_t topics);
+extern int pubsub_set_filter(pubsub_subscriber_t *sub, uint32_t topics);
+extern int pubsub_unsubscribe(pubsub_subscriber_t *sub);
+extern int pubsub_publish(uint8_t topic, void *msg);
+extern int pubsub_publish_from_isr(uint8_t topic, void *msg, BaseType_t *woken);
+extern uint32_t pubsub_wait(pubsub_subscriber_t *sub, TickType_t timeout);
+extern void *pubsub_take(pubsub_subscriber_t *sub, uint8_t topic);
+extern int pubsub_get_stats(uint8_t topic, pubsub_stats_t *stats);
+extern void pubsub_reset_stats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef _SDK_RWLOCK_H
+#define _SDK_RWLOCK_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
+typedef struct {
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t readContended;                 // Read locks that had to wait for a writer
+    uint32_t writeContended;                // Write locks that had to wait for readers or another writer
+    uint32_t timeouts;
+    uint16_t maxReaders;                    // Most readers holding the lock at once
+    uint32_t readWaitMax;                   // Core timer ticks
+    uint32_t writeWaitMax;
+} rwlock_stats_t;
+
+// A reader/writer lock, owned by the application. Any number of tasks may
+// hold it for reading, or one task for writing. The first
+// configRWLOCK_MAX_READERS readers are tracked so that a waiting writer can
+// lend them its priority.
+typedef struct {
+    SemaphoreHandle_t gate;                 // Held by the writer, and taken by readers queueing behind one
+    SemaphoreHandle_t drained;              // Given by the last reader out while the writer waits
+    TaskHandle_t writer;
+    TaskHandle_t reader[configRWLOCK_MAX_READERS];
+    volatile uint16_t readers;
+    volatile uint16_t writersWaiting;
+    rwlock_stats_t stats;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    StaticSemaphore_t gateBuffer;
+    StaticSemaphore_t drainedBuffer;
+#endif
+} rwlock_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int rwlock_init(rwlock_t *lock);
+extern int rwlock_read_lock(rwlock_t *lock, TickType_t timeout);
+extern void rwlock_read_unlock(rwlock_t *lock);
+extern int rwlock_write_lock(rwlock_t *lock, TickType_t timeout);
+extern void rwlock_write_unlock(rwlock_t *lock);
+extern int rwlock_get_stats(rwlock_t *lock, rwlock_stats_t *stats);
+extern void rwlock_reset_stats(rwlock_t *lock);
+
+// Runs on the target only, as it busy-waits on the core timer and prints to
+// a UART, and only with configUSE_RWLOCK_BENCHMARK; otherwise it returns 0.
+// tests/host/test_rwlock.cpp tests the lock itself.
+extern int rwlock_benchmark(uint8_t uart, uint8_t readers, uint8_t writers, uint32_t ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
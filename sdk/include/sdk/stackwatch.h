@@ -0,0 +1,37 @@
+#ifndef _SDK_STACKWATCH_H
+#define _SDK_STACKWATCH_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef struct {
+    TaskHandle_t task;
+    char name[configMAX_TASK_NAME_LEN];
+    const char *macro;                              // Config macro that sizes the stack, or NULL
+    uint32_t size;                                  // Allocated stack in words, 0 if unknown
+    uint32_t lowest;                                // Lowest free space seen in words
+    uint16_t history[configSTACKWATCH_HISTORY];     // Recent free space samples in words
+    uint8_t samples;
+    uint8_t next;
+} stackwatch_entry_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int stackwatch_start();
+extern int stackwatch_register(TaskHandle_t task, uint32_t size, const char *macro);
+extern void stackwatch_sample();
+extern int stackwatch_get_entry(uint8_t index, stackwatch_entry_t *entry);
+extern uint32_t stackwatch_isr_free();
+extern uint32_t stackwatch_recommend(uint32_t used);
+extern int stackwatch_report(uint8_t uart);
+extern int stackwatch_dump_config(uint8_t uart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef _SDK_SWITCHBENCH_H
+#define _SDK_SWITCHBENCH_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+typedef struct {
+    uint32_t min;                   // CPU cycles per switch
+    uint32_t avg;
+    uint32_t max;
+    uint32_t ownerChanges;          // Times the FPU changed hands (lazy switching only)
+} switchbench_result_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int switchbench_run(uint32_t iterations, uint8_t fpuTasks, switchbench_result_t *result);
+extern int switchbench_report(uint8_t uart, uint32_t iterations);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
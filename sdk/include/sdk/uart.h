@@ -2,6 +2,7 @@
 #define _SDK_UART_H
 
 #include <stdint.h>
+#include "FreeRTOS.h"
 #include "stream_buffer.h"
 
 #define uart8N1 0b000
@@ -26,6 +27,7 @@ extern int uart_rx_available(uint8_t uart);
 extern int uart_tx_available(uint8_t uart);
 extern int uart_peek(uint8_t uart);
 extern int uart_read(uint8_t uart);
+extern int uart_wait_rx(uint8_t uart, TickType_t timeout);
 extern int uart_write_bytes(uint8_t uart, const uint8_t *bytes, size_t len);
 extern int uart_write(uint8_t uart, uart_queue_t byte);
 extern int uart_set_tx_pin(uint8_t uart, uint8_t pin);
@@ -0,0 +1,45 @@
+#ifndef _SDK_WORKQUEUE_H
+#define _SDK_WORKQUEUE_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+// A unit of deferred work, owned by the submitter and usually static. An
+// item can only be queued once at a time; submitting it again while it is
+// still waiting to run is coalesced into the pending run.
+typedef struct workqueue_item {
+    struct workqueue_item *volatile next;
+    void (*function)(void *arg);
+    void *arg;
+    volatile uint32_t queued;               // Core timer count when queued, 0 when idle
+    uint8_t lane;
+} workqueue_item_t;
+
+#define workqueueITEM(function, arg, lane) { NULL, (function), (arg), 0, (lane) }
+
+typedef struct {
+    uint32_t submitted;
+    uint32_t coalesced;
+    uint32_t executed;
+    uint32_t depth;                         // Items waiting now
+    uint32_t maxDepth;
+    uint32_t latencyMax;                    // Core timer ticks, submit to start of run
+    uint64_t latencyTotal;
+} workqueue_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int workqueue_start();
+extern int workqueue_submit(workqueue_item_t *item);
+extern int workqueue_submit_from_isr(workqueue_item_t *item, BaseType_t *woken);
+extern int workqueue_get_stats(uint8_t lane, workqueue_stats_t *stats);
+extern int workqueue_report(uint8_t uart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef _ARDUINO_H
+#define _ARDUINO_H
+
+// Stands in for pic32/Arduino.h when the core is built on the host. The
+// Makefile includes it ahead of every source, so the real one, which needs
+// the PIC32 headers, is left out by its include guard.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+#include "WString.h"
+#include "Stream.h"
+#include "Print.h"
+#endif
+
+#define CHANGE  0x2
+#define FALLING 0x3
+#define RISING  0x4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void delay(uint32_t ms);
+extern uint32_t millis();
+extern uint32_t micros();
+extern void yield();
+
+// In the PIC32 C library but not in glibc
+extern char *ltoa(long val, char *s, int radix);
+extern char *ultoa(unsigned long val, char *s, int radix);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
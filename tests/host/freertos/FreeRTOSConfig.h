@@ -0,0 +1,21 @@
+#ifndef HOST_FREERTOS_CONFIG_H
+#define HOST_FREERTOS_CONFIG_H
+
+// The target's configuration, so drivers built for the tests see the same
+// options and defaults as on the PIC32. <xc.h> is an empty stand-in here.
+#include "../../../sdk/freertos/targets/MZ/FreeRTOSConfig.h"
+
+// Both ways of allocating kernel objects are built, so the drivers' static
+// paths are tested as well; where a driver has both it takes that one.
+#undef configSUPPORT_STATIC_ALLOCATION
+#define configSUPPORT_STATIC_ALLOCATION 1
+
+// Drivers that are off by default on the target, built so they can be tested
+#undef configUSE_HTIMER
+#define configUSE_HTIMER 1
+
+// Latencies and waits in microseconds rather than core timer counts
+#define pubsubTIMESTAMP(dest) ((dest) = micros())
+#define rwlockTIMESTAMP(dest) ((dest) = micros())
+
+#endif
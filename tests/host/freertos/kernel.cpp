@@ -0,0 +1,604 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "stream_buffer.h"
+
+// Stand-ins for the parts of the FreeRTOS API the drivers use, so they can
+// be tested on the host with real concurrency. Each task is a thread, and
+// all run at once whatever their priority, so the tests see more ways for
+// tasks to interleave than the PIC32 would give them, not fewer.
+//
+// Every kernel object is guarded by one lock, the same one critical
+// sections take, and every change to one wakes all the waiting threads to
+// look again. A tick is a millisecond of real time since the program
+// started. Priorities and priority inheritance are recorded, so the
+// drivers can read them back, but do not change which thread runs.
+
+struct tskTaskControlBlock {
+    TaskFunction_t code;
+    void *arg;
+    char name[configMAX_TASK_NAME_LEN];
+    UBaseType_t priority;
+    UBaseType_t basePriority;
+    UBaseType_t mutexesHeld;
+    uint32_t notifyValue;
+    bool notified;
+};
+
+struct QueueDefinition {
+    uint8_t type;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t count;                          // Items queued, or the semaphore's count
+    std::deque<std::vector<uint8_t> > items;
+    TaskHandle_t holder;                        // Of a mutex
+    UBaseType_t recursion;
+};
+
+struct StreamBufferDef_t {
+    size_t size;
+    size_t trigger;
+    std::deque<uint8_t> data;
+};
+
+// Never destroyed, as tasks are still running when the program exits
+static std::recursive_mutex &kernelLock = *new std::recursive_mutex();
+static std::condition_variable_any &kernelChanged = *new std::condition_variable_any();
+static std::vector<TaskHandle_t> &kernelTasks = *new std::vector<TaskHandle_t>();
+static const std::chrono::steady_clock::time_point kernelStart = std::chrono::steady_clock::now();
+static thread_local TaskHandle_t currentTask = NULL;
+
+typedef std::unique_lock<std::recursive_mutex> KernelLock;
+
+// Wait with the kernel locked until ready() is true, or for ticks.
+// Returns whether it became true.
+template <typename Ready>
+static bool kernelWait(KernelLock &lock, TickType_t ticks, Ready ready) {
+    if (ticks == portMAX_DELAY) {
+        kernelChanged.wait(lock, ready);
+        return true;
+    }
+    return kernelChanged.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+static void kernelNotify() {
+    kernelChanged.notify_all();
+}
+
+extern "C" {
+
+void vAssertCalled(const char *pcFile, unsigned long ulLine) {
+    fprintf(stderr, "%s:%lu: configASSERT failed\n", pcFile, ulLine);
+    abort();
+}
+
+void *pvPortMalloc(size_t xSize) {
+    return malloc(xSize);
+}
+
+void vPortFree(void *pv) {
+    free(pv);
+}
+
+/* Critical sections and interrupts */
+
+void vTaskEnterCritical(void) {
+    kernelLock.lock();
+}
+
+void vTaskExitCritical(void) {
+    kernelLock.unlock();
+}
+
+UBaseType_t uxPortSetInterruptMaskFromISR(void) {
+    kernelLock.lock();
+    return 0;
+}
+
+void vPortClearInterruptMaskFromISR(UBaseType_t uxSavedStatusRegister) {
+    (void)uxSavedStatusRegister;
+    kernelLock.unlock();
+}
+
+void vPortYield(void) {
+    std::this_thread::yield();
+}
+
+void vTaskSuspendAll(void) {
+    kernelLock.lock();
+}
+
+BaseType_t xTaskResumeAll(void) {
+    kernelLock.unlock();
+    return pdFALSE;
+}
+
+/* Tasks */
+
+static TaskHandle_t newTask(TaskFunction_t code, const char *name, void *arg, UBaseType_t priority) {
+    TaskHandle_t t = new tskTaskControlBlock();
+    t->code = code;
+    t->arg = arg;
+    strncpy(t->name, name, sizeof(t->name) - 1);
+    t->priority = t->basePriority = priority;
+    KernelLock lock(kernelLock);
+    kernelTasks.push_back(t);
+    return t;
+}
+
+static void startTask(TaskHandle_t t) {
+    std::thread([t] {
+        currentTask = t;
+        t->code(t->arg);
+    }).detach();
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char * const pcName, const configSTACK_DEPTH_TYPE usStackDepth,
+    void * const pvParameters, UBaseType_t uxPriority, TaskHandle_t * const pxCreatedTask) {
+    (void)usStackDepth;
+    TaskHandle_t t = newTask(pxTaskCode, pcName, pvParameters, uxPriority);
+    if (pxCreatedTask != NULL) *pxCreatedTask = t;
+    startTask(t);
+    return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t pxTaskCode, const char * const pcName, const uint32_t ulStackDepth,
+    void * const pvParameters, UBaseType_t uxPriority, StackType_t * const puxStackBuffer, StaticTask_t * const pxTaskBuffer) {
+    (void)ulStackDepth;
+    configASSERT((puxStackBuffer != NULL) && (pxTaskBuffer != NULL));
+    TaskHandle_t t = newTask(pxTaskCode, pcName, pvParameters, uxPriority);
+    startTask(t);
+    return t;
+}
+
+// The main thread, and any other not started by xTaskCreate(), is a task
+// too, so tests can block in the kernel from main()
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (currentTask == NULL) currentTask = newTask(NULL, "main", NULL, tskIDLE_PRIORITY + 1);
+    return currentTask;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete) {
+    // Only a task ending itself is supported; its TCB stays in
+    // kernelTasks, as a handle to it may still be in use
+    configASSERT((xTaskToDelete == NULL) || (xTaskToDelete == xTaskGetCurrentTaskHandle()));
+    pthread_exit(NULL);
+}
+
+void vTaskSuspend(TaskHandle_t xTaskToSuspend) {
+    configASSERT((xTaskToSuspend == NULL) || (xTaskToSuspend == xTaskGetCurrentTaskHandle()));
+    KernelLock lock(kernelLock);
+    kernelChanged.wait(lock, [] { return false; });
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - kernelStart).count();
+}
+
+TickType_t xTaskGetTickCountFromISR(void) {
+    return xTaskGetTickCount();
+}
+
+void vTaskDelay(const TickType_t xTicksToDelay) {
+    if (xTicksToDelay == 0) std::this_thread::yield();
+    else std::this_thread::sleep_for(std::chrono::milliseconds(xTicksToDelay));
+}
+
+void vTaskDelayUntil(TickType_t * const pxPreviousWakeTime, const TickType_t xTimeIncrement) {
+    *pxPreviousWakeTime += xTimeIncrement;
+    TickType_t wait = *pxPreviousWakeTime - xTaskGetTickCount();
+    if ((int32_t)wait > 0) vTaskDelay(wait);
+}
+
+char *pcTaskGetName(TaskHandle_t xTaskToQuery) {
+    return (xTaskToQuery != NULL) ? xTaskToQuery->name : xTaskGetCurrentTaskHandle()->name;
+}
+
+UBaseType_t uxTaskPriorityGet(const TaskHandle_t xTask) {
+    KernelLock lock(kernelLock);
+    return (xTask != NULL) ? xTask->priority : xTaskGetCurrentTaskHandle()->priority;
+}
+
+void vTaskPrioritySet(TaskHandle_t xTask, UBaseType_t uxNewPriority) {
+    KernelLock lock(kernelLock);
+    TaskHandle_t t = (xTask != NULL) ? xTask : xTaskGetCurrentTaskHandle();
+    // As in tasks.c, an inherited priority is kept until it is given back
+    if ((t->priority == t->basePriority) || (uxNewPriority > t->priority)) t->priority = uxNewPriority;
+    t->basePriority = uxNewPriority;
+}
+
+/* Timeouts */
+
+void vTaskInternalSetTimeOutState(TimeOut_t * const pxTimeOut) {
+    pxTimeOut->xOverflowCount = 0;
+    pxTimeOut->xTimeOnEntering = xTaskGetTickCount();
+}
+
+void vTaskSetTimeOutState(TimeOut_t * const pxTimeOut) {
+    vTaskInternalSetTimeOutState(pxTimeOut);
+}
+
+BaseType_t xTaskCheckForTimeOut(TimeOut_t * const pxTimeOut, TickType_t * const pxTicksToWait) {
+    if (*pxTicksToWait == portMAX_DELAY) return pdFALSE;
+    TickType_t elapsed = xTaskGetTickCount() - pxTimeOut->xTimeOnEntering;
+    if (elapsed >= *pxTicksToWait) {
+        *pxTicksToWait = 0;
+        return pdTRUE;
+    }
+    *pxTicksToWait -= elapsed;
+    vTaskInternalSetTimeOutState(pxTimeOut);
+    return pdFALSE;
+}
+
+/* Notifications */
+
+static BaseType_t notify(TaskHandle_t t, uint32_t ulValue, eNotifyAction eAction, uint32_t *pulPreviousNotificationValue) {
+    configASSERT(t != NULL);
+    KernelLock lock(kernelLock);
+    if (pulPreviousNotificationValue != NULL) *pulPreviousNotificationValue = t->notifyValue;
+    switch (eAction) {
+        case eSetBits: t->notifyValue |= ulValue; break;
+        case eIncrement: t->notifyValue++; break;
+        case eSetValueWithOverwrite: t->notifyValue = ulValue; break;
+        case eSetValueWithoutOverwrite:
+            if (t->notified) return pdFAIL;
+            t->notifyValue = ulValue;
+            break;
+        case eNoAction: break;
+    }
+    t->notified = true;
+    kernelNotify();
+    return pdPASS;
+}
+
+BaseType_t xTaskGenericNotify(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction, uint32_t *pulPreviousNotificationValue) {
+    return notify(xTaskToNotify, ulValue, eAction, pulPreviousNotificationValue);
+}
+
+BaseType_t xTaskGenericNotifyFromISR(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction,
+    uint32_t *pulPreviousNotificationValue, BaseType_t *pxHigherPriorityTaskWoken) {
+    (void)pxHigherPriorityTaskWoken;
+    return notify(xTaskToNotify, ulValue, eAction, pulPreviousNotificationValue);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken) {
+    (void)pxHigherPriorityTaskWoken;
+    notify(xTaskToNotify, 0, eIncrement, NULL);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+    TaskHandle_t t = xTaskGetCurrentTaskHandle();
+    KernelLock lock(kernelLock);
+    kernelWait(lock, xTicksToWait, [t] { return t->notifyValue != 0; });
+    uint32_t value = t->notifyValue;
+    if (value != 0) t->notifyValue = (xClearCountOnExit != pdFALSE) ? 0 : value - 1;
+    t->notified = false;
+    return value;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit, uint32_t *pulNotificationValue, TickType_t xTicksToWait) {
+    TaskHandle_t t = xTaskGetCurrentTaskHandle();
+    KernelLock lock(kernelLock);
+    if (!t->notified) t->notifyValue &= ~ulBitsToClearOnEntry;
+    kernelWait(lock, xTicksToWait, [t] { return t->notified; });
+    if (pulNotificationValue != NULL) *pulNotificationValue = t->notifyValue;
+    if (!t->notified) return pdFALSE;
+    t->notifyValue &= ~ulBitsToClearOnExit;
+    t->notified = false;
+    return pdTRUE;
+}
+
+uint32_t ulTaskNotifyValueClear(TaskHandle_t xTask, uint32_t ulBitsToClear) {
+    TaskHandle_t t = (xTask != NULL) ? xTask : xTaskGetCurrentTaskHandle();
+    KernelLock lock(kernelLock);
+    uint32_t value = t->notifyValue;
+    t->notifyValue &= ~ulBitsToClear;
+    return value;
+}
+
+/* Priority inheritance, for the drivers that implement their own locks */
+
+TaskHandle_t pvTaskIncrementMutexHeldCount(void) {
+    TaskHandle_t t = xTaskGetCurrentTaskHandle();
+    KernelLock lock(kernelLock);
+    t->mutexesHeld++;
+    return t;
+}
+
+BaseType_t xTaskPriorityInherit(TaskHandle_t const pxMutexHolder) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    KernelLock lock(kernelLock);
+    if (pxMutexHolder == NULL) return pdFALSE;
+    if (pxMutexHolder->priority < self->priority) {
+        pxMutexHolder->priority = self->priority;
+        return pdTRUE;
+    }
+    return (pxMutexHolder->basePriority < self->priority) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xTaskPriorityDisinherit(TaskHandle_t const pxMutexHolder) {
+    KernelLock lock(kernelLock);
+    if (pxMutexHolder == NULL) return pdFALSE;
+    configASSERT(pxMutexHolder->mutexesHeld > 0);
+    pxMutexHolder->mutexesHeld--;
+    if ((pxMutexHolder->priority != pxMutexHolder->basePriority) && (pxMutexHolder->mutexesHeld == 0)) {
+        pxMutexHolder->priority = pxMutexHolder->basePriority;
+        return pdTRUE;
+    }
+    return pdFALSE;
+}
+
+void vTaskPriorityDisinheritAfterTimeout(TaskHandle_t const pxMutexHolder, UBaseType_t uxHighestPriorityWaitingTask) {
+    KernelLock lock(kernelLock);
+    if ((pxMutexHolder == NULL) || (pxMutexHolder->mutexesHeld != 1)) return;
+    UBaseType_t priority = pxMutexHolder->basePriority;
+    if (uxHighestPriorityWaitingTask > priority) priority = uxHighestPriorityWaitingTask;
+    pxMutexHolder->priority = priority;
+}
+
+/* Queues, semaphores and mutexes */
+
+static QueueHandle_t newQueue(UBaseType_t length, UBaseType_t itemSize, uint8_t type) {
+    QueueHandle_t q = new QueueDefinition();
+    q->type = type;
+    q->length = length;
+    q->itemSize = itemSize;
+    return q;
+}
+
+static bool isMutex(QueueHandle_t q) {
+    return (q->type == queueQUEUE_TYPE_MUTEX) || (q->type == queueQUEUE_TYPE_RECURSIVE_MUTEX);
+}
+
+QueueHandle_t xQueueGenericCreate(const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize, const uint8_t ucQueueType) {
+    return newQueue(uxQueueLength, uxItemSize, ucQueueType);
+}
+
+QueueHandle_t xQueueGenericCreateStatic(const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize, uint8_t *pucQueueStorage,
+    StaticQueue_t *pxStaticQueue, const uint8_t ucQueueType) {
+    configASSERT(pxStaticQueue != NULL);
+    configASSERT((uxItemSize == 0) || (pucQueueStorage != NULL));
+    return newQueue(uxQueueLength, uxItemSize, ucQueueType);
+}
+
+QueueHandle_t xQueueCreateMutex(const uint8_t ucQueueType) {
+    QueueHandle_t q = newQueue(1, 0, ucQueueType);
+    q->count = 1;
+    return q;
+}
+
+QueueHandle_t xQueueCreateMutexStatic(const uint8_t ucQueueType, StaticQueue_t *pxStaticQueue) {
+    configASSERT(pxStaticQueue != NULL);
+    return xQueueCreateMutex(ucQueueType);
+}
+
+QueueHandle_t xQueueCreateCountingSemaphore(const UBaseType_t uxMaxCount, const UBaseType_t uxInitialCount) {
+    QueueHandle_t q = newQueue(uxMaxCount, 0, queueQUEUE_TYPE_COUNTING_SEMAPHORE);
+    q->count = uxInitialCount;
+    return q;
+}
+
+QueueHandle_t xQueueCreateCountingSemaphoreStatic(const UBaseType_t uxMaxCount, const UBaseType_t uxInitialCount, StaticQueue_t *pxStaticQueue) {
+    configASSERT(pxStaticQueue != NULL);
+    return xQueueCreateCountingSemaphore(uxMaxCount, uxInitialCount);
+}
+
+void vQueueDelete(QueueHandle_t xQueue) {
+    delete xQueue;
+}
+
+// Add an item, with the kernel locked and room for it
+static void queuePut(QueueHandle_t q, const void *item, BaseType_t position) {
+    if (q->itemSize > 0) {
+        const uint8_t *p = (const uint8_t *)item;
+        std::vector<uint8_t> data(p, p + q->itemSize);
+        if (position == queueOVERWRITE) q->items.clear();
+        if (position == queueSEND_TO_FRONT) q->items.push_front(data);
+        else q->items.push_back(data);
+        q->count = q->items.size();
+    } else {
+        if (isMutex(q)) {
+            configASSERT(q->holder == xTaskGetCurrentTaskHandle());
+            xTaskPriorityDisinherit(q->holder);
+            q->holder = NULL;
+        }
+        q->count++;
+    }
+    kernelNotify();
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue, const void * const pvItemToQueue, TickType_t xTicksToWait, const BaseType_t xCopyPosition) {
+    KernelLock lock(kernelLock);
+    if (!kernelWait(lock, xTicksToWait, [xQueue, xCopyPosition] {
+            return (xQueue->count < xQueue->length) || (xCopyPosition == queueOVERWRITE); })) {
+        return errQUEUE_FULL;
+    }
+    queuePut(xQueue, pvItemToQueue, xCopyPosition);
+    return pdPASS;
+}
+
+BaseType_t xQueueGenericSendFromISR(QueueHandle_t xQueue, const void * const pvItemToQueue, BaseType_t * const pxHigherPriorityTaskWoken,
+    const BaseType_t xCopyPosition) {
+    (void)pxHigherPriorityTaskWoken;
+    return xQueueGenericSend(xQueue, pvItemToQueue, 0, xCopyPosition);
+}
+
+BaseType_t xQueueGiveFromISR(QueueHandle_t xQueue, BaseType_t * const pxHigherPriorityTaskWoken) {
+    (void)pxHigherPriorityTaskWoken;
+    configASSERT(!isMutex(xQueue));
+    return xQueueGenericSend(xQueue, NULL, 0, queueSEND_TO_BACK);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void * const pvBuffer, TickType_t xTicksToWait) {
+    KernelLock lock(kernelLock);
+    if (!kernelWait(lock, xTicksToWait, [xQueue] { return xQueue->count > 0; })) return errQUEUE_EMPTY;
+    memcpy(pvBuffer, xQueue->items.front().data(), xQueue->itemSize);
+    xQueue->items.pop_front();
+    xQueue->count = xQueue->items.size();
+    kernelNotify();
+    return pdPASS;
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t xQueue, void * const pvBuffer, BaseType_t * const pxHigherPriorityTaskWoken) {
+    (void)pxHigherPriorityTaskWoken;
+    return xQueueReceive(xQueue, pvBuffer, 0);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void * const pvBuffer, TickType_t xTicksToWait) {
+    KernelLock lock(kernelLock);
+    if (!kernelWait(lock, xTicksToWait, [xQueue] { return xQueue->count > 0; })) return errQUEUE_EMPTY;
+    memcpy(pvBuffer, xQueue->items.front().data(), xQueue->itemSize);
+    return pdPASS;
+}
+
+BaseType_t xQueueSemaphoreTake(QueueHandle_t xQueue, TickType_t xTicksToWait) {
+    KernelLock lock(kernelLock);
+    if (!kernelWait(lock, xTicksToWait, [xQueue] { return xQueue->count > 0; })) return errQUEUE_EMPTY;
+    xQueue->count--;
+    if (isMutex(xQueue)) xQueue->holder = pvTaskIncrementMutexHeldCount();
+    kernelNotify();
+    return pdPASS;
+}
+
+// Only the holder changes the holder to or from itself, so this needs the
+// lock only around the count; waiting with it held twice would never wake
+BaseType_t xQueueTakeMutexRecursive(QueueHandle_t xMutex, TickType_t xTicksToWait) {
+    if (xQueueGetMutexHolder(xMutex) != xTaskGetCurrentTaskHandle()) {
+        if (xQueueSemaphoreTake(xMutex, xTicksToWait) != pdPASS) return pdFAIL;
+    }
+    KernelLock lock(kernelLock);
+    xMutex->recursion++;
+    return pdPASS;
+}
+
+BaseType_t xQueueGiveMutexRecursive(QueueHandle_t xMutex) {
+    KernelLock lock(kernelLock);
+    if (xMutex->holder != xTaskGetCurrentTaskHandle()) return pdFAIL;
+    if (--xMutex->recursion == 0) queuePut(xMutex, NULL, queueSEND_TO_BACK);
+    return pdPASS;
+}
+
+TaskHandle_t xQueueGetMutexHolder(QueueHandle_t xSemaphore) {
+    KernelLock lock(kernelLock);
+    return xSemaphore->holder;
+}
+
+UBaseType_t uxQueueMessagesWaiting(const QueueHandle_t xQueue) {
+    KernelLock lock(kernelLock);
+    return xQueue->count;
+}
+
+UBaseType_t uxQueueMessagesWaitingFromISR(const QueueHandle_t xQueue) {
+    return uxQueueMessagesWaiting(xQueue);
+}
+
+UBaseType_t uxQueueSpacesAvailable(const QueueHandle_t xQueue) {
+    KernelLock lock(kernelLock);
+    return xQueue->length - xQueue->count;
+}
+
+/* Stream buffers */
+
+StreamBufferHandle_t xStreamBufferGenericCreate(size_t xBufferSizeBytes, size_t xTriggerLevelBytes, BaseType_t xIsMessageBuffer) {
+    configASSERT(xIsMessageBuffer == pdFALSE);
+    configASSERT(xTriggerLevelBytes <= xBufferSizeBytes);
+    StreamBufferHandle_t s = new StreamBufferDef_t();
+    s->size = xBufferSizeBytes;
+    s->trigger = (xTriggerLevelBytes == 0) ? 1 : xTriggerLevelBytes;
+    return s;
+}
+
+// As in stream_buffer.c, the storage holds one byte more than the buffer
+StreamBufferHandle_t xStreamBufferGenericCreateStatic(size_t xBufferSizeBytes, size_t xTriggerLevelBytes, BaseType_t xIsMessageBuffer,
+    uint8_t * const pucStreamBufferStorageArea, StaticStreamBuffer_t * const pxStaticStreamBuffer) {
+    configASSERT((pucStreamBufferStorageArea != NULL) && (pxStaticStreamBuffer != NULL));
+    return xStreamBufferGenericCreate(xBufferSizeBytes, xTriggerLevelBytes, xIsMessageBuffer);
+}
+
+void vStreamBufferDelete(StreamBufferHandle_t xStreamBuffer) {
+    delete xStreamBuffer;
+}
+
+// Waits for room for all of the data, or as much of it as the buffer
+// holds, then sends as much as fits
+size_t xStreamBufferSend(StreamBufferHandle_t xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes, TickType_t xTicksToWait) {
+    StreamBufferHandle_t s = xStreamBuffer;
+    size_t required = (xDataLengthBytes < s->size) ? xDataLengthBytes : s->size;
+    KernelLock lock(kernelLock);
+    if (xTicksToWait != 0) kernelWait(lock, xTicksToWait, [s, required] { return s->size - s->data.size() >= required; });
+    size_t n = s->size - s->data.size();
+    if (n > xDataLengthBytes) n = xDataLengthBytes;
+    const uint8_t *p = (const uint8_t *)pvTxData;
+    s->data.insert(s->data.end(), p, p + n);
+    if (n > 0) kernelNotify();
+    return n;
+}
+
+size_t xStreamBufferSendFromISR(StreamBufferHandle_t xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes,
+    BaseType_t * const pxHigherPriorityTaskWoken) {
+    (void)pxHigherPriorityTaskWoken;
+    return xStreamBufferSend(xStreamBuffer, pvTxData, xDataLengthBytes, 0);
+}
+
+// Waits, if the buffer is empty, for the trigger level to be reached,
+// then takes what there is
+size_t xStreamBufferReceive(StreamBufferHandle_t xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes, TickType_t xTicksToWait) {
+    StreamBufferHandle_t s = xStreamBuffer;
+    KernelLock lock(kernelLock);
+    if (s->data.empty() && (xTicksToWait != 0)) kernelWait(lock, xTicksToWait, [s] { return s->data.size() >= s->trigger; });
+    size_t n = s->data.size();
+    if (n > xBufferLengthBytes) n = xBufferLengthBytes;
+    std::copy(s->data.begin(), s->data.begin() + n, (uint8_t *)pvRxData);
+    s->data.erase(s->data.begin(), s->data.begin() + n);
+    if (n > 0) kernelNotify();
+    return n;
+}
+
+size_t xStreamBufferReceiveFromISR(StreamBufferHandle_t xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes,
+    BaseType_t * const pxHigherPriorityTaskWoken) {
+    (void)pxHigherPriorityTaskWoken;
+    return xStreamBufferReceive(xStreamBuffer, pvRxData, xBufferLengthBytes, 0);
+}
+
+size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t xStreamBuffer) {
+    KernelLock lock(kernelLock);
+    return xStreamBuffer->size - xStreamBuffer->data.size();
+}
+
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t xStreamBuffer) {
+    KernelLock lock(kernelLock);
+    return xStreamBuffer->data.size();
+}
+
+BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t xStreamBuffer) {
+    KernelLock lock(kernelLock);
+    return xStreamBuffer->data.empty() ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xStreamBufferIsFull(StreamBufferHandle_t xStreamBuffer) {
+    KernelLock lock(kernelLock);
+    return (xStreamBuffer->data.size() == xStreamBuffer->size) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xStreamBufferReset(StreamBufferHandle_t xStreamBuffer) {
+    KernelLock lock(kernelLock);
+    xStreamBuffer->data.clear();
+    kernelNotify();
+    return pdPASS;
+}
+
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "Arduino.h"
+
+// What the tests need of the PIC32 C library and the core's timing
+
+static char *host_ultoa(unsigned long val, char *s, int radix, bool negative) {
+    char tmp[8 * sizeof(long) + 2];
+    int i = 0;
+    do {
+        int digit = val % radix;
+        tmp[i++] = (digit < 10) ? '0' + digit : 'a' + digit - 10;
+        val /= radix;
+    } while (val > 0);
+    char *p = s;
+    if (negative) *p++ = '-';
+    while (i > 0) *p++ = tmp[--i];
+    *p = 0;
+    return s;
+}
+
+extern "C" {
+
+char *ltoa(long val, char *s, int radix) {
+    if ((radix == 10) && (val < 0)) return host_ultoa(0ul - val, s, radix, true);
+    return host_ultoa(val, s, radix, false);
+}
+
+char *ultoa(unsigned long val, char *s, int radix) {
+    return host_ultoa(val, s, radix, false);
+}
+
+// int and unsigned int are 32 bits, as on the PIC32
+char *itoa(int val, char *s, int radix) {
+    if ((radix == 10) && (val < 0)) return host_ultoa(0u - val, s, radix, true);
+    return host_ultoa((unsigned int)val, s, radix, false);
+}
+
+char *utoa(unsigned int val, char *s, int radix) {
+    return host_ultoa(val, s, radix, false);
+}
+
+char *dtostrf(double val, signed char width, unsigned char prec, char *s) {
+    sprintf(s, "%*.*f", width, prec, val);
+    return s;
+}
+
+// With hostVirtualTime set the clock only moves when delay() is called, by
+// as much as it was asked to wait, and hostDelays counts the calls, so a
+// test can see how code waits without waiting itself
+bool hostVirtualTime = false;
+uint32_t hostMillis = 0;
+uint32_t hostDelays = 0;
+
+uint32_t micros() {
+    if (hostVirtualTime) return hostMillis * 1000;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+uint32_t millis() {
+    if (hostVirtualTime) return hostMillis;
+    return micros() / 1000;
+}
+
+void delay(uint32_t ms) {
+    if (hostVirtualTime) {
+        hostMillis += ms;
+        hostDelays++;
+        return;
+    }
+    struct timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000 };
+    nanosleep(&ts, NULL);
+}
+
+void yield() {
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef _TEST_H
+#define _TEST_H
+
+#include <stdio.h>
+#include <string.h>
+
+// The checks for a host test. Each test is its own program, which reports
+// the checks that failed and exits with the number of them.
+//
+//     int main() {
+//         CHECK(a == b);
+//         CHECK_STR(s.c_str(), "42");
+//         return test_summary("fixed string");
+//     }
+//
+// long is 64 bits on most hosts but 32 on the PIC32, so tests keep the
+// values they pass as long within 32 bits.
+
+static int testChecks = 0;
+static int testFailures = 0;
+
+#define CHECK(cond) do { \
+    testChecks++; \
+    if (!(cond)) { \
+        testFailures++; \
+        printf("%s:%d: FAILED: %s\n", __FILE__, __LINE__, #cond); \
+    } \
+} while (0)
+
+#define CHECK_STR(got, expected) test_check_str((got), (expected), #got, __FILE__, __LINE__)
+
+// A function rather than a macro body, so temporaries that got and
+// expected point into live until the comparison is done
+static inline void test_check_str(const char *got, const char *expected, const char *what, const char *file, int line) {
+    testChecks++;
+    if (strcmp(got, expected) != 0) {
+        testFailures++;
+        printf("%s:%d: FAILED: %s is \"%s\", expected \"%s\"\n", file, line, what, got, expected);
+    }
+}
+
+static inline int test_summary(const char *name) {
+    printf("%s: %d checks, %d failed\n", name, testChecks, testFailures);
+    return (testFailures > 255) ? 255 : testFailures;
+}
+
+#endif
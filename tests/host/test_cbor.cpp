@@ -0,0 +1,524 @@
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "Cbor.h"
+#include "test.h"
+#include "test_io.h"
+
+// CborWriter and CborReader against the examples in RFC 8949 appendix A.
+// Every example is read back and printed in diagnostic notation, from a
+// buffer and from a Stream, and every one the writer can produce is
+// written and compared byte for byte. Then badly formed and truncated data.
+//
+// With --bench it also times writing and reading a small record as CBOR
+// against printf() and sscanf() of the same fields as text.
+
+struct Example {
+    const char *hex;
+    // As in the RFC, except that floats that are not whole numbers are
+    // written in the fewest digits that read back the same, a bignum is shown as its tag, and strings
+    // are given as their UTF-8 bytes
+    const char *diag;
+};
+
+static const Example examples[] = {
+    { "00", "0" },
+    { "01", "1" },
+    { "0a", "10" },
+    { "17", "23" },
+    { "1818", "24" },
+    { "1819", "25" },
+    { "1864", "100" },
+    { "1903e8", "1000" },
+    { "1a000f4240", "1000000" },
+    { "1b000000e8d4a51000", "1000000000000" },
+    { "1bffffffffffffffff", "18446744073709551615" },
+    { "c249010000000000000000", "2(h'010000000000000000')" },
+    { "3bffffffffffffffff", "-18446744073709551616" },
+    { "c349010000000000000000", "3(h'010000000000000000')" },
+    { "20", "-1" },
+    { "29", "-10" },
+    { "3863", "-100" },
+    { "3903e7", "-1000" },
+    { "f90000", "0" },
+    { "f98000", "-0" },
+    { "f93c00", "1" },
+    { "fb3ff199999999999a", "1.1" },
+    { "f93e00", "1.5" },
+    { "f97bff", "65504" },
+    { "fa47c35000", "100000" },
+    { "fa7f7fffff", "3.4028234663852886e+38" },
+    { "fb7e37e43c8800759c", "1e+300" },
+    { "f90001", "5.9604644775390625e-08" },
+    { "f90400", "6.103515625e-05" },
+    { "f9c400", "-4" },
+    { "fbc010666666666666", "-4.1" },
+    { "f97c00", "Infinity" },
+    { "f97e00", "NaN" },
+    { "f9fc00", "-Infinity" },
+    { "fa7f800000", "Infinity" },
+    { "fa7fc00000", "NaN" },
+    { "faff800000", "-Infinity" },
+    { "fb7ff0000000000000", "Infinity" },
+    { "fb7ff8000000000000", "NaN" },
+    { "fbfff0000000000000", "-Infinity" },
+    { "f4", "false" },
+    { "f5", "true" },
+    { "f6", "null" },
+    { "f7", "undefined" },
+    { "f0", "simple(16)" },
+    { "f8ff", "simple(255)" },
+    { "c074323031332d30332d32315432303a30343a30305a", "0(\"2013-03-21T20:04:00Z\")" },
+    { "c11a514b67b0", "1(1363896240)" },
+    { "c1fb41d452d9ec200000", "1(1363896240.5)" },
+    { "d74401020304", "23(h'01020304')" },
+    { "d818456449455446", "24(h'6449455446')" },
+    { "d82076687474703a2f2f7777772e6578616d706c652e636f6d", "32(\"http://www.example.com\")" },
+    { "40", "h''" },
+    { "4401020304", "h'01020304'" },
+    { "60", "\"\"" },
+    { "6161", "\"a\"" },
+    { "6449455446", "\"IETF\"" },
+    { "62225c", "\"\\\"\\\\\"" },
+    { "62c3bc", "\"\xc3\xbc\"" },
+    { "63e6b0b4", "\"\xe6\xb0\xb4\"" },
+    { "64f0908591", "\"\xf0\x90\x85\x91\"" },
+    { "80", "[]" },
+    { "83010203", "[1, 2, 3]" },
+    { "8301820203820405", "[1, [2, 3], [4, 5]]" },
+    { "98190102030405060708090a0b0c0d0e0f101112131415161718181819",
+      "[1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25]" },
+    { "a0", "{}" },
+    { "a201020304", "{1: 2, 3: 4}" },
+    { "a26161016162820203", "{\"a\": 1, \"b\": [2, 3]}" },
+    { "826161a161626163", "[\"a\", {\"b\": \"c\"}]" },
+    { "a56161614161626142616361436164614461656145", "{\"a\": \"A\", \"b\": \"B\", \"c\": \"C\", \"d\": \"D\", \"e\": \"E\"}" },
+    { "5f42010243030405ff", "(_ h'0102', h'030405')" },
+    { "7f657374726561646d696e67ff", "(_ \"strea\", \"ming\")" },
+    { "9fff", "[_ ]" },
+    { "9f018202039f0405ffff", "[_ 1, [2, 3], [_ 4, 5]]" },
+    { "9f01820203820405ff", "[_ 1, [2, 3], [4, 5]]" },
+    { "83018202039f0405ff", "[1, [2, 3], [_ 4, 5]]" },
+    { "83019f0203ff820405", "[1, [_ 2, 3], [4, 5]]" },
+    { "9f0102030405060708090a0b0c0d0e0f101112131415161718181819ff",
+      "[_ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25]" },
+    { "bf61610161629f0203ffff", "{_ \"a\": 1, \"b\": [_ 2, 3]}" },
+    { "826161bf61626163ff", "[\"a\", {_ \"b\": \"c\"}]" },
+    { "bf6346756ef563416d7421ff", "{_ \"Fun\": true, \"Amt\": -2}" },
+};
+
+static size_t from_hex(const char *hex, uint8_t *out) {
+    size_t n = 0;
+    for (; hex[0] && hex[1]; hex += 2) {
+        char pair[3] = { hex[0], hex[1], 0 };
+        out[n++] = (uint8_t)strtoul(pair, NULL, 16);
+    }
+    return n;
+}
+
+static void to_hex(const uint8_t *data, size_t len, char *out) {
+    for (size_t i = 0; i < len; i++) sprintf(out + i * 2, "%02x", data[i]);
+    out[len * 2] = 0;
+}
+
+// Diagnostic notation for what the reader is on, reading whatever it
+// contains. Returns false if the data was bad.
+static bool diag(CborReader &cbor, Capture &out);
+
+static bool diag_content(CborReader &cbor, Capture &out) {
+    uint8_t buf[8];
+    size_t n;
+    if (cbor.type() == CborReader::Text) {
+        out.print('"');
+        while ((n = cbor.readData(buf, sizeof(buf))) > 0) {
+            for (size_t i = 0; i < n; i++) {
+                if ((buf[i] == '"') || (buf[i] == '\\')) out.print('\\');
+                out.write(buf[i]);
+            }
+        }
+        out.print('"');
+    } else {
+        out.print("h'");
+        while ((n = cbor.readData(buf, sizeof(buf))) > 0) {
+            for (size_t i = 0; i < n; i++) out.printf("%02x", buf[i]);
+        }
+        out.print('\'');
+    }
+    return cbor.type() != CborReader::Error;
+}
+
+static void diag_float(double value, Capture &out) {
+    char text[32];
+    if (isnan(value)) {
+        out.print("NaN");
+        return;
+    }
+    if (isinf(value)) {
+        out.print((value < 0) ? "-Infinity" : "Infinity");
+        return;
+    }
+    if ((value == trunc(value)) && (fabs(value) < 1e15)) {
+        snprintf(text, sizeof(text), "%.0f", value);
+    } else {
+        for (int precision = 1; precision <= 17; precision++) {
+            snprintf(text, sizeof(text), "%.*g", precision, value);
+            if (strtod(text, NULL) == value) break;
+        }
+    }
+    out.print(text);
+}
+
+static bool diag(CborReader &cbor, Capture &out) {
+    CborReader::Type type = cbor.type();
+    uint64_t u;
+    int64_t i;
+    double d;
+    bool b;
+
+    switch (type) {
+        case CborReader::Unsigned:
+            cbor.getUInt64(u);
+            out.printf("%llu", (unsigned long long)u);
+            return true;
+        case CborReader::Negative:
+            if (cbor.getInt64(i)) out.printf("%lld", (long long)i);
+            else out.print("-18446744073709551616");    // Past int64_t, which only -2^64 is of the examples
+            return true;
+        case CborReader::Float:
+            cbor.getDouble(d);
+            diag_float(d, out);
+            return true;
+        case CborReader::False:
+        case CborReader::True:
+            cbor.getBool(b);
+            out.print(b ? "true" : "false");
+            return true;
+        case CborReader::Null:
+            out.print("null");
+            return true;
+        case CborReader::Undefined:
+            out.print("undefined");
+            return true;
+        case CborReader::Simple:
+            out.printf("simple(%lu)", (unsigned long)cbor.tag());
+            return true;
+        case CborReader::Tag:
+            out.printf("%lu(", (unsigned long)cbor.tag());
+            cbor.next();
+            if (!diag(cbor, out)) return false;
+            out.print(')');
+            return true;
+        case CborReader::Bytes:
+        case CborReader::Text:
+            if (!cbor.isIndefinite()) return diag_content(cbor, out);
+            out.print("(_ ");
+            for (int k = 0; cbor.next() == type; k++) {
+                if (k > 0) out.print(", ");
+                if (cbor.isIndefinite() || !diag_content(cbor, out)) return false;
+            }
+            out.print(')');
+            return cbor.type() == CborReader::Break;
+        case CborReader::Array:
+        case CborReader::Map: {
+            bool map = (type == CborReader::Map);
+            bool indefinite = cbor.isIndefinite();
+            size_t items = cbor.length() * (map ? 2 : 1);
+            out.print(map ? '{' : '[');
+            if (indefinite) out.print("_ ");
+            for (size_t k = 0; indefinite || (k < items); k++) {
+                CborReader::Type next = cbor.next();
+                if (indefinite && (next == CborReader::Break)) break;
+                if (k > 0) out.print(((k % 2) && map) ? ": " : ", ");
+                if (!diag(cbor, out)) return false;
+            }
+            out.print(map ? '}' : ']');
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static void read_examples() {
+    uint8_t data[64];
+    Capture out;
+
+    for (size_t e = 0; e < sizeof(examples) / sizeof(examples[0]); e++) {
+        size_t len = from_hex(examples[e].hex, data);
+
+        CborReader cbor(data, len);
+        out.clear();
+        cbor.next();
+        CHECK(diag(cbor, out));
+        CHECK_STR(out.text, examples[e].diag);
+        CHECK(cbor.next() == CborReader::End);
+
+        // Passed over in one go
+        CborReader skipped(data, len);
+        skipped.next();
+        CHECK(skipped.skip());
+        CHECK(skipped.position() == len);
+        CHECK(skipped.next() == CborReader::End);
+
+        MemoryStream stream(data, len);
+        CborReader fromStream(stream);
+        out.clear();
+        fromStream.next();
+        CHECK(diag(fromStream, out));
+        CHECK_STR(out.text, examples[e].diag);
+        CHECK(stream.position() == len);
+    }
+}
+
+typedef void (*WriteExample)(CborWriter &cbor);
+
+static void write_examples() {
+    // The writer never uses half floats, and uses a float only where it
+    // loses nothing, so the examples written as halves are left out
+    struct { const char *hex; WriteExample write; } written[] = {
+        { "00", [](CborWriter &c) { c.writeUInt(0); } },
+        { "17", [](CborWriter &c) { c.writeUInt(23); } },
+        { "1818", [](CborWriter &c) { c.writeUInt(24); } },
+        { "1864", [](CborWriter &c) { c.writeUInt(100); } },
+        { "1903e8", [](CborWriter &c) { c.writeUInt(1000); } },
+        { "1a000f4240", [](CborWriter &c) { c.writeUInt(1000000); } },
+        { "1b000000e8d4a51000", [](CborWriter &c) { c.writeUInt64(1000000000000ull); } },
+        { "1bffffffffffffffff", [](CborWriter &c) { c.writeUInt64(UINT64_MAX); } },
+        { "20", [](CborWriter &c) { c.writeInt(-1); } },
+        { "29", [](CborWriter &c) { c.writeInt(-10); } },
+        { "3863", [](CborWriter &c) { c.writeInt(-100); } },
+        { "3903e7", [](CborWriter &c) { c.writeInt(-1000); } },
+        { "3b7fffffffffffffff", [](CborWriter &c) { c.writeInt64(INT64_MIN); } },
+        { "fb3ff199999999999a", [](CborWriter &c) { c.writeDouble(1.1); } },
+        { "fa47c35000", [](CborWriter &c) { c.writeDouble(100000.0); } },
+        { "fa7f7fffff", [](CborWriter &c) { c.writeDouble(3.4028234663852886e+38); } },
+        { "fb7e37e43c8800759c", [](CborWriter &c) { c.writeDouble(1.0e+300); } },
+        { "fbc010666666666666", [](CborWriter &c) { c.writeDouble(-4.1); } },
+        { "fa7f800000", [](CborWriter &c) { c.writeFloat(INFINITY); } },
+        { "fa7fc00000", [](CborWriter &c) { c.writeDouble(NAN); } },
+        { "faff800000", [](CborWriter &c) { c.writeDouble(-INFINITY); } },
+        { "f4", [](CborWriter &c) { c.writeBool(false); } },
+        { "f5", [](CborWriter &c) { c.writeBool(true); } },
+        { "f6", [](CborWriter &c) { c.writeNull(); } },
+        { "c074323031332d30332d32315432303a30343a30305a",
+          [](CborWriter &c) { c.writeTag(0); c.writeString("2013-03-21T20:04:00Z", 20); } },
+        { "c11a514b67b0", [](CborWriter &c) { c.writeTag(1); c.writeUInt(1363896240); } },
+        { "c1fb41d452d9ec200000", [](CborWriter &c) { c.writeTag(1); c.writeDouble(1363896240.5); } },
+        { "d74401020304", [](CborWriter &c) { const uint8_t b[] = { 1, 2, 3, 4 }; c.writeTag(23); c.writeBytes(b, 4); } },
+        { "40", [](CborWriter &c) { c.writeBytes(NULL, 0); } },
+        { "60", [](CborWriter &c) { c.writeString(StringView("")); } },
+        { "6449455446", [](CborWriter &c) { c.writeString(StringView("IETF")); } },
+        { "62c3bc", [](CborWriter &c) { c.writeString(StringView("\xc3\xbc")); } },
+        { "80", [](CborWriter &c) { c.beginArray(0); } },
+        { "8301820203820405", [](CborWriter &c) {
+            c.beginArray(3); c.writeUInt(1);
+            c.beginArray(2); c.writeUInt(2); c.writeUInt(3);
+            c.beginArray(2); c.writeUInt(4); c.writeUInt(5); } },
+        { "98190102030405060708090a0b0c0d0e0f101112131415161718181819", [](CborWriter &c) {
+            c.beginArray(25);
+            for (uint32_t i = 1; i <= 25; i++) c.writeUInt(i); } },
+        { "a0", [](CborWriter &c) { c.beginMap(0); } },
+        { "a26161016162820203", [](CborWriter &c) {
+            c.beginMap(2); c.writeString("a", 1); c.writeUInt(1);
+            c.writeString("b", 1); c.beginArray(2); c.writeUInt(2); c.writeUInt(3); } },
+        { "9fff", [](CborWriter &c) { c.beginArray(); c.end(); } },
+        { "9f018202039f0405ffff", [](CborWriter &c) {
+            c.beginArray(); c.writeUInt(1);
+            c.beginArray(2); c.writeUInt(2); c.writeUInt(3);
+            c.beginArray(); c.writeUInt(4); c.writeUInt(5); c.end();
+            c.end(); } },
+        { "bf6346756ef563416d7421ff", [](CborWriter &c) {
+            c.beginMap(); c.writeString("Fun", 3); c.writeBool(true);
+            c.writeString("Amt", 3); c.writeInt(-2); c.end(); } },
+    };
+    Capture out;
+    char hex[128];
+
+    for (size_t e = 0; e < sizeof(written) / sizeof(written[0]); e++) {
+        out.clear();
+        CborWriter cbor(out);
+        written[e].write(cbor);
+        CHECK(cbor.ok());
+        to_hex((const uint8_t *)out.text, out.len, hex);
+        CHECK_STR(hex, written[e].hex);
+    }
+
+    // A Printable that writes itself
+    struct Sample : public Printable {
+        virtual size_t printTo(Print &p) const {
+            CborWriter cbor(p);
+            cbor.beginArray(3);
+            cbor.writeUInt(5);
+            cbor.writeInt(-3);
+            cbor.writeFloat(21.5f);
+            return 8;
+        }
+    } sample;
+    out.clear();
+    CborWriter cbor(out);
+    cbor.write(sample);
+    to_hex((const uint8_t *)out.text, out.len, hex);
+    CHECK_STR(hex, "830522fa41ac0000");
+
+    // A write that comes up short is reported
+    Capture full;
+    full.len = sizeof(full.text) - 3;
+    CborWriter short_(full);
+    short_.writeUInt(1000);
+    CHECK(!short_.ok());
+}
+
+static CborReader::Type first(const char *hex, bool skip) {
+    uint8_t data[64];
+    size_t len = from_hex(hex, data);
+    CborReader cbor(data, len);
+    cbor.next();
+    if (skip) cbor.skip();
+    return cbor.type();
+}
+
+static void bad_data() {
+    // Reserved additional information, and indefinite length integers and tags
+    CHECK(first("1c", false) == CborReader::Error);
+    CHECK(first("1f", false) == CborReader::Error);
+    CHECK(first("3f", false) == CborReader::Error);
+    CHECK(first("df", false) == CborReader::Error);
+
+    // Cut short in a header, in a string and in an array
+    CHECK(first("1a0102", false) == CborReader::Error);
+    CHECK(first("8301", true) == CborReader::Error);
+    CHECK(first("830165616263", true) == CborReader::Error);
+    CHECK(first("9f0102", true) == CborReader::Error);
+    CHECK(first("c1", true) == CborReader::Error);
+
+    // A chunk of the wrong type, or itself indefinite, in an indefinite string
+    CHECK(first("5f6161ff", true) == CborReader::Error);
+    CHECK(first("7f7f6161ffff", true) == CborReader::Error);
+
+    // A break where an item should be
+    CHECK(first("82ff", true) == CborReader::Error);
+
+    // Nesting deeper than CBOR_MAX_DEPTH is refused, at the limit it is not
+    char deep[2 * (CBOR_MAX_DEPTH + 3) + 1];
+    for (int depth = CBOR_MAX_DEPTH; depth <= CBOR_MAX_DEPTH + 2; depth++) {
+        int n = 0;
+        for (int k = 0; k < depth; k++) n += sprintf(deep + n, "81");
+        sprintf(deep + n, "01");
+        CHECK((first(deep, true) == CborReader::Error) == (depth > CBOR_MAX_DEPTH));
+    }
+
+    // Values that do not fit what is asked for
+    uint8_t data[16];
+    uint32_t u32;
+    long l;
+    int64_t i64;
+    bool b;
+    CborReader big(data, from_hex("1b0000000100000000", data));
+    big.next();
+    CHECK(!big.getUInt(u32));
+    CHECK(!big.getBool(b));
+    CborReader neg(data, from_hex("3b8000000000000000", data));
+    neg.next();
+    CHECK(!neg.getInt64(i64));
+    CHECK(!neg.getInt(l));
+
+    // getString() leaves out a string too long for the buffer, and the
+    // next item can still be read
+    char text[5];
+    CborReader strings(data, from_hex("6568656c6c6f626869", data));
+    strings.next();
+    CHECK(!strings.getString(text, sizeof(text)));
+    CHECK(strings.next() == CborReader::Text);
+    CHECK(strings.getString(text, sizeof(text)));
+    CHECK_STR(text, "hi");
+}
+
+// Writing and reading a record of three fields, as CBOR and as text
+static void bench() {
+    const int records = 500000;
+    static uint8_t data[16 * 1024 * 1024];
+    static char text[32 * 1024 * 1024];
+
+    class Memory : public Print {
+        public:
+            uint8_t *buf;
+            size_t len;
+            Memory(uint8_t *b) : buf(b), len(0) {}
+            virtual size_t write(uint8_t c) { buf[len++] = c; return 1; }
+            virtual size_t write(const uint8_t *b, size_t n) { memcpy(buf + len, b, n); len += n; return n; }
+            using Print::write;
+    };
+
+    Memory cborOut(data);
+    clock_t start = clock();
+    for (int i = 0; i < records; i++) {
+        CborWriter cbor(cborOut);
+        cbor.beginMap(3);
+        cbor.writeString("t", 1);
+        cbor.writeUInt(i * 10);
+        cbor.writeString("mV", 2);
+        cbor.writeInt(3300 - i % 700);
+        cbor.writeString("temp", 4);
+        cbor.writeFloat(21.5f + (i % 10) * 0.1f);
+    }
+    double cborWrite = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    Memory textOut((uint8_t *)text);
+    start = clock();
+    for (int i = 0; i < records; i++) {
+        char line[64];
+        int n = snprintf(line, sizeof(line), "t=%u mV=%d temp=%.2f\r\n", i * 10, 3300 - i % 700, 21.5f + (i % 10) * 0.1f);
+        textOut.write((const uint8_t *)line, n);
+    }
+    double textWrite = (double)(clock() - start) / CLOCKS_PER_SEC;
+    text[textOut.len] = 0;
+
+    long cborSum = 0;
+    start = clock();
+    CborReader cbor(data, cborOut.len);
+    while (cbor.next() == CborReader::Map) {
+        for (size_t fields = cbor.length(); fields > 0; fields--) {
+            StringView key;
+            long value;
+            cbor.next();
+            cbor.getView(key);
+            cbor.next();
+            if ((key == "mV") && cbor.getInt(value)) cborSum += value;
+            else cbor.skip();
+        }
+    }
+    double cborRead = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    // Each line is copied out first, as sscanf() on the whole buffer would
+    // measure strlen() of what is left of it
+    long textSum = 0;
+    start = clock();
+    const char *p = text;
+    for (int i = 0; i < records; i++) {
+        char line[64];
+        unsigned t;
+        int mv;
+        float temp;
+        const char *end = strchr(p, '\n') + 1;
+        memcpy(line, p, end - p);
+        line[end - p] = 0;
+        if (sscanf(line, "t=%u mV=%d temp=%f", &t, &mv, &temp) == 3) textSum += mv;
+        p = end;
+    }
+    double textRead = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    CHECK(cborSum == textSum);
+    printf("CBOR:   %4.1f bytes, written in %5.0f ns, read in %5.0f ns\n",
+        (double)cborOut.len / records, cborWrite * 1e9 / records, cborRead * 1e9 / records);
+    printf("printf: %4.1f bytes, written in %5.0f ns, read in %5.0f ns (sscanf)\n",
+        (double)textOut.len / records, textWrite * 1e9 / records, textRead * 1e9 / records);
+}
+
+int main(int argc, char **argv) {
+    read_examples();
+    write_examples();
+    bad_data();
+    if ((argc > 1) && (strcmp(argv[1], "--bench") == 0)) bench();
+    return test_summary("cbor");
+}
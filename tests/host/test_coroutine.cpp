@@ -0,0 +1,404 @@
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Coroutine.h"
+#include "sdk/gpio.h"
+#include "test.h"
+
+// The coroutine scheduler against a kernel of its own: the tick count is
+// virtual and only moves when the scheduler blocks in ulTaskNotifyTake(),
+// so every wait it asks for is recorded and the tests see exactly when each
+// coroutine was stepped. Rather than kernel.cpp's threads, the few kernel
+// and GPIO functions Coroutine.cpp calls are stubbed here.
+
+static TickType_t now = 0;
+static uint32_t pending = 0;            // Notifications given to the task
+static std::vector<TickType_t> waits;   // What each ulTaskNotifyTake() asked for
+static int yields = 0;
+static int gives = 0;
+static int givesFromISR = 0;
+static int connected = 0;
+
+// An interrupt that notifies the scheduler when the tick reaches isrAt
+static CoroutineScheduler *isrScheduler = NULL;
+static TickType_t isrAt = 0;
+static uint32_t isrBits = 0;
+
+static int task;
+
+extern "C" {
+TickType_t xTaskGetTickCount(void) {
+    return now;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return (TaskHandle_t)&task;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+    waits.push_back(xTicksToWait);
+    if ((pending == 0) && (isrScheduler != NULL) && ((int32_t)(isrAt - now) <= (int32_t)xTicksToWait)) {
+        now = isrAt;
+        isrScheduler->notify(isrBits);
+        isrScheduler = NULL;
+    }
+    if (pending == 0) {
+        now += xTicksToWait;
+        return 0;
+    }
+    uint32_t n = pending;
+    pending = xClearCountOnExit ? 0 : n - 1;
+    return n;
+}
+
+BaseType_t xTaskGenericNotify(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction, uint32_t *pulPreviousNotificationValue) {
+    (void)ulValue;
+    (void)pulPreviousNotificationValue;
+    if ((xTaskToNotify == (TaskHandle_t)&task) && (eAction == eIncrement)) pending++;
+    gives++;
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken) {
+    if (xTaskToNotify == (TaskHandle_t)&task) pending++;
+    givesFromISR++;
+    if (pxHigherPriorityTaskWoken != NULL) *pxHigherPriorityTaskWoken = pdTRUE;
+}
+
+void vPortYield(void) {
+    yields++;
+}
+
+int pinToGPIO(int pin) {
+    return (pin < 100) ? pin : -1;
+}
+
+int gpio_connect_change_interrupt(uint8_t pin, uint8_t type, gpioISR_t callback) {
+    (void)pin;
+    (void)type;
+    (void)callback;
+    connected++;
+    return 1;
+}
+
+int gpio_disconnect_change_interrupt(uint8_t pin, uint8_t type) {
+    (void)pin;
+    (void)type;
+    connected--;
+    return 1;
+}
+}
+
+// What the coroutines were stepped in, one letter each
+static std::string trace;
+
+// Yields a number of times, then finishes
+class Yielder : public Coroutine {
+    public:
+        char id;
+        int times, n;
+        Yielder(char i, int t) : id(i), times(t), n(0) {}
+    protected:
+        void step() {
+            trace += id;
+            CO_BEGIN();
+            for (n = 0; n < times; n++) CO_YIELD();
+            CO_END();
+        }
+};
+
+// Waits for a flag
+class Poller : public Coroutine {
+    public:
+        char id;
+        volatile bool flag;
+        Poller(char i) : id(i), flag(false) {}
+    protected:
+        void step() {
+            trace += id;
+            CO_BEGIN();
+            CO_AWAIT(flag);
+            CO_END();
+        }
+};
+
+// Waits for the fifth tick
+class Ticker : public Coroutine {
+    protected:
+        void step() {
+            CO_BEGIN();
+            CO_AWAIT(xTaskGetTickCount() >= 5);
+            CO_END();
+        }
+};
+
+// Sleeps for a period a number of times
+class Sleeper : public Coroutine {
+    public:
+        char id;
+        uint32_t period;
+        int times, n;
+        Sleeper(char i, uint32_t p, int t) : id(i), period(p), times(t), n(0) {}
+    protected:
+        void step() {
+            trace += id;
+            CO_BEGIN();
+            for (n = 0; n < times; n++) CO_DELAY(period);
+            CO_END();
+        }
+};
+
+// Waits for the flag for at most 100 ms
+class Waiter : public Coroutine {
+    public:
+        bool flag;
+        Waiter() : flag(false) {}
+    protected:
+        void step() {
+            CO_BEGIN();
+            CO_AWAIT_FOR(flag, 100);
+            CO_END();
+        }
+};
+
+// Waits for bit 1, then for bit 0 or 2
+class Listener : public Coroutine {
+    public:
+        int got;
+        Listener() : got(0) {}
+    protected:
+        void step() {
+            CO_BEGIN();
+            CO_AWAIT_NOTIFY(0x2);
+            got++;
+            CO_AWAIT_NOTIFY(0x1 | 0x4);
+            got++;
+            CO_END();
+        }
+};
+
+// Takes itself off the scheduler from inside step()
+class Quitter : public Coroutine {
+    public:
+        char id;
+        CoroutineScheduler *scheduler;
+        Quitter(char i, CoroutineScheduler *s) : id(i), scheduler(s) {}
+    protected:
+        void step() {
+            trace += id;
+            scheduler->remove(*this);
+        }
+};
+
+static void reset() {
+    now = 0;
+    pending = 0;
+    waits.clear();
+    yields = 0;
+    gives = 0;
+    givesFromISR = 0;
+    trace.clear();
+}
+
+static std::string pass(CoroutineScheduler &s, Coroutine::Status *status) {
+    trace.clear();
+    *status = s.runOnce();
+    return trace;
+}
+
+static void order() {
+    CoroutineScheduler s;
+    Yielder a('a', 2);
+    Poller b('b');
+    Sleeper c('c', 10, 2);
+    Coroutine::Status status;
+
+    reset();
+    CHECK(s.add(a) && s.add(b) && s.add(c));
+    CHECK(!s.add(a));
+
+    // In the order they were added, skipping the sleeper until it is due
+    CHECK(pass(s, &status) == "abc");
+    CHECK((status == Coroutine::Ready) && (c.status() == Coroutine::Sleeping) && (b.status() == Coroutine::Polling));
+    CHECK(pass(s, &status) == "ab");
+    CHECK(status == Coroutine::Ready);
+    CHECK(pass(s, &status) == "ab");
+    CHECK((status == Coroutine::Polling) && a.done());
+    now = 9;
+    CHECK(pass(s, &status) == "b");
+    now = 10;
+    CHECK(pass(s, &status) == "bc");
+    CHECK(status == Coroutine::Polling);
+    b.flag = true;
+    CHECK(pass(s, &status) == "b");
+    CHECK((status == Coroutine::Sleeping) && b.done());
+    now = 20;
+    CHECK(pass(s, &status) == "c");
+    CHECK((status == Coroutine::Done) && s.empty());
+    CHECK(s.passes() == 7);
+
+    // A finished coroutine starts over when it is added again
+    CHECK(s.add(a));
+    CHECK((pass(s, &status) == "a") && (a.n == 0));
+}
+
+static void running() {
+    CoroutineScheduler s;
+    Sleeper a('a', 25, 3);
+    Sleeper b('b', 40, 2);
+
+    // Blocked until the earliest sleeper is due, never polling
+    reset();
+    s.add(a);
+    s.add(b);
+    s.run();
+    CHECK(trace == "ababaab");
+    TickType_t expected[] = { 25, 15, 10, 25, 5 };
+    CHECK((waits.size() == 5) && std::equal(waits.begin(), waits.end(), expected));
+    CHECK((now == 80) && (yields == 0));
+
+    // A polling coroutine is looked at every tick
+    Ticker t;
+    reset();
+    s.add(t);
+    s.run();
+    CHECK((waits.size() == 5) && (now == 5) && (yields == 0) && t.done());
+    CHECK(std::count(waits.begin(), waits.end(), 1) == 5);
+
+    // A ready one yields to other tasks between passes
+    Yielder y('y', 3);
+    reset();
+    s.add(y);
+    s.run();
+    CHECK((yields == 3) && waits.empty() && (trace == "yyyy"));
+
+    // Notified while every coroutine sleeps, the task wakes early and
+    // sleeps again for what is left
+    Sleeper z('z', 1000, 1);
+    reset();
+    s.add(z);
+    isrScheduler = &s;
+    isrAt = 300;
+    isrBits = 0x8;
+    s.run();
+    CHECK((waits.size() == 2) && (waits[0] == 1000) && (waits[1] == 700));
+    CHECK((now == 1000) && (gives == 1) && (trace == "zz"));
+    CHECK(s.takeNotification(0x8) && !s.takeNotification(0x8));
+}
+
+static void timeouts() {
+    CoroutineScheduler s;
+    Waiter w;
+
+    // Nothing arrives: polled until the deadline, then timed out
+    reset();
+    s.add(w);
+    CHECK(s.runOnce() == Coroutine::Polling);
+    now = 99;
+    CHECK(s.runOnce() == Coroutine::Polling);
+    now = 100;
+    CHECK((s.runOnce() == Coroutine::Done) && w.done() && w.timedOut());
+
+    // The condition comes first
+    now = 1000;
+    s.add(w);
+    CHECK((s.runOnce() == Coroutine::Polling) && !w.timedOut());
+    now = 1050;
+    w.flag = true;
+    CHECK((s.runOnce() == Coroutine::Done) && !w.timedOut());
+
+    // Already true, it does not wait at all
+    s.add(w);
+    CHECK((s.runOnce() == Coroutine::Done) && !w.timedOut());
+
+    // Across the wrap of the tick count
+    now = (TickType_t)-50;
+    w.flag = false;
+    s.add(w);
+    CHECK(s.runOnce() == Coroutine::Polling);
+    now = 49;
+    CHECK(s.runOnce() == Coroutine::Polling);
+    now = 50;
+    CHECK((s.runOnce() == Coroutine::Done) && w.timedOut());
+}
+
+static void notifications() {
+    CoroutineScheduler s;
+    Listener l;
+
+    // Before the scheduler has run there is no task to wake, but the bits
+    // are kept
+    reset();
+    s.notify(0x10);
+    CHECK(gives == 0);
+
+    s.add(l);
+    CHECK(s.runOnce() == Coroutine::Polling);
+    s.notify(0x1);
+    CHECK((gives == 1) && (pending == 1));
+    CHECK((s.runOnce() == Coroutine::Polling) && (l.got == 0));
+
+    // Bit 1 is taken by the first wait, and bit 0, sent earlier, by the
+    // second in the same step
+    BaseType_t woken = pdFALSE;
+    s.notifyFromISR(0x2, &woken);
+    CHECK((givesFromISR == 1) && (woken == pdTRUE));
+    CHECK((s.runOnce() == Coroutine::Done) && (l.got == 2));
+    CHECK(!s.takeNotification(0x1 | 0x2));
+    CHECK(s.takeNotification(0x10));
+}
+
+static void removal() {
+    CoroutineScheduler s;
+    Quitter p('p', &s);
+    Yielder x('x', 5);
+    Quitter q('q', &s);
+    Coroutine::Status status;
+
+    // Both quitters leave in their own step, at the head and the tail,
+    // and the pass carries on past them
+    reset();
+    s.add(p);
+    s.add(x);
+    s.add(q);
+    CHECK(pass(s, &status) == "pxq");
+    CHECK(pass(s, &status) == "x");
+    CHECK(!s.remove(p) && !s.remove(q));
+
+    // The tail was moved back, so adding goes after x
+    CHECK(s.add(q));
+    CHECK(pass(s, &status) == "xq");
+    CHECK(s.remove(x) && s.empty());
+}
+
+static void edges() {
+    CoEdge e(7, CHANGE);
+    CoEdge bad(200, RISING);
+
+    connected = 0;
+    CHECK(e.begin() && (connected == 2));
+    CHECK(!bad.begin());
+    e.edge();
+    e.edge();
+    CHECK(e.take() && e.take() && !e.take());
+    e.edge();
+    e.end();
+    CHECK(!e.take() && (connected == 0));
+}
+
+int main() {
+    // A vtable pointer, the two list pointers and 8 bytes of state: 20
+    // bytes on the PIC32, where Coroutine.cpp checks it
+    CHECK(sizeof(Coroutine) == 3 * sizeof(void *) + 8);
+
+    order();
+    running();
+    timeouts();
+    notifications();
+    removal();
+    edges();
+    return test_summary("coroutine");
+}
@@ -0,0 +1,277 @@
+#include <stdlib.h>
+
+#include "FixedString.h"
+#include "Print.h"
+#include "test.h"
+#include "test_io.h"
+
+// FixedString has the String API, so each operation here is done to a
+// String and to a FixedString large enough not to overflow, and the two
+// must agree. Then the parts of FixedString that String does not have:
+// cutting off at the capacity, and never using the heap.
+
+// Linked with --wrap, so every allocation is counted
+static int heapCalls = 0;
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    heapCalls++;
+    return __real_malloc(size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    heapCalls++;
+    return __real_realloc(ptr, size);
+}
+}
+
+// Do the same to s and f and check they still match
+#define BOTH(op) do { s op; f op; CHECK_STR(f.c_str(), s.c_str()); } while (0)
+// Check that the same call on s and f gives the same answer
+#define SAME(call) CHECK((s call) == (f call))
+
+static void construct() {
+    CHECK_STR(FixedString<64>("text").c_str(), String("text").c_str());
+    CHECK_STR(FixedString<64>('c').c_str(), String('c').c_str());
+
+    CHECK_STR(FixedString<64>((unsigned char)200).c_str(), String((unsigned char)200).c_str());
+    CHECK_STR(FixedString<64>((unsigned char)200, 16).c_str(), String((unsigned char)200, 16).c_str());
+
+    int ints[] = { 0, 1, -1, 9, 10, -10, 12345, -12345, 2147483647, -2147483647 - 1 };
+    unsigned char bases[] = { 10, 16, 2, 8, 36 };
+    for (size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); i++) {
+        for (size_t b = 0; b < sizeof(bases); b++) {
+            CHECK_STR(FixedString<64>(ints[i], bases[b]).c_str(), String(ints[i], bases[b]).c_str());
+            CHECK_STR(FixedString<64>((unsigned int)ints[i], bases[b]).c_str(), String((unsigned int)ints[i], bases[b]).c_str());
+            CHECK_STR(FixedString<64>((unsigned long)(uint32_t)ints[i], bases[b]).c_str(),
+                String((unsigned long)(uint32_t)ints[i], bases[b]).c_str());
+        }
+        // A negative long in another base would show the host's 64 bits
+        CHECK_STR(FixedString<64>((long)ints[i]).c_str(), String((long)ints[i]).c_str());
+    }
+
+    double doubles[] = { 0.0, 1.5, -1.5, 3.14159, -0.001, 123456.789, 1e-7 };
+    for (size_t i = 0; i < sizeof(doubles) / sizeof(doubles[0]); i++) {
+        for (unsigned char places = 0; places <= 8; places++) {
+            CHECK_STR(FixedString<64>(doubles[i], places).c_str(), String(doubles[i], places).c_str());
+            CHECK_STR(FixedString<64>((float)doubles[i], places).c_str(), String((float)doubles[i], places).c_str());
+        }
+        CHECK_STR(FixedString<64>(doubles[i]).c_str(), String(doubles[i]).c_str());
+    }
+
+    String str("from a String");
+    FixedString<64> fromString(str);
+    CHECK(fromString == str);
+    CHECK(fromString.toString() == str);
+    FixedString<64> fromFixed(fromString);
+    CHECK(fromFixed == fromString);
+    FixedString<32> otherSize(fromString);
+    CHECK(otherSize == fromString);
+}
+
+static void concat() {
+    String s;
+    FixedString<64> f;
+
+    BOTH(+= "abc");
+    BOTH(+= 'd');
+    BOTH(+= (unsigned char)7);
+    BOTH(+= -42);
+    BOTH(+= 42u);
+    BOTH(+= -100000L);
+    BOTH(+= 100000UL);
+    BOTH(+= String("S"));
+    BOTH(.concat(2.5));
+    BOTH(.concat(-2.25f));
+    BOTH(.concat(""));
+    BOTH(= "reset");
+    BOTH(= String("again"));
+    CHECK(s.concat("x") == f.concat("x"));
+    CHECK_STR((f + "+" + 1).c_str(), String(s + "+" + 1).c_str());
+}
+
+static void compare() {
+    const char *words[] = { "", "a", "abc", "abd", "ABC", "ab", "b" };
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+        String s(words[i]);
+        FixedString<64> f(words[i]);
+        for (size_t j = 0; j < sizeof(words) / sizeof(words[0]); j++) {
+            String other(words[j]);
+            int a = s.compareTo(other);
+            int b = f.compareTo(other);
+            CHECK(((a < 0) && (b < 0)) || ((a == 0) && (b == 0)) || ((a > 0) && (b > 0)));
+            SAME(.equals(other));
+            SAME(.equalsIgnoreCase(other));
+            SAME(.startsWith(other));
+            SAME(.startsWith(other, 1));
+            SAME(.endsWith(other));
+            CHECK((s == other) == (f == other));
+            CHECK((s != other) == (f != other));
+            CHECK((s < other) == (f < other));
+            CHECK((s > other) == (f > other));
+            CHECK((s <= other) == (f <= other));
+            CHECK((s >= other) == (f >= other));
+        }
+    }
+}
+
+static void search() {
+    String s("hello world, hello moon");
+    FixedString<64> f("hello world, hello moon");
+    const char chars[] = { 'h', 'o', 'l', 'n', 'z', ' ' };
+    const char *strs[] = { "hello", "o", "moon", "lo w", "zz", "" };
+
+    for (unsigned int from = 0; from <= s.length() + 1; from++) {
+        for (size_t i = 0; i < sizeof(chars); i++) {
+            SAME(.indexOf(chars[i], from));
+            SAME(.lastIndexOf(chars[i], from));
+        }
+        for (size_t i = 0; i < sizeof(strs) / sizeof(strs[0]); i++) {
+            SAME(.indexOf(String(strs[i]), from));
+            SAME(.lastIndexOf(String(strs[i]), from));
+        }
+    }
+    for (size_t i = 0; i < sizeof(chars); i++) {
+        SAME(.indexOf(chars[i]));
+        SAME(.lastIndexOf(chars[i]));
+    }
+    for (size_t i = 0; i < sizeof(strs) / sizeof(strs[0]); i++) {
+        SAME(.indexOf(String(strs[i])));
+        SAME(.lastIndexOf(String(strs[i])));
+    }
+
+    for (unsigned int a = 0; a <= s.length() + 2; a += 3) {
+        for (unsigned int b = 0; b <= s.length() + 2; b += 2) {
+            CHECK_STR(f.substring(a, b).c_str(), s.substring(a, b).c_str());
+        }
+        CHECK_STR(f.substring(a).c_str(), s.substring(a).c_str());
+    }
+}
+
+static void edit() {
+    String s("  The quick brown fox  ");
+    FixedString<64> f("  The quick brown fox  ");
+
+    BOTH(.trim());
+    BOTH(.toUpperCase());
+    BOTH(.toLowerCase());
+    BOTH(.replace('o', '0'));
+    BOTH(.replace("quick", "slow"));
+    BOTH(.replace(" ", ""));
+    BOTH(.replace("w", "ww"));
+    BOTH(.replace("nothing", "x"));
+    BOTH(.remove(3, 2));
+    BOTH(.remove(5));
+    BOTH(.remove(50));
+    BOTH(.remove(0, 100));
+
+    BOTH(= "\t\r\n ");
+    BOTH(.trim());
+    BOTH(= "abcdef");
+    BOTH(.setCharAt(2, 'X'));
+    BOTH(.setCharAt(20, 'Y'));
+    for (unsigned int i = 0; i < 8; i++) {
+        SAME(.charAt(i));
+        CHECK(((const String &)s)[i] == ((const FixedString<64> &)f)[i]);
+    }
+    s[0] = 'Z';
+    f[0] = 'Z';
+    CHECK(f == s);
+
+    char a[4], b[4];
+    for (unsigned int index = 0; index < 8; index++) {
+        memset(a, '#', sizeof(a));
+        memset(b, '#', sizeof(b));
+        s.toCharArray(a, sizeof(a), index);
+        f.toCharArray(b, sizeof(b), index);
+        CHECK(memcmp(a, b, sizeof(a)) == 0);
+    }
+}
+
+static void numbers() {
+    const char *texts[] = { "0", "42", "-17", "  12abc", "abc", "2147483647", "3.75", "-0.5e2", "" };
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+        String s(texts[i]);
+        FixedString<64> f(texts[i]);
+        SAME(.toInt());
+        SAME(.toFloat());
+    }
+}
+
+static void overflow() {
+    FixedString<8> f("1234");
+    CHECK(f.capacity() == 8);
+    CHECK(f.concat("5678"));
+    CHECK(!f.overflowed());
+    CHECK(!f.concat("9"));
+    CHECK(f.overflowed());
+    CHECK_STR(f.c_str(), "12345678");
+    CHECK(f.length() == 8);
+    f.clearOverflow();
+    CHECK(!f.overflowed());
+
+    f = "0123456789";
+    CHECK_STR(f.c_str(), "01234567");
+    CHECK(f.overflowed());
+
+    FixedString<8> g("aXbXc");
+    g.replace("X", "---");
+    CHECK_STR(g.c_str(), "a---b---");
+    CHECK(g.overflowed());
+
+    FixedString<8> h(-1234567890);
+    CHECK_STR(h.c_str(), "-1234567");
+    CHECK(h.overflowed());
+
+    // a + b has the size of a
+    FixedString<4> small("ab");
+    CHECK_STR((small + "cdef").c_str(), "abcd");
+    CHECK((small + "cdef").overflowed());
+    CHECK(!small.overflowed());
+}
+
+static void print() {
+    Capture out;
+    FixedString<16> f("value=");
+    f += 12;
+    out.print(f);
+    out.println(FixedString<4>("ok"));
+    CHECK_STR(out.text, "value=12ok\r\n");
+}
+
+static void noHeap() {
+    heapCalls = 0;
+    FixedString<48> f("start");
+    for (int i = 0; i < 10; i++) {
+        f += i;
+        f += ',';
+    }
+    f.replace(",", ";");
+    f.toUpperCase();
+    f.trim();
+    FixedString<48> g = f.substring(2, 10) + f;
+    g.remove(3, 4);
+    (void)g.indexOf("5;");
+    (void)g.toInt();
+    CHECK(heapCalls == 0);
+
+    // And the check itself works
+    String s("a string long enough not to fit inline");
+    CHECK(heapCalls > 0);
+}
+
+int main() {
+    construct();
+    concat();
+    compare();
+    search();
+    edit();
+    numbers();
+    overflow();
+    print();
+    noHeap();
+    return test_summary("fixed string");
+}
@@ -0,0 +1,218 @@
+#include <stdlib.h>
+
+#include "sdk/frame.h"
+#include "test.h"
+
+// The codec of sdk/drivers/frame.c in a loopback. Payloads of every length
+// up to a few blocks, with and without zeros, are framed whole and in
+// pieces and decoded again a byte at a time. Frames from the encoder in
+// tools/frame_decode.py are checked byte for byte, and frames with a bit
+// flipped must be counted as errors and never delivered.
+
+static uint32_t next_random(uint32_t *x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+static size_t from_hex(const char *hex, uint8_t *out) {
+    size_t n = 0;
+    for (; hex[0] && hex[1]; hex += 2) {
+        char byte[3] = { hex[0], hex[1], 0 };
+        out[n++] = (uint8_t)strtoul(byte, NULL, 16);
+    }
+    return n;
+}
+
+// Collects what the encoder writes
+typedef struct {
+    uint8_t data[2048];
+    size_t len;
+    size_t largest;
+} Sink;
+
+static void sink_write(void *ctx, const uint8_t *data, size_t len) {
+    Sink *s = (Sink *)ctx;
+    if (s->len + len <= sizeof(s->data)) memcpy(s->data + s->len, data, len);
+    s->len += len;
+    if (len > s->largest) s->largest = len;
+}
+
+// Payloads of the kinds that matter to COBS
+enum { FillRandom, FillZeros, FillZeroRuns, FillNoZeros, FillKinds };
+
+static void fill(uint8_t *p, size_t len, int kind, uint32_t *x) {
+    for (size_t i = 0; i < len; i++) {
+        switch (kind) {
+            case FillRandom: p[i] = (uint8_t)next_random(x); break;
+            case FillZeros: p[i] = 0; break;
+            case FillZeroRuns: p[i] = ((next_random(x) % 8) < 5) ? 0 : (uint8_t)next_random(x); break;
+            default: p[i] = (uint8_t)(next_random(x) % 255) + 1; break;
+        }
+    }
+}
+
+static void known() {
+    uint8_t payload[300], expected[300], frame[300];
+
+    CHECK(frame_crc16(0xFFFF, (const uint8_t *)"123456789", 9) == 0x29B1);
+
+    struct { const char *payload; const char *frame; } vectors[] = {
+        { "", "03ffff00" },
+        { "00", "0103e1f000" },
+        { "0000", "0101031d0f00" },
+        { "11220033", "0311220433074500" },
+        { "11223344", "071122334459f300" },
+    };
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        size_t len = from_hex(vectors[i].payload, payload);
+        size_t want = from_hex(vectors[i].frame, expected);
+        size_t n = frame_encode(payload, len, frame, sizeof(frame));
+        CHECK((n == want) && (memcmp(frame, expected, n) == 0));
+    }
+
+    // 254 bytes without a zero fill a block, which then needs no zero
+    // after it; one fewer leaves room for the first CRC byte
+    for (int i = 0; i < 254; i++) payload[i] = i + 1;
+    expected[0] = 0xFF;
+    memcpy(expected + 1, payload, 254);
+    from_hex("035c1d00", expected + 255);
+    CHECK((frame_encode(payload, 254, frame, sizeof(frame)) == 259) && (memcmp(frame, expected, 259) == 0));
+    memcpy(expected + 1, payload, 253);
+    from_hex("48029b00", expected + 254);
+    CHECK((frame_encode(payload, 253, frame, sizeof(frame)) == 258) && (memcmp(frame, expected, 258) == 0));
+
+    // A buffer one byte short is refused
+    CHECK(frame_encode(payload, 254, frame, 258) == 0);
+}
+
+static void loopback() {
+    static uint8_t payload[1100];
+    static uint8_t frame[frameENCODED_SIZE(1100)];
+    static uint8_t buf[1100 + 2];
+    frame_decoder_t d;
+    frame_encoder_t e;
+    Sink sink;
+    uint32_t x = 2463534242u;
+    int bad = 0, frames = 0;
+
+    frame_decoder_init(&d, buf, sizeof(buf));
+    for (size_t len = 0; len <= 1100; len += (len < 600) ? 1 : 13) {
+        for (int kind = 0; kind < FillKinds; kind++) {
+            fill(payload, len, kind, &x);
+            size_t n = frame_encode(payload, len, frame, sizeof(frame));
+            if ((n == 0) || (n > frameENCODED_SIZE(len))) bad++;
+            // The delimiter is the only zero
+            if ((memchr(frame, 0, n) != frame + n - 1)) bad++;
+
+            // Built in pieces it must come out the same, a block at a time
+            memset(&sink, 0, sizeof(sink));
+            frame_begin(&e, sink_write, &sink);
+            for (size_t done = 0; done < len; ) {
+                size_t piece = next_random(&x) % 300;
+                if (piece > len - done) piece = len - done;
+                frame_put(&e, payload + done, piece);
+                done += piece;
+            }
+            frame_end(&e);
+            if ((sink.len != n) || (memcmp(sink.data, frame, n) != 0) || (sink.largest > 256)) bad++;
+
+            for (size_t i = 0; i < n; i++) {
+                if (frame_decode(&d, frame[i]) != (i == n - 1)) bad++;
+            }
+            if ((d.length != len) || (memcmp(d.buf, payload, len) != 0)) bad++;
+            frames++;
+        }
+    }
+    CHECK(bad == 0);
+    CHECK((d.stats.frames == (uint32_t)frames) && (d.stats.crcErrors == 0) && (d.stats.formatErrors == 0));
+}
+
+static void resync() {
+    uint8_t payload[64], frame[frameENCODED_SIZE(64)], buf[18];
+    frame_decoder_t d;
+    uint32_t x = 1;
+    int delivered = 0;
+
+    // A frame too big for the buffer is counted and skipped, and the next
+    // one still arrives
+    frame_decoder_init(&d, buf, sizeof(buf));
+    fill(payload, 17, FillRandom, &x);
+    size_t n = frame_encode(payload, 17, frame, sizeof(frame));
+    for (size_t i = 0; i < n; i++) delivered += frame_decode(&d, frame[i]);
+    CHECK((delivered == 0) && (d.stats.overruns == 1));
+    n = frame_encode(payload, 16, frame, sizeof(frame));
+    for (size_t i = 0; i < n; i++) delivered += frame_decode(&d, frame[i]);
+    CHECK((delivered == 1) && (d.length == 16) && (memcmp(buf, payload, 16) == 0));
+
+    // Joining part way through a frame costs that frame only
+    fill(payload, 12, FillZeroRuns, &x);
+    n = frame_encode(payload, 12, frame, sizeof(frame));
+    delivered = 0;
+    for (size_t i = 5; i < n; i++) delivered += frame_decode(&d, frame[i]);
+    for (size_t i = 0; i < n; i++) delivered += frame_decode(&d, frame[i]);
+    CHECK((delivered == 1) && (d.length == 12) && (memcmp(buf, payload, 12) == 0));
+    CHECK(d.stats.crcErrors + d.stats.formatErrors == 1);
+
+    // Empty frames between delimiters are not errors
+    frame_decoder_init(&d, buf, sizeof(buf));
+    frame_decode(&d, 0);
+    frame_decode(&d, 0);
+    CHECK((d.stats.frames == 0) && (d.stats.formatErrors == 0) && (d.stats.crcErrors == 0));
+}
+
+static void corruption() {
+    const int count = 20000;
+    uint8_t payload[64], frame[frameENCODED_SIZE(64)], buf[64 + 2];
+    frame_decoder_t d;
+    uint32_t x = 88172645u;
+    int delivered = 0;
+
+    frame_decoder_init(&d, buf, sizeof(buf));
+    for (int i = 0; i < count; i++) {
+        size_t len = next_random(&x) % 65;
+        fill(payload, len, (i & 1) ? FillZeroRuns : FillRandom, &x);
+        size_t n = frame_encode(payload, len, frame, sizeof(frame));
+        // Any bit of any byte but the delimiter
+        frame[next_random(&x) % (n - 1)] ^= 1 << (next_random(&x) % 8);
+        for (size_t k = 0; k < n; k++) delivered += frame_decode(&d, frame[k]);
+        // A flipped bit that made a zero leaves the rest of the frame to
+        // end at the delimiter, so there is nothing left over for the next
+    }
+    printf("corruption: %d frames damaged, %lu bad CRC, %lu bad COBS, %d delivered\n", count,
+        (unsigned long)d.stats.crcErrors, (unsigned long)d.stats.formatErrors, delivered);
+    CHECK((delivered == 0) && (d.stats.frames == 0));
+    CHECK(d.stats.crcErrors + d.stats.formatErrors >= (uint32_t)count);
+}
+
+static void speed() {
+    const int count = 200000;
+    uint8_t payload[64], frame[frameENCODED_SIZE(64)], buf[64 + 2];
+    frame_decoder_t d;
+    uint32_t x = 7;
+    size_t wire = 0;
+
+    frame_decoder_init(&d, buf, sizeof(buf));
+    fill(payload, sizeof(payload), FillZeroRuns, &x);
+    uint32_t start = micros();
+    for (int i = 0; i < count; i++) {
+        payload[0] = (uint8_t)i;
+        size_t n = frame_encode(payload, sizeof(payload), frame, sizeof(frame));
+        for (size_t k = 0; k < n; k++) frame_decode(&d, frame[k]);
+        wire += n;
+    }
+    uint32_t us = micros() - start;
+    printf("loopback: %d frames of 64 bytes, %.1f bytes on the wire each, %.0f frames/s\n", count,
+        (double)wire / count, count * 1e6 / (us ? us : 1));
+    CHECK(d.stats.frames == (uint32_t)count);
+}
+
+int main() {
+    known();
+    loopback();
+    resync();
+    corruption();
+    speed();
+    return test_summary("frame");
+}
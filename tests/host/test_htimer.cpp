@@ -0,0 +1,191 @@
+#include <stdlib.h>
+
+#include <set>
+#include <utility>
+
+#include "sdk/htimer_heap.h"
+#include "test.h"
+
+// The timer heap of sdk/drivers/htimer_heap.c with 10000 timers, run
+// through the retransmit workload of tools/htimer_bench.py: on every tick
+// the timers due are taken and restarted, and one random timer is reset or
+// stopped. A std::set of the same timers says which must come out next, and
+// every so often the whole heap is checked: each timer's index points back
+// at it, and no timer is due before its parent. The tick count starts just
+// short of the wrap, so the signed comparisons are tested across it.
+
+static uint32_t next_random(uint32_t *x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+enum { Timers = 10000 };
+
+static htimer_t timers[Timers];
+static htimer_t *nodes[Timers];
+static htimer_heap_t heap = { nodes, 0, Timers };
+
+// Expiry times without the wrap, and the timer, in the order they are due
+typedef std::set<std::pair<int64_t, int> > Reference;
+static int64_t due[Timers];
+
+static void callback(htimer_t *timer, void *arg) {
+    (void)timer;
+    (void)arg;
+}
+
+// Each timer where its index says, and not due before its parent
+static bool valid(const htimer_heap_t *h) {
+    for (uint16_t i = 0; i < h->count; i++) {
+        if (h->node[i]->index != i) return false;
+        if ((i > 0) && ((int32_t)(h->node[i]->expiry - h->node[(i - 1) / 2]->expiry) < 0)) return false;
+    }
+    return true;
+}
+
+static void start(Reference &ref, int id, int64_t expiry, uint32_t period) {
+    if (timers[id].index != htimerINACTIVE) ref.erase(std::make_pair(due[id], id));
+    htimer_heap_apply(&heap, &timers[id], htimerCMD_START, (uint32_t)expiry, period);
+    ref.insert(std::make_pair(expiry, id));
+    due[id] = expiry;
+}
+
+static void stop(Reference &ref, int id) {
+    if (timers[id].index != htimerINACTIVE) ref.erase(std::make_pair(due[id], id));
+    htimer_heap_apply(&heap, &timers[id], htimerCMD_STOP, 0, 0);
+}
+
+static void workload() {
+    const int ops = 200000;
+    Reference ref;
+    uint32_t x = 2463534242u;
+    int64_t now = 0xFFFFFFFFu - 50000;
+    int bad = 0, invalid = 0, checks = 0;
+    uint32_t fired = 0, periodic = 0;
+
+    for (int i = 0; i < Timers; i++) {
+        timers[i] = (htimer_t)htimerINIT(callback, NULL);
+        // One in eight is periodic, which the heap rearms itself
+        uint32_t period = ((i % 8) == 0) ? 500 + i % 1000 : 0;
+        start(ref, i, now + 100 + next_random(&x) % 2900, period);
+    }
+    CHECK((heap.count == Timers) && valid(&heap));
+
+    for (int op = 0; op < ops; op++) {
+        now++;
+        while ((heap.count > 0) && ((int32_t)((uint32_t)now - heap.node[0]->expiry) >= 0)) {
+            htimer_t *root = heap.node[0];
+            uint32_t period = root->period;
+            htimer_t *timer = htimer_heap_pop_expired(&heap);
+            int id = (int)(timer - timers);
+            // Ties may come out in either order, so it is the time that must match
+            if ((timer != root) || ref.empty() || (ref.begin()->first != due[id])) bad++;
+            ref.erase(std::make_pair(due[id], id));
+            fired++;
+            if (period != 0) {
+                // Rearmed from its old expiry, so it does not drift
+                if ((timer->index == htimerINACTIVE) || (timer->expiry != (uint32_t)(due[id] + period))) bad++;
+                due[id] += period;
+                ref.insert(std::make_pair(due[id], id));
+                periodic++;
+            } else {
+                if (timer->index != htimerINACTIVE) bad++;
+                start(ref, id, now + 100 + next_random(&x) % 2900, 0);
+            }
+        }
+
+        // A reset or stop of any timer, wherever it is in the heap
+        int id = next_random(&x) % Timers;
+        if ((next_random(&x) % 10) < 8) {
+            start(ref, id, now + 100 + next_random(&x) % 2900, timers[id].period);
+        } else {
+            stop(ref, id);
+            if (timers[id].index != htimerINACTIVE) bad++;
+        }
+        if (heap.count != ref.size()) bad++;
+
+        if ((op % 1000) == 0) {
+            checks++;
+            if (!valid(&heap)) invalid++;
+        }
+    }
+    printf("htimer: %d operations on %d timers, %lu fired (%lu periodic), %d full checks\n", ops, Timers,
+        (unsigned long)fired, (unsigned long)periodic, checks);
+    CHECK(bad == 0);
+    CHECK(invalid == 0);
+    CHECK(valid(&heap));
+    CHECK((uint32_t)now < 0x80000000u);
+
+    // Everything left comes out in order
+    bad = 0;
+    while (heap.count > 0) {
+        htimer_t *timer = heap.node[0];
+        int id = (int)(timer - timers);
+        if (ref.begin()->first != due[id]) bad++;
+        ref.erase(std::make_pair(due[id], id));
+        htimer_heap_remove(&heap, timer);
+    }
+    CHECK((bad == 0) && ref.empty());
+}
+
+static void edges() {
+    htimer_t t[4];
+    htimer_t *n[3];
+    htimer_heap_t h = { n, 0, 3 };
+
+    for (int i = 0; i < 4; i++) t[i] = (htimer_t)htimerINIT(callback, NULL);
+
+    // A full heap refuses a new timer, but can still restart one it has
+    CHECK(htimer_heap_apply(&h, &t[0], htimerCMD_START, 30, 0));
+    CHECK(htimer_heap_apply(&h, &t[1], htimerCMD_START, 10, 0));
+    CHECK(htimer_heap_apply(&h, &t[2], htimerCMD_START, 20, 0));
+    CHECK(!htimer_heap_apply(&h, &t[3], htimerCMD_START, 5, 0));
+    CHECK((h.count == 3) && (t[3].index == htimerINACTIVE) && (h.node[0] == &t[1]));
+    CHECK(htimer_heap_apply(&h, &t[0], htimerCMD_START, 1, 0));
+    CHECK((h.node[0] == &t[0]) && valid(&h));
+
+    // Stopping one that is not running does nothing
+    CHECK(htimer_heap_apply(&h, &t[3], htimerCMD_STOP, 0, 0));
+    CHECK(h.count == 3);
+
+    // The last one and the root
+    CHECK(htimer_heap_apply(&h, h.node[2], htimerCMD_STOP, 0, 0));
+    CHECK(htimer_heap_apply(&h, &t[0], htimerCMD_STOP, 0, 0));
+    CHECK((h.count == 1) && (t[0].index == htimerINACTIVE) && valid(&h));
+
+    // Pushed later than the others, a root sinks
+    CHECK(htimer_heap_apply(&h, &t[0], htimerCMD_START, 15, 0));
+    CHECK(htimer_heap_apply(&h, &t[3], htimerCMD_START, 12, 0));
+    CHECK(htimer_heap_apply(&h, h.node[0], htimerCMD_START, 100, 0));
+    CHECK(valid(&h) && (h.node[0]->expiry == 12));
+}
+
+static void speed() {
+    const int ops = 2000000;
+    uint32_t x = 7;
+    uint32_t now = 0;
+
+    heap.count = 0;
+    for (int i = 0; i < Timers; i++) {
+        timers[i] = (htimer_t)htimerINIT(callback, NULL);
+        htimer_heap_apply(&heap, &timers[i], htimerCMD_START, 100 + next_random(&x) % 2900, 0);
+    }
+    uint32_t start = micros();
+    for (int op = 0; op < ops; op++) {
+        int id = next_random(&x) % Timers;
+        htimer_heap_apply(&heap, &timers[id], htimerCMD_START, now + 100 + next_random(&x) % 2900, 0);
+        now++;
+    }
+    uint32_t us = micros() - start;
+    printf("htimer: %d resets of %d timers, %.0f ns each\n", ops, Timers, us * 1000.0 / ops);
+    CHECK(valid(&heap) && (heap.count == Timers));
+}
+
+int main() {
+    workload();
+    edges();
+    speed();
+    return test_summary("htimer");
+}
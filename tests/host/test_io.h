@@ -0,0 +1,60 @@
+#ifndef _TEST_IO_H
+#define _TEST_IO_H
+
+#include <string.h>
+
+#include "Print.h"
+#include "Stream.h"
+
+// host.cpp's clock, for tests that check how long code waits
+extern "C" {
+extern bool hostVirtualTime;
+extern uint32_t hostMillis;
+extern uint32_t hostDelays;
+}
+
+// A Print that keeps what is written to it, up to a limit
+class Capture : public Print
+{
+    public:
+        char text[1024];
+        size_t len;
+
+        Capture() : len(0) { text[0] = 0; }
+        void clear() { len = 0; text[0] = 0; }
+
+        virtual size_t write(uint8_t c) { return write(&c, 1); }
+        virtual size_t write(const uint8_t *buffer, size_t size) {
+            if (size > sizeof(text) - 1 - len) size = sizeof(text) - 1 - len;
+            if (size > 0) memcpy(text + len, buffer, size);
+            len += size;
+            text[len] = 0;
+            return size;
+        }
+        using Print::write;
+};
+
+// A Stream that reads from a buffer, and has nothing more once that runs
+// out, so reads time out straight away
+class MemoryStream : public Stream
+{
+    private:
+        const uint8_t *_data;
+        size_t _len;
+        size_t _pos;
+
+    public:
+        MemoryStream(const void *data, size_t len) : _data((const uint8_t *)data), _len(len), _pos(0) { setTimeout(0); }
+        void rewind() { _pos = 0; }
+        size_t position() const { return _pos; }
+
+        virtual int available() { return _len - _pos; }
+        virtual int read() { return (_pos < _len) ? _data[_pos++] : -1; }
+        virtual int peek() { return (_pos < _len) ? _data[_pos] : -1; }
+        virtual void flush() {}
+        virtual bool waitAvailable(unsigned long timeout) { (void)timeout; return _pos < _len; }
+        virtual size_t write(uint8_t c) { (void)c; return 0; }
+        using Print::write;
+};
+
+#endif
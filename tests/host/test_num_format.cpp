@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "num_format.h"
+#include "test.h"
+
+// Round trips for num_format. Integers are checked against a counter kept
+// as text and incremented digit by digit, so every value in a range is
+// compared without a second formatter; floats are parsed back and must be
+// within half a unit of the last decimal place of the value.
+//
+// By default every value below 2^24 is checked in base 10, and below 2^16
+// in every base, with the edges of each digit count and a spread of
+// values above. With --exhaustive every 32-bit value is checked in bases
+// 10, 16 and 2, and every float from 1 up to where num_format_float()
+// gives "ovf"; that takes ten minutes or so.
+
+static const char digitChars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+// A number as text, most significant digit first, that can be incremented
+typedef struct {
+    char text[NUM_FORMAT_INT_SIZE];
+    size_t len;
+    uint8_t base;
+} Counter;
+
+static void counter_init(Counter *c, uint8_t base) {
+    c->text[0] = '0';
+    c->text[1] = 0;
+    c->len = 1;
+    c->base = base;
+}
+
+static void counter_increment(Counter *c) {
+    size_t i = c->len;
+    while (i > 0) {
+        i--;
+        const char *d = strchr(digitChars, c->text[i]);
+        if (d - digitChars + 1 < c->base) {
+            c->text[i] = d[1];
+            return;
+        }
+        c->text[i] = '0';
+    }
+    memmove(c->text + 1, c->text, c->len + 1);
+    c->text[0] = '1';
+    c->len++;
+}
+
+// Check num_format_u32() on every value from 0 to the given one
+static uint64_t count_to(Counter *c, uint64_t to) {
+    char buf[NUM_FORMAT_INT_SIZE];
+    uint64_t bad = 0;
+    for (uint64_t v = 0; v <= to; v++) {
+        if (v > 0) counter_increment(c);
+        size_t len = num_format_u32(buf, (uint32_t)v, c->base);
+        if ((len != c->len) || (memcmp(buf, c->text, len + 1) != 0)) {
+            if (bad++ < 5) printf("base %u: %llu gave %s, expected %s\n", c->base, (unsigned long long)v, buf, c->text);
+        }
+    }
+    return bad;
+}
+
+static void counted(uint8_t base, uint64_t to) {
+    Counter c;
+    counter_init(&c, base);
+    CHECK(count_to(&c, to) == 0);
+}
+
+static uint32_t next_random(uint32_t *x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+// One value, parsed back with strtoul
+static int round_trip_u32(uint32_t value, uint8_t base) {
+    char buf[NUM_FORMAT_INT_SIZE];
+    char *end;
+    size_t len = num_format_u32(buf, value, base);
+    if ((len != strlen(buf)) || (len == 0)) return 0;
+    if ((len > 1) && (buf[0] == '0')) return 0;
+    return (strtoul(buf, &end, base) == value) && (*end == 0);
+}
+
+static void integers(bool exhaustive) {
+    char buf[NUM_FORMAT_INT_SIZE];
+    char ref[NUM_FORMAT_INT_SIZE];
+
+    if (exhaustive) {
+        counted(10, UINT32_MAX);
+        counted(16, UINT32_MAX);
+        counted(2, UINT32_MAX);
+    } else {
+        counted(10, (1 << 24) - 1);
+        counted(16, (1 << 24) - 1);
+    }
+    for (uint8_t base = 2; base <= 36; base++) counted(base, 0xFFFF);
+
+    // Either side of every change in the number of digits, in every base
+    for (uint8_t base = 2; base <= 36; base++) {
+        int bad = 0;
+        for (uint64_t power = base; power <= UINT32_MAX; power *= base) {
+            for (int64_t d = -2; d <= 2; d++) {
+                if (!round_trip_u32((uint32_t)(power + d), base)) bad++;
+            }
+        }
+        if (!round_trip_u32(UINT32_MAX, base) || !round_trip_u32(UINT32_MAX - 1, base)) bad++;
+        CHECK(bad == 0);
+    }
+
+    // And a spread of everything else
+    uint32_t x = 2463534242u;
+    int bad = 0;
+    for (int i = 0; i < 2000000; i++) {
+        next_random(&x);
+        if (!round_trip_u32(x, (i % 35) + 2)) bad++;
+        if (!round_trip_u32(x >> (i % 32), 10)) bad++;
+    }
+    CHECK(bad == 0);
+
+    // Signed: a sign only in base 10, and the bits as they are otherwise
+    int32_t ints[] = { 0, 1, -1, 9, -9, 10, -10, 99, -100, 123456789, -123456789, INT32_MAX, INT32_MIN, INT32_MIN + 1 };
+    for (size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); i++) {
+        num_format_i32(buf, ints[i], 10);
+        snprintf(ref, sizeof(ref), "%ld", (long)ints[i]);
+        CHECK_STR(buf, ref);
+        num_format_i32(buf, ints[i], 16);
+        snprintf(ref, sizeof(ref), "%lX", (unsigned long)(uint32_t)ints[i]);
+        CHECK_STR(buf, ref);
+    }
+    bad = 0;
+    for (int i = 0; i < 1000000; i++) {
+        next_random(&x);
+        size_t len = num_format_i32(buf, (int32_t)x, 10);
+        snprintf(ref, sizeof(ref), "%ld", (long)(int32_t)x);
+        if ((len != strlen(ref)) || (strcmp(buf, ref) != 0)) bad++;
+    }
+    CHECK(bad == 0);
+
+    // A base out of range is taken as 10
+    CHECK((num_format_u32(buf, 1234, 0) == 4) && (strcmp(buf, "1234") == 0));
+    CHECK((num_format_u32(buf, 1234, 1) == 4) && (strcmp(buf, "1234") == 0));
+    CHECK((num_format_u32(buf, 1234, 37) == 4) && (strcmp(buf, "1234") == 0));
+    CHECK((num_format_i32(buf, -1234, 255) == 5) && (strcmp(buf, "-1234") == 0));
+
+    // The longest results fit the buffer size given for them
+    CHECK(num_format_u32(buf, UINT32_MAX, 2) == NUM_FORMAT_INT_SIZE - 2);
+    CHECK(num_format_i32(buf, INT32_MIN, 10) == 11);
+}
+
+// Whether text is value to the given number of decimal places: no further
+// from it than half the last place, allowing for the error of scaling a
+// double, and formatted as it should be
+static int check_float(const char *text, double value, uint8_t digits) {
+    const char *dot = strchr(text, '.');
+    if ((digits == 0) != (dot == NULL)) return 0;
+    if ((dot != NULL) && (strlen(dot + 1) != digits)) return 0;
+    long double parsed = strtold(text, NULL);
+    long double half = 0.5L * powl(10.0L, -(long double)digits);
+    long double slack = fabsl((long double)value) * 4e-16L;
+    return fabsl(parsed - (long double)value) <= half + slack;
+}
+
+static void floats(bool exhaustive) {
+    char buf[NUM_FORMAT_FLOAT_SIZE];
+
+    // Rounded half up
+    struct { double value; uint8_t digits; const char *text; } known[] = {
+        { 0.0, 0, "0" }, { 0.0, 2, "0.00" }, { 0.5, 0, "1" }, { 2.5, 0, "3" }, { 1.25, 1, "1.3" },
+        { -1.25, 1, "-1.3" }, { 0.125, 2, "0.13" }, { 9.9999, 3, "10.000" }, { 123.456, 2, "123.46" },
+        { -0.001, 2, "-0.00" }, { 1e-10, 12, "0.000000000100" }, { 3.0, 18, "3.000000000000000000" },
+        { 4294967296.0, 1, "4294967296.0" }, { 1e18, 0, "1000000000000000000" },
+        { 1.7e19, 0, "17000000000000000000" }, { 1.8e19, 2, "ovf" }, { -1.8e19, 2, "-ovf" },
+        { NAN, 2, "nan" }, { INFINITY, 2, "inf" }, { -INFINITY, 2, "inf" }
+    };
+    for (size_t i = 0; i < sizeof(known) / sizeof(known[0]); i++) {
+        size_t len = num_format_float(buf, known[i].value, known[i].digits);
+        CHECK_STR(buf, known[i].text);
+        CHECK(len == strlen(buf));
+    }
+
+    // More places than NUM_FORMAT_FLOAT_DIGITS are not written
+    CHECK(num_format_float(buf, 1.0, 30) == 2 + NUM_FORMAT_FLOAT_DIGITS);
+
+    // The longest result fits the buffer size given for it
+    CHECK(num_format_float(buf, -1.7e19, NUM_FORMAT_FLOAT_DIGITS) < NUM_FORMAT_FLOAT_SIZE);
+
+    // Doubles from 1e-20 to 1.8e19 to every number of places
+    uint32_t x = 88172645u;
+    int bad = 0;
+    for (int i = 0; i < 3000000; i++) {
+        double mantissa = (double)next_random(&x) / 4294967296.0 + 1.0;
+        double value = ldexp(mantissa, (int)(next_random(&x) % 130) - 66);
+        if (fabs(value) >= 1.8e19) continue;
+        if (i & 1) value = -value;
+        uint8_t digits = i % (NUM_FORMAT_FLOAT_DIGITS + 1);
+        num_format_float(buf, value, digits);
+        if (!check_float(buf, value, digits)) {
+            if (bad++ < 5) printf("%.25g to %u places gave %s\n", value, digits, buf);
+        }
+    }
+    CHECK(bad == 0);
+
+    // Nine places are enough to get a float of 1 or more back exactly
+    uint32_t from = 0x3F800000;                 // 1.0
+    uint32_t step = exhaustive ? 1 : 97;
+    bad = 0;
+    for (uint32_t u = from; ; u += step) {
+        float f;
+        memcpy(&f, &u, sizeof(f));
+        if (f >= 1.8e19f) break;
+        num_format_float(buf, f, 9);
+        if (strtof(buf, NULL) != f) {
+            if (bad++ < 5) printf("%.9g gave %s\n", f, buf);
+        }
+        num_format_float(buf, -f, 9);
+        if (strtof(buf, NULL) != -f) bad++;
+    }
+    CHECK(bad == 0);
+}
+
+int main(int argc, char **argv) {
+    bool exhaustive = (argc > 1) && (strcmp(argv[1], "--exhaustive") == 0);
+    integers(exhaustive);
+    floats(exhaustive);
+    return test_summary(exhaustive ? "num format (exhaustive)" : "num format");
+}
@@ -0,0 +1,105 @@
+#include <stdlib.h>
+
+#include "Print.h"
+#include "num_format.h"
+#include "test.h"
+
+// Print's print(), println() and printf() each format into a buffer on the
+// stack and hand it over in one write(), so a port sends a line in one go
+// and other tasks' output does not land in the middle of it.
+
+// Counts the writes it gets, and keeps what they wrote
+class CountingPrint : public Print
+{
+    public:
+        char text[1024];
+        size_t len;
+        int writes;
+        size_t largest;
+
+        CountingPrint() { clear(); }
+        void clear() { len = 0; writes = 0; largest = 0; text[0] = 0; }
+
+        virtual size_t write(uint8_t c) { return write(&c, 1); }
+        virtual size_t write(const uint8_t *buffer, size_t size) {
+            writes++;
+            if (size > largest) largest = size;
+            if (size > sizeof(text) - 1 - len) size = sizeof(text) - 1 - len;
+            memcpy(text + len, buffer, size);
+            len += size;
+            text[len] = 0;
+            return size;
+        }
+        using Print::write;
+};
+
+static CountingPrint out;
+
+// One write, of what was expected, with the count returned
+#define ONE_WRITE(call, expected) do { \
+    out.clear(); \
+    size_t n = out.call; \
+    CHECK(out.writes == 1); \
+    CHECK_STR(out.text, expected); \
+    CHECK(n == strlen(expected)); \
+} while (0)
+
+static void numbers() {
+    ONE_WRITE(println(-1234567L), "-1234567\r\n");
+    ONE_WRITE(println(2147483647L), "2147483647\r\n");
+    ONE_WRITE(println(0xDEADBEEFUL, HEX), "DEADBEEF\r\n");
+    ONE_WRITE(println(5, BIN), "101\r\n");
+    ONE_WRITE(println((unsigned char)200), "200\r\n");
+    ONE_WRITE(print(-42), "-42");
+    ONE_WRITE(print(0xFFFFFFFFUL, BIN), "11111111111111111111111111111111");
+    ONE_WRITE(println(3.14159f), "3.14\r\n");
+    ONE_WRITE(println(-2.5, 4), "-2.5000\r\n");
+    ONE_WRITE(println(1e12), "ovf\r\n");
+    ONE_WRITE(print(0.1, 0), "0");
+    ONE_WRITE(println('x'), "x\r\n");
+    ONE_WRITE(println("a line"), "a line\r\n");
+    ONE_WRITE(println(String("a String")), "a String\r\n");
+    ONE_WRITE(println(), "\r\n");
+}
+
+static void formatted() {
+    ONE_WRITE(printf("%d items at %s", 3, "noon"), "3 items at noon");
+
+    // Longer than the stack buffer, it is formatted on the heap but still
+    // written once
+    char expected[200];
+    memset(expected, 'y', 150);
+    expected[150] = 0;
+    ONE_WRITE(printf("%s", expected), expected);
+    snprintf(expected, sizeof(expected), "%0150d", 7);
+    ONE_WRITE(printf("%0150d", 7), expected);
+}
+
+// More places than a double holds are zeros, written in pieces that fit
+// the stack buffer
+static void long_floats() {
+    char expected[300];
+    int digits[] = { NUM_FORMAT_FLOAT_DIGITS, NUM_FORMAT_FLOAT_DIGITS + 1, 60, 61, 62, 63, 100, 255 };
+    for (size_t i = 0; i < sizeof(digits) / sizeof(digits[0]); i++) {
+        int d = digits[i];
+        snprintf(expected, sizeof(expected), "%.*f", d, -0.25);
+        out.clear();
+        size_t n = out.print(-0.25, d);
+        CHECK_STR(out.text, expected);
+        CHECK((n == strlen(expected)) && (out.largest <= PRINT_BUFFER_SIZE));
+        CHECK(out.writes == (int)(strlen(expected) + PRINT_BUFFER_SIZE - 3) / (PRINT_BUFFER_SIZE - 2));
+
+        out.clear();
+        n = out.println(1234.75, d);
+        snprintf(expected, sizeof(expected), "%.*f\r\n", d, 1234.75);
+        CHECK_STR(out.text, expected);
+        CHECK((n == strlen(expected)) && (out.largest <= PRINT_BUFFER_SIZE));
+    }
+}
+
+int main() {
+    numbers();
+    formatted();
+    long_floats();
+    return test_summary("print");
+}
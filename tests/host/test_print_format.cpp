@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <math.h>
+
+#include "PrintFormat.h"
+#include "num_format.h"
+#include "test.h"
+#include "test_io.h"
+
+// PRINT_FORMAT against the C library's snprintf, which it should match
+// for everything it supports, apart from %f rounding half up rather than
+// to even and writing zeros after NUM_FORMAT_FLOAT_DIGITS places.
+
+static Capture out;
+
+// Check what PRINT_FORMAT wrote to out, and the count it returned
+#define SAME_AS_PRINTF(fmt, ...) do { \
+    char ref[sizeof(out.text)]; \
+    snprintf(ref, sizeof(ref), fmt, ##__VA_ARGS__); \
+    out.clear(); \
+    size_t n = PRINT_FORMAT(out, fmt, ##__VA_ARGS__); \
+    CHECK_STR(out.text, ref); \
+    CHECK(n == strlen(ref)); \
+} while (0)
+
+static void integers() {
+    int ints[] = { 0, 1, -1, 42, -42, 12345, INT32_MAX, INT32_MIN };
+    for (size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); i++) {
+        int v = ints[i];
+        unsigned int u = (unsigned int)v;
+        SAME_AS_PRINTF("%d|%i|%u", v, v, u);
+        SAME_AS_PRINTF("[%5d][%-5d][%05d][%+d][% d][%+05d]", v, v, v, v, v, v);
+        SAME_AS_PRINTF("%x %X %o %8x %-8X| %08o", u, u, u, u, u, u);
+        SAME_AS_PRINTF("%ld %lu %hd", (long)v, (unsigned long)u, (short)v);
+    }
+    SAME_AS_PRINTF("%c%c%-3c|%3c", 'a', 66, 'c', 'd');
+    SAME_AS_PRINTF("100%% %d%%", 5);
+
+    out.clear();
+    PRINT_FORMAT(out, "%b %08b", 5u, 5u);
+    CHECK_STR(out.text, "101 00000101");
+}
+
+static void strings() {
+    String s("String");
+    FixedString<16> f("Fixed");
+    StringView v("View and more", 4);
+    out.clear();
+    PRINT_FORMAT(out, "%s %s %s %s", "text", s, f, v);
+    CHECK_STR(out.text, "text String Fixed View");
+
+    SAME_AS_PRINTF("[%8s][%-8s][%.3s][%8.2s]", "abc", "abc", "abcdef", "abcdef");
+    const char *none = NULL;
+    out.clear();
+    PRINT_FORMAT(out, "%s", none);
+    CHECK_STR(out.text, "(null)");
+}
+
+static void floats() {
+    double values[] = { 0.0, 1.0, -1.0, 3.14159265, -2.71828, 1234.5678, 0.000123, 1e15 };
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        double v = values[i];
+        SAME_AS_PRINTF("%f %.0f %.2f %.6f", v, v, v, v);
+        SAME_AS_PRINTF("[%10.3f][%-10.3f][%010.3f][%+.1f][% .1f]", v, v, v, v, v);
+    }
+    SAME_AS_PRINTF("%.3f", 1.0f);
+
+    // Places past NUM_FORMAT_FLOAT_DIGITS are zeros
+    SAME_AS_PRINTF("%.25f", 0.5);
+    SAME_AS_PRINTF("%.25f", -3.0);
+    SAME_AS_PRINTF("[%40.25f]", 0.25);
+    SAME_AS_PRINTF("[%-40.25f]", 0.25);
+    SAME_AS_PRINTF("[%040.25f]", -0.25);
+    out.clear();
+    PRINT_FORMAT(out, "%.200f", 1.5);
+    CHECK((out.len == 202) && (strncmp(out.text, "1.5", 3) == 0) && (strspn(out.text + 3, "0") == 199));
+
+    // But not after a value that is not a number
+    out.clear();
+    PRINT_FORMAT(out, "%.25f %.25f", (double)NAN, (double)INFINITY);
+    CHECK_STR(out.text, "nan inf");
+}
+
+static void wide() {
+    // Wider than a uint8_t would hold
+    SAME_AS_PRINTF("%300d", 7);
+    SAME_AS_PRINTF("%-300d|", -7);
+    SAME_AS_PRINTF("%0300x", 0xABCu);
+    SAME_AS_PRINTF("%256s|", "x");
+    SAME_AS_PRINTF("%.200s", "short");
+
+    // Widths past PRINT_FORMAT_MAX_FIELD are cut to it
+    out.clear();
+    PRINT_FORMAT(out, "%99999999d", 1);
+    CHECK(out.len == PRINT_FORMAT_MAX_FIELD);
+    out.clear();
+    PRINT_FORMAT(out, "%.99999999s|", "abc");
+    CHECK_STR(out.text, "abc|");
+}
+
+static void unchecked() {
+    // format() takes a format that is not a literal, and leaves out the
+    // conversions it has no argument for
+    const char *fmt = "%d and %s and %d";
+    out.clear();
+    CHECK(PrintFormat::format(out, fmt, 1, "two") == 14);
+    CHECK_STR(out.text, "1 and two and ");
+}
+
+int main() {
+    integers();
+    strings();
+    floats();
+    wide();
+    unchecked();
+    return test_summary("print format");
+}
@@ -0,0 +1,222 @@
+#include <stdlib.h>
+
+#include <atomic>
+
+#include "sdk/msgpool.h"
+#include "sdk/pubsub.h"
+#include "test.h"
+
+// The event bus of sdk/drivers/pubsub.c with real waits: the test's main()
+// and its helpers are tasks of freertos/kernel.cpp, whose tick is a
+// millisecond. Only topics in a subscriber's filter reach it, a payload
+// published again before it is taken is counted as overwritten, and every
+// subscriber holds its own reference to a payload until it takes or drops
+// it. The msgpool functions are stubbed with blocks that only count their
+// references.
+
+struct Block {
+    int refs;
+};
+
+extern "C" {
+void msgpool_ref(void *msg, uint16_t count) {
+    ((Block *)msg)->refs += count;
+}
+
+void msgpool_free(void *msg) {
+    ((Block *)msg)->refs--;
+}
+
+void msgpool_free_from_isr(void *msg, BaseType_t *woken) {
+    (void)woken;
+    ((Block *)msg)->refs--;
+}
+}
+
+enum { TOPIC_A, TOPIC_B, TOPIC_C };
+
+// Waits, and says how many ticks it took
+static uint32_t timed_wait(pubsub_subscriber_t *sub, TickType_t timeout, TickType_t *elapsed) {
+    TickType_t start = xTaskGetTickCount();
+    uint32_t bits = pubsub_wait(sub, timeout);
+    *elapsed = xTaskGetTickCount() - start;
+    return bits;
+}
+
+// Publishes a topic after a delay
+static void late_publisher(void *arg) {
+    vTaskDelay(50);
+    pubsub_publish((uint8_t)(uintptr_t)arg, NULL);
+    vTaskSuspend(NULL);
+}
+
+static void filtering() {
+    pubsub_subscriber_t sub;
+    TickType_t elapsed;
+
+    CHECK(pubsub_subscribe(&sub, pubsubTOPIC(TOPIC_A)));
+
+    // A topic outside the filter reaches nobody, and the wait times out
+    CHECK(pubsub_publish(TOPIC_B, NULL) == 0);
+    CHECK((timed_wait(&sub, 50, &elapsed) == 0) && (elapsed >= 50));
+    CHECK(pubsub_publish(configPUBSUB_TOPICS, NULL) == 0);
+
+    CHECK(pubsub_publish(TOPIC_A, NULL) == 1);
+    CHECK(timed_wait(&sub, 1000, &elapsed) == pubsubTOPIC(TOPIC_A));
+    CHECK(elapsed < 1000);
+
+    // Widening the filter lets the next one in
+    pubsub_set_filter(&sub, pubsubTOPIC(TOPIC_A) | pubsubTOPIC(TOPIC_B));
+    CHECK(pubsub_publish(TOPIC_B, NULL) == 1);
+    CHECK(pubsub_wait(&sub, 0) == pubsubTOPIC(TOPIC_B));
+    CHECK(pubsub_unsubscribe(&sub) && !pubsub_unsubscribe(&sub));
+}
+
+static void stale_bits() {
+    pubsub_subscriber_t sub;
+    TickType_t elapsed;
+    TaskHandle_t helper;
+
+    // Published, then dropped from the filter before the wait: the
+    // notification it left must not end the wait early
+    CHECK(pubsub_subscribe(&sub, pubsubTOPIC(TOPIC_A) | pubsubTOPIC(TOPIC_B)));
+    CHECK(pubsub_publish(TOPIC_B, NULL) == 1);
+    pubsub_set_filter(&sub, pubsubTOPIC(TOPIC_A));
+    CHECK(timed_wait(&sub, 100, &elapsed) == 0);
+    printf("pubsub: a wait of 100 ticks woken by a dropped topic returned after %lu\n", (unsigned long)elapsed);
+    CHECK(elapsed >= 100);
+
+    // Still waiting when a wanted topic comes later
+    pubsub_set_filter(&sub, pubsubTOPIC(TOPIC_A) | pubsubTOPIC(TOPIC_B));
+    CHECK(pubsub_publish(TOPIC_B, NULL) == 1);
+    pubsub_set_filter(&sub, pubsubTOPIC(TOPIC_A));
+    CHECK(xTaskCreate(late_publisher, "late", configMINIMAL_STACK_SIZE, (void *)(uintptr_t)TOPIC_A,
+        tskIDLE_PRIORITY + 1, &helper) == pdPASS);
+    CHECK(timed_wait(&sub, 1000, &elapsed) == pubsubTOPIC(TOPIC_A));
+    CHECK((elapsed >= 40) && (elapsed < 1000));
+    pubsub_unsubscribe(&sub);
+}
+
+static void overwrites() {
+    pubsub_subscriber_t sub;
+    pubsub_stats_t stats;
+    Block first = { 1 }, second = { 1 };
+
+    pubsub_reset_stats();
+    CHECK(pubsub_subscribe(&sub, pubsubTOPIC(TOPIC_A)));
+    CHECK((pubsub_publish(TOPIC_A, &first) == 1) && (first.refs == 2));
+    msgpool_free(&first);
+
+    // The newer payload replaces the one not taken, whose reference goes
+    CHECK((pubsub_publish(TOPIC_A, &second) == 1) && (second.refs == 2));
+    msgpool_free(&second);
+    CHECK((first.refs == 0) && (second.refs == 1));
+    CHECK(pubsub_get_stats(TOPIC_A, &stats));
+    CHECK((stats.published == 2) && (stats.overwritten == 1));
+
+    // Reported once, with the latest payload
+    CHECK(pubsub_wait(&sub, 0) == pubsubTOPIC(TOPIC_A));
+    CHECK(pubsub_wait(&sub, 0) == 0);
+    CHECK(pubsub_take(&sub, TOPIC_A) == &second);
+    CHECK(pubsub_take(&sub, TOPIC_A) == NULL);
+    msgpool_free(&second);
+    CHECK(second.refs == 0);
+
+    // Reported but not taken is still overwritten
+    Block third = { 1 };
+    CHECK(pubsub_publish(TOPIC_A, NULL) == 1);
+    CHECK(pubsub_wait(&sub, 0) == pubsubTOPIC(TOPIC_A));
+    pubsub_publish(TOPIC_A, &third);
+    pubsub_publish(TOPIC_A, NULL);
+    CHECK(third.refs == 1);
+    CHECK(pubsub_get_stats(TOPIC_A, &stats) && (stats.overwritten == 2));
+    pubsub_unsubscribe(&sub);
+}
+
+// A second subscriber, in a task of its own as each must be
+static pubsub_subscriber_t other;
+static std::atomic<bool> otherReady(false);
+
+static void other_subscriber(void *arg) {
+    (void)arg;
+    pubsub_subscribe(&other, pubsubTOPIC(TOPIC_A));
+    otherReady = true;
+    vTaskSuspend(NULL);
+}
+
+static void references() {
+    pubsub_subscriber_t sub;
+    TaskHandle_t helper;
+    Block block = { 1 };
+
+    CHECK(pubsub_subscribe(&sub, pubsubTOPIC(TOPIC_A)));
+    CHECK(xTaskCreate(other_subscriber, "other", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, &helper) == pdPASS);
+    while (!otherReady) vTaskDelay(1);
+
+    // One reference for each subscriber, none copied
+    CHECK((pubsub_publish(TOPIC_A, &block) == 2) && (block.refs == 3));
+
+    // Taken from one, dropped by the other's unsubscribe, and freed by the
+    // publisher
+    CHECK(pubsub_take(&sub, TOPIC_A) == &block);
+    msgpool_free(&block);
+    CHECK(block.refs == 2);
+    CHECK(pubsub_unsubscribe(&other) && (block.refs == 1));
+    msgpool_free(&block);
+    CHECK(block.refs == 0);
+
+    // Unsubscribing drops what the subscriber had not taken
+    Block left = { 1 };
+    pubsub_publish(TOPIC_A, &left);
+    CHECK(pubsub_unsubscribe(&sub) && (left.refs == 1));
+}
+
+static void interrupts() {
+    pubsub_subscriber_t sub;
+    pubsub_stats_t stats;
+    BaseType_t woken = pdFALSE;
+    Block first = { 1 }, second = { 1 };
+
+    pubsub_reset_stats();
+    CHECK(pubsub_subscribe(&sub, pubsubTOPIC(TOPIC_B)));
+    CHECK((pubsub_publish_from_isr(TOPIC_B, &first, &woken) == 1) && (first.refs == 2));
+    CHECK((pubsub_publish_from_isr(TOPIC_B, &second, &woken) == 1) && (first.refs == 1));
+    CHECK(pubsub_publish_from_isr(TOPIC_A, NULL, &woken) == 0);
+
+    // The latency runs from the first publish still pending to the wake
+    vTaskDelay(20);
+    CHECK(pubsub_wait(&sub, 0) == pubsubTOPIC(TOPIC_B));
+    CHECK(pubsub_take(&sub, TOPIC_B) == &second);
+    msgpool_free(&second);
+    CHECK(pubsub_get_stats(TOPIC_B, &stats));
+    printf("pubsub: latency %lu us after a 20 ms delay\n", (unsigned long)stats.latencyMax);
+    CHECK((stats.published == 2) && (stats.delivered == 1) && (stats.overwritten == 1));
+    CHECK((stats.latencyMin == stats.latencyMax) && (stats.latencyMin >= 20000));
+    CHECK(stats.latencyTotal == stats.latencyMin);
+
+    CHECK(pubsub_publish(TOPIC_B, NULL) == 1);
+    CHECK(pubsub_wait(&sub, 0) == pubsubTOPIC(TOPIC_B));
+    CHECK(pubsub_get_stats(TOPIC_B, &stats));
+    CHECK((stats.delivered == 2) && (stats.latencyMin < 20000) && (stats.latencyMax >= 20000));
+    CHECK(!pubsub_get_stats(configPUBSUB_TOPICS, &stats));
+    pubsub_unsubscribe(&sub);
+}
+
+static void full_table() {
+    static pubsub_subscriber_t subs[configPUBSUB_MAX_SUBSCRIBERS + 1];
+
+    for (int i = 0; i < configPUBSUB_MAX_SUBSCRIBERS; i++) CHECK(pubsub_subscribe(&subs[i], pubsubTOPIC(TOPIC_C)));
+    CHECK(!pubsub_subscribe(&subs[configPUBSUB_MAX_SUBSCRIBERS], pubsubTOPIC(TOPIC_C)));
+    CHECK(pubsub_publish(TOPIC_C, NULL) == configPUBSUB_MAX_SUBSCRIBERS);
+    for (int i = 0; i < configPUBSUB_MAX_SUBSCRIBERS; i++) pubsub_unsubscribe(&subs[i]);
+}
+
+int main() {
+    filtering();
+    stale_bits();
+    overwrites();
+    references();
+    interrupts();
+    full_table();
+    return test_summary("pubsub");
+}
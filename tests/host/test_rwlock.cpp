@@ -0,0 +1,258 @@
+#include <stdlib.h>
+
+#include <atomic>
+
+#include "sdk/rwlock.h"
+#include "test.h"
+
+// The reader/writer lock of sdk/drivers/rwlock.c, its readers and writers
+// being tasks of freertos/kernel.cpp, whose tick is a millisecond. Each
+// worker task takes and gives the lock when the test asks it to, so the
+// test can line them up: readers share the lock, a waiting writer keeps new
+// readers out but lends its priority to those inside, and giving up on a
+// timeout puts everything back. A stress run then has readers and writers
+// contend for it freely, checking that a writer is never inside with
+// anyone else. rwlock_benchmark() busy-waits on the core timer and prints
+// to a UART, so it stays on the target.
+
+enum { READ, READ_UNLOCK, WRITE, WRITE_UNLOCK };
+
+static rwlock_t lock;
+
+// A task that takes or gives the lock when asked
+struct Worker {
+    TaskHandle_t task;
+    std::atomic<int> op;
+    std::atomic<int> asked;
+    std::atomic<int> done;
+    TickType_t timeout;
+    int result;
+};
+
+static void worker_task(void *arg) {
+    Worker *w = (Worker *)arg;
+
+    for (;;) {
+        while (w->done == w->asked) vTaskDelay(1);
+        switch (w->op) {
+            case READ: w->result = rwlock_read_lock(&lock, w->timeout); break;
+            case READ_UNLOCK: rwlock_read_unlock(&lock); break;
+            case WRITE: w->result = rwlock_write_lock(&lock, w->timeout); break;
+            case WRITE_UNLOCK: rwlock_write_unlock(&lock); break;
+        }
+        w->done++;
+    }
+}
+
+static void start(Worker *w, UBaseType_t priority) {
+    w->op = READ;
+    w->asked = 0;
+    w->done = 0;
+    w->timeout = portMAX_DELAY;
+    w->result = 0;
+    xTaskCreate(worker_task, "worker", configMINIMAL_STACK_SIZE, w, priority, &w->task);
+}
+
+static void ask(Worker *w, int op) {
+    w->op = op;
+    w->asked++;
+}
+
+// Whether the worker finished what it was asked within ticks
+static bool finished(Worker *w, TickType_t ticks) {
+    TickType_t start = xTaskGetTickCount();
+    while (w->done != w->asked) {
+        if (xTaskGetTickCount() - start >= ticks) return false;
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+// Whether a task's priority becomes priority within ticks
+static bool priority_becomes(TaskHandle_t task, UBaseType_t priority, TickType_t ticks) {
+    TickType_t start = xTaskGetTickCount();
+    while (uxTaskPriorityGet(task) != priority) {
+        if (xTaskGetTickCount() - start >= ticks) return false;
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+static const UBaseType_t low = tskIDLE_PRIORITY + 1;
+static const UBaseType_t high = tskIDLE_PRIORITY + 3;
+
+static Worker reader[3], late, writer, other;
+
+static void sharing() {
+    rwlock_stats_t stats;
+
+    CHECK(rwlock_init(&lock));
+    for (int i = 0; i < 3; i++) start(&reader[i], low);
+    start(&late, low);
+    start(&writer, high);
+    start(&other, high);
+
+    // Readers get in together, without waiting
+    for (int i = 0; i < 3; i++) {
+        ask(&reader[i], READ);
+        CHECK(finished(&reader[i], 1000) && reader[i].result);
+    }
+    CHECK(rwlock_get_stats(&lock, &stats));
+    CHECK((stats.reads == 3) && (stats.maxReaders == 3) && (stats.readContended == 0));
+
+    // A writer gives up on them after its timeout, putting their
+    // priorities back
+    writer.timeout = 30;
+    TickType_t begin = xTaskGetTickCount();
+    ask(&writer, WRITE);
+    CHECK(priority_becomes(reader[0].task, high, 1000));
+    CHECK(finished(&writer, 1000) && !writer.result);
+    CHECK(xTaskGetTickCount() - begin >= 30);
+    for (int i = 0; i < 3; i++) CHECK(uxTaskPriorityGet(reader[i].task) == low);
+    CHECK(rwlock_get_stats(&lock, &stats) && (stats.timeouts == 1) && (stats.writes == 0));
+
+    // And the readers are not kept out after it
+    ask(&late, READ);
+    CHECK(finished(&late, 1000) && late.result);
+    ask(&late, READ_UNLOCK);
+    CHECK(finished(&late, 1000));
+}
+
+static void writer_waiting() {
+    rwlock_stats_t stats;
+
+    rwlock_reset_stats(&lock);
+
+    // Waiting for the readers inside, the writer lends them its priority
+    writer.timeout = portMAX_DELAY;
+    ask(&writer, WRITE);
+    for (int i = 0; i < 3; i++) CHECK(priority_becomes(reader[i].task, high, 1000));
+    CHECK(!finished(&writer, 20));
+
+    // A new reader waits behind the writer, while one already inside gets
+    // in again
+    ask(&late, READ);
+    ask(&reader[0], READ);
+    CHECK(finished(&reader[0], 1000) && reader[0].result);
+    CHECK(!finished(&late, 20));
+
+    // Each reader drops back as it leaves, but one still inside by its
+    // nested lock keeps the priority until it leaves altogether
+    ask(&reader[0], READ_UNLOCK);
+    CHECK(finished(&reader[0], 1000));
+    CHECK(uxTaskPriorityGet(reader[0].task) == high);
+    for (int i = 0; i < 3; i++) {
+        ask(&reader[i], READ_UNLOCK);
+        CHECK(finished(&reader[i], 1000));
+        CHECK(uxTaskPriorityGet(reader[i].task) == low);
+    }
+
+    // The last one out lets the writer in, and the late reader only follows
+    // it
+    CHECK(finished(&writer, 1000) && writer.result);
+    CHECK(!finished(&late, 20));
+    ask(&writer, WRITE_UNLOCK);
+    CHECK(finished(&writer, 1000));
+    CHECK(finished(&late, 1000) && late.result);
+
+    CHECK(rwlock_get_stats(&lock, &stats));
+    printf("rwlock: the late reader waited %lu us, the writer %lu us\n",
+        (unsigned long)stats.readWaitMax, (unsigned long)stats.writeWaitMax);
+    CHECK((stats.writes == 1) && (stats.writeContended == 1) && (stats.readContended == 1));
+    CHECK((stats.readWaitMax >= 20000) && (stats.writeWaitMax >= 20000));
+    ask(&late, READ_UNLOCK);
+    CHECK(finished(&late, 1000));
+}
+
+static void timeouts() {
+    rwlock_stats_t stats;
+
+    // A reader gives up on a writer that holds the lock
+    rwlock_reset_stats(&lock);
+    ask(&writer, WRITE);
+    CHECK(finished(&writer, 1000) && writer.result);
+    late.timeout = 20;
+    ask(&late, READ);
+    CHECK(finished(&late, 1000) && !late.result);
+
+    // As does a writer queued behind it, which must then not keep readers
+    // out
+    other.timeout = 20;
+    ask(&other, WRITE);
+    CHECK(finished(&other, 1000) && !other.result);
+    CHECK((lock.writersWaiting == 0) && (lock.readers == 0));
+    ask(&writer, WRITE_UNLOCK);
+    CHECK(finished(&writer, 1000));
+    ask(&late, READ);
+    CHECK(finished(&late, 1000) && late.result);
+    ask(&late, READ_UNLOCK);
+    CHECK(finished(&late, 1000));
+    CHECK(rwlock_get_stats(&lock, &stats) && (stats.timeouts == 2) && (stats.writes == 1) && (stats.reads == 1));
+}
+
+// Free contention: readers and writers in a loop, each checking who else
+// is inside
+static std::atomic<int> inside_readers(0), inside_writers(0), overlaps(0), stopped(0);
+static std::atomic<bool> stopping(false);
+static std::atomic<uint32_t> total_reads(0), total_writes(0);
+
+static void contender(void *arg) {
+    const bool writes = (arg != NULL);
+    uint32_t x = (uint32_t)(uintptr_t)&x | 1;
+
+    while (!stopping) {
+        if (writes) {
+            rwlock_write_lock(&lock, portMAX_DELAY);
+            if ((++inside_writers != 1) || (inside_readers != 0)) overlaps++;
+            for (volatile int i = 0; i < 200; i++) {}
+            inside_writers--;
+            rwlock_write_unlock(&lock);
+            total_writes++;
+        } else {
+            rwlock_read_lock(&lock, portMAX_DELAY);
+            inside_readers++;
+            if (inside_writers != 0) overlaps++;
+            for (volatile int i = 0; i < 100; i++) {}
+            inside_readers--;
+            rwlock_read_unlock(&lock);
+            total_reads++;
+        }
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        if ((x % 8) == 0) vTaskDelay(0);
+    }
+    stopped++;
+    vTaskSuspend(NULL);
+}
+
+static void stress() {
+    const int readers = 6, writers = 2;
+    rwlock_stats_t stats;
+
+    CHECK(rwlock_init(&lock));
+    for (int i = 0; i < readers + writers; i++) {
+        xTaskCreate(contender, "contender", configMINIMAL_STACK_SIZE, (i < readers) ? NULL : (void *)1, low, NULL);
+    }
+    vTaskDelay(300);
+    stopping = true;
+    while (stopped != readers + writers) vTaskDelay(1);
+
+    CHECK(rwlock_get_stats(&lock, &stats));
+    printf("rwlock: %lu reads and %lu writes in 300 ms, %lu/%lu contended, %u readers at once\n",
+        (unsigned long)total_reads, (unsigned long)total_writes, (unsigned long)stats.readContended,
+        (unsigned long)stats.writeContended, stats.maxReaders);
+    CHECK(overlaps == 0);
+    CHECK((total_reads > 0) && (total_writes > 0));
+    CHECK((stats.reads == total_reads) && (stats.writes == total_writes) && (stats.timeouts == 0));
+    CHECK((lock.readers == 0) && (lock.writer == NULL) && (lock.writersWaiting == 0));
+}
+
+int main() {
+    sharing();
+    writer_waiting();
+    timeouts();
+    stress();
+    CHECK(rwlock_benchmark(0, 1, 1, 10) == 0);
+    return test_summary("rwlock");
+}
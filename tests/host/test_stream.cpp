@@ -0,0 +1,119 @@
+#include <stdlib.h>
+
+#include "Stream.h"
+#include "test_io.h"
+#include "test.h"
+
+// How Stream's timed reads wait. With host.cpp's clock virtual, delay()
+// moves time on instead of sleeping, so a timeout of a second runs at once
+// and the test sees every delay() and available() the wait made. The
+// default waitAvailable() should sleep a tick at a time, looking at
+// available() once for each, and a stream that overrides it to block on its
+// own data source should be left to do so.
+
+// A MemoryStream whose data turns up at a given time, waiting the way the
+// default Stream does and counting how often it is asked
+class LateStream : public MemoryStream
+{
+    public:
+        uint32_t arrives;
+        uint32_t polls;
+
+        LateStream(const char *data, uint32_t at) : MemoryStream(data, strlen(data)), arrives(at), polls(0) { setTimeout(1000); }
+
+        virtual int available() { polls++; return (hostMillis >= arrives) ? MemoryStream::available() : 0; }
+        virtual int read() { return (hostMillis >= arrives) ? MemoryStream::read() : -1; }
+        virtual int peek() { return (hostMillis >= arrives) ? MemoryStream::peek() : -1; }
+        virtual bool waitAvailable(unsigned long timeout) { return Stream::waitAvailable(timeout); }
+};
+
+// One that blocks on its source itself, as a UART or a stream buffer does:
+// the data comes after wake milliseconds, or the source is closed then
+class BlockingStream : public LateStream
+{
+    public:
+        bool closed;
+        int waits;
+
+        BlockingStream(const char *data, uint32_t at, bool c) : LateStream(data, at), closed(c), waits(0) {}
+
+        virtual bool waitAvailable(unsigned long timeout) {
+            waits++;
+            if (hostMillis + timeout < arrives) {
+                hostMillis += timeout;
+                return false;
+            }
+            if (hostMillis < arrives) hostMillis = arrives;
+            return !closed;
+        }
+};
+
+static void start() {
+    hostVirtualTime = true;
+    hostMillis = 5000;
+    hostDelays = 0;
+}
+
+static void sleeps() {
+    // Nothing ever comes: the whole second is slept through a tick at a
+    // time, looking at available() once a tick
+    LateStream empty("", 0);
+    start();
+    CHECK(empty.parseInt() == 0);
+    printf("stream: parseInt() timed out after %lu ms, %lu delay() and %lu available() calls\n",
+        (unsigned long)(hostMillis - 5000), (unsigned long)hostDelays, (unsigned long)empty.polls);
+    CHECK(hostMillis - 5000 == 1000);
+    CHECK(hostDelays == 1000);
+    CHECK(empty.polls <= hostDelays + 2);
+
+    // Data part way through ends the wait when it comes
+    LateStream late("-42\n", 5250);
+    start();
+    CHECK(late.parseInt() == -42);
+    CHECK((hostMillis == 5250) && (hostDelays == 250));
+    CHECK(late.polls <= hostDelays + 2);
+
+    // The timeout is for each character, not the whole read
+    LateStream slow("abc", 5900);
+    char buf[8];
+    start();
+    CHECK(slow.readBytes(buf, 4) == 3);
+    CHECK(hostMillis == 5900 + 1000);
+    CHECK(hostDelays == 1900);
+
+    // With no timeout it does not wait at all
+    LateStream none("", 0);
+    none.setTimeout(0);
+    start();
+    CHECK((none.parseInt() == 0) && (hostDelays == 0) && (hostMillis == 5000));
+}
+
+static void overrides() {
+    char buf[8];
+
+    // A stream that blocks by itself is waited on once, with no delay()
+    BlockingStream blocking("123,", 5300, false);
+    start();
+    CHECK(blocking.parseInt() == 123);
+    CHECK((hostDelays == 0) && (blocking.waits == 1) && (hostMillis == 5300));
+
+    // Told there is nothing coming, the read gives up at once rather than
+    // waiting out the rest of the timeout
+    BlockingStream closed("xyz", 5100, true);
+    start();
+    CHECK(closed.readBytes(buf, 3) == 0);
+    CHECK((hostDelays == 0) && (closed.waits == 1) && (hostMillis == 5100));
+
+    // Timing out in its own wait
+    BlockingStream quiet("9", 9000, false);
+    start();
+    CHECK(quiet.parseInt() == 0);
+    CHECK((hostDelays == 0) && (quiet.waits == 1) && (hostMillis == 6000));
+}
+
+int main() {
+    sleeps();
+    overrides();
+    hostVirtualTime = false;
+    return test_summary("stream");
+}
@@ -0,0 +1,272 @@
+#include <stdlib.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "StreamMux.h"
+#include "test.h"
+
+// StreamMux under load, with its writer and reader tasks and the tasks
+// writing to it all threads of freertos/kernel.cpp. What it sends to the
+// port is cut into random pieces, as a serial port would deliver it, put
+// through frame_decode() and split into channels again. Every line must
+// come out whole, and each task's lines on a channel in the order it wrote
+// them; on the Drop channel every record is either sent whole or counted
+// as dropped whole.
+
+// The serial port: keeps what is written to it, and gives out what the
+// test puts in
+class Port : public Stream
+{
+    private:
+        std::mutex _lock;
+        std::vector<uint8_t> _out;
+        std::vector<uint8_t> _in;
+        size_t _inPos;
+
+    public:
+        Port() : _inPos(0) {}
+
+        virtual size_t write(uint8_t c) { return write(&c, 1); }
+        virtual size_t write(const uint8_t *buffer, size_t size) {
+            std::lock_guard<std::mutex> lock(_lock);
+            _out.insert(_out.end(), buffer, buffer + size);
+            return size;
+        }
+        using Print::write;
+
+        virtual int available() {
+            std::lock_guard<std::mutex> lock(_lock);
+            return _in.size() - _inPos;
+        }
+        virtual int read() {
+            std::lock_guard<std::mutex> lock(_lock);
+            return (_inPos < _in.size()) ? _in[_inPos++] : -1;
+        }
+        virtual int peek() {
+            std::lock_guard<std::mutex> lock(_lock);
+            return (_inPos < _in.size()) ? _in[_inPos] : -1;
+        }
+        virtual void flush() {}
+
+        std::vector<uint8_t> sent() {
+            std::lock_guard<std::mutex> lock(_lock);
+            return _out;
+        }
+        void receive(const uint8_t *data, size_t len) {
+            std::lock_guard<std::mutex> lock(_lock);
+            _in.insert(_in.end(), data, data + len);
+        }
+};
+
+static uint32_t next_random(uint32_t *x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+// Never destroyed, as the mux's tasks still use them while the program exits
+static Port &port = *new Port();
+static StreamMux &mux = *new StreamMux(port);
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+static uint8_t bulkTx[512 + 1];
+#endif
+
+enum { Producers = 6, Lines = 2000, Records = 20000 };
+enum { DropChannel = 3, Channels = 4 };
+
+static std::atomic<int> running(0);
+static uint32_t recordsSent = 0;
+static uint32_t recordBytesSent = 0;
+static uint32_t recordBytesDropped = 0;
+static uint32_t recordsCut = 0;
+
+// Lines of random length to random channels, each in one write()
+static void producerTask(void *arg) {
+    int n = (int)(intptr_t)arg;
+    uint32_t x = 1000 + n;
+    char line[300];
+    for (int i = 0; i < Lines; i++) {
+        int channel = next_random(&x) % DropChannel;
+        int pad = next_random(&x) % 200;
+        int len = snprintf(line, sizeof(line), "task %d line %d %d ", n, i, pad);
+        memset(line + len, 'x', pad);
+        line[len + pad] = '\n';
+        mux.channel(channel).write((const uint8_t *)line, len + pad + 1);
+        if ((i % 64) == 0) vTaskDelay(1);
+    }
+    running--;
+    vTaskDelete(NULL);
+}
+
+// Records in bursts faster than the port takes them, to a channel that drops what does not fit
+static void floodTask(void *arg) {
+    (void)arg;
+    char record[64];
+    for (int i = 0; i < Records; i++) {
+        int len = snprintf(record, sizeof(record), "record %d %08x\n", i, i * 2654435761u);
+        size_t n = mux.channel(DropChannel).write((const uint8_t *)record, len);
+        if (n == (size_t)len) {
+            recordsSent++;
+            recordBytesSent += n;
+        } else {
+            if (n != 0) recordsCut++;
+            recordBytesDropped += len;
+        }
+        if ((i % 100) == 0) vTaskDelay(1);
+    }
+    running--;
+    vTaskDelete(NULL);
+}
+
+// Split what was sent into channels, feeding the decoder random pieces
+static void demux(const std::vector<uint8_t> &wire, std::string *channels, uint32_t *frames, frame_stats_t *stats) {
+    static uint8_t buf[STREAM_MUX_PAYLOAD + 3];
+    frame_decoder_t d;
+    uint32_t x = 99;
+    frame_decoder_init(&d, buf, sizeof(buf));
+    for (size_t pos = 0; pos < wire.size(); ) {
+        size_t n = next_random(&x) % 64 + 1;
+        for (size_t end = (pos + n < wire.size()) ? pos + n : wire.size(); pos < end; pos++) {
+            if (!frame_decode(&d, wire[pos])) continue;
+            if ((d.length < 1) || (d.buf[0] >= Channels)) {
+                channels[Channels].append(1, '?');
+                continue;
+            }
+            channels[d.buf[0]].append((const char *)d.buf + 1, d.length - 1);
+            (*frames)++;
+        }
+    }
+    *stats = d.stats;
+}
+
+static void sent() {
+    std::string channels[Channels + 1];
+    uint32_t frames = 0;
+    frame_stats_t stats;
+    std::vector<uint8_t> wire;
+
+    // Wait for the writer task to send everything
+    size_t size = 0;
+    for (int tries = 0; tries < 100; tries++) {
+        for (int c = 0; c < Channels; c++) mux.channel(c).flush();
+        vTaskDelay(20);
+        wire = port.sent();
+        if ((tries > 0) && (wire.size() == size)) break;
+        size = wire.size();
+    }
+    demux(wire, channels, &frames, &stats);
+    printf("stream mux: %lu bytes in %lu frames, %lu of %d records dropped\n", (unsigned long)wire.size(),
+        (unsigned long)frames, (unsigned long)(Records - recordsSent), Records);
+    CHECK((stats.crcErrors == 0) && (stats.formatErrors == 0) && (stats.overruns == 0));
+    CHECK(channels[Channels].empty());
+
+    // Every line whole, and each task's lines in order on each channel
+    int bad = 0, lines = 0;
+    int last[DropChannel][Producers];
+    memset(last, -1, sizeof(last));
+    for (int c = 0; c < DropChannel; c++) {
+        const std::string &s = channels[c];
+        for (size_t pos = 0; pos < s.size(); ) {
+            size_t end = s.find('\n', pos);
+            if (end == std::string::npos) {
+                bad++;
+                break;
+            }
+            std::string line = s.substr(pos, end - pos);
+            int n, i, pad, len;
+            if ((sscanf(line.c_str(), "task %d line %d %d %n", &n, &i, &pad, &len) != 3) ||
+                (n < 0) || (n >= Producers) || (i <= last[c][n]) ||
+                (line.size() != (size_t)(len + pad)) || (line.find_first_not_of('x', len) != std::string::npos)) {
+                bad++;
+            } else {
+                last[c][n] = i;
+            }
+            lines++;
+            pos = end + 1;
+        }
+    }
+    CHECK(bad == 0);
+    CHECK(lines == Producers * Lines);
+    for (int c = 0; c < DropChannel; c++) CHECK(mux.channel(c).txDropped() == 0);
+
+    // Records sent whole or not at all, still in order
+    const std::string &s = channels[DropChannel];
+    int records = 0, previous = -1;
+    bad = 0;
+    for (size_t pos = 0; pos < s.size(); ) {
+        size_t end = s.find('\n', pos);
+        unsigned int i, hash;
+        int len;
+        if ((end == std::string::npos) ||
+            (sscanf(s.c_str() + pos, "record %u %08x%n", &i, &hash, &len) != 2) || (pos + len != end) ||
+            (hash != i * 2654435761u) || ((int)i <= previous)) {
+            bad++;
+            break;
+        }
+        previous = i;
+        records++;
+        pos = end + 1;
+    }
+    CHECK(bad == 0);
+    CHECK(recordsCut == 0);
+    CHECK((uint32_t)records == recordsSent);
+    CHECK(s.size() == recordBytesSent);
+    CHECK(mux.channel(DropChannel).txDropped() == recordBytesDropped);
+}
+
+// Frames coming in go to their channel's receive buffer
+static void received() {
+    uint8_t frame[frameENCODED_SIZE(STREAM_MUX_PAYLOAD + 1)];
+    uint8_t payload[STREAM_MUX_PAYLOAD + 1];
+    const char *text[] = { "first ", "second ", "third" };
+
+    for (size_t i = 0; i < 3; i++) {
+        payload[0] = 0;
+        memcpy(payload + 1, text[i], strlen(text[i]));
+        port.receive(frame, frame_encode(payload, strlen(text[i]) + 1, frame, sizeof(frame)));
+    }
+    // Channel 7 is not in use, and a broken frame is counted
+    payload[0] = 7;
+    port.receive(frame, frame_encode(payload, 4, frame, sizeof(frame)));
+    static const uint8_t broken[] = { 0x05, 0x01, 0x02, 0x00 };
+    port.receive(broken, sizeof(broken));
+
+    char buf[64];
+    Stream &console = mux.channel(0);
+    console.setTimeout(2000);
+    size_t n = console.readBytes(buf, 18);
+    CHECK((n == 18) && (memcmp(buf, "first second third", 18) == 0));
+    for (int tries = 0; (tries < 200) && (mux.unknownFrames() == 0); tries++) vTaskDelay(5);
+    CHECK(mux.unknownFrames() == 1);
+    CHECK(mux.rxStats().frames == 4);
+    CHECK(mux.rxStats().crcErrors + mux.rxStats().formatErrors == 1);
+}
+
+int main() {
+    CHECK(mux.channel(0).begin(256, 64));
+    CHECK(mux.channel(1).begin(512, 0, 1));
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    CHECK(mux.channel(2).begin(bulkTx, sizeof(bulkTx), NULL, 0));
+#else
+    CHECK(mux.channel(2).begin(512));
+#endif
+    CHECK(mux.channel(DropChannel).begin(200, 0, 0, StreamMuxChannel::Drop));
+    CHECK(!mux.channel(0).begin(16));
+    for (int c = 0; c < DropChannel; c++) mux.channel(c).setTimeout(60000);
+    CHECK(mux.begin());
+
+    running = Producers + 1;
+    for (int n = 0; n < Producers; n++) xTaskCreate(producerTask, "Producer", 256, (void *)(intptr_t)n, 1, NULL);
+    xTaskCreate(floodTask, "Flood", 256, NULL, 1, NULL);
+    while (running > 0) vTaskDelay(10);
+
+    sent();
+    received();
+    return test_summary("stream mux");
+}
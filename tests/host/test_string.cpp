@@ -0,0 +1,139 @@
+#include <stdlib.h>
+#include <utility>
+
+#include "WString.h"
+#include "test.h"
+
+// How often String goes to the heap. Strings of up to STRING_SSO_CAPACITY
+// characters live inside the object, and a buffer that has to grow grows
+// by half again, so appending in a loop allocates a logarithmic number of
+// times.
+
+// Linked with --wrap, so every allocation is counted
+static int heapCalls = 0;
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    heapCalls++;
+    return __real_malloc(size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    heapCalls++;
+    return __real_realloc(ptr, size);
+}
+}
+
+static void inline_strings() {
+    heapCalls = 0;
+    String empty;
+    String s("12345678901");
+    String c('c');
+    String n(-2147483647L);
+    String h(0xFFFFFFFFUL, 16);
+    String f(3.25f, 2);
+    String copy(s);
+    copy = "abc";
+    copy += "defghijk";
+    CHECK(heapCalls == 0);
+    CHECK_STR(s.c_str(), "12345678901");
+    CHECK_STR(n.c_str(), "-2147483647");
+    CHECK_STR(copy.c_str(), "abcdefghijk");
+
+    // One more character is one allocation
+    String longer("123456789012");
+    CHECK(heapCalls == 1);
+    copy += "!";
+    CHECK(heapCalls == 2);
+    CHECK_STR(copy.c_str(), "abcdefghijk!");
+}
+
+static void appending() {
+    String s;
+    heapCalls = 0;
+    for (int i = 0; i < 100; i++) s += 'x';
+    CHECK(s.length() == 100);
+    CHECK(heapCalls <= 6);
+    printf("string: 100 appends took %d allocations\n", heapCalls);
+
+    // reserve() up front takes one, and the appends none
+    String r;
+    heapCalls = 0;
+    r.reserve(100);
+    for (int i = 0; i < 100; i++) r += 'y';
+    CHECK(heapCalls == 1);
+}
+
+static void sums() {
+    String a("t");
+    heapCalls = 0;
+    String r = a + "=" + 123 + "ms";
+    CHECK(heapCalls == 0);
+    CHECK_STR(r.c_str(), "t=123ms");
+
+    // Past the inline size the sum allocates as it grows, not for each of
+    // its six terms: four times here, and once more for the copy into the
+    // result, which copies the sum as it comes back by reference
+    String b("a longer name");
+    heapCalls = 0;
+    String big = b + " = " + 1234567 + " ms, " + 89 + " %";
+    CHECK_STR(big.c_str(), "a longer name = 1234567 ms, 89 %");
+    CHECK(heapCalls <= 5);
+}
+
+static void moves() {
+    // From an inline string the characters are copied, as there is no
+    // buffer to take over, and the source is left empty
+    String small("short");
+    heapCalls = 0;
+    String to(std::move(small));
+    CHECK(heapCalls == 0);
+    CHECK_STR(to.c_str(), "short");
+    CHECK(small.length() == 0);
+
+    // From a heap string the buffer itself moves
+    String large("long enough for the heap");
+    const char *buffer = large.c_str();
+    heapCalls = 0;
+    String taken(std::move(large));
+    CHECK(heapCalls == 0);
+    CHECK(taken.c_str() == buffer);
+    CHECK_STR(taken.c_str(), "long enough for the heap");
+
+    // Assigned to a string whose own heap buffer is big enough, which is
+    // kept
+    String target("another string on the heap");
+    String source("and one more on the heap");
+    buffer = target.c_str();
+    heapCalls = 0;
+    target = std::move(source);
+    CHECK(heapCalls == 0);
+    CHECK(target.c_str() == buffer);
+    CHECK_STR(target.c_str(), "and one more on the heap");
+
+    // Or too small, which is given up for the source's
+    String shorter("sixteen chars...");
+    buffer = taken.c_str();
+    heapCalls = 0;
+    shorter = std::move(taken);
+    CHECK(heapCalls == 0);
+    CHECK(shorter.c_str() == buffer);
+
+    // Or an inline string into a heap buffer big enough for it
+    String inl("tiny");
+    heapCalls = 0;
+    target = std::move(inl);
+    CHECK(heapCalls == 0);
+    CHECK_STR(target.c_str(), "tiny");
+}
+
+int main() {
+    inline_strings();
+    appending();
+    sums();
+    moves();
+    return test_summary("string");
+}
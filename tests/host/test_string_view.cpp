@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "StringView.h"
+#include "Stream.h"
+#include "test.h"
+#include "test_io.h"
+
+// StringView's parsing, against the C library, and Stream::readLine(),
+// which fills the buffers views are usually taken from.
+//
+// With --bench it also times picking three fields out of 100000 NMEA GGA
+// sentences with views against doing it with String's substring() and
+// toFloat().
+
+static uint32_t next_random(uint32_t *x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+// How many doubles apart a and b are
+static uint64_t ulps(double a, double b) {
+    int64_t ia, ib;
+    memcpy(&ia, &a, sizeof(ia));
+    memcpy(&ib, &b, sizeof(ib));
+    if (ia < 0) ia = INT64_MIN - ia;
+    if (ib < 0) ib = INT64_MIN - ib;
+    return (ia > ib) ? (uint64_t)(ia - ib) : (uint64_t)(ib - ia);
+}
+
+static void parse() {
+    long l;
+    unsigned long h;
+    double d;
+
+    CHECK(StringView("-1234").parseInt(l) && (l == -1234));
+    CHECK(StringView("+2147483647").parseInt(l) && (l == 2147483647));
+    CHECK(!StringView("12a").parseInt(l));
+    CHECK(!StringView("").parseInt(l));
+    CHECK(StringView("fF00").parseHex(h) && (h == 0xFF00));
+    CHECK(StringView("0x10").parseHex(h) && (h == 0x10));
+    CHECK(!StringView("0x").parseHex(h));
+    CHECK(StringView("ignored").toInt() == 0);
+
+    const char *good[] = { "0", "-0.5", "+3.25", "1e3", "1.5E-3", ".5", "5.", "0.000001234", "123456789012345678901234" };
+    for (size_t i = 0; i < sizeof(good) / sizeof(good[0]); i++) {
+        CHECK(StringView(good[i]).parseDouble(d) && (ulps(d, strtod(good[i], NULL)) <= 1));
+    }
+    const char *bad[] = { "", "-", ".", "e5", "1e", "1.2.3", "1x", " 1" };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        CHECK(!StringView(bad[i]).parseDouble(d));
+    }
+    CHECK(StringView("1e999").parseDouble(d) && isinf(d));
+    CHECK(StringView("1e-999").parseDouble(d) && (d == 0.0));
+
+    // Seventeen significant digits, which is what it takes to print any
+    // double so it reads back the same, come back within a unit or two of
+    // the last place; the old nine digit mantissa was out by millions
+    char text[64];
+    uint32_t x = 123456789u;
+    uint64_t worst = 0;
+    for (int i = 0; i < 200000; i++) {
+        double mantissa = (double)next_random(&x) / 4294967296.0 + 1.0;
+        double value = ldexp(mantissa, (int)(next_random(&x) % 120) - 60);
+        snprintf(text, sizeof(text), "%.17g", value);
+        if (!StringView(text).parseDouble(d)) worst = UINT64_MAX;
+        else if (ulps(d, value) > worst) worst = ulps(d, value);
+    }
+    CHECK(worst <= 2);
+
+    // And a float gets back exactly what was printed from it
+    int bad_floats = 0;
+    for (int i = 0; i < 200000; i++) {
+        float f = (float)ldexp((double)next_random(&x) / 4294967296.0 + 1.0, (int)(next_random(&x) % 120) - 60);
+        float back;
+        snprintf(text, sizeof(text), "%.9g", f);
+        if (!StringView(text).parseFloat(back) || (back != f)) bad_floats++;
+    }
+    CHECK(bad_floats == 0);
+}
+
+static void tokenize() {
+    StringTokenizer fields(StringView("$GPGGA,,12.5,x"), ',');
+    StringView field;
+    float f;
+    CHECK(fields.next(field) && (field == "$GPGGA"));
+    CHECK(fields.next(field) && field.isEmpty());
+    CHECK(fields.next(field) && field.parseFloat(f) && (f == 12.5f));
+    CHECK(fields.next(field) && (field == "x"));
+    CHECK(!fields.next(field));
+}
+
+static void readLine() {
+    static const char input[] = "first\r\nsecond\n\nlonger than the buffer\nlast";
+    MemoryStream in(input, sizeof(input) - 1);
+    char buf[8];
+    bool complete;
+
+    StringView line = in.readLine(buf, sizeof(buf), complete);
+    CHECK((line == "first") && complete);
+    line = in.readLine(buf, sizeof(buf), complete);
+    CHECK((line == "second") && complete);
+    line = in.readLine(buf, sizeof(buf), complete);
+    CHECK(line.isEmpty() && complete);
+
+    // A line longer than the buffer comes in pieces, and only the last
+    // ends it
+    line = in.readLine(buf, sizeof(buf), complete);
+    CHECK((line == "longer t") && !complete);
+    line = in.readLine(buf, sizeof(buf), complete);
+    CHECK((line == "han the ") && !complete);
+    line = in.readLine(buf, sizeof(buf), complete);
+    CHECK((line == "buffer") && complete);
+
+    // The end of the input is not the end of a line
+    line = in.readLine(buf, sizeof(buf), complete);
+    CHECK((line == "last") && !complete);
+    line = in.readLine(buf, sizeof(buf), complete);
+    CHECK(line.isEmpty() && !complete);
+
+    // Without the flag, and with another terminator
+    static const char fields[] = "a;b";
+    MemoryStream in2(fields, sizeof(fields) - 1);
+    CHECK(in2.readLine(buf, sizeof(buf), ';') == "a");
+    CHECK(in2.readLine(buf, sizeof(buf), ';') == "b");
+}
+
+static void bench() {
+    const int sentences = 100000;
+    static char text[sentences * 80];
+    size_t len = 0;
+
+    for (int i = 0; i < sentences; i++) {
+        len += snprintf(text + len, sizeof(text) - len, "$GPGGA,%02d%02d%02d.00,%02d%02d.%03d,N,%03d%02d.%03d,E,1,08,0.9,%d.%d,M,46.9,M,,*47\n",
+            i / 3600 % 24, i / 60 % 60, i % 60, 48 + i % 3, i % 60, i % 1000, 11 + i % 7, (i * 7) % 60, (i * 13) % 1000,
+            500 + i % 100, i % 10);
+    }
+
+    // Latitude, longitude and altitude, the third, fifth and tenth fields
+    double viewSum = 0;
+    clock_t start = clock();
+    const char *p = text;
+    for (int i = 0; i < sentences; i++) {
+        const char *end = strchr(p, '\n');
+        StringTokenizer fields(StringView(p, end - p), ',');
+        StringView field;
+        float f;
+        for (int n = 0; (n < 10) && fields.next(field); n++) {
+            if (((n == 2) || (n == 4) || (n == 9)) && field.parseFloat(f)) viewSum += f;
+        }
+        p = end + 1;
+    }
+    double viewTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    double stringSum = 0;
+    start = clock();
+    p = text;
+    for (int i = 0; i < sentences; i++) {
+        char line[80];
+        const char *end = strchr(p, '\n');
+        memcpy(line, p, end - p);
+        line[end - p] = 0;
+        String s(line);
+        int from = 0;
+        for (int n = 0; n < 10; n++) {
+            int comma = s.indexOf(',', from);
+            if (comma < 0) break;
+            if ((n == 2) || (n == 4) || (n == 9)) stringSum += s.substring(from, comma).toFloat();
+            from = comma + 1;
+        }
+        p = end + 1;
+    }
+    double stringTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    CHECK(fabs(viewSum - stringSum) <= 1e-6 * fabs(stringSum));
+    printf("string view: %d GGA sentences, three fields each, in %.0f ms with views, %.0f ms with String\n",
+        sentences, viewTime * 1000, stringTime * 1000);
+}
+
+int main(int argc, char **argv) {
+    parse();
+    tokenize();
+    readLine();
+    if ((argc > 1) && (strcmp(argv[1], "--bench") == 0)) bench();
+    return test_summary("string view");
+}
@@ -0,0 +1,8 @@
+#ifndef _HOST_XC_H
+#define _HOST_XC_H
+
+// Stands in for the compiler's <xc.h> and <p32xxxx.h>, which
+// FreeRTOSConfig.h and the drivers include for the PIC32 registers. Code
+// built for the host tests must not use them.
+
+#endif
@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+"""Decode frames sent with sdk/drivers/frame.c or FrameStream.
+
+Each frame on the wire is the payload followed by its CRC-16 (CCITT,
+polynomial 0x1021, initial value 0xFFFF, high byte first), COBS encoded and
+ended with a zero byte. Reads a capture (from a file, or '-' for stdin, so
+a serial port can be piped in) and prints each good frame in hex, then a
+count of the frames dropped for a bad CRC or broken COBS.
+
+    frame_decode.py capture.bin
+    frame_decode.py --selftest              # this script's own loopback
+
+--selftest checks this script's encoder and decoder against each other:
+it measures frames per second, then flips random bits in encoded frames
+and checks that every damaged frame is dropped. The C codec itself is
+tested the same way, and against frames from this encoder, by
+tests/host/test_frame.cpp.
+"""
+
+import argparse
+import os
+import random
+import sys
+import time
+
+
+def _crc_table():
+    table = []
+    for i in range(256):
+        crc = i << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+        table.append(crc & 0xFFFF)
+    return table
+
+
+CRC_TABLE = _crc_table()
+
+
+def crc16(data, crc=0xFFFF):
+    for b in data:
+        crc = ((crc << 8) & 0xFFFF) ^ CRC_TABLE[(crc >> 8) ^ b]
+    return crc
+
+
+def encode(payload):
+    """Frame a payload as frame_encode() does."""
+    crc = crc16(payload)
+    data = bytes(payload) + bytes([crc >> 8, crc & 0xFF])
+    out = bytearray()
+    block = bytearray()
+    for b in data:
+        if b == 0:
+            out.append(len(block) + 1)
+            out += block
+            block = bytearray()
+            continue
+        block.append(b)
+        if len(block) == 254:
+            out.append(255)
+            out += block
+            block = bytearray()
+    out.append(len(block) + 1)
+    out += block
+    out.append(0)
+    return bytes(out)
+
+
+class Decoder:
+    """The decoder from frame.c, fed a chunk of bytes at a time."""
+
+    def __init__(self, size=4096):
+        self.size = size
+        self.frames = 0
+        self.crc_errors = 0
+        self.format_errors = 0
+        self.overruns = 0
+        self.partial = bytearray()
+
+    def feed(self, data):
+        """Yield the payload of each good frame completed by data."""
+        chunks = (bytes(self.partial) + bytes(data)).split(b"\0")
+        self.partial = bytearray(chunks.pop())
+        for chunk in chunks:
+            if not chunk:
+                continue
+            frame = self._unstuff(chunk)
+            if frame is None:
+                self.format_errors += 1
+            elif len(frame) > self.size:
+                self.overruns += 1
+            elif crc16(frame) != 0:
+                self.crc_errors += 1
+            else:
+                self.frames += 1
+                yield frame[:-2]
+
+    @staticmethod
+    def _unstuff(chunk):
+        out = bytearray()
+        i = 0
+        while i < len(chunk):
+            code = chunk[i]
+            end = i + code
+            if end > len(chunk):
+                return None
+            out += chunk[i + 1:end]
+            i = end
+            if code != 0xFF and i < len(chunk):
+                out.append(0)
+        if len(out) < 2:
+            return None
+        return out
+
+
+def selftest(count, size, seed):
+    rng = random.Random(seed)
+    payloads = []
+    for _ in range(count):
+        n = rng.randint(0, size)
+        payloads.append(bytes(rng.choice((0, rng.randrange(256))) for _ in range(n)))
+
+    start = time.perf_counter()
+    stream = b"".join(encode(p) for p in payloads)
+    decoder = Decoder()
+    received = list(decoder.feed(stream))
+    elapsed = time.perf_counter() - start
+    ok = received == payloads
+    print("loopback: %d frames, %d bytes on the wire (%.1f%% overhead), %.0f frames/s %s" % (
+        count, len(stream), 100.0 * (len(stream) / max(1, sum(len(p) for p in payloads)) - 1),
+        count / elapsed, "ok" if ok else "MISMATCH"))
+
+    decoder = Decoder()
+    missed = 0
+    for p in payloads:
+        frame = bytearray(encode(p))
+        k = rng.randrange(len(frame) - 1)
+        frame[k] ^= 1 << rng.randrange(8)
+        # Anything that comes out must not be the frame as sent
+        missed += sum(1 for f in decoder.feed(frame) if f == p)
+        list(decoder.feed(b"\0"))
+    print("corruption: %d frames damaged, %d bad CRC, %d bad COBS, %d passed undetected" % (
+        count, decoder.crc_errors, decoder.format_errors, missed))
+    return ok and missed == 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode COBS/CRC-16 frames")
+    parser.add_argument("file", nargs="?", help="capture file, or - for stdin")
+    parser.add_argument("--selftest", action="store_true", help="run the loopback test of this script's codec")
+    parser.add_argument("--count", type=int, default=20000, help="frames for --selftest")
+    parser.add_argument("--size", type=int, default=64, help="largest payload for --selftest")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    if args.selftest:
+        sys.exit(0 if selftest(args.count, args.size, args.seed) else 1)
+    if args.file is None:
+        parser.error("a capture file is needed")
+
+    f = sys.stdin.buffer if args.file == "-" else open(args.file, "rb")
+    decoder = Decoder()
+    try:
+        while True:
+            data = f.read1(4096) if hasattr(f, "read1") else f.read(4096)
+            if not data:
+                break
+            for frame in decoder.feed(data):
+                print(frame.hex())
+                sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    print("%d frames, %d bad CRC, %d bad COBS" % (
+        decoder.frames, decoder.crc_errors, decoder.format_errors), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
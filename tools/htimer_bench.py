@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""Compare the cost of the htimer heap with the FreeRTOS timer list.
+
+Models a retransmit workload: a number of timers are started, and on every
+step one random timer is either reset (an acknowledgement arrived and the
+next packet was sent), stopped, or left to expire and be restarted. The
+FreeRTOS timer task keeps active timers in a list sorted by expiry, and
+vListInsert() walks it from the start, so the cost of a start or reset is
+the position it is inserted at. sdk/drivers/htimer.c uses a binary min-heap
+with each timer holding its index, so the same operations cost O(log n).
+
+The cost counted is the number of expiry comparisons, which is what
+dominates on the target; the list walk is counted from the insert position
+rather than stepped through, so large runs stay fast. The heap here is a
+model; tests/host/test_htimer.cpp runs the same workload on the C code of
+sdk/drivers/htimer_heap.c, checking it as it goes, and times it.
+
+    htimer_bench.py                         # 10000 timers, 100000 operations
+    htimer_bench.py --timers 200 --ops 50000 --timeout 50 500
+"""
+
+import argparse
+import bisect
+import random
+import sys
+
+
+class Heap:
+    """The heap from htimer_heap.c, counting comparisons."""
+
+    def __init__(self):
+        self.node = []
+        self.index = {}
+        self.compares = 0
+
+    def _before(self, a, b):
+        self.compares += 1
+        return a[0] < b[0]
+
+    def _place(self, timer, i):
+        self.node[i] = timer
+        self.index[timer[1]] = i
+
+    def _sift_up(self, i):
+        timer = self.node[i]
+        while i > 0:
+            parent = (i - 1) // 2
+            if not self._before(timer, self.node[parent]):
+                break
+            self._place(self.node[parent], i)
+            i = parent
+        self._place(timer, i)
+
+    def _sift_down(self, i):
+        timer = self.node[i]
+        count = len(self.node)
+        while True:
+            child = 2 * i + 1
+            if child >= count:
+                break
+            if child + 1 < count and self._before(self.node[child + 1], self.node[child]):
+                child += 1
+            if not self._before(self.node[child], timer):
+                break
+            self._place(self.node[child], i)
+            i = child
+        self._place(timer, i)
+
+    def _update(self, i):
+        timer = self.node[i]
+        self._sift_down(i)
+        if self.index[timer[1]] == i:
+            self._sift_up(i)
+
+    def start(self, tid, expiry):
+        timer = (expiry, tid)
+        if tid in self.index:
+            i = self.index[tid]
+            self.node[i] = timer
+            self._update(i)
+        else:
+            self.node.append(timer)
+            self._place(timer, len(self.node) - 1)
+            self._sift_up(len(self.node) - 1)
+
+    def stop(self, tid):
+        i = self.index.pop(tid, None)
+        if i is None:
+            return
+        last = self.node.pop()
+        if i < len(self.node):
+            self._place(last, i)
+            self._update(i)
+
+    def head(self):
+        return self.node[0] if self.node else None
+
+    def pop(self):
+        timer = self.node[0]
+        self.stop(timer[1])
+        return timer
+
+
+class SortedList:
+    """The FreeRTOS active timer list, counting comparisons of the walk."""
+
+    def __init__(self):
+        self.items = []
+        self.expiry = {}
+        self.compares = 0
+
+    def start(self, tid, expiry):
+        self.stop(tid)
+        # vListInsert() stops at the first item with a later expiry
+        pos = bisect.bisect_right(self.items, (expiry, tid))
+        self.compares += pos + 1
+        self.items.insert(pos, (expiry, tid))
+        self.expiry[tid] = expiry
+
+    def stop(self, tid):
+        # uxListRemove() is O(1) on the target, so it costs no comparisons
+        expiry = self.expiry.pop(tid, None)
+        if expiry is not None:
+            del self.items[bisect.bisect_left(self.items, (expiry, tid))]
+
+    def head(self):
+        return self.items[0] if self.items else None
+
+    def pop(self):
+        timer = self.items[0]
+        self.stop(timer[1])
+        return timer
+
+
+def run(timers, ops, timeout, seed, structure):
+    rng = random.Random(seed)
+    now = 0
+    for tid in range(timers):
+        structure.start(tid, now + rng.randint(*timeout))
+    fired = 0
+    for _ in range(ops):
+        now += 1
+        while structure.head() is not None and structure.head()[0] <= now:
+            _, tid = structure.pop()
+            fired += 1
+            structure.start(tid, now + rng.randint(*timeout))
+        tid = rng.randrange(timers)
+        if rng.random() < 0.8:
+            structure.start(tid, now + rng.randint(*timeout))
+        else:
+            structure.stop(tid)
+    return structure.compares, fired
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--timers", type=int, default=10000)
+    parser.add_argument("--ops", type=int, default=100000)
+    parser.add_argument("--timeout", type=int, nargs=2, default=[100, 3000], metavar=("MIN", "MAX"),
+                        help="range of timeouts in ticks (default 100 3000)")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    print(f"{args.timers} timers, {args.ops} operations, timeouts {args.timeout[0]}-{args.timeout[1]} ticks")
+    print(f"{'structure':<12} {'compares':>14} {'per op':>10} {'fired':>8}")
+    for name, structure in (("sorted list", SortedList()), ("heap", Heap())):
+        compares, fired = run(args.timers, args.ops, args.timeout, args.seed, structure)
+        per_op = compares / (args.ops + fired)
+        print(f"{name:<12} {compares:>14} {per_op:>10.1f} {fired:>8}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
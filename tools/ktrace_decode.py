@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+"""Decode a kernel trace captured with ktrace_dump().
+
+Reads the binary dump (from a file, or '-' for stdin) and prints either a
+timeline of events or a scheduling report with per-task wake-up latency
+(time from being made ready to being switched in) and activation jitter
+(variation in the interval between successive activations).
+
+    ktrace_decode.py trace.bin              # timeline
+    ktrace_decode.py --report trace.bin     # latency / jitter report
+"""
+
+import argparse
+import math
+import struct
+import sys
+
+MAGIC = 0x52544B46
+HEADER = struct.Struct("<IHHIIIIII")
+RECORD = struct.Struct("<IBBH")
+
+EVENTS = {
+    0x00: "NONE",
+    0x01: "SWITCH_IN",
+    0x02: "SWITCH_OUT",
+    0x03: "READY",
+    0x04: "TASK_CREATE",
+    0x05: "TASK_DELETE",
+    0x06: "DELAY",
+    0x07: "DELAY_UNTIL",
+    0x08: "SUSPEND",
+    0x09: "RESUME",
+    0x0A: "PRIORITY_SET",
+    0x0B: "PRIORITY_INHERIT",
+    0x0C: "PRIORITY_DISINHERIT",
+    0x10: "QUEUE_CREATE",
+    0x11: "QUEUE_DELETE",
+    0x12: "QUEUE_SEND",
+    0x13: "QUEUE_SEND_FAILED",
+    0x14: "QUEUE_SEND_ISR",
+    0x15: "QUEUE_RECEIVE",
+    0x16: "QUEUE_RECEIVE_FAILED",
+    0x17: "QUEUE_RECEIVE_ISR",
+    0x18: "QUEUE_PEEK",
+    0x19: "BLOCK_SEND",
+    0x1A: "BLOCK_RECEIVE",
+    0x1B: "BLOCK_PEEK",
+    0x20: "NOTIFY",
+    0x21: "NOTIFY_ISR",
+    0x22: "NOTIFY_WAIT_BLOCK",
+    0x23: "NOTIFY_TAKE_BLOCK",
+    0x30: "TICK",
+}
+
+# Events whose parameter is a task number
+TASK_PARAM = {0x01, 0x03, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x20, 0x21}
+
+
+class Trace:
+    def __init__(self, data):
+        if len(data) < HEADER.size:
+            raise ValueError("dump too short")
+        (magic, version, record_size, capacity, head, self.timer_hz,
+         self.overhead, max_tasks, name_len) = HEADER.unpack_from(data, 0)
+        if magic != MAGIC:
+            raise ValueError("bad magic 0x%08x" % magic)
+        if record_size != RECORD.size:
+            raise ValueError("unsupported record size %d" % record_size)
+        self.version = version
+        self.total = head
+
+        offset = HEADER.size
+        self.names = {}
+        for i in range(max_tasks):
+            raw = data[offset:offset + name_len].split(b"\0", 1)[0]
+            if raw:
+                self.names[i] = raw.decode("ascii", "replace")
+            offset += name_len
+
+        count = min(head, capacity)
+        available = (len(data) - offset) // RECORD.size
+        if available < count:
+            sys.stderr.write("warning: dump truncated, %d of %d records\n" % (available, count))
+            count = available
+
+        # Unwrap the 32 bit core timer into a monotonic tick count
+        self.records = []
+        now = 0
+        last = None
+        for i in range(count):
+            ts, event, task, param = RECORD.unpack_from(data, offset + i * RECORD.size)
+            if last is not None:
+                now += (ts - last) & 0xFFFFFFFF
+            last = ts
+            self.records.append((now, event, task, param))
+
+    def name(self, task):
+        return self.names.get(task, "#%d" % task)
+
+    def us(self, ticks):
+        return ticks * 1000000.0 / self.timer_hz
+
+
+def timeline(trace):
+    for ts, event, task, param in trace.records:
+        label = EVENTS.get(event)
+        if label is None:
+            label = "USER+%d" % (event - 0x80) if event >= 0x80 else "0x%02x" % event
+        if event in TASK_PARAM:
+            arg = trace.name(param)
+        else:
+            arg = "0x%04x" % param
+        print("%12.2f  %-8s  %-20s %s" % (trace.us(ts), trace.name(task), label, arg))
+
+
+def histogram(values, indent="    "):
+    # Power of two buckets in microseconds
+    buckets = {}
+    for v in values:
+        b = 0 if v < 1 else int(math.log2(v)) + 1
+        buckets[b] = buckets.get(b, 0) + 1
+    peak = max(buckets.values())
+    for b in range(min(buckets), max(buckets) + 1):
+        n = buckets.get(b, 0)
+        lo = 0 if b == 0 else 1 << (b - 1)
+        hi = 1 << b
+        print("%s%7d - %-7d us %6d %s" % (indent, lo, hi, n, "#" * int(40 * n / peak)))
+
+
+def summary(label, values):
+    mean = sum(values) / len(values)
+    sd = math.sqrt(sum((v - mean) ** 2 for v in values) / len(values))
+    print("  %s: n=%d min=%.2f mean=%.2f max=%.2f sd=%.2f us" %
+          (label, len(values), min(values), mean, max(values), sd))
+
+
+def report(trace):
+    ready = {}
+    latency = {}
+    activations = {}
+
+    for ts, event, task, param in trace.records:
+        if event == 0x03:
+            ready.setdefault(param, ts)
+        elif event == 0x01:
+            t = ready.pop(param, None)
+            if t is not None:
+                latency.setdefault(param, []).append(trace.us(ts - t))
+                activations.setdefault(param, []).append(ts)
+
+    span = trace.records[-1][0] - trace.records[0][0] if trace.records else 0
+    print("%d records (%d recorded), %.1f ms, timer %d Hz, %d cycles/event" %
+          (len(trace.records), trace.total, trace.us(span) / 1000.0,
+           trace.timer_hz, trace.overhead))
+
+    for task in sorted(set(latency) | set(activations)):
+        print()
+        print("%s" % trace.name(task))
+        lat = latency.get(task, [])
+        if lat:
+            summary("wake latency", lat)
+            histogram(lat)
+        act = activations.get(task, [])
+        if len(act) > 2:
+            periods = [trace.us(b - a) for a, b in zip(act, act[1:])]
+            summary("period", periods)
+            mean = sum(periods) / len(periods)
+            histogram([abs(p - mean) for p in periods])
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode a ktrace dump")
+    parser.add_argument("file", help="binary dump file, or - for stdin")
+    parser.add_argument("--report", action="store_true", help="print latency and jitter report")
+    args = parser.parse_args()
+
+    if args.file == "-":
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.file, "rb") as f:
+            data = f.read()
+
+    try:
+        trace = Trace(data)
+    except ValueError as e:
+        sys.exit("ktrace_decode: %s" % e)
+
+    if args.report:
+        report(trace)
+    else:
+        timeline(trace)
+
+
+if __name__ == "__main__":
+    main()
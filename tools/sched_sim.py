@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""Simulate a periodic task set under fixed priorities and under EDF.
+
+Steps the task set one tick at a time over a hyperperiod (or --ticks) and
+reports, for each policy, deadline misses, worst response times and the
+number of context switches, with the switch overhead as a share of the
+processor for a given switch cost.
+
+Fixed priority scheduling uses the priorities given, or deadline monotonic
+order if none are, and round robins tasks of equal priority using the
+per-priority time slices from --slice (as vTaskSetTimeSlice() would).
+EDF follows sdk/drivers/edf.c: a job released while another job is running
+preempts it briefly to rank itself, which costs two extra switches when it
+is not the earliest deadline, and admission uses the same density test.
+
+    sched_sim.py                            # the example task set
+    sched_sim.py --task ctl:2:5 --task comms:3:10:8 --task log:4:40
+    sched_sim.py --task a:1:4::2 --task b:1:4::2 --slice 2=4 --switch-us 3
+"""
+
+import argparse
+import math
+import sys
+from functools import reduce
+
+EXAMPLE = ["comms:2:10:6", "control:3:10", "logging:4:50", "ui:5:100", "background:10:200"]
+
+
+class Task:
+    def __init__(self, spec):
+        fields = spec.split(":")
+        if len(fields) < 3:
+            raise argparse.ArgumentTypeError(f"task '{spec}' must be NAME:WCET:PERIOD[:DEADLINE[:PRIORITY]]")
+        self.name = fields[0]
+        self.wcet = int(fields[1])
+        self.period = int(fields[2])
+        self.deadline = int(fields[3]) if len(fields) > 3 and fields[3] else self.period
+        self.priority = int(fields[4]) if len(fields) > 4 and fields[4] else None
+        if not 0 < self.wcet <= self.deadline <= self.period:
+            raise argparse.ArgumentTypeError(f"task '{spec}' needs 0 < wcet <= deadline <= period")
+
+
+class Job:
+    def __init__(self, task, release):
+        self.task = task
+        self.release = release
+        self.deadline = release + task.deadline
+        self.left = task.wcet
+
+
+def simulate(tasks, ticks, policy, slices):
+    """Returns per-task (jobs, misses, worst response) and the switch counts."""
+    stats = {t.name: [0, 0, 0] for t in tasks}
+    ready = []
+    running = None
+    used = 0                # Ticks of the current time slice used
+    switches = 0
+    rank_switches = 0
+    order = {}              # Round robin position within each priority
+
+    for now in range(ticks):
+        released = []
+        for t in tasks:
+            if now % t.period == 0:
+                job = Job(t, now)
+                ready.append(job)
+                released.append(job)
+
+        if policy == "edf":
+            choice = min(ready, key=lambda j: (j.deadline, j.release)) if ready else None
+            # Each release that does not become the running job still
+            # preempts the running job to rank itself, then switches back
+            if running is not None and running in ready:
+                rank_switches += 2 * sum(1 for j in released if j is not choice)
+        else:
+            if ready:
+                top = max(j.task.priority for j in ready)
+                level = [j for j in ready if j.task.priority == top]
+                slice_ticks = max(1, slices.get(top, 1))
+                if running in level and (used < slice_ticks or len(level) == 1):
+                    choice = running
+                else:
+                    # Next in round robin order after the one that ran last
+                    last = order.get(top, -1)
+                    level.sort(key=lambda j: tasks.index(j.task))
+                    after = [j for j in level if tasks.index(j.task) > last]
+                    choice = (after or level)[0]
+            else:
+                choice = None
+
+        if choice is not running:
+            if choice is not None:
+                switches += 1
+                order[choice.task.priority] = tasks.index(choice.task)
+            used = 0
+        running = choice
+
+        if running is not None:
+            running.left -= 1
+            used += 1
+            if running.left == 0:
+                ready.remove(running)
+                s = stats[running.task.name]
+                response = now + 1 - running.release
+                s[0] += 1
+                s[2] = max(s[2], response)
+                running = None
+
+        # Jobs still waiting at their deadline have missed it
+        for job in ready:
+            if job.deadline == now + 1 and job.left > 0:
+                stats[job.task.name][1] += 1
+
+    return stats, switches, rank_switches
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--task", action="append", type=Task, metavar="NAME:WCET:PERIOD[:DEADLINE[:PRIORITY]]",
+                        help="a periodic task, times in ticks (repeatable)")
+    parser.add_argument("--slice", action="append", default=[], metavar="PRIORITY=TICKS",
+                        help="time slice for a priority under fixed priorities (repeatable)")
+    parser.add_argument("--ticks", type=int, help="ticks to simulate (default one hyperperiod)")
+    parser.add_argument("--tick-us", type=float, default=1000.0, help="tick period in us (default 1000)")
+    parser.add_argument("--switch-us", type=float, default=2.0, help="cost of one context switch in us (default 2)")
+    args = parser.parse_args()
+
+    tasks = args.task or [Task(s) for s in EXAMPLE]
+    slices = {}
+    for s in args.slice:
+        priority, ticks = s.split("=")
+        slices[int(priority)] = int(ticks)
+
+    # Deadline monotonic where no priority was given: shortest deadline highest
+    by_deadline = sorted({t.deadline for t in tasks}, reverse=True)
+    for t in tasks:
+        if t.priority is None:
+            t.priority = by_deadline.index(t.deadline) + 1
+
+    hyperperiod = reduce(lambda a, b: a * b // math.gcd(a, b), (t.period for t in tasks))
+    ticks = args.ticks or min(hyperperiod, 10_000_000)
+    utilisation = sum(t.wcet / t.period for t in tasks)
+    density = sum(t.wcet / t.deadline for t in tasks)
+    print(f"{len(tasks)} tasks, utilisation {utilisation:.1%}, density {density:.1%}, "
+          f"{ticks} ticks (hyperperiod {hyperperiod})")
+    print(f"EDF admission: {'pass' if density <= 1.0 else 'fail'} (density test)")
+
+    for policy in ("fixed", "edf"):
+        stats, switches, rank_switches = simulate(tasks, ticks, policy, slices)
+        total = switches + rank_switches
+        overhead = total * args.switch_us / (ticks * args.tick_us)
+        print(f"\n{policy}: {switches} switches + {rank_switches} ranking = {total}, "
+              f"{total * 1e6 / (ticks * args.tick_us):.1f}/s, overhead {overhead:.3%}")
+        print(f"  {'task':<12} {'prio':>4} {'jobs':>8} {'misses':>7} {'worst resp':>10} {'deadline':>8}")
+        for t in tasks:
+            jobs, misses, worst = stats[t.name]
+            prio = t.priority if policy == "fixed" else "-"
+            print(f"  {t.name:<12} {prio:>4} {jobs:>8} {misses:>7} {worst:>10} {t.deadline:>8}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
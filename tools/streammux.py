@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+"""Split the channels of a StreamMux apart again.
+
+Reads what a StreamMux sent (from a file, or '-' for stdin, so a serial
+port can be piped in). Each frame is the channel number and its data,
+framed as in sdk/drivers/frame.c. The data of every channel is gathered
+and printed line by line with the channel number in front, or, with
+--channel, only one channel's data is written out as it was sent.
+
+    streammux.py capture.bin                # all channels, one line each
+    streammux.py --channel 2 - < /dev/ttyUSB0 > telemetry.bin
+    streammux.py --selftest                 # this script's demultiplexer
+
+--selftest has a number of producer threads write lines of random length
+to the channels, in pieces, while a writer thread does what the
+StreamMux writer task does. It drains the channels in order of priority,
+up to 128 bytes a frame, and sends the frames in batches. The output is
+then cut into random pieces, as a serial port would deliver it, and
+split apart. The test checks that every channel comes back exactly as it
+was written. It is a model of the writer task, for checking this script;
+StreamMux itself is tested the same way by tests/host/test_stream_mux.cpp.
+"""
+
+import argparse
+import os
+import random
+import sys
+import threading
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from frame_decode import Decoder, encode  # noqa: E402
+
+CHANNELS = 8
+PAYLOAD = 128
+BATCH = 512
+
+
+class Demux:
+    def __init__(self):
+        self.decoder = Decoder(PAYLOAD + 3)
+        self.data = {}
+        self.unknown = 0
+
+    def feed(self, data):
+        """Yield (channel, data) for each frame completed by data."""
+        for frame in self.decoder.feed(data):
+            if not frame:
+                self.unknown += 1
+                continue
+            channel = frame[0]
+            self.data.setdefault(channel, bytearray()).extend(frame[1:])
+            yield channel, bytes(frame[1:])
+
+
+def selftest(producers, lines, seed):
+    rng = random.Random(seed)
+    priorities = [rng.randrange(3) for _ in range(CHANNELS)]
+    buffers = [bytearray() for _ in range(CHANNELS)]
+    locks = [threading.Lock() for _ in range(CHANNELS)]
+    wake = threading.Event()
+    done = threading.Event()
+    wire = []
+    expected = [[] for _ in range(CHANNELS)]
+
+    def producer(n):
+        prng = random.Random(seed * 1000 + n)
+        for i in range(lines):
+            channel = prng.randrange(CHANNELS)
+            text = "task %d line %d %s\n" % (n, i, "x" * prng.randrange(200))
+            data = text.encode()
+            # Like a write() on a channel: under the channel's lock, as
+            # many pieces as the buffer takes
+            with locks[channel]:
+                expected[channel].append(data)
+                while data:
+                    piece = prng.randint(1, len(data))
+                    buffers[channel].extend(data[:piece])
+                    data = data[piece:]
+                    wake.set()
+
+    def writer():
+        last = 0
+        while True:
+            wake.wait(0.01)
+            wake.clear()
+            batch = bytearray()
+            while True:
+                best = None
+                for i in range(1, CHANNELS + 1):
+                    c = (last + i) % CHANNELS
+                    if buffers[c] and (best is None or priorities[c] > priorities[best]):
+                        best = c
+                if best is None:
+                    break
+                last = best
+                with locks[best]:
+                    payload = bytes(buffers[best][:PAYLOAD])
+                    del buffers[best][:PAYLOAD]
+                frame = encode(bytes([best]) + payload)
+                if len(batch) + len(frame) > BATCH:
+                    wire.append(bytes(batch))
+                    batch = bytearray()
+                batch += frame
+            if batch:
+                wire.append(bytes(batch))
+            if done.is_set() and not any(buffers):
+                return
+
+    threads = [threading.Thread(target=producer, args=(n,)) for n in range(producers)]
+    w = threading.Thread(target=writer)
+    w.start()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    done.set()
+    w.join()
+
+    stream = b"".join(wire)
+    demux = Demux()
+    pos = 0
+    frames = 0
+    while pos < len(stream):
+        n = rng.randint(1, 64)
+        frames += sum(1 for _ in demux.feed(stream[pos:pos + n]))
+        pos += n
+
+    ok = True
+    for c in range(CHANNELS):
+        got = bytes(demux.data.get(c, b""))
+        # Lines on a channel stay whole and in the order they were written
+        if got != b"".join(expected[c]):
+            print("channel %d: MISMATCH (%d bytes, expected %d)" % (
+                c, len(got), sum(len(d) for d in expected[c])))
+            ok = False
+    print("%d producers, %d lines, %d bytes in %d frames, %d writes to the port: %s" % (
+        producers, producers * lines, len(stream), frames, len(wire), "ok" if ok else "FAILED"))
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Demultiplex StreamMux output")
+    parser.add_argument("file", nargs="?", help="capture file, or - for stdin")
+    parser.add_argument("--channel", type=int, help="write only this channel's data, unchanged")
+    parser.add_argument("--selftest", action="store_true", help="run the concurrent load test")
+    parser.add_argument("--producers", type=int, default=6, help="threads for --selftest")
+    parser.add_argument("--lines", type=int, default=2000, help="lines per thread for --selftest")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    if args.selftest:
+        sys.exit(0 if selftest(args.producers, args.lines, args.seed) else 1)
+    if args.file is None:
+        parser.error("a capture file is needed")
+
+    f = sys.stdin.buffer if args.file == "-" else open(args.file, "rb")
+    demux = Demux()
+    partial = {}
+    try:
+        while True:
+            data = f.read1(4096) if hasattr(f, "read1") else f.read(4096)
+            if not data:
+                break
+            for channel, payload in demux.feed(data):
+                if args.channel is not None:
+                    if channel == args.channel:
+                        sys.stdout.buffer.write(payload)
+                        sys.stdout.buffer.flush()
+                    continue
+                # Print whole lines only, as a line can span frames
+                text = partial.get(channel, b"") + payload
+                *whole, partial[channel] = text.split(b"\n")
+                for line in whole:
+                    print("[%d] %s" % (channel, line.decode("utf-8", "replace").rstrip("\r")))
+                sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    if args.channel is None:
+        for channel, rest in sorted(partial.items()):
+            if rest:
+                print("[%d] %s" % (channel, rest.decode("utf-8", "replace")))
+    d = demux.decoder
+    print("%d frames, %d bad CRC, %d bad COBS, %d overruns, %d without a channel" % (
+        d.frames, d.crc_errors, d.format_errors, d.overruns, demux.unknown), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""Simulate the MZ port's core timer tick to check it for drift.
+
+Models vPortIncrementTick(): the compare advances by the integer reload
+each tick and the remainder is carried in a fractional accumulator. The
+simulated tick count after the given run time is compared with the ideal
+count, alongside the old reload-only scheme. Late interrupts can be injected
+to check that missed compares are caught up rather than lost.
+
+    tick_drift.py                           # 200 MHz, 1 kHz, 24 hours
+    tick_drift.py --sysclk 252000000 --rate 10000
+    tick_drift.py --late 0.01 --late-max 5 --hours 1
+                                            # 1% of ticks run up to 5 ticks late
+
+Without --late the tick count is calculated directly, otherwise every tick is
+stepped through, which is slow for long runs at high tick rates.
+"""
+
+import argparse
+import random
+import sys
+
+
+def compare_after(n, reload, remainder, rate):
+    """Compare value after n ticks; the accumulator adds floor(n * rem / rate)."""
+    return n * reload + (n * remainder) // rate
+
+
+def count_ticks(core_hz, rate, seconds, accumulate):
+    """Ticks that have fired by the given time when no interrupt is late."""
+    reload = core_hz // rate
+    remainder = core_hz % rate if accumulate else 0
+    end = core_hz * seconds
+    # Largest n whose compare (the time tick n fires) is not after the end
+    lo, hi = 0, end // reload + 1
+    while lo < hi:
+        mid = (lo + hi + 1) // 2
+        if compare_after(mid, reload, remainder, rate) <= end:
+            lo = mid
+        else:
+            hi = mid - 1
+    return lo
+
+
+def simulate(core_hz, rate, seconds, accumulate, late, late_max, seed):
+    """Return (ticks, missed) after running for the given time.
+
+    The core timer is 32 bits but only differences matter to the port, so
+    unbounded integers are used here.
+    """
+    rng = random.Random(seed)
+    reload = core_hz // rate
+    remainder = core_hz % rate if accumulate else 0
+    fraction = 0
+    compare = reload
+    end = core_hz * seconds
+    ticks = 0
+    missed = 0
+
+    if not late:
+        return count_ticks(core_hz, rate, seconds, accumulate), 0
+
+    while compare <= end:
+        # The time at which the interrupt handler reads the count
+        now = compare
+        if late and rng.random() < late:
+            now += rng.randint(1, max(1, int(late_max * reload)))
+
+        while True:
+            ticks += 1
+            compare += reload
+            fraction += remainder
+            if fraction >= rate:
+                fraction -= rate
+                compare += 1
+            if compare > now:
+                break
+            missed += 1
+    return ticks, missed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--sysclk", type=int, default=200000000, help="system clock in Hz")
+    parser.add_argument("--rate", type=int, default=1000, help="configTICK_RATE_HZ")
+    parser.add_argument("--hours", type=float, default=24.0, help="simulated run time")
+    parser.add_argument("--late", type=float, default=0.0, help="fraction of ticks that run late")
+    parser.add_argument("--late-max", type=float, default=3.0, help="how late, in ticks, at most")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    core_hz = args.sysclk // 2
+    seconds = int(args.hours * 3600)
+    ideal = args.rate * seconds
+
+    status = 0
+    for name, accumulate in (("reload only", False), ("accumulator", True)):
+        ticks, missed = simulate(core_hz, args.rate, seconds, accumulate,
+                                 args.late, args.late_max, args.seed)
+        drift = (ticks - ideal) / args.rate
+        print("%-12s ticks %d (ideal %d)  drift %+.6f s  caught up %d" %
+              (name, ticks, ideal, drift, missed))
+        if accumulate and ticks != ideal:
+            status = 1
+    return status
+
+
+if __name__ == "__main__":
+    sys.exit(main())